@@ -10,6 +10,7 @@ const float kEnvMapBlendRatio = 0.35f;
 const float kParallaxHeightScale = 0.01f;
 const float kParallaxMapMinNumLayers = 4.0f;
 const float kParallaxMapMaxNumLayers = 8.0f;
+const int kMaxNumShadowCascades = 4;
 
 /*******************************************************************************
  * Uniform Blocks
@@ -30,17 +31,51 @@ layout(std140) uniform ModelMaterial {
   bool mix_fog_with_skybox;
   bool use_normal;
   bool use_pcf;
+  // Scale of the number of parallax layers of the material tier
+  float parallax_layers_scale;
 }
 model_material;
 
-layout(std140) uniform Lighting {
-  mat4 light_trans;
-  vec3 light_color;
-  vec3 light_pos;
-  vec3 light_intensity;
-  vec3 view_pos;
+layout(std140) uniform CascadedShadows {
+  mat4 light_transes[kMaxNumShadowCascades];
+  vec4 split_depths;
+  int num_cascades;
+}
+cascaded_shadows;
+
+layout(std140) uniform LightClusters {
+  // Number of tiles in x and y, number of slices and number of point lights
+  uvec4 grid_size;
+  // Projection elements P00, P11, P20 and P21
+  vec4 proj_params;
+  // The slice of a view depth is floor(log(depth) * x + y)
+  vec4 slice_params;
 }
-lighting;
+light_clusters;
+
+#include "scene_features.glsl"
+
+/*******************************************************************************
+ * Shader Storage Blocks
+ ******************************************************************************/
+
+struct PointLight {
+  vec4 pos_radius;
+  vec4 color_intensity;
+};
+
+layout(std430, binding = 1) readonly buffer PointLightsBuffer {
+  PointLight point_lights[];
+};
+
+// Offset and number of the lights of each cluster in the light indexes
+layout(std430, binding = 2) readonly buffer ClusterRangesBuffer {
+  uvec2 cluster_ranges[];
+};
+
+layout(std430, binding = 3) readonly buffer ClusterLightIdxsBuffer {
+  uint cluster_light_idxs[];
+};
 
 /*******************************************************************************
  * Textures
@@ -71,11 +106,17 @@ layout(location = 1) in VSTangentLighting {
 vs_tangent_lighting;
 
 layout(location = 8) in VSDepth {
-  vec4 light_space_pos;
+  vec4 world_pos;
   vec4 camera_space_pos;
 }
 vs_depth;
 
+layout(location = 10) in VSLight {
+  flat vec3 color;
+  flat vec3 intensity;
+}
+vs_light;
+
 /*******************************************************************************
  * Outputs
  ******************************************************************************/
@@ -97,7 +138,7 @@ float CheckInsideBox(vec2 coords, vec2 bottom_left, vec2 top_right) {
  ******************************************************************************/
 
 vec3 GetTangentNorm() {
-  if (model_material.use_normals_tex) {
+  if (MATERIAL_USE_NORMALS_TEX) {
     const vec3 norm = vec3(texture(normals_tex, vs_tex.coords));
     return normalize(norm * 2.0f - 1.0f);
   } else {
@@ -132,13 +173,17 @@ vec3 GetViewingDir() {
 
 vec2 CalcParallaxMappingTexCoords(sampler2D tex) {
   const vec2 tex_coords = vs_tex.coords;
-  if (!model_material.use_height_tex) {
+  if (!MATERIAL_USE_HEIGHT_TEX) {
     return tex_coords;
   }
   const vec3 view_dir = GetTangentViewDir();
-  // The more perpendicular of a view direction, the more number of layers
+  // The more perpendicular of a view direction, the more number of layers, and
+  // the reduced material tiers use fewer layers
   const float num_layers =
-      mix(kParallaxMapMaxNumLayers, kParallaxMapMinNumLayers, abs(view_dir.z));
+      max(model_material.parallax_layers_scale *
+              mix(kParallaxMapMaxNumLayers, kParallaxMapMinNumLayers,
+                  abs(view_dir.z)),
+          1.0f);
   // Calculate the height of each layer
   const float layer_height = 1.0f / num_layers;
   // Calculate the amount to shift the texture coordinates per layer
@@ -183,12 +228,30 @@ vec4 GetParallaxMappingColor(sampler2D tex) {
  * Shadow Calculations
  ******************************************************************************/
 
+// Returns -1 when the fragment is farther than all cascades
+int FindShadowCascade() {
+  const float camera_depth = -vs_depth.camera_space_pos.z;
+  for (int i = 0; i < cascaded_shadows.num_cascades; i++) {
+    if (camera_depth < cascaded_shadows.split_depths[i]) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 float CalcShadow() {
   // Set the bias
   const float bias = 1e-4f;
+  // Find the cascade which covers the fragment
+  const int cascade_idx = FindShadowCascade();
+  if (cascade_idx < 0) {
+    return 0.0f;
+  }
+  // Transform into the tile of the cascade
+  const vec4 light_space_pos =
+      cascaded_shadows.light_transes[cascade_idx] * vs_depth.world_pos;
   // Perform perspective divide
-  vec3 proj_coords =
-      vec3(vs_depth.light_space_pos) / vs_depth.light_space_pos.w;
+  vec3 proj_coords = vec3(light_space_pos) / light_space_pos.w;
   // Transform to [0,1] range
   proj_coords = proj_coords * 0.5f + 0.5f;
   // Get depth of current fragment from light's perspective
@@ -198,7 +261,7 @@ float CalcShadow() {
     return 0.0f;
   }
   // Perform PCF
-  if (model_material.use_pcf) {
+  if (MATERIAL_USE_PCF) {
     float shadow = 0.0f;
     const vec2 scale = 1.0f / textureSize(light_depth_map_tex, 0);
     for (float x = -1.0f; x <= 1.0f; x++) {
@@ -222,62 +285,135 @@ float CalcShadow() {
 
 vec4 GetAmbientColor() {
   vec4 tex_color;
-  if (model_material.use_ambient_tex) {
+  if (MATERIAL_USE_AMBIENT_TEX) {
     tex_color = GetParallaxMappingColor(ambient_tex);
   } else {
     tex_color = model_material.ambient_color;
   }
   const vec4 affecting_color =
-      vec4(lighting.light_intensity.x * lighting.light_color, 1.0f);
+      vec4(vs_light.intensity.x * vs_light.color, 1.0f);
   return affecting_color * tex_color;
 }
 
-vec4 GetDiffuseColor() {
-  vec4 tex_color;
-  if (model_material.use_diffuse_tex) {
-    tex_color = GetParallaxMappingColor(diffuse_tex);
+vec4 GetDiffuseTexColor() {
+  if (MATERIAL_USE_DIFFUSE_TEX) {
+    return GetParallaxMappingColor(diffuse_tex);
   } else {
-    tex_color = model_material.diffuse_color;
+    return model_material.diffuse_color;
   }
+}
+
+vec4 GetSpecularTexColor() {
+  if (MATERIAL_USE_SPECULAR_TEX) {
+    return GetParallaxMappingColor(specular_tex);
+  } else {
+    return model_material.specular_color;
+  }
+}
+
+vec4 GetDiffuseColor(const vec4 tex_color) {
   const vec3 norm = GetTangentNorm();
   const vec3 light_dir = GetTangentLightDir();
   float diffuse_strength = max(dot(norm, light_dir), 0.0f);
 
-  if (!model_material.use_normal) {
+  if (!MATERIAL_USE_NORMAL) {
     diffuse_strength = 1.0f;
   }
 
   const vec4 affecting_color =
-      vec4(lighting.light_intensity.y * diffuse_strength * lighting.light_color,
-           1.0f);
+      vec4(vs_light.intensity.y * diffuse_strength * vs_light.color, 1.0f);
   return affecting_color * tex_color;
 }
 
-vec4 GetSpecularColor() {
-  vec4 tex_color;
-  if (model_material.use_specular_tex) {
-    tex_color = GetParallaxMappingColor(specular_tex);
-  } else {
-    tex_color = model_material.specular_color;
-  }
+vec4 GetSpecularColor(const vec4 tex_color) {
   const vec3 norm = GetTangentNorm();
   const vec3 halfway_dir = GetTangentHalfwayDir();
   const float shininess = model_material.shininess;
   float energy_conservation = (8.0f + shininess) / (8.0f * kPi);
   float specular_strength = pow(max(dot(norm, halfway_dir), 0.0f), shininess);
 
-  if (!model_material.use_normal) {
+  if (!MATERIAL_USE_NORMAL) {
     energy_conservation = 1.0f;
     specular_strength = 1.0f;
   }
 
   const vec4 affecting_color =
-      vec4(lighting.light_intensity.z * energy_conservation *
-               specular_strength * lighting.light_color,
+      vec4(vs_light.intensity.z * energy_conservation * specular_strength *
+               vs_light.color,
            1.0f);
   return affecting_color * tex_color;
 }
 
+/*******************************************************************************
+ * Point Light Calculations
+ ******************************************************************************/
+
+// Returns the cluster of the light clusters which covers the fragment
+uint FindLightCluster() {
+  const uvec3 grid_size = light_clusters.grid_size.xyz;
+  const vec4 camera_space_pos = vs_depth.camera_space_pos;
+  const float depth = max(-camera_space_pos.z, 1e-6f);
+  // Project into the NDC to find the tile
+  const vec2 ndc_pos = (light_clusters.proj_params.xy * camera_space_pos.xy +
+                        light_clusters.proj_params.zw * camera_space_pos.z) /
+                       depth;
+  const ivec2 tile = clamp(
+      ivec2(floor((ndc_pos * 0.5f + 0.5f) * vec2(grid_size.xy))), ivec2(0),
+      ivec2(grid_size.xy) - 1);
+  // Find the logarithmic slice
+  const int slice = clamp(int(floor(log(depth) * light_clusters.slice_params.x +
+                                    light_clusters.slice_params.y)),
+                          0, int(grid_size.z) - 1);
+  return (uint(slice) * grid_size.y + uint(tile.y)) * grid_size.x +
+         uint(tile.x);
+}
+
+// Only loops over the lights assigned to the cluster of the fragment
+vec4 CalcPointLightsColor(const vec4 diffuse_tex_color,
+                          const vec4 specular_tex_color) {
+  if (light_clusters.grid_size.w == 0u) {
+    return vec4(0.0f);
+  }
+  const uvec2 cluster_range = cluster_ranges[FindLightCluster()];
+  const mat3 world_to_tang = transpose(vs_tangent_lighting.tang_to_world_conv);
+  const vec3 norm = GetTangentNorm();
+  const vec3 view_dir = GetTangentViewDir();
+  const float shininess = model_material.shininess;
+  const float energy_conservation = (8.0f + shininess) / (8.0f * kPi);
+  vec3 color = vec3(0.0f);
+  for (uint i = 0u; i < cluster_range.y; i++) {
+    const PointLight point_light =
+        point_lights[cluster_light_idxs[cluster_range.x + i]];
+    const vec3 light_pos = world_to_tang * point_light.pos_radius.xyz;
+    const vec3 light_vec = light_pos - vs_tangent_lighting.pos;
+    const float dist = length(light_vec);
+    // Fade out smoothly to zero at the radius
+    const float dist_ratio = dist / point_light.pos_radius.w;
+    const float dist_ratio2 = dist_ratio * dist_ratio;
+    const float window = clamp(1.0f - dist_ratio2 * dist_ratio2, 0.0f, 1.0f);
+    const float attenuation = window * window / (dist * dist + 1.0f);
+    if (attenuation <= 0.0f) {
+      continue;
+    }
+    const vec3 light_dir = light_vec / max(dist, 1e-4f);
+    const vec3 halfway_dir = normalize(light_dir + view_dir);
+    float diffuse_strength = max(dot(norm, light_dir), 0.0f);
+    float specular_strength = energy_conservation *
+                              pow(max(dot(norm, halfway_dir), 0.0f), shininess);
+
+    if (!MATERIAL_USE_NORMAL) {
+      diffuse_strength = 1.0f;
+      specular_strength = 1.0f;
+    }
+
+    const vec3 light_color = point_light.color_intensity.w * attenuation *
+                             point_light.color_intensity.rgb;
+    color += light_color * (diffuse_strength * vec3(diffuse_tex_color) +
+                            specular_strength * vec3(specular_tex_color));
+  }
+  return vec4(color, 0.0f);
+}
+
 /*******************************************************************************
  * Environment Mapping
  ******************************************************************************/
@@ -317,12 +453,18 @@ vec3 HsvToRgb(const vec3 c) {
  ******************************************************************************/
 
 vec4 CalcBlinnPhongShadowColor() {
+  const vec4 diffuse_tex_color = GetDiffuseTexColor();
+  const vec4 specular_tex_color = GetSpecularTexColor();
   const vec4 ambient_color = GetAmbientColor();
-  const vec4 diffuse_color = GetDiffuseColor();
-  const vec4 specular_color = GetSpecularColor();
+  const vec4 diffuse_color = GetDiffuseColor(diffuse_tex_color);
+  const vec4 specular_color = GetSpecularColor(specular_tex_color);
   const vec4 non_shadow = vec4(vec3(1.0f - CalcShadow()), 1.0f);
-  const vec4 color =
-      ambient_color + non_shadow * (diffuse_color + specular_color);
+  // The point lights don't cast shadows
+  const vec4 point_lights_color =
+      CalcPointLightsColor(diffuse_tex_color, specular_tex_color);
+  const vec4 color = ambient_color +
+                     non_shadow * (diffuse_color + specular_color) +
+                     point_lights_color;
   // Check whether to discard the fragment if the alpha is too low
   if (ambient_color.a < kDiscardAlphaHigh) {
     discard;
@@ -333,7 +475,7 @@ vec4 CalcBlinnPhongShadowColor() {
 vec4 MixWithEnvMapColor() {
   // Calculate environment mapping blend ratio
   float env_map_blend_ratio = kEnvMapBlendRatio;
-  if (!model_material.use_env_map) {
+  if (!MATERIAL_USE_ENV_MAP) {
     env_map_blend_ratio = 0.0f;
   }
   // Blend Blinn-Phong color with environment mapped color
@@ -363,7 +505,7 @@ vec4 MixWithFogColor() {
 
   // Move the light of fog color into the hue of skybox color
   vec3 fog_color_hsv = RgbToHsv(kFogColor);
-  if (model_material.mix_fog_with_skybox) {
+  if (MATERIAL_MIX_FOG_WITH_SKYBOX) {
     fog_color_hsv.z +=
         clamp(kMixWithSkyboxRatio * (skybox_color_hsv.z - fog_color_hsv.z),
               (-kMaxFogAdjust), kMaxFogAdjust);
@@ -385,7 +527,7 @@ vec4 MixWithFogColor() {
  ******************************************************************************/
 
 void main() {
-  if (model_material.use_fog) {
+  if (MATERIAL_USE_FOG) {
     fs_color = MixWithFogColor();
   } else {
     fs_color = MixWithEnvMapColor();
@@ -11,11 +11,7 @@ layout(std140) uniform GlobalTrans {
 }
 global_trans;
 
-layout(std140) uniform ModelTrans { mat4 trans; }
-model_trans;
-
 layout(std140) uniform Lighting {
-  mat4 light_trans;
   vec3 light_color;
   vec3 light_pos;
   vec3 light_intensity;
@@ -31,9 +27,8 @@ layout(location = 0) in vec3 in_pos;
 layout(location = 1) in vec2 in_tex_coords;
 layout(location = 2) in vec3 in_norm;
 layout(location = 3) in vec3 in_tangent;
-layout(location = 4) in vec3 in_instancing_translation;
-layout(location = 5) in vec3 in_instancing_rotation;
-layout(location = 6) in vec3 in_instancing_scaling;
+layout(location = 4) in mat3x4 in_instance_model_rows;
+layout(location = 8) in mat3x4 in_instance_normal_rows;
 
 /*******************************************************************************
  * Outputs
@@ -52,83 +47,37 @@ layout(location = 1) out VSTangentLighting {
 vs_tangent_lighting;
 
 layout(location = 8) out VSDepth {
-  vec4 light_space_pos;
+  vec4 world_pos;
   vec4 camera_space_pos;
 }
 vs_depth;
 
-/*******************************************************************************
- * Quaternion Calculations
- ******************************************************************************/
-
-vec4 NormalizeQuat(const vec4 quat) { return normalize(quat); }
-
-// Reference:
-// https://en.wikipedia.org/wiki/Conversion_between_quaternions_and_Euler_angles
-vec4 EulerAnglesToQuat(const vec3 euler_angles) {
-  const float cy = cos(euler_angles.z * 0.5f);
-  const float sy = sin(euler_angles.z * 0.5f);
-  const float cp = cos(euler_angles.y * 0.5f);
-  const float sp = sin(euler_angles.y * 0.5f);
-  const float cr = cos(euler_angles.x * 0.5f);
-  const float sr = sin(euler_angles.x * 0.5f);
-  vec4 quat;
-  quat.w = cy * cp * cr + sy * sp * sr;
-  quat.x = cy * cp * sr - sy * sp * cr;
-  quat.y = sy * cp * sr + cy * sp * cr;
-  quat.z = sy * cp * cr - cy * sp * sr;
-  return quat;
+layout(location = 10) out VSLight {
+  flat vec3 color;
+  flat vec3 intensity;
 }
+vs_light;
 
-// Reference: https://stackoverflow.com/a/1556470
-mat4 QuatToRotationMatrix(vec4 quat) {
-  mat4 rotation_mat;
-  rotation_mat[0] =
-      vec4(1.0f - 2.0f * quat[1] * quat[1] - 2.0f * quat[2] * quat[2],
-           2.0f * quat[0] * quat[1] + 2.0f * quat[2] * quat[3],
-           2.0f * quat[0] * quat[2] - 2.0f * quat[1] * quat[3], 0.0f);
-  rotation_mat[1] =
-      vec4(2.0f * quat[0] * quat[1] - 2.0f * quat[2] * quat[3],
-           1.0f - 2.0f * quat[0] * quat[0] - 2.0f * quat[2] * quat[2],
-           2.0f * quat[1] * quat[2] + 2.0f * quat[0] * quat[3], 0.0f);
-  rotation_mat[2] =
-      vec4(2.0f * quat[0] * quat[2] + 2.0f * quat[1] * quat[3],
-           2.0f * quat[1] * quat[2] - 2.0f * quat[0] * quat[3],
-           1.0f - 2.0f * quat[0] * quat[0] - 2.0f * quat[1] * quat[1], 0.0f);
-  rotation_mat[3] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
-  return rotation_mat;
-}
+// The depth pre-pass calculates the same positions, so that the depths could
+// be tested for equality
+invariant gl_Position;
 
 /*******************************************************************************
  * Transformations
  ******************************************************************************/
 
-mat4 CalcInstancingTrans() {
-  mat4 translation_mat;
-  mat4 scaling_mat;
-
-  translation_mat[0] = vec4(1.0f, 0.0f, 0.0f, 0.0f);
-  translation_mat[1] = vec4(0.0f, 1.0f, 0.0f, 0.0f);
-  translation_mat[2] = vec4(0.0f, 0.0f, 1.0f, 0.0f);
-  translation_mat[3] = vec4(in_instancing_translation, 1.0f);
-
-  scaling_mat[0] = vec4(in_instancing_scaling[0], 0.0f, 0.0f, 0.0f);
-  scaling_mat[1] = vec4(0.0f, in_instancing_scaling[1], 0.0f, 0.0f);
-  scaling_mat[2] = vec4(0.0f, 0.0f, in_instancing_scaling[2], 0.0f);
-  scaling_mat[3] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
-
-  return translation_mat *
-         QuatToRotationMatrix(EulerAnglesToQuat(in_instancing_rotation)) *
-         scaling_mat;
-}
-
+// The instance matrices are baked on the CPU, the rows of the model matrix are
+// the columns of the input
 mat4 CalcModel() {
-  return global_trans.model * model_trans.trans * CalcInstancingTrans();
+  return global_trans.model * mat4(transpose(in_instance_model_rows));
 }
 
 mat4 CalcTrans() { return global_trans.proj * global_trans.view * CalcModel(); }
 
-mat3 CalcFixedNormalModel() { return transpose(inverse(mat3(CalcModel()))); }
+// The global model is assumed to be rigid
+mat3 CalcFixedNormalModel() {
+  return mat3(global_trans.model) * transpose(mat3(in_instance_normal_rows));
+}
 
 mat3 CalcWorldToTangConverter() {
   const mat3 fixed_norm_model = CalcFixedNormalModel();
@@ -171,8 +120,12 @@ void main() {
   vs_tex.coords = in_tex_coords;
   // Calculate tangent lighting
   OutputTangentLighting();
-  // Calculate light space vertex position
-  vs_depth.light_space_pos = lighting.light_trans * model_trans.trans * pos;
+  // Calculate world space vertex position, the shadow cascade is chosen in the
+  // fragment shader
+  vs_depth.world_pos = CalcModel() * pos;
   // Calculate camera space vertex position
   vs_depth.camera_space_pos = global_trans.view * CalcModel() * pos;
+  // Pass light color and intensity
+  vs_light.color = lighting.light_color;
+  vs_light.intensity = lighting.light_intensity;
 }
@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * Material Features
+ *
+ * When USE_PERMUTATION is defined, each feature is resolved at compile time by
+ * whether its FEATURE_* macro is defined, so that the unused branches are
+ * removed by the compiler. Otherwise the features are read from the uniform
+ * block at run time.
+ ******************************************************************************/
+
+#ifdef USE_PERMUTATION
+
+#ifdef FEATURE_AMBIENT_TEX
+#define MATERIAL_USE_AMBIENT_TEX true
+#else
+#define MATERIAL_USE_AMBIENT_TEX false
+#endif
+
+#ifdef FEATURE_DIFFUSE_TEX
+#define MATERIAL_USE_DIFFUSE_TEX true
+#else
+#define MATERIAL_USE_DIFFUSE_TEX false
+#endif
+
+#ifdef FEATURE_SPECULAR_TEX
+#define MATERIAL_USE_SPECULAR_TEX true
+#else
+#define MATERIAL_USE_SPECULAR_TEX false
+#endif
+
+#ifdef FEATURE_HEIGHT_TEX
+#define MATERIAL_USE_HEIGHT_TEX true
+#else
+#define MATERIAL_USE_HEIGHT_TEX false
+#endif
+
+#ifdef FEATURE_NORMALS_TEX
+#define MATERIAL_USE_NORMALS_TEX true
+#else
+#define MATERIAL_USE_NORMALS_TEX false
+#endif
+
+#ifdef FEATURE_ENV_MAP
+#define MATERIAL_USE_ENV_MAP true
+#else
+#define MATERIAL_USE_ENV_MAP false
+#endif
+
+#ifdef FEATURE_FOG
+#define MATERIAL_USE_FOG true
+#else
+#define MATERIAL_USE_FOG false
+#endif
+
+#ifdef FEATURE_MIX_FOG_WITH_SKYBOX
+#define MATERIAL_MIX_FOG_WITH_SKYBOX true
+#else
+#define MATERIAL_MIX_FOG_WITH_SKYBOX false
+#endif
+
+#ifdef FEATURE_NORMAL
+#define MATERIAL_USE_NORMAL true
+#else
+#define MATERIAL_USE_NORMAL false
+#endif
+
+#ifdef FEATURE_PCF
+#define MATERIAL_USE_PCF true
+#else
+#define MATERIAL_USE_PCF false
+#endif
+
+#else
+
+#define MATERIAL_USE_AMBIENT_TEX model_material.use_ambient_tex
+#define MATERIAL_USE_DIFFUSE_TEX model_material.use_diffuse_tex
+#define MATERIAL_USE_SPECULAR_TEX model_material.use_specular_tex
+#define MATERIAL_USE_HEIGHT_TEX model_material.use_height_tex
+#define MATERIAL_USE_NORMALS_TEX model_material.use_normals_tex
+#define MATERIAL_USE_ENV_MAP model_material.use_env_map
+#define MATERIAL_USE_FOG model_material.use_fog
+#define MATERIAL_MIX_FOG_WITH_SKYBOX model_material.mix_fog_with_skybox
+#define MATERIAL_USE_NORMAL model_material.use_normal
+#define MATERIAL_USE_PCF model_material.use_pcf
+
+#endif
@@ -0,0 +1,153 @@
+#version 440
+
+/*******************************************************************************
+ * Uniform Blocks
+ ******************************************************************************/
+
+layout(std140) uniform GlobalTrans {
+  mat4 model;
+  mat4 view;
+  mat4 proj;
+}
+global_trans;
+
+layout(std140) uniform Lighting {
+  vec3 light_color;
+  vec3 light_pos;
+  vec3 light_intensity;
+  vec3 view_pos;
+}
+lighting;
+
+/*******************************************************************************
+ * Shader Storage Blocks
+ ******************************************************************************/
+
+struct ModelParams {
+  vec4 light_pos;
+  vec4 light_color;
+  vec4 light_intensity;
+};
+
+layout(std430, binding = 0) readonly buffer ModelParamsBuffer {
+  ModelParams model_params[];
+};
+
+/*******************************************************************************
+ * Inputs
+ ******************************************************************************/
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec2 in_tex_coords;
+layout(location = 2) in vec3 in_norm;
+layout(location = 3) in vec3 in_tangent;
+layout(location = 4) in mat3x4 in_instance_model_rows;
+layout(location = 7) in float in_model_idx;
+layout(location = 8) in mat3x4 in_instance_normal_rows;
+
+/*******************************************************************************
+ * Outputs
+ ******************************************************************************/
+
+layout(location = 0) out VSTex { vec2 coords; }
+vs_tex;
+
+layout(location = 1) out VSTangentLighting {
+  mat3 tang_to_world_conv;
+  vec3 pos;
+  vec3 norm;
+  vec3 light_pos;
+  vec3 view_pos;
+}
+vs_tangent_lighting;
+
+layout(location = 8) out VSDepth {
+  vec4 world_pos;
+  vec4 camera_space_pos;
+}
+vs_depth;
+
+layout(location = 10) out VSLight {
+  flat vec3 color;
+  flat vec3 intensity;
+}
+vs_light;
+
+// The depth pre-pass calculates the same positions, so that the depths could
+// be tested for equality
+invariant gl_Position;
+
+/*******************************************************************************
+ * Model Parameters
+ ******************************************************************************/
+
+ModelParams GetModelParams() { return model_params[int(in_model_idx)]; }
+
+/*******************************************************************************
+ * Transformations
+ ******************************************************************************/
+
+// The instance matrices are baked on the CPU, the rows of the model matrix are
+// the columns of the input
+mat4 CalcModel() {
+  return global_trans.model * mat4(transpose(in_instance_model_rows));
+}
+
+mat4 CalcTrans() { return global_trans.proj * global_trans.view * CalcModel(); }
+
+// The global model is assumed to be rigid
+mat3 CalcFixedNormalModel() {
+  return mat3(global_trans.model) * transpose(mat3(in_instance_normal_rows));
+}
+
+mat3 CalcWorldToTangConverter() {
+  const mat3 fixed_norm_model = CalcFixedNormalModel();
+  const vec3 tangent_n = normalize(fixed_norm_model * in_norm);
+  const vec3 tangent_t = normalize(fixed_norm_model * in_tangent);
+  const vec3 ortho_tangent_t =
+      normalize(tangent_t - dot(tangent_t, tangent_n) * tangent_n);
+  const vec3 ortho_tangent_b = cross(tangent_n, ortho_tangent_t);
+  return transpose(mat3(ortho_tangent_t, ortho_tangent_b, tangent_n));
+}
+
+/*******************************************************************************
+ * Lighting Calculations
+ ******************************************************************************/
+
+void OutputTangentLighting() {
+  // Calculate the model
+  const mat4 model = CalcModel();
+  // Calculate world to tangent space converter
+  const mat3 world_to_tang = CalcWorldToTangConverter();
+  // Calculate tangent to world space converter
+  vs_tangent_lighting.tang_to_world_conv = transpose(world_to_tang);
+  // Calculate positions, normal, light position and view position in tangent
+  // space
+  vs_tangent_lighting.pos = world_to_tang * vec3(model * vec4(in_pos, 1.0f));
+  vs_tangent_lighting.norm = world_to_tang * mat3(model) * in_norm;
+  vs_tangent_lighting.light_pos =
+      world_to_tang * vec3(GetModelParams().light_pos);
+  vs_tangent_lighting.view_pos = world_to_tang * lighting.view_pos;
+}
+
+/*******************************************************************************
+ * Entry Point
+ ******************************************************************************/
+
+void main() {
+  const vec4 pos = vec4(in_pos, 1.0f);
+  // Calculate vertex position
+  gl_Position = CalcTrans() * pos;
+  // Pass texture coordinates
+  vs_tex.coords = in_tex_coords;
+  // Calculate tangent lighting
+  OutputTangentLighting();
+  // Calculate world space vertex position, the shadow cascade is chosen in the
+  // fragment shader
+  vs_depth.world_pos = CalcModel() * pos;
+  // Calculate camera space vertex position
+  vs_depth.camera_space_pos = global_trans.view * CalcModel() * pos;
+  // Pass light color and intensity
+  vs_light.color = vec3(GetModelParams().light_color);
+  vs_light.intensity = vec3(GetModelParams().light_intensity);
+}
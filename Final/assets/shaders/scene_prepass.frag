@@ -0,0 +1,5 @@
+#version 440
+
+// Only the depths are written, the fragment depth isn't touched so that the
+// early depth test still works
+void main() {}
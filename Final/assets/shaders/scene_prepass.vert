@@ -0,0 +1,48 @@
+#version 440
+
+/*******************************************************************************
+ * Uniform Blocks
+ ******************************************************************************/
+
+layout(std140) uniform GlobalTrans {
+  mat4 model;
+  mat4 view;
+  mat4 proj;
+}
+global_trans;
+
+/*******************************************************************************
+ * Inputs
+ ******************************************************************************/
+
+layout(location = 0) in vec3 in_pos;
+
+layout(location = 4) in mat3x4 in_instance_model_rows;
+
+/*******************************************************************************
+ * Outputs
+ ******************************************************************************/
+
+// The scene pass tests its depths for equality with these depths
+invariant gl_Position;
+
+/*******************************************************************************
+ * Transformations
+ ******************************************************************************/
+
+// The instance matrices are baked on the CPU, the rows of the model matrix are
+// the columns of the input
+mat4 CalcModel() {
+  return global_trans.model * mat4(transpose(in_instance_model_rows));
+}
+
+mat4 CalcTrans() { return global_trans.proj * global_trans.view * CalcModel(); }
+
+/*******************************************************************************
+ * Entry Point
+ ******************************************************************************/
+
+void main() {
+  const vec4 pos = vec4(in_pos, 1.0f);
+  gl_Position = CalcTrans() * pos;
+}
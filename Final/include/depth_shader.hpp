@@ -1,6 +1,7 @@
 #pragma once
 
 #include "as/trans/camera.hpp"
+#include "as/trans/shadow_cascades.hpp"
 
 #include "scene_model_dto.hpp"
 #include "scene_shader.hpp"
@@ -15,8 +16,20 @@ class DepthShader : public Shader {
   enum class DepthTextureTypes {
     kFromLight,
     kFromCamera,
+    kStaticFromLight,
   };
 
+  struct ShadowStats {
+    bool is_static_redrawn;
+    unsigned int num_redrawn_tiles;
+    unsigned int num_static_redraws;
+    unsigned int num_static_draws;
+    unsigned int num_dynamic_draws;
+    unsigned int num_triangles;
+  };
+
+  DepthShader();
+
   /* Shader Registrations */
 
   void RegisterSceneShader(SceneShader &scene_shader);
@@ -40,10 +53,28 @@ class DepthShader : public Shader {
 
   dto::GlobalTrans GetLightTrans() const;
 
+  glm::mat4 GetCascadeTrans(const int cascade_idx) const;
+
+  const as::ShadowCascades &GetShadowCascades() const;
+
   void UseDepthFramebuffer();
 
   void UseDepthTexture(const DepthTextureTypes depth_tex_type);
 
+  /* Statistics Getters */
+
+  const as::DrawList &GetDrawList() const;
+
+  ShadowStats GetShadowStats() const;
+
+  /* State Updaters */
+
+  void ToggleShadowCaching(const bool toggle);
+
+  void UpdateCascades(const dto::GlobalTrans &camera_trans);
+
+  void SetNumCascades(const int num_cascades);
+
   /* Name Management */
 
   std::string GetId() const override;
@@ -63,31 +94,87 @@ class DepthShader : public Shader {
 
   std::string GetGlobalTransBufferName() const;
 
-  std::string GetModelTransBufferName() const;
-
   std::string GetGlobalTransUniformBlockName() const;
 
-  std::string GetModelTransUniformBlockName() const;
-
  private:
+  enum class CasterFilters {
+    kAll,
+    kStatic,
+    kDynamic,
+  };
+
   /* Constants */
   static const glm::ivec2 kDepthMapSize;
+  static const GLuint kDrawPass;
+  static const float kMaxDrawDepth;
+  static const float kMaxShadowDist;
+  static const float kMaxCasterDist;
 
   /* Shaders */
   SceneShader *scene_shader_;
 
   /* GL States */
   dto::GlobalTrans global_trans_;
-  dto::ModelTrans model_trans_;
+  bool use_shadow_caching_;
+
+  /* Shadow Cascades */
+  int num_cascades_;
+  as::ShadowCascades shadow_cascades_;
+
+  /* Shadow Caching */
+  bool is_static_cache_valid_;
+  unsigned int cached_static_casters_version_;
+  std::vector<glm::mat4> cached_cascade_transes_;
+  bool has_drawn_dynamic_casters_;
+
+  /* Draw Lists */
+  as::DrawList draw_list_;
+
+  /* Statistics */
+  ShadowStats shadow_stats_;
 
   /* State Updaters */
 
   void UpdateGlobalTrans(const dto::GlobalTrans &global_trans);
 
-  void UpdateModelTrans(const dto::SceneModel &scene_model);
-
   /* GL Drawing Methods */
 
-  void DrawModelWithoutTextures(const dto::SceneModel &scene_model);
+  glm::mat4 GetLightView() const;
+
+  int GetNumCascadeCols(const int num_cascades) const;
+
+  std::vector<int> GetAllCascadeIdxs() const;
+
+  glm::ivec4 GetCascadeViewport(const int cascade_idx) const;
+
+  void DrawCachedFromLight();
+
+  unsigned int DrawCascades(const CasterFilters caster_filter,
+                            const std::vector<int> &cascade_idxs);
+
+  void ClearCascadeTile(const int cascade_idx);
+
+  void CopyDepthTile(const DepthTextureTypes src_depth_tex_type,
+                     const DepthTextureTypes dst_depth_tex_type,
+                     const int cascade_idx);
+
+  void DrawSceneModels(const dto::GlobalTrans &global_trans,
+                       const SceneShader::CullingViews view,
+                       const CasterFilters caster_filter);
+
+  void RecordDrawCmds(const glm::vec3 &view_pos,
+                      const SceneShader::CullingViews view,
+                      const CasterFilters caster_filter);
+
+  unsigned int SubmitDrawCmds(const SceneShader::CullingViews view,
+                              const int cascade_idx,
+                              unsigned int &num_triangles);
+
+  SceneShader::VisibleRange GetVisibleRange(
+      const SceneShader::CullingViews view, const int cascade_idx,
+      const size_t mesh_draw_info_idx) const;
+
+  bool HasVisibleInstances(const SceneShader::CullingViews view,
+                           const size_t mesh_draw_info_idx) const;
 };
 }  // namespace shader
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "as/gl/render_graph.hpp"
+
 #include "shader.hpp"
 
 namespace shader {
@@ -62,6 +64,8 @@ class PostprocShader : public Shader {
 
   void InitFramebuffers();
 
+  void InitDummyTexture();
+
   void InitVertexArrays();
 
   void InitUniformBlocks();
@@ -70,7 +74,12 @@ class PostprocShader : public Shader {
 
   void UpdatePostprocTextures(const GLsizei width, const GLsizei height);
 
-  void UpdatePostprocRenderbuffer(const GLsizei width, const GLsizei height);
+  void ConfigPostprocTexture(const PostprocTextureTypes postproc_tex_type,
+                             const int scaling_idx);
+
+  void AttachPostprocRenderbuffer(
+      const PostprocFramebufferTypes postproc_framebuffer_type,
+      const int scaling_idx);
 
   void UsePostprocFramebuffer(
       const PostprocFramebufferTypes postproc_framebuffer_type,
@@ -82,7 +91,7 @@ class PostprocShader : public Shader {
       const PostprocFramebufferTypes postproc_framebuffer_type,
       const PostprocTextureTypes postproc_tex_type, const int scaling_idx);
 
-  void DrawBloom(const glm::ivec2 &window_size);
+  void DrawBloomPass(const int pass_idx, const glm::ivec2 &window_size);
 
   void DrawPostprocEffects();
 
@@ -108,19 +117,34 @@ class PostprocShader : public Shader {
 
   void UpdateUseGammaCorrect(const bool use_gamma_correct);
 
-  /* Name Management */
+  /* Render Graph */
 
-  std::string GetId() const override;
+  void AddPostprocRenderbufferResources(as::RenderGraph &render_graph,
+                                        const glm::ivec2 &window_size);
+
+  void AddPostprocTextureResources(as::RenderGraph &render_graph,
+                                   const glm::ivec2 &window_size);
+
+  std::vector<std::string> GetPostprocTextureResourceNames(
+      const PostprocFramebufferTypes postproc_framebuffer_type,
+      const bool read) const;
+
+  std::vector<std::string> GetPostprocRenderbufferResourceNames(
+      const PostprocFramebufferTypes postproc_framebuffer_type) const;
 
- protected:
   /* Name Management */
 
-  std::string GetPostprocInputsBufferName() const;
+  std::string GetId() const override;
 
   std::string GetPostprocFramebufferName(
       const PostprocFramebufferTypes postproc_framebuffer_type,
       const int scaling_idx) const;
 
+ protected:
+  /* Name Management */
+
+  std::string GetPostprocInputsBufferName() const;
+
   std::string GetQuadVertexArrayGroupName() const;
 
   std::string GetPostprocTextureName(
@@ -135,6 +159,10 @@ class PostprocShader : public Shader {
       const PostprocFramebufferTypes postproc_framebuffer_type,
       const int scaling_idx) const;
 
+  std::string GetDummyTextureName() const;
+
+  std::string GetDummyTextureUnitName() const;
+
   std::string GetPostprocInputsUniformBlockName() const;
 
  private:
@@ -156,6 +184,13 @@ class PostprocShader : public Shader {
   PostprocTextureTypes GetPassHdrTextureType(const int pass_idx,
                                              const bool read) const;
 
+  PostprocFramebufferTypes GetPassFramebufferType(const int pass_idx) const;
+
+  int GetPassNumScaling(const int pass_idx) const;
+
+  bool IsBloomChainTexture(const PostprocTextureTypes postproc_tex_type,
+                           const int scaling_idx) const;
+
   /* State Updaters */
 
   void UpdatePostprocInputs();
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "as/common.hpp"
+
+namespace ctrl {
+class ResolutionController {
+ public:
+  ResolutionController(const float target_seconds, const float min_scale,
+                       const float max_scale, const float scale_step);
+
+  float GetScale() const;
+
+  float GetFrameSeconds() const;
+
+  float GetTargetSeconds() const;
+
+  void SetTargetSeconds(const float target_seconds);
+
+  void Reset();
+
+  bool Update(const float gpu_seconds, const float cpu_seconds);
+
+ private:
+  /* Constants */
+  static const float kProportionalGain;
+  static const float kIntegralGain;
+  static const float kDerivativeGain;
+  static const float kFrameSecondsSmoothing;
+  static const float kDeadBand;
+  static const float kScaleHysteresis;
+  static const int kNumHoldFrames;
+
+  float target_seconds_;
+  float min_scale_;
+  float max_scale_;
+  float scale_step_;
+
+  // Scale applied to the render targets, which is a multiple of the step
+  float scale_;
+  // Unquantized output of the controller
+  float desired_scale_;
+
+  // Smoothed GPU frame time
+  float frame_seconds_;
+
+  float integral_;
+  float prev_error_;
+
+  // Frames since the scale last changed
+  int num_held_frames_;
+
+  float QuantizeScale(const float scale) const;
+};
+}  // namespace ctrl
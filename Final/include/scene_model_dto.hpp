@@ -8,6 +8,13 @@
 namespace dto {
 class SceneModel {
  public:
+  // Rows of the affine model matrix and of the normal matrix, the last
+  // components of the normal rows are zeros
+  struct InstanceMatrices {
+    glm::vec4 model_rows[3];   // 16*0=0, +48->48
+    glm::vec4 normal_rows[3];  // 16*3=48, +48->96
+  };
+
   SceneModel();
 
   SceneModel(const std::string &id, const std::string &path,
@@ -87,6 +94,8 @@ class SceneModel {
 
   std::vector<glm::mat4> GetInstancingTransforms() const;
 
+  glm::mat4 GetInstancingTransform(const size_t instance_idx) const;
+
   size_t GetNumInstancing() const;
 
   size_t GetInstancingMemSize() const;
@@ -99,6 +108,24 @@ class SceneModel {
 
   bool GetUseEnvMap() const;
 
+  /* Instancing Updates */
+
+  bool HasDirtyInstances() const;
+
+  size_t GetDirtyInstanceBegin() const;
+
+  size_t GetDirtyInstanceEnd() const;
+
+  void ClearDirtyInstances();
+
+  /* Instance Matrices */
+
+  void BakeInstanceMatrices();
+
+  const std::vector<InstanceMatrices> &GetInstanceMatrices() const;
+
+  glm::mat4 GetInstanceModel(const size_t instance_idx) const;
+
  private:
   /* Name Management */
   std::string id_;
@@ -116,6 +143,16 @@ class SceneModel {
   std::vector<glm::vec3> instancing_rotations_;
   std::vector<glm::vec3> instancing_scalings_;
 
+  /* Instancing Updates */
+  // Range [begin, end) of the instances changed since the last upload
+  size_t dirty_instance_begin_;
+  size_t dirty_instance_end_;
+
+  /* Instance Matrices */
+  // Model transformation which the matrices are baked with
+  glm::mat4 baked_trans_;
+  std::vector<InstanceMatrices> instance_matrices_;
+
   /* Lighting */
   glm::vec3 light_pos_;
   glm::vec3 light_color_;
@@ -146,6 +183,18 @@ class SceneModel {
   std::vector<glm::vec3> GetDefaultInstancingTransforms(
       const glm::vec3 &default_transform) const;
 
+  /* Instancing Updates */
+
+  void MarkDirtyInstances(const size_t begin, const size_t end);
+
+  void MarkAllDirtyInstances();
+
+  /* Instance Matrices */
+
+  static void BakeInstanceMatrix(const glm::mat4 &trans,
+                                 const glm::mat4 &instancing_trans,
+                                 InstanceMatrices &instance_matrices);
+
   /* Name Management */
 
   std::string GetTextureUnitName(const std::string &tex_unit_group_name,
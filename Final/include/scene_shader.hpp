@@ -1,6 +1,12 @@
 #pragma once
 
-#include "depth_shader.hpp"
+#include "as/gl/draw_list.hpp"
+#include "as/trans/bvh.hpp"
+#include "as/trans/frustum.hpp"
+#include "as/trans/light_clusters.hpp"
+#include "as/trans/occlusion_buffer.hpp"
+#include "as/trans/shadow_cascades.hpp"
+
 #include "scene_model_dto.hpp"
 #include "shader.hpp"
 #include "skybox_shader.hpp"
@@ -13,6 +19,14 @@ class SkyboxShader;
 
 class SceneShader : public Shader {
  public:
+  // Including the full material tier
+  static const int kMaxNumMaterialTiers = 4;
+
+  enum class CullingViews {
+    kCamera,
+    kLight,
+  };
+
   struct ModelMaterial {
     bool use_ambient_tex;  // 4*0=0, +1->1
 
@@ -48,23 +62,143 @@ class SceneShader : public Shader {
     bool pad_use_pcf[3];  // +3->100
     bool use_pcf;         //+1->101
 
-    bool pad[3];  // +3->104
+    bool pad_parallax_layers_scale[3];  // +3->104
+    float parallax_layers_scale;        // 4*26=104, +4->108
   };
 
   struct Lighting {
-    glm::mat4 light_trans;  // 64*1=64, +64->128
-    glm::vec3 light_color;  // 16*8=128, +12->140
+    glm::vec3 light_color;  // 16*0=0, +12->12
+
+    bool pad_light_pos[4];  // +4->16
+    glm::vec3 light_pos;    // 16*1=16, +12->28
+
+    bool pad_light_intensity[4];  // +4->32
+    glm::vec3 light_intensity;    // 16*2=32, +12->44
+
+    bool pad_view_pos[4];  // +4->48
+    glm::vec3 view_pos;    // 16*3=48, +12->60
+
+    bool pad[4];  // +4->64=16*4
+  };
+
+  struct CascadedShadows {
+    // Transformations into the tiles of the depth texture
+    glm::mat4 light_transes[as::ShadowCascades::kMaxNumCascades];  // +256->256
+    glm::vec4 split_depths;  // 16*16=256, +16->272
+    GLint num_cascades;      // 4*68=272, +4->276
+
+    bool pad[12];  // +12->288=16*18
+  };
+
+  struct LightClusterParams {
+    // Number of tiles in x and y, number of slices and number of point lights
+    glm::uvec4 grid_size;  // 16*0=0, +16->16
+    // Projection elements P00, P11, P20 and P21
+    glm::vec4 proj_params;  // 16*1=16, +16->32
+    // Scale and bias to find the slices
+    glm::vec4 slice_params;  // 16*2=32, +16->48
+  };
 
-    bool pad_light_pos[4];  // +4->144
-    glm::vec3 light_pos;    // 16*9=144, +12->156
+  struct ModelParams {
+    glm::vec4 light_pos;        // 16*0=0, +16->16
+    glm::vec4 light_color;      // 16*1=16, +16->32
+    glm::vec4 light_intensity;  // 16*2=32, +16->48
+  };
 
-    bool pad_light_intensity[4];  // +4->160
-    glm::vec3 light_intensity;    // 16*10=160, +12->172
+  struct DrawElementsIndirectCmd {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_idx;
+    GLint base_vertex;
+    GLuint base_instance;
+  };
 
-    bool pad_view_pos[4];  // +4->176
-    glm::vec3 view_pos;    // 16*11=176, +12->188
+  struct InstancingStats {
+    GLsizeiptr num_uploaded_bytes;
+    unsigned int num_updated_instances;
+    unsigned int num_orphaned_buffers;
+  };
 
-    bool pad[4];  // +4->192=16*12
+  struct CullingStats {
+    unsigned int num_instances;
+    unsigned int num_camera_visible_instances;
+    unsigned int num_light_visible_instances;
+    unsigned int num_visited_nodes;
+    unsigned int num_occluded_instances;
+  };
+
+  struct FragmentStats {
+    // Whether the pipeline statistics queries are supported
+    bool is_supported;
+    // Fragment shader invocations in the last measured frame
+    GLuint64 num_prepass_invocations;
+    GLuint64 num_scene_invocations;
+    // Scene invocations last measured with and without the depth pre-pass
+    GLuint64 num_prepassed_scene_invocations;
+    GLuint64 num_unprepassed_scene_invocations;
+  };
+
+  struct BatchingStats {
+    // Meshes whose geometry and material are shared with an earlier mesh
+    unsigned int num_shared_meshes;
+    // Draws merged into the draws of the shared meshes
+    unsigned int num_batched_draws;
+  };
+
+  struct LightClusterStats {
+    unsigned int num_point_lights;
+    // Assignments of the lights to the clusters
+    unsigned int num_light_refs;
+    unsigned int max_num_cluster_lights;
+    // CPU seconds of assigning the lights in the last frame
+    double assign_seconds;
+  };
+
+  // Reduced material of the instances which are far or small on the screen
+  struct MaterialTier {
+    // The instance uses the tier when it is at least this far from the camera,
+    // or when its bounding sphere covers at most this fraction of the screen
+    // height
+    float min_distance;
+    float max_screen_size;
+    // Scale of the number of parallax layers, the parallax mapping is skipped
+    // when it is zero
+    float parallax_layers_scale;
+    bool use_pcf;
+    bool use_env_map;
+  };
+
+  struct MaterialLodStats {
+    // Camera instances of each tier, tier 0 is the full material
+    std::vector<unsigned int> num_tier_instances;
+    // Estimated texture fetches per screen pixel with the full materials and
+    // with the selected tiers
+    float full_fragment_cost;
+    float tier_fragment_cost;
+  };
+
+  struct MeshDrawInfo {
+    std::string scene_model_name;
+    size_t mesh_idx;
+    GLuint va_idx;
+    GLuint material_idx;
+    GLsizei num_idxs;
+    // Local bounding box
+    glm::vec3 min_pos;
+    glm::vec3 max_pos;
+    glm::vec3 center;
+    as::Material material;
+    // First mesh with the same geometry and material, which may be itself
+    size_t shared_info_idx;
+    // Whether the mesh is drawn in the depth pre-pass, the meshes which may
+    // discard fragments are not
+    bool use_depth_prepass;
+  };
+
+  // Range of the visible instances in the instancing buffers
+  struct VisibleRange {
+    GLuint base_instance;
+    GLuint num_instances;
   };
 
   SceneShader();
@@ -79,10 +213,14 @@ class SceneShader : public Shader {
 
   const std::map<std::string, dto::SceneModel> &GetSceneModels() const;
 
+  const std::vector<MeshDrawInfo> &GetMeshDrawInfos() const;
+
   dto::SceneModel &GetSceneModel(const std::string &scene_model_name);
 
   /* GL Initializations */
 
+  void SubmitPrograms() override;
+
   void Init();
 
   void ReuseSkyboxTexture();
@@ -91,6 +229,8 @@ class SceneShader : public Shader {
 
   /* GL Drawing Methods */
 
+  void UpdateVisibleInstances();
+
   void Draw();
 
   /* State Getters */
@@ -103,9 +243,66 @@ class SceneShader : public Shader {
 
   glm::mat4 GetLightProjection() const;
 
+  const std::vector<MaterialTier> &GetMaterialTiers() const;
+
   float GetMinDistanceToModel(const glm::vec3 &pos,
                               const std::string &scene_model_name) const;
 
+  bool CastRay(const glm::vec3 &origin, const glm::vec3 &dir,
+               const float max_dist, std::string &scene_model_name,
+               size_t &instance_idx, float &dist) const;
+
+  /* Shadow Caster Getters */
+
+  bool IsShadowCaster(const std::string &scene_model_name) const;
+
+  bool IsDynamicCaster(const std::string &scene_model_name) const;
+
+  bool HasDynamicCasters() const;
+
+  unsigned int GetStaticCastersVersion() const;
+
+  /* Statistics Getters */
+
+  const as::DrawList &GetDrawList() const;
+
+  unsigned int GetNumDrawCalls() const;
+
+  size_t GetNumPermutationPrograms() const;
+
+  InstancingStats GetInstancingStats() const;
+
+  CullingStats GetCullingStats() const;
+
+  BatchingStats GetBatchingStats() const;
+
+  FragmentStats GetFragmentStats() const;
+
+  LightClusterStats GetLightClusterStats() const;
+
+  MaterialLodStats GetMaterialLodStats() const;
+
+  const as::Bvh &GetInstanceBvh() const;
+
+  const as::OcclusionBuffer &GetOcclusionBuffer() const;
+
+  /* Benchmarks */
+
+  double BenchmarkVertexThroughput(
+      const std::vector<std::string> &scene_model_names,
+      const int num_iterations, GLuint64 &num_vertices);
+
+  /* Visibility Getters */
+
+  VisibleRange GetVisibleRange(const CullingViews view,
+                               const size_t mesh_draw_info_idx) const;
+
+  VisibleRange GetCascadeVisibleRange(const int cascade_idx,
+                                      const size_t mesh_draw_info_idx) const;
+
+  VisibleRange GetMaterialTierRange(const GLuint material_tier_idx,
+                                    const size_t mesh_draw_info_idx) const;
+
   /* State Updaters */
 
   void UpdateGlobalTrans(const dto::GlobalTrans &global_trans);
@@ -114,12 +311,31 @@ class SceneShader : public Shader {
 
   void UpdateViewPos(const glm::vec3 &view_pos);
 
-  void UpdateSceneModel(const dto::SceneModel &scene_model);
+  void UpdatePointLights(
+      const std::vector<as::LightClusters::PointLight> &point_lights);
+
+  void SetMaterialTiers(const std::vector<MaterialTier> &material_tiers);
 
   void TogglePcf(const bool toggle);
 
   void ToggleInstantiating(const bool toggle);
 
+  void ToggleIndirectDrawing(const bool toggle);
+
+  void ToggleCulling(const bool toggle);
+
+  void ToggleDuplicateModels(const bool toggle);
+
+  void ToggleOcclusionCulling(const bool toggle);
+
+  void ToggleMeshBatching(const bool toggle);
+
+  void ToggleDepthPrepass(const bool toggle);
+
+  void ToggleMaterialLod(const bool toggle);
+
+  void TogglePermutations(const bool toggle);
+
   void ToggleNormalHeight(const bool toggle);
 
   void ToggleFog(const bool toggle);
@@ -134,6 +350,8 @@ class SceneShader : public Shader {
 
   std::string GetGlobalTransUniformBlockName() const;
 
+  std::string GetUniformRingBufferName() const;
+
  protected:
   /* GL Initializations */
 
@@ -141,30 +359,142 @@ class SceneShader : public Shader {
 
   /* Name Management */
 
-  std::string GetModelTransBufferName() const;
-
   std::string GetModelMaterialBufferName() const;
 
   std::string GetLightingBufferName() const;
 
-  std::string GetInstancingTranslationsBufferName(
-      const dto::SceneModel &scene_model) const;
+  std::string GetCascadedShadowsBufferName() const;
+
+  std::string GetLightClustersBufferName() const;
+
+  std::string GetPointLightsBufferName() const;
+
+  std::string GetClusterRangesBufferName() const;
+
+  std::string GetClusterLightIdxsBufferName() const;
 
-  std::string GetInstancingRotationsBufferName(
+  std::string GetIndirectProgramName() const;
+
+  std::string GetPermutationProgramName(const GLuint permutation_mask) const;
+
+  std::string GetPermutationFragmentShaderName(
+      const GLuint permutation_mask) const;
+
+  std::string GetIndirectVertexShaderPath() const;
+
+  std::string GetPrepassProgramName() const;
+
+  std::string GetPrepassVertexShaderPath() const;
+
+  std::string GetPrepassFragmentShaderPath() const;
+
+  std::string GetPrepassVertexArrayName(
       const dto::SceneModel &scene_model) const;
 
-  std::string GetInstancingScalingsBufferName(
+  std::string GetPrepassPositionsBufferName() const;
+
+  std::string GetIndirectVertexArrayName() const;
+
+  std::string GetIndirectVerticesBufferName() const;
+
+  std::string GetIndirectIdxsBufferName() const;
+
+  std::string GetIndirectInstancingMatricesBufferName() const;
+
+  std::string GetIndirectInstancingModelIdxsBufferName() const;
+
+  std::string GetIndirectModelParamsBufferName() const;
+
+  std::string GetIndirectCmdsBufferName() const;
+
+  std::string GetInstancingMatricesBufferName(
       const dto::SceneModel &scene_model) const;
 
   std::string GetSkyboxTextureUnitName() const;
 
-  std::string GetModelTransUniformBlockName() const;
-
   std::string GetModelMaterialUniformBlockName() const;
 
   std::string GetLightingUniformBlockName() const;
 
+  std::string GetCascadedShadowsUniformBlockName() const;
+
+  std::string GetLightClustersUniformBlockName() const;
+
  private:
+  struct SceneDrawItem {
+    size_t mesh_draw_info_idx;
+    GLuint material_tier_idx;
+    std::string program_name;
+    GLintptr lighting_ofs;
+    GLintptr model_material_ofs;
+  };
+
+  struct IndirectBatch {
+    size_t mesh_draw_info_idx;
+    GLuint material_tier_idx;
+    GLintptr cmds_ofs;
+    GLsizei num_cmds;
+  };
+
+  struct InstanceBounds {
+    // Model transformation which the bounds are calculated with
+    glm::mat4 model_trans;
+    // Local bounding box of all meshes
+    glm::vec3 min_pos;
+    glm::vec3 max_pos;
+    // Model transformations multiplied by instancing transformations
+    std::vector<glm::mat4> instance_transforms;
+    // World bounding boxes of the instances
+    as::AabbBatch aabb_batch;
+  };
+
+  struct OccluderMesh {
+    std::vector<glm::vec3> poses;
+    std::vector<size_t> idxs;
+  };
+
+  struct InstanceLod {
+    GLuint material_tier_idx;
+    // Fraction of the screen covered by the bounding sphere
+    float screen_coverage;
+  };
+
+  struct VisibleInstances {
+    std::vector<size_t> camera_instance_idxs;
+    // Light instances in each shadow cascade
+    std::vector<std::vector<size_t>> cascade_instance_idxs;
+  };
+
+  // Model index and instance index of an instance in the compacted buffers
+  using CompactedInstance = std::tuple<GLuint, size_t>;
+
+  /* Constants */
+  static const int kNumUniformRingSegments;
+  static const GLuint kDrawPass;
+  static const float kMaxDrawDepth;
+  static const GLuint kModelParamsBindingIdx;
+  static const std::vector<std::string> kPermutationFeatureDefines;
+  static const size_t kMaxNumPermutationPrograms;
+  static const float kBvhRebuildCostRatio;
+  static const int kOcclusionBufferWidth;
+  static const int kOcclusionBufferHeight;
+  static const std::vector<std::string> kOccluderSceneModelNames;
+  static const unsigned int kNumStaticCasterFrames;
+  static const std::vector<std::string> kReceiverOnlySceneModelNames;
+  static const float kMinPrepassAlpha;
+  static const int kLightClusterNumTilesX;
+  static const int kLightClusterNumTilesY;
+  static const int kLightClusterNumSlices;
+  static const float kLightClusterNearDepth;
+  static const float kLightClusterFarDepth;
+  static const GLuint kPointLightsBindingIdx;
+  static const GLuint kClusterRangesBindingIdx;
+  static const GLuint kClusterLightIdxsBindingIdx;
+  static const MaterialTier kFullMaterialTier;
+  static const std::vector<MaterialTier> kDefaultMaterialTiers;
+  static const float kNumParallaxFetches;
+  static const float kNumPcfFetches;
+
   /* Model States */
   float model_rotation;
 
@@ -177,11 +507,90 @@ class SceneShader : public Shader {
 
   /* GL States */
   dto::GlobalTrans global_trans_;
-  dto::ModelTrans model_trans_;
   ModelMaterial model_material_;
   Lighting lighting_;
+  CascadedShadows cascaded_shadows_;
+  LightClusterParams light_cluster_params_;
   bool use_instantiating_;
   bool use_normal_height_;
+  bool use_indirect_drawing_;
+  bool use_permutations_;
+  bool use_culling_;
+  bool use_occlusion_culling_;
+  bool use_mesh_batching_;
+  bool use_depth_prepass_;
+  bool use_pcf_;
+  bool use_material_lod_;
+  bool use_duplicate_models_;
+
+  /* Shader Permutations */
+  std::set<GLuint> submitted_permutation_masks_;
+  std::set<GLuint> ready_permutation_masks_;
+
+  /* Draw Lists */
+  std::vector<MeshDrawInfo> mesh_draw_infos_;
+  std::vector<SceneDrawItem> draw_items_;
+  as::DrawList draw_list_;
+
+  /* Indirect Drawing */
+  std::map<std::string, GLuint> scene_model_idxs_;
+  std::vector<DrawElementsIndirectCmd> mesh_indirect_cmds_;
+  std::vector<ModelParams> model_params_;
+  std::vector<DrawElementsIndirectCmd> indirect_cmds_;
+  std::vector<IndirectBatch> indirect_batches_;
+
+  /* Culling */
+  std::map<std::string, InstanceBounds> instance_bounds_;
+  std::vector<VisibleRange> camera_visible_ranges_;
+  // Visible ranges of each shadow cascade
+  std::vector<std::vector<VisibleRange>> cascade_visible_ranges_;
+  as::Bvh bvh_;
+  // Offsets of the instances of each model in the BVH items
+  std::map<std::string, size_t> bvh_item_ofses_;
+  // Instances held by each compacted buffer since its last upload
+  std::map<std::string, std::vector<CompactedInstance>> compacted_instances_;
+  as::OcclusionBuffer occlusion_buffer_;
+  std::map<std::string, std::vector<OccluderMesh>> occluder_meshes_;
+
+  /* Mesh Batching */
+  // Meshes drawn by each mesh in the current frame, which is empty when the
+  // mesh is drawn by another mesh
+  std::vector<std::vector<size_t>> batched_info_idxs_;
+
+  /* Material LOD */
+  // Reduced tiers from the nearest, the full tier is not included
+  std::vector<MaterialTier> material_tiers_;
+  // Tiers of the camera instances of each model
+  std::map<std::string, std::vector<InstanceLod>> instance_lods_;
+  // Camera ranges of each tier, which split the camera visible ranges
+  std::vector<std::vector<VisibleRange>> camera_tier_ranges_;
+
+  /* Light Clusters */
+  std::vector<as::LightClusters::PointLight> point_lights_;
+  as::LightClusters light_clusters_;
+
+  /* Shadow Casters */
+  // Number of frames since the model last moved
+  std::map<std::string, unsigned int> num_still_frames_;
+  unsigned int static_casters_version_;
+
+  /* Statistics */
+  unsigned int num_draw_calls_;
+  InstancingStats instancing_stats_;
+  CullingStats culling_stats_;
+  BatchingStats batching_stats_;
+  LightClusterStats light_cluster_stats_;
+  MaterialLodStats material_lod_stats_;
+
+  /* Fragment Statistics */
+  // Double-buffered pipeline statistics queries
+  GLuint prepass_query_hdlrs_[2];
+  GLuint scene_query_hdlrs_[2];
+  bool has_fragment_queries_[2];
+  // Whether the pre-pass was drawn when the queries were issued
+  bool was_prepassed_[2];
+  unsigned int fragment_query_frame_idx_;
+  FragmentStats fragment_stats_;
 
   /* Model Initialization */
 
@@ -189,28 +598,210 @@ class SceneShader : public Shader {
 
   void InitModels();
 
+  void InitOccluderMeshes();
+
   /* GL Initialization */
 
   void InitVertexArrays();
 
   void InitInstancingVertexArrays();
 
+  void InitMeshDrawInfos();
+
+  void InitIndirectProgram();
+
+  void InitIndirectVertexArray();
+
+  void InitPrepassProgram();
+
+  void InitPrepassVertexArrays();
+
+  void InitFragmentQueries();
+
+  void SpecifyInstanceMatrices(const std::string &va_name,
+                               const std::string &buffer_name);
+
+  void InitIndirectBuffers();
+
+  void InitLightClusterBuffers();
+
   void InitUniformBlocks();
 
-  void InitLightTrans();
+  void InitUniformRingBuffer();
+
+  void SetSceneTextureUniforms(const std::string &program_name);
+
+  /* Shader Permutations */
+
+  GLuint GetPermutationMask() const;
+
+  std::string SelectPermutationProgram(const GLuint permutation_mask);
+
+  void SubmitPermutationProgram(const GLuint permutation_mask);
+
+  void InitPermutationProgram(const GLuint permutation_mask);
 
   /* State Updaters */
 
-  void UpdateModelTrans(const dto::SceneModel &scene_model);
+  GLintptr UpdateLighting(const dto::SceneModel &scene_model);
 
-  void UpdateLighting(const dto::SceneModel &scene_model);
+  void UpdateCascadedShadows();
 
   void UpdateModelMaterial(const dto::SceneModel &scene_model);
 
-  void UpdateModelMaterial(const as::Material &material);
+  GLintptr UpdateModelMaterial(const as::Material &material,
+                               const GLuint material_tier_idx);
+
+  template <class T>
+  GLintptr WriteUniformRingBuffer(const T &buffer_data);
+
+  void BindUniformRingBufferRange(const std::string &binding_name,
+                                  const GLintptr ofs, const GLsizeiptr size);
+
+  void UpdateIndirectInstancing();
+
+  void StreamInstancing();
+
+  void StreamSceneModelInstancing(const std::string &scene_model_name);
+
+  void StreamInstancingRange(
+      const std::string &buffer_name,
+      const std::vector<dto::SceneModel::InstanceMatrices> &instance_matrices,
+      const size_t src_begin, const size_t dst_begin,
+      const size_t num_instances);
+
+  void UploadSceneModelInstancing(const std::string &scene_model_name);
+
+  void UploadInstancing(
+      const std::string &buffer_name,
+      const std::vector<dto::SceneModel::InstanceMatrices> &instance_matrices);
+
+  void UpdateIndirectModelParams();
+
+  /* Culling */
+
+  void CullInstances();
+
+  void UpdateInstanceBounds(const std::string &scene_model_name,
+                            size_t &changed_begin, size_t &changed_end);
+
+  void UpdateBvh();
+
+  void BuildBvh();
+
+  void UpdateCasterState(const std::string &scene_model_name,
+                         const bool is_changed);
+
+  bool FindBvhItem(const size_t item_idx, std::string &scene_model_name,
+                   size_t &instance_idx) const;
+
+  void CullOccludedInstances(const glm::mat4 &view_proj,
+                             std::vector<unsigned char> &camera_visibles);
+
+  size_t GetNumCameraInstances(const dto::SceneModel &scene_model) const;
+
+  VisibleInstances CollectVisibleInstances(
+      const std::string &scene_model_name,
+      const std::vector<as::Frustum> &cascade_frusta,
+      const unsigned char *camera_visibles,
+      const unsigned char *light_visibles);
+
+  void CompactSceneModelInstances(
+      const std::string &scene_model_name, const as::Frustum &camera_frustum,
+      const std::vector<as::Frustum> &cascade_frusta,
+      const std::map<std::string, VisibleInstances> &visible_instances,
+      const std::vector<const dto::SceneModel *> &indexed_scene_models,
+      std::vector<CompactedInstance> &merged_compacted_instances);
+
+  bool UploadCompactedInstances(
+      const std::string &buffer_name,
+      const std::vector<CompactedInstance> &compacted_instances,
+      const std::vector<const dto::SceneModel *> &indexed_scene_models);
+
+  std::vector<size_t> CullMeshInstances(
+      const as::Frustum &frustum, const InstanceBounds &instance_bounds,
+      const MeshDrawInfo &mesh_draw_info,
+      const std::vector<size_t> &instance_idxs) const;
+
+  /* Mesh Batching */
+
+  static uint64_t HashMeshGeometry(const std::vector<as::Vertex> &vertices,
+                                   const std::vector<size_t> &idxs);
+
+  bool HasSameGeometry(const size_t mesh_draw_info_idx,
+                       const std::vector<as::Vertex> &vertices,
+                       const std::vector<size_t> &idxs) const;
+
+  bool CanBatchSceneModels(const std::string &scene_model_name1,
+                           const std::string &scene_model_name2) const;
+
+  void UpdateMeshBatches();
+
+  /* Material LOD */
+
+  GLuint GetNumMaterialTiers() const;
+
+  const MaterialTier &GetMaterialTier(const GLuint material_tier_idx) const;
+
+  void ResetMaterialLodStats();
+
+  void SelectMaterialTiers(const std::string &scene_model_name,
+                           const std::vector<size_t> &instance_idxs);
+
+  float EstimateFragmentCost(const MeshDrawInfo &mesh_draw_info,
+                             const bool use_env_map,
+                             const MaterialTier &material_tier) const;
+
+  /* Light Clusters */
+
+  void AssignLightClusters();
+
+  void UploadLightClusters();
+
+  void BindLightClusterBuffers();
 
   /* GL Drawing Methods */
 
-  void DrawModel(const dto::SceneModel &scene_model);
+  void DrawDepthPrepass();
+
+  void UseSceneDepthTest(const bool is_prepassed);
+
+  void RecordDrawCmds();
+
+  void SubmitDrawCmds();
+
+  void DrawMesh(const std::string &program_name,
+                const dto::SceneModel &scene_model,
+                const MeshDrawInfo &mesh_draw_info,
+                const VisibleRange &visible_range);
+
+  void DrawIndirect();
+
+  void RecordIndirectCmds();
+
+  void SubmitIndirectCmds();
+
+  void BindMaterialTextures(const std::string &program_name,
+                            const as::Material &material);
+
+  /* Fragment Statistics */
+
+  void ReadFragmentQueries(const int query_idx);
 };
+
+/*******************************************************************************
+ * State Updaters (Private)
+ ******************************************************************************/
+
+template <class T>
+inline GLintptr SceneShader::WriteUniformRingBuffer(const T &buffer_data) {
+  // Get managers
+  as::RingBufferManager &ring_buffer_manager =
+      gl_managers_->GetRingBufferManager();
+  // Get names
+  const std::string ring_buffer_name = GetUniformRingBufferName();
+  // Write the data
+  return ring_buffer_manager.AllocRingBuffer(ring_buffer_name, sizeof(T),
+                                             &buffer_data);
+}
 }  // namespace shader
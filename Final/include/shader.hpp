@@ -15,6 +15,8 @@ class Shader {
 
   void RegisterGLManagers(as::GLManagers &gl_managers);
 
+  virtual void SubmitPrograms();
+
   /* GL Drawing Methods */
 
   virtual void UseProgram() const;
@@ -62,7 +64,6 @@ class Shader {
   std::string GetMeshVertexArrayIdxsBufferName(const std::string &group_name,
                                                const size_t mesh_idx) const;
 
- private:
   /* Path Management */
 
   std::string GetShaderPath(const ShaderTypes &shader_type) const;
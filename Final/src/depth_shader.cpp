@@ -1,5 +1,14 @@
 #include "depth_shader.hpp"
 
+shader::DepthShader::DepthShader()
+    : scene_shader_(nullptr),
+      use_shadow_caching_(true),
+      num_cascades_(as::ShadowCascades::kMaxNumCascades),
+      is_static_cache_valid_(false),
+      cached_static_casters_version_(0),
+      has_drawn_dynamic_casters_(false),
+      shadow_stats_(ShadowStats{false, 0, 0, 0, 0, 0}) {}
+
 /*******************************************************************************
  * Shader Registrations
  ******************************************************************************/
@@ -13,13 +22,12 @@ void shader::DepthShader::RegisterSceneShader(SceneShader &scene_shader) {
  ******************************************************************************/
 
 void shader::DepthShader::Init() {
-  CreateShaders();
-  CreatePrograms();
   InitFramebuffers();
   InitUniformBlocks();
   // Initialize multiple depth textures
-  const DepthTextureTypes depth_tex_types[] = {DepthTextureTypes::kFromLight,
-                                               DepthTextureTypes::kFromCamera};
+  const DepthTextureTypes depth_tex_types[] = {
+      DepthTextureTypes::kFromLight, DepthTextureTypes::kFromCamera,
+      DepthTextureTypes::kStaticFromLight};
   for (const DepthTextureTypes depth_tex_type : depth_tex_types) {
     InitDepthTexture(depth_tex_type);
   }
@@ -29,6 +37,7 @@ void shader::DepthShader::InitFramebuffers() {
   // Get managers
   as::FramebufferManager &framebuffer_manager =
       gl_managers_->GetFramebufferManager();
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
   // Get names
   const std::string name = GetDepthFramebufferName();
   // Create framebuffers
@@ -36,15 +45,15 @@ void shader::DepthShader::InitFramebuffers() {
   // Bind framebuffers
   framebuffer_manager.BindFramebuffer(name, GL_FRAMEBUFFER);
   // Disable color rendering
-  glDrawBuffer(GL_NONE);
-  glReadBuffer(GL_NONE);
+  trace_manager.RecordCall("glDrawBuffer", {GL_NONE}, 0,
+                           [&] { glDrawBuffer(GL_NONE); });
+  trace_manager.RecordCall("glReadBuffer", {GL_NONE}, 0,
+                           [&] { glReadBuffer(GL_NONE); });
 }
 
 void shader::DepthShader::InitUniformBlocks() {
   LinkDataToUniformBlock(GetGlobalTransBufferName(),
                          GetGlobalTransUniformBlockName(), global_trans_);
-  LinkDataToUniformBlock(GetModelTransBufferName(),
-                         GetModelTransUniformBlockName(), model_trans_);
 }
 
 void shader::DepthShader::InitDepthTexture(
@@ -53,6 +62,7 @@ void shader::DepthShader::InitDepthTexture(
   as::FramebufferManager &framebuffer_manager =
       gl_managers_->GetFramebufferManager();
   as::TextureManager &texture_manager = gl_managers_->GetTextureManager();
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
   // Get names
   const std::string framebuffer_name = GetDepthFramebufferName();
   const std::string tex_name = GetDepthTextureName(depth_tex_type);
@@ -73,7 +83,10 @@ void shader::DepthShader::InitDepthTexture(
   texture_manager.SetTextureParamInt(tex_name, GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
                                      GL_CLAMP_TO_BORDER);
   const float borderColor[] = {1.0f, 1.0f, 1.0f, 1.0f};
-  glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+  trace_manager.RecordCall(
+      "glTexParameterfv", {GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR}, 0, [&] {
+        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+      });
   // Attach textures to framebuffers
   framebuffer_manager.AttachTexture2DToFramebuffer(
       framebuffer_name, tex_name, GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
@@ -85,41 +98,43 @@ void shader::DepthShader::InitDepthTexture(
  ******************************************************************************/
 
 void shader::DepthShader::DrawFromLight(const glm::ivec2 &window_size) {
+  // Get managers
+  as::StateManager &state_manager = gl_managers_->GetStateManager();
   // Use depth program
   UseProgram();
-  // Set the new viewport
-  glViewport(0, 0, kDepthMapSize.x, kDepthMapSize.y);
-  // Get light space transformation
-  const dto::GlobalTrans global_trans = GetLightTrans();
-  // Update global transformation
-  UpdateGlobalTrans(global_trans);
 
-  // Use "from light" texture
-  UseDepthTexture(DepthTextureTypes::kFromLight);
+  shadow_stats_.is_static_redrawn = false;
+  shadow_stats_.num_redrawn_tiles = 0;
+  shadow_stats_.num_static_draws = 0;
+  shadow_stats_.num_dynamic_draws = 0;
+  shadow_stats_.num_triangles = 0;
 
-  as::ClearDepthBuffer();
+  if (use_shadow_caching_) {
+    DrawCachedFromLight();
+  } else {
+    // Use "from light" texture
+    UseDepthTexture(DepthTextureTypes::kFromLight);
 
-  // Draw the scene models without textures
-  const auto &scene_models = scene_shader_->GetSceneModels();
-  for (const auto &pair : scene_models) {
-    const dto::SceneModel &scene_model = pair.second;
+    as::ClearDepthBuffer();
 
-    // Update states
-    UpdateModelTrans(scene_model);
-    // Draw the model
-    DrawModelWithoutTextures(scene_model);
+    // Draw the scene models visible from the light into each cascade without
+    // textures, all casters are redrawn in every frame
+    shadow_stats_.num_dynamic_draws =
+        DrawCascades(CasterFilters::kAll, GetAllCascadeIdxs());
   }
 
   // Restore the viewport
-  glViewport(0, 0, window_size.x, window_size.y);
+  state_manager.SetViewport(0, 0, window_size.x, window_size.y);
 }
 
 void shader::DepthShader::DrawFromCamera(const glm::ivec2 &window_size,
                                          const dto::GlobalTrans &camera_trans) {
+  // Get managers
+  as::StateManager &state_manager = gl_managers_->GetStateManager();
   // Use depth program
   UseProgram();
   // Set the new viewport
-  glViewport(0, 0, kDepthMapSize.x, kDepthMapSize.y);
+  state_manager.SetViewport(0, 0, kDepthMapSize.x, kDepthMapSize.y);
   // Update global transformation
   UpdateGlobalTrans(camera_trans);
 
@@ -128,28 +143,22 @@ void shader::DepthShader::DrawFromCamera(const glm::ivec2 &window_size,
 
   as::ClearDepthBuffer();
 
-  // Draw the scene models without textures
-  const auto &scene_models = scene_shader_->GetSceneModels();
-  for (const auto &pair : scene_models) {
-    const dto::SceneModel &scene_model = pair.second;
-
-    // Update states
-    UpdateModelTrans(scene_model);
-    // Draw the model
-    DrawModelWithoutTextures(scene_model);
-  }
+  // Draw the scene models visible from the camera without textures
+  DrawSceneModels(camera_trans, SceneShader::CullingViews::kCamera,
+                  CasterFilters::kAll);
 
   // Restore the viewport
-  glViewport(0, 0, window_size.x, window_size.y);
+  state_manager.SetViewport(0, 0, window_size.x, window_size.y);
 }
 
+/*
+ * The projection encloses all cascades, so that the instances visible from
+ * the light are culled once for all cascades
+ */
 dto::GlobalTrans shader::DepthShader::GetLightTrans() const {
-  // Use a camera at the light position
-  const as::CameraTrans camera_trans(scene_shader_->GetLightPos(),
-                                     scene_shader_->GetLightAngles());
   // Set the light space
-  const glm::mat4 light_proj = scene_shader_->GetLightProjection();
-  const glm::mat4 light_view = camera_trans.GetTrans();
+  const glm::mat4 light_proj = shadow_cascades_.GetBoundingProj();
+  const glm::mat4 light_view = GetLightView();
   const glm::mat4 light_model = glm::mat4(1.0f);
   // Set the new global transformation to the light space
   dto::GlobalTrans global_trans;
@@ -159,6 +168,29 @@ dto::GlobalTrans shader::DepthShader::GetLightTrans() const {
   return global_trans;
 }
 
+/*
+ * Transforms the world positions into the tile of the cascade in the depth
+ * texture
+ */
+glm::mat4 shader::DepthShader::GetCascadeTrans(const int cascade_idx) const {
+  // Get the tile of the cascade
+  const int num_cols = GetNumCascadeCols(shadow_cascades_.GetNumCascades());
+  const int col = cascade_idx % num_cols;
+  const int row = cascade_idx / num_cols;
+  // Scale and move the clip space into the tile
+  const float scale = 1.0f / static_cast<float>(num_cols);
+  const glm::vec3 translation(-1.0f + scale * (2.0f * col + 1.0f),
+                              -1.0f + scale * (2.0f * row + 1.0f), 0.0f);
+  const glm::mat4 tile_trans =
+      glm::translate(glm::mat4(1.0f), translation) *
+      glm::scale(glm::mat4(1.0f), glm::vec3(scale, scale, 1.0f));
+  return tile_trans * shadow_cascades_.GetProj(cascade_idx) * GetLightView();
+}
+
+const as::ShadowCascades &shader::DepthShader::GetShadowCascades() const {
+  return shadow_cascades_;
+}
+
 void shader::DepthShader::UseDepthFramebuffer() {
   // Get managers
   as::FramebufferManager &framebuffer_manager =
@@ -183,6 +215,48 @@ void shader::DepthShader::UseDepthTexture(
       GL_TEXTURE_2D, 0);
 }
 
+/*******************************************************************************
+ * Statistics Getters
+ ******************************************************************************/
+
+const as::DrawList &shader::DepthShader::GetDrawList() const {
+  return draw_list_;
+}
+
+shader::DepthShader::ShadowStats shader::DepthShader::GetShadowStats() const {
+  return shadow_stats_;
+}
+
+/*******************************************************************************
+ * State Updaters
+ ******************************************************************************/
+
+void shader::DepthShader::ToggleShadowCaching(const bool toggle) {
+  if (toggle == use_shadow_caching_) {
+    return;
+  }
+  use_shadow_caching_ = toggle;
+  // The light depth texture has been drawn without the cache
+  is_static_cache_valid_ = false;
+}
+
+void shader::DepthShader::UpdateCascades(const dto::GlobalTrans &camera_trans) {
+  // Each cascade takes a tile of the depth texture
+  const int tile_size = kDepthMapSize.x / GetNumCascadeCols(num_cascades_);
+  shadow_cascades_.Fit(camera_trans.proj,
+                       camera_trans.view * camera_trans.model, GetLightView(),
+                       num_cascades_, kMaxShadowDist, kMaxCasterDist,
+                       tile_size);
+}
+
+void shader::DepthShader::SetNumCascades(const int num_cascades) {
+  if (num_cascades < 1 || num_cascades > as::ShadowCascades::kMaxNumCascades) {
+    throw std::runtime_error("Invalid number of shadow cascades '" +
+                             std::to_string(num_cascades) + "'");
+  }
+  num_cascades_ = num_cascades;
+}
+
 /*******************************************************************************
  * Name Management
  ******************************************************************************/
@@ -208,6 +282,8 @@ std::string shader::DepthShader::DepthTextureTypeToName(
       return "from_light";
     case DepthTextureTypes::kFromCamera:
       return "from_camera";
+    case DepthTextureTypes::kStaticFromLight:
+      return "static_from_light";
     default:
       throw std::runtime_error("Unknown depth texture type");
   }
@@ -225,24 +301,24 @@ std::string shader::DepthShader::GetGlobalTransBufferName() const {
   return GetProgramName() + "/buffer/global_trans";
 }
 
-std::string shader::DepthShader::GetModelTransBufferName() const {
-  return GetProgramName() + "/buffer/model_trans";
-}
-
 std::string shader::DepthShader::GetGlobalTransUniformBlockName() const {
   return "GlobalTrans";
 }
 
-std::string shader::DepthShader::GetModelTransUniformBlockName() const {
-  return "ModelTrans";
-}
-
 /*******************************************************************************
  * Constants (Private)
  ******************************************************************************/
 
 const glm::ivec2 shader::DepthShader::kDepthMapSize = glm::ivec2(2048, 2048);
 
+const GLuint shader::DepthShader::kDrawPass = 0;
+
+const float shader::DepthShader::kMaxDrawDepth = 1e3f;
+
+const float shader::DepthShader::kMaxShadowDist = 200.0f;
+
+const float shader::DepthShader::kMaxCasterDist = 500.0f;
+
 /*******************************************************************************
  * State Updaters (Private)
  ******************************************************************************/
@@ -258,40 +334,332 @@ void shader::DepthShader::UpdateGlobalTrans(
   buffer_manager.UpdateBuffer(buffer_name);
 }
 
-void shader::DepthShader::UpdateModelTrans(const dto::SceneModel &scene_model) {
-  // Get managers
-  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
-  // Get names
-  const std::string buffer_name = GetModelTransBufferName();
+/*******************************************************************************
+ * GL Drawing Methods (Private)
+ ******************************************************************************/
 
-  // Update model transformation
-  model_trans_.trans = scene_model.GetTrans();
+glm::mat4 shader::DepthShader::GetLightView() const {
+  // Use a camera at the light position
+  const as::CameraTrans camera_trans(scene_shader_->GetLightPos(),
+                                     scene_shader_->GetLightAngles());
+  return camera_trans.GetTrans();
+}
 
-  // Update the buffer
-  buffer_manager.UpdateBuffer(buffer_name);
+int shader::DepthShader::GetNumCascadeCols(const int num_cascades) const {
+  return static_cast<int>(std::ceil(std::sqrt(num_cascades)));
 }
 
-/*******************************************************************************
- * GL Drawing Methods (Private)
- ******************************************************************************/
+std::vector<int> shader::DepthShader::GetAllCascadeIdxs() const {
+  std::vector<int> cascade_idxs;
+  for (int cascade_idx = 0; cascade_idx < shadow_cascades_.GetNumCascades();
+       cascade_idx++) {
+    cascade_idxs.push_back(cascade_idx);
+  }
+  return cascade_idxs;
+}
+
+glm::ivec4 shader::DepthShader::GetCascadeViewport(
+    const int cascade_idx) const {
+  const int num_cols = GetNumCascadeCols(shadow_cascades_.GetNumCascades());
+  const int tile_size = kDepthMapSize.x / num_cols;
+  const int col = cascade_idx % num_cols;
+  const int row = cascade_idx / num_cols;
+  return glm::ivec4(col * tile_size, row * tile_size, tile_size, tile_size);
+}
 
-void shader::DepthShader::DrawModelWithoutTextures(
-    const dto::SceneModel &scene_model) {
-  // Get model
-  const as::Model &model = scene_model.GetModel();
-  // Get meshes
-  const std::vector<as::Mesh> &meshes = model.GetMeshes();
+/*
+ * Keeps the static casters of each cascade in its tile of the cached depth
+ * texture. Only the tiles whose cascade transformations have changed are
+ * cleared and redrawn, and only those tiles are copied into the light depth
+ * texture. All tiles are restored from the cache when the dynamic casters are
+ * drawn on top of them. Nothing is drawn when no tile has changed and there
+ * are no dynamic casters, since the light depth texture already holds the
+ * cached depths.
+ */
+void shader::DepthShader::DrawCachedFromLight() {
+  // Check whether the cached depths are still valid, all tiles are redrawn
+  // when the static casters or the tile layout have changed
+  const int num_cascades = shadow_cascades_.GetNumCascades();
+  const unsigned int static_casters_version =
+      scene_shader_->GetStaticCastersVersion();
+  const bool is_cache_valid =
+      is_static_cache_valid_ &&
+      static_casters_version == cached_static_casters_version_ &&
+      static_cast<int>(cached_cascade_transes_.size()) == num_cascades;
+  // Find the tiles whose cascade transformations have changed
+  std::vector<glm::mat4> cascade_transes;
+  std::vector<int> redrawn_cascade_idxs;
+  for (int cascade_idx = 0; cascade_idx < num_cascades; cascade_idx++) {
+    const glm::mat4 cascade_trans = GetCascadeTrans(cascade_idx);
+    if (!is_cache_valid ||
+        cascade_trans != cached_cascade_transes_.at(cascade_idx)) {
+      redrawn_cascade_idxs.push_back(cascade_idx);
+    }
+    cascade_transes.push_back(cascade_trans);
+  }
+
+  if (!redrawn_cascade_idxs.empty()) {
+    // Draw the static casters into the changed tiles of the cache
+    UseDepthTexture(DepthTextureTypes::kStaticFromLight);
+    for (const int cascade_idx : redrawn_cascade_idxs) {
+      ClearCascadeTile(cascade_idx);
+    }
+    shadow_stats_.num_static_draws =
+        DrawCascades(CasterFilters::kStatic, redrawn_cascade_idxs);
+    // Save the cache states
+    is_static_cache_valid_ = true;
+    cached_static_casters_version_ = static_casters_version;
+    cached_cascade_transes_ = cascade_transes;
+    shadow_stats_.is_static_redrawn = true;
+    shadow_stats_.num_redrawn_tiles =
+        static_cast<unsigned int>(redrawn_cascade_idxs.size());
+    shadow_stats_.num_static_redraws++;
+  }
+
+  // Restore all tiles if the dynamic casters are drawn in this frame or the
+  // last one, otherwise only the redrawn tiles are copied
+  const bool has_dynamic_casters = scene_shader_->HasDynamicCasters();
+  const std::vector<int> copied_cascade_idxs =
+      has_dynamic_casters || has_drawn_dynamic_casters_ ? GetAllCascadeIdxs()
+                                                        : redrawn_cascade_idxs;
+  has_drawn_dynamic_casters_ = has_dynamic_casters;
+  if (copied_cascade_idxs.empty()) {
+    return;
+  }
+
+  // Start from the cached depths
+  for (const int cascade_idx : copied_cascade_idxs) {
+    CopyDepthTile(DepthTextureTypes::kStaticFromLight,
+                  DepthTextureTypes::kFromLight, cascade_idx);
+  }
+  UseDepthTexture(DepthTextureTypes::kFromLight);
+  // Draw the dynamic casters on top
+  if (has_dynamic_casters) {
+    shadow_stats_.num_dynamic_draws =
+        DrawCascades(CasterFilters::kDynamic, GetAllCascadeIdxs());
+  }
+}
+
+/*
+ * The draw commands are recorded once and submitted to the tile of each given
+ * cascade with the instances of the cascade. Returns the number of submitted
+ * draw commands.
+ */
+unsigned int shader::DepthShader::DrawCascades(
+    const CasterFilters caster_filter, const std::vector<int> &cascade_idxs) {
+  // Get managers
+  as::StateManager &state_manager = gl_managers_->GetStateManager();
+  // Get light space transformation
+  const dto::GlobalTrans light_trans = GetLightTrans();
+  // Get the viewing position from the view transformation
+  const glm::vec3 view_pos = glm::vec3(glm::inverse(light_trans.view)[3]);
+  // Record and sort the draw commands
+  RecordDrawCmds(view_pos, SceneShader::CullingViews::kLight, caster_filter);
+  draw_list_.Sort();
+
+  unsigned int num_draws = 0;
+  for (const int cascade_idx : cascade_idxs) {
+    // Draw into the tile of the cascade
+    const glm::ivec4 viewport = GetCascadeViewport(cascade_idx);
+    state_manager.SetViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+    // Update global transformation
+    dto::GlobalTrans cascade_trans = light_trans;
+    cascade_trans.proj = shadow_cascades_.GetProj(cascade_idx);
+    UpdateGlobalTrans(cascade_trans);
+    // Submit the draw commands
+    num_draws += SubmitDrawCmds(SceneShader::CullingViews::kLight, cascade_idx,
+                                shadow_stats_.num_triangles);
+  }
+  return num_draws;
+}
+
+/*
+ * Clears the depths of the tile only, the other tiles keep their depths
+ */
+void shader::DepthShader::ClearCascadeTile(const int cascade_idx) {
+  // Get managers
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
+  // Get the tile of the cascade
+  const glm::ivec4 viewport = GetCascadeViewport(cascade_idx);
+
+  // Scissor the clear to the tile
+  trace_manager.RecordCall("glEnable", {GL_SCISSOR_TEST}, 0,
+                           [&] { glEnable(GL_SCISSOR_TEST); });
+  trace_manager.RecordCall(
+      "glScissor", {viewport.x, viewport.y, viewport.z, viewport.w}, 0, [&] {
+        glScissor(viewport.x, viewport.y, viewport.z, viewport.w);
+      });
+  trace_manager.RecordCall("glClear", {GL_DEPTH_BUFFER_BIT}, 0,
+                           [&] { glClear(GL_DEPTH_BUFFER_BIT); });
+  trace_manager.RecordCall("glDisable", {GL_SCISSOR_TEST}, 0,
+                           [&] { glDisable(GL_SCISSOR_TEST); });
+}
+
+void shader::DepthShader::CopyDepthTile(
+    const DepthTextureTypes src_depth_tex_type,
+    const DepthTextureTypes dst_depth_tex_type, const int cascade_idx) {
+  // Get managers
+  const as::TextureManager &texture_manager =
+      gl_managers_->GetTextureManager();
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
   // Get names
-  const std::string group_name = scene_model.GetVertexArrayGroupName();
+  const std::string src_tex_name = GetDepthTextureName(src_depth_tex_type);
+  const std::string dst_tex_name = GetDepthTextureName(dst_depth_tex_type);
+  // Get the tile of the cascade
+  const glm::ivec4 viewport = GetCascadeViewport(cascade_idx);
+  // Copy the tile in the first level
+  const GLuint src_tex_hdlr = texture_manager.GetTextureHdlr(src_tex_name);
+  const GLuint dst_tex_hdlr = texture_manager.GetTextureHdlr(dst_tex_name);
+  trace_manager.RecordCall(
+      "glCopyImageSubData",
+      {src_tex_hdlr, dst_tex_hdlr, viewport.x, viewport.y, viewport.z,
+       viewport.w},
+      0, [&] {
+        glCopyImageSubData(src_tex_hdlr, GL_TEXTURE_2D, 0, viewport.x,
+                           viewport.y, 0, dst_tex_hdlr, GL_TEXTURE_2D, 0,
+                           viewport.x, viewport.y, 0, viewport.z, viewport.w,
+                           1);
+      });
+}
+
+void shader::DepthShader::DrawSceneModels(
+    const dto::GlobalTrans &global_trans,
+    const SceneShader::CullingViews view, const CasterFilters caster_filter) {
+  // Get the viewing position from the view transformation
+  const glm::vec3 view_pos = glm::vec3(glm::inverse(global_trans.view)[3]);
+  // Record, sort and submit the draw commands
+  RecordDrawCmds(view_pos, view, caster_filter);
+  draw_list_.Sort();
+  unsigned int num_triangles = 0;
+  SubmitDrawCmds(view, 0, num_triangles);
+}
+
+/*
+ * The per-model transformation takes the material field of the sort keys, so
+ * that the meshes of a model are drawn together from front to back and the
+ * transformation is only updated once for each model
+ */
+void shader::DepthShader::RecordDrawCmds(
+    const glm::vec3 &view_pos, const SceneShader::CullingViews view,
+    const CasterFilters caster_filter) {
+  // Get managers
+  const as::ProgramManager &program_manager =
+      gl_managers_->GetProgramManager();
+  // Get the index which identifies the program in the sort keys
+  const GLuint program_sort_idx =
+      program_manager.GetProgramSortIdx(GetProgramName());
+  // Get the mesh draw information recorded by the scene shader
+  const std::vector<SceneShader::MeshDrawInfo> &mesh_draw_infos =
+      scene_shader_->GetMeshDrawInfos();
+  const auto &scene_models = scene_shader_->GetSceneModels();
 
-  // Draw each mesh with its own texture
-  for (size_t mesh_idx = 0; mesh_idx < meshes.size(); mesh_idx++) {
-    const as::Mesh &mesh = meshes.at(mesh_idx);
-    // Get the array indexes
-    const std::vector<size_t> &idxs = mesh.GetIdxs();
+  draw_list_.Clear();
+
+  std::map<std::string, GLuint> scene_model_idxs;
+  for (size_t info_idx = 0; info_idx < mesh_draw_infos.size(); info_idx++) {
+    const SceneShader::MeshDrawInfo &mesh_draw_info =
+        mesh_draw_infos.at(info_idx);
+    const dto::SceneModel &scene_model =
+        scene_models.at(mesh_draw_info.scene_model_name);
+    // Check whether all instances of the mesh are culled
+    if (!HasVisibleInstances(view, info_idx)) {
+      continue;
+    }
+    // Check whether the caster is drawn in this pass
+    if (caster_filter != CasterFilters::kAll &&
+        scene_shader_->IsDynamicCaster(mesh_draw_info.scene_model_name) !=
+            (caster_filter == CasterFilters::kDynamic)) {
+      continue;
+    }
+    // Assign the model index
+    if (scene_model_idxs.count(mesh_draw_info.scene_model_name) == 0) {
+      const GLuint scene_model_idx =
+          static_cast<GLuint>(scene_model_idxs.size());
+      scene_model_idxs[mesh_draw_info.scene_model_name] = scene_model_idx;
+    }
+    // Calculate the depth of the mesh center
+    const glm::vec4 center =
+        scene_model.GetTrans() * glm::vec4(mesh_draw_info.center, 1.0f);
+    const float depth = glm::distance(view_pos, glm::vec3(center));
+    // Record the draw command
+    const GLuint64 sort_key = as::DrawList::MakeSortKey(
+        kDrawPass, program_sort_idx,
+        scene_model_idxs.at(mesh_draw_info.scene_model_name),
+        as::DrawList::QuantizeDepth(depth, kMaxDrawDepth),
+        mesh_draw_info.va_idx);
+    draw_list_.AddDrawCmd(sort_key, info_idx);
+  }
+}
+
+/*
+ * The cascade index is only used by the light view. Returns the number of
+ * submitted draw commands and adds the number of submitted triangles.
+ */
+unsigned int shader::DepthShader::SubmitDrawCmds(
+    const SceneShader::CullingViews view, const int cascade_idx,
+    unsigned int &num_triangles) {
+  // Get managers
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
+  // Get the mesh draw information recorded by the scene shader
+  const std::vector<SceneShader::MeshDrawInfo> &mesh_draw_infos =
+      scene_shader_->GetMeshDrawInfos();
+  const auto &scene_models = scene_shader_->GetSceneModels();
+
+  unsigned int num_draws = 0;
+  for (const as::DrawList::DrawCmd &draw_cmd : draw_list_.GetDrawCmds()) {
+    const SceneShader::MeshDrawInfo &mesh_draw_info =
+        mesh_draw_infos.at(draw_cmd.item_idx);
+    const dto::SceneModel &scene_model =
+        scene_models.at(mesh_draw_info.scene_model_name);
+    // Check whether the mesh has no instances in the cascade
+    const SceneShader::VisibleRange visible_range =
+        GetVisibleRange(view, cascade_idx, draw_cmd.item_idx);
+    if (visible_range.num_instances == 0) {
+      continue;
+    }
+    // Get names
+    const std::string group_name = scene_model.GetVertexArrayGroupName();
     /* Draw Vertex Arrays */
-    UseMesh(group_name, mesh_idx);
-    glDrawElementsInstanced(GL_TRIANGLES, idxs.size(), GL_UNSIGNED_INT, nullptr,
-                            scene_model.GetNumInstancing());
+    UseMesh(group_name, mesh_draw_info.mesh_idx);
+    const GLsizei num_idxs = mesh_draw_info.num_idxs;
+    const GLsizei num_instances =
+        static_cast<GLsizei>(visible_range.num_instances);
+    const GLuint base_instance = visible_range.base_instance;
+    trace_manager.RecordCall(
+        "glDrawElementsInstancedBaseInstance",
+        {GL_TRIANGLES, num_idxs, num_instances, base_instance}, 0, [&] {
+          glDrawElementsInstancedBaseInstance(GL_TRIANGLES, num_idxs,
+                                              GL_UNSIGNED_INT, nullptr,
+                                              num_instances, base_instance);
+        });
+    num_draws++;
+    num_triangles += static_cast<unsigned int>(num_idxs / 3) *
+                     visible_range.num_instances;
+  }
+  return num_draws;
+}
+
+shader::SceneShader::VisibleRange shader::DepthShader::GetVisibleRange(
+    const SceneShader::CullingViews view, const int cascade_idx,
+    const size_t mesh_draw_info_idx) const {
+  if (view == SceneShader::CullingViews::kLight) {
+    return scene_shader_->GetCascadeVisibleRange(cascade_idx,
+                                                 mesh_draw_info_idx);
+  }
+  return scene_shader_->GetVisibleRange(view, mesh_draw_info_idx);
+}
+
+bool shader::DepthShader::HasVisibleInstances(
+    const SceneShader::CullingViews view,
+    const size_t mesh_draw_info_idx) const {
+  const int num_cascades = view == SceneShader::CullingViews::kLight
+                               ? shadow_cascades_.GetNumCascades()
+                               : 1;
+  for (int cascade_idx = 0; cascade_idx < num_cascades; cascade_idx++) {
+    if (GetVisibleRange(view, cascade_idx, mesh_draw_info_idx).num_instances >
+        0) {
+      return true;
+    }
   }
+  return false;
 }
@@ -7,8 +7,6 @@ shader::DiffShader::DiffShader() { diff_.display_mode = 0; }
  ******************************************************************************/
 
 void shader::DiffShader::Init() {
-  CreateShaders();
-  CreatePrograms();
   LoadModel();
   InitFramebuffers();
   InitUniformBlocks();
@@ -45,6 +43,8 @@ void shader::DiffShader::InitVertexArrays() {
  ******************************************************************************/
 
 void shader::DiffShader::Draw() {
+  // Get managers
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
   // Get names
   const std::string group_name = GetQuadVertexArrayGroupName();
 
@@ -56,10 +56,13 @@ void shader::DiffShader::Draw() {
   const as::Mesh &mesh = meshes.front();
   // Get the array indexes
   const std::vector<size_t> &idxs = mesh.GetIdxs();
+  const GLsizei num_idxs = static_cast<GLsizei>(idxs.size());
   // Use the first mesh
   UseMesh(group_name, 0);
   // Draw the mesh
-  glDrawElements(GL_TRIANGLES, idxs.size(), GL_UNSIGNED_INT, nullptr);
+  trace_manager.RecordCall("glDrawElements", {GL_TRIANGLES, num_idxs}, 0, [&] {
+    glDrawElements(GL_TRIANGLES, num_idxs, GL_UNSIGNED_INT, nullptr);
+  });
 }
 
 void shader::DiffShader::UseDiffFramebuffer(const DiffTypes diff_type) {
@@ -83,15 +86,10 @@ void shader::DiffShader::UpdateObjDiffRenderbuffer(const GLsizei width,
   const std::string obj_framebuffer_name =
       GetDiffFramebufferName(DiffTypes::kObj);
   const std::string obj_renderbuffer_name = GetObjDiffDepthRenderbufferName();
-  // Check whether to delete old renderbuffer
-  if (framebuffer_manager.HasRenderbuffer(obj_renderbuffer_name)) {
-    framebuffer_manager.DeleteRenderbuffer(obj_renderbuffer_name);
-  }
-  // Create renderbuffers
-  framebuffer_manager.GenRenderbuffer(obj_renderbuffer_name);
-  // Initialize renderbuffers
-  framebuffer_manager.InitRenderbuffer(obj_renderbuffer_name, GL_RENDERBUFFER,
-                                       GL_DEPTH24_STENCIL8, width, height);
+  // Acquire the renderbuffer from the pool, the old one is released
+  const as::FramebufferManager::RenderTargetDesc desc = {GL_DEPTH24_STENCIL8,
+                                                         width, height, 1, 0};
+  framebuffer_manager.AcquireRenderbuffer(obj_renderbuffer_name, desc);
   // Attach the renderbuffer to all framebuffers
   for (const DiffTypes diff_type : diff_types) {
     const std::string framebuffer_name = GetDiffFramebufferName(diff_type);
@@ -116,16 +114,12 @@ void shader::DiffShader::UpdateDiffFramebufferTextures(const GLsizei width,
     const std::string tex_name = GetDiffFramebufferTextureName(diff_type);
     const std::string tex_unit_name =
         GetDiffFramebufferTextureUnitName(diff_type);
-    // Check whether to delete old texture
-    if (texture_manager.HasTexture(tex_name)) {
-      texture_manager.DeleteTexture(tex_name);
-    }
-    // Generate texture
-    texture_manager.GenTexture(tex_name);
+    // Acquire the texture from the pool, the old one is released
+    const as::FramebufferManager::RenderTargetDesc desc = {GL_RGB8, width,
+                                                           height, 1, 0};
+    framebuffer_manager.AcquireTexture2D(tex_name, desc);
     // Update texture
     texture_manager.BindTexture(tex_name, GL_TEXTURE_2D, tex_unit_name);
-    texture_manager.InitTexture2D(tex_name, GL_TEXTURE_2D, 1, GL_RGB8, width,
-                                  height);
     texture_manager.SetTextureParamInt(tex_name, GL_TEXTURE_2D,
                                        GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     texture_manager.SetTextureParamInt(tex_name, GL_TEXTURE_2D,
@@ -4,7 +4,12 @@
 
 #include "as/common.hpp"
 #include "as/gl/gl_tools.hpp"
+#include "as/gl/render_graph.hpp"
+#include "as/trans/bvh.hpp"
 #include "as/trans/camera.hpp"
+#include "as/trans/frustum.hpp"
+#include "as/trans/light_clusters.hpp"
+#include "as/trans/shadow_cascades.hpp"
 
 #include "aircraft_controller.hpp"
 #include "depth_shader.hpp"
@@ -12,6 +17,7 @@
 #include "fbx_camera_controller.hpp"
 #include "fbx_controller.hpp"
 #include "postproc_shader.hpp"
+#include "resolution_controller.hpp"
 #include "scene_shader.hpp"
 #include "skybox_shader.hpp"
 #include "sound_controller.hpp"
@@ -34,11 +40,29 @@ static const auto kCameraZoomingStep = 1.0f;
 static const auto kTimerInterval = 10;
 /* Camera Shaking */
 static const auto kCameraShakingMaxWind = 0.1f;
+/* Dynamic Resolution */
+static const auto kInitTargetFrameTime = 1.0f / 60.0f;
+static const auto kMinRenderScale = 0.5f;
+static const auto kMaxRenderScale = 1.0f;
+static const auto kRenderScaleStep = 0.125f;
 /* Collision */
 static const auto kCollisionDistUpdateInterval = 0.5f;
 static const auto kCollisionDist = 0.3f;
 static const auto kCollisionWarningDist = 1.0f;
 static const auto kCollisionShakingDurationRatio = 0.5f;
+/* Point Lights */
+static const auto kBuildingLampsCenter = glm::vec3(12.8f, 1.4f, 15.8f);
+static const auto kBuildingLampsOfs = 0.9f;
+static const auto kNumRunwayLights = 32;
+static const auto kRunwayLightsBeginPos = glm::vec3(8.0f, 0.2f, -30.0f);
+static const auto kRunwayLightsStep = glm::vec3(0.0f, 0.0f, 2.0f);
+static const auto kRunwayWidth = 4.0f;
+static const auto kExplosionFlashRadius = 15.0f;
+static const auto kExplosionFlashIntensity = 20.0f;
+static const auto kExplosionFlashDuration = 1.5f;
+static const auto kMaxNumExtraPointLights = 1024;
+static const auto kExtraPointLightsRange = 40.0f;
+static const auto kExtraPointLightsSeed = 1u;
 
 /* Debug */
 // Shadow
@@ -50,6 +74,34 @@ static const auto kEditingModelName = "tower";
 static const auto kEditingModelScalingStep = 0.01f;
 static const auto kEditingModelRotationStep = 0.01f;
 static const auto kEditingModelTranslationStep = 0.1f;
+// GL trace
+static const auto kGLTracePath = "gl_trace.csv";
+// The first frames of the headless runs upload the whole scene, so they are
+// drawn before recording
+static const auto kHeadlessNumWarmupFrames = 3;
+// Program binary cache
+static const auto kProgramBinaryCacheDir = "cache/programs";
+// Profiler
+static const auto kProfilePath = "profile.csv";
+static const auto kProfileGraphHeight = 40.0f;
+// Render graph
+static const auto kRenderGraphTimelinePath = "render_graph.txt";
+// Culling benchmark
+static const auto kCullingBenchmarkNumInstances = 100000;
+static const auto kCullingBenchmarkNumIterations = 10;
+static const auto kCullingBenchmarkRange = 500.0f;
+static const auto kCullingBenchmarkNumMovedInstances = 1000;
+// Vertex benchmark
+static const auto kVertexBenchmarkNumIterations = 100;
+static const std::vector<std::string> kVertexBenchmarkSceneModelNames = {
+    "tower", "ground"};
+// Light benchmark
+static const std::vector<int> kLightBenchmarkNumLights = {0,   16,  64,
+                                                          256, 512, 1024};
+static const auto kLightBenchmarkNumWarmupFrames = 10;
+static const auto kLightBenchmarkNumFrames = 30;
+// Picking
+static const auto kLookAtMaxDist = 1e3f;
 
 /*******************************************************************************
  * Debugging
@@ -57,6 +109,29 @@ static const auto kEditingModelTranslationStep = 0.1f;
 
 // Model editing
 int editing_model_instance_idx = 0;
+// Culling benchmark
+bool run_culling_benchmark = false;
+double culling_benchmark_bounds_seconds = 0.0;
+double culling_benchmark_batch_seconds = 0.0;
+double culling_benchmark_scalar_seconds = 0.0;
+size_t culling_benchmark_num_visibles = 0;
+double culling_benchmark_build_seconds = 0.0;
+double culling_benchmark_refit_seconds = 0.0;
+double culling_benchmark_bvh_seconds = 0.0;
+unsigned int culling_benchmark_num_visited_nodes = 0;
+// Vertex benchmark
+bool run_vertex_benchmark = false;
+double vertex_benchmark_seconds = 0.0;
+GLuint64 vertex_benchmark_num_vertices = 0;
+// Light benchmark
+bool run_light_benchmark = false;
+size_t light_benchmark_step_idx = 0;
+int light_benchmark_frame_idx = 0;
+int light_benchmark_orig_num_lights = 0;
+std::vector<double> light_benchmark_gpu_seconds;
+std::vector<double> light_benchmark_assign_seconds;
+// Headless run
+bool is_headless = false;
 
 /*******************************************************************************
  * Camera States
@@ -73,6 +148,7 @@ as::CameraTrans camera_trans(glm::vec3(10.0f, 5.0f, 0.0f),
 
 as::GLManagers gl_managers;
 as::UiManager ui_manager;
+as::RenderGraph render_graph;
 
 /*******************************************************************************
  * Shaders
@@ -118,6 +194,9 @@ ctrl::AircraftController aircraft_ctrl(
 ctrl::FbxController fbx_ctrl;
 ctrl::FbxController explosion_fbx_ctrl;
 ctrl::SoundController sound_ctrl;
+ctrl::ResolutionController resolution_ctrl(kInitTargetFrameTime,
+                                           kMinRenderScale, kMaxRenderScale,
+                                           kRenderScaleStep);
 
 /*******************************************************************************
  * Random Number Generators
@@ -139,6 +218,15 @@ bool has_collided = false;
 float collision_anim_elapsed_time = 0.0f;
 bool has_collision_anim_finished = false;
 
+/*******************************************************************************
+ * Point Light States
+ ******************************************************************************/
+
+// The building lamps and the runway lights
+std::vector<as::LightClusters::PointLight> fixed_point_lights;
+// Randomly placed lights for stressing the light clusters
+std::vector<as::LightClusters::PointLight> extra_point_lights;
+
 /*******************************************************************************
  * Rendering States
  ******************************************************************************/
@@ -160,7 +248,23 @@ bool use_hdr = false;
 bool use_gamma_correct = false;
 
 bool limit_window_scaling = false;
+bool use_dynamic_resolution = false;
+float target_frame_time_ms = 1e3f * kInitTargetFrameTime;
 bool render_wireframe = false;
+bool use_indirect_drawing = false;
+bool use_culling = true;
+bool use_occlusion_culling = true;
+bool use_mesh_batching = true;
+bool use_depth_prepass = false;
+bool use_material_lod = true;
+float reduced_material_tier_dist = 40.0f;
+float far_material_tier_dist = 100.0f;
+bool use_shadow_caching = true;
+int num_shadow_cascades = as::ShadowCascades::kMaxNumCascades;
+int num_extra_point_lights = 0;
+bool use_shader_permutations = true;
+bool animate_instances = false;
+bool record_gl_trace = false;
 
 /*******************************************************************************
  * User Interface States
@@ -206,12 +310,20 @@ void InitGLUT(int argc, char *argv[]) {
  ******************************************************************************/
 
 void ConfigGLSettings() {
-  glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-  glClearDepth(1.0f);
-  glClearStencil(0);
-  glDepthFunc(GL_LEQUAL);
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_MULTISAMPLE_ARB);
+  // Get managers
+  as::TraceManager &trace_manager = gl_managers.GetTraceManager();
+
+  trace_manager.RecordCall("glClearColor", {}, 0,
+                           [] { glClearColor(1.0f, 1.0f, 1.0f, 1.0f); });
+  trace_manager.RecordCall("glClearDepth", {}, 0, [] { glClearDepth(1.0f); });
+  trace_manager.RecordCall("glClearStencil", {0}, 0,
+                           [] { glClearStencil(0); });
+  trace_manager.RecordCall("glDepthFunc", {GL_LEQUAL}, 0,
+                           [] { glDepthFunc(GL_LEQUAL); });
+  trace_manager.RecordCall("glEnable", {GL_DEPTH_TEST}, 0,
+                           [] { glEnable(GL_DEPTH_TEST); });
+  trace_manager.RecordCall("glEnable", {GL_MULTISAMPLE_ARB}, 0,
+                           [] { glEnable(GL_MULTISAMPLE_ARB); });
   // glEnable(GL_CULL_FACE);
   // glEnable(GL_BLEND);
 
@@ -219,11 +331,15 @@ void ConfigGLSettings() {
   // glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
   // Enable stencil test
-  glEnable(GL_STENCIL_TEST);
+  trace_manager.RecordCall("glEnable", {GL_STENCIL_TEST}, 0,
+                           [] { glEnable(GL_STENCIL_TEST); });
   // Set default stencil action
-  glStencilFunc(GL_EQUAL, 0, 0xFF);
+  trace_manager.RecordCall("glStencilFunc", {GL_EQUAL, 0, 0xFF}, 0,
+                           [] { glStencilFunc(GL_EQUAL, 0, 0xFF); });
   // Set stencil test actions
-  glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+  trace_manager.RecordCall(
+      "glStencilOp", {GL_KEEP, GL_KEEP, GL_REPLACE}, 0,
+      [] { glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE); });
 }
 
 void InitUiManager() {
@@ -247,6 +363,17 @@ void InitShaders() {
   scene_shader.RegisterDepthShader(depth_shader);
   scene_shader.RegisterSkyboxShader(skybox_shader);
   skybox_shader.RegisterSceneShader(scene_shader);
+  // Cache the linked programs to skip compiling shaders on the next launch
+  as::ProgramManager &program_manager = gl_managers.GetProgramManager();
+  program_manager.EnableBinaryCache(kProgramBinaryCacheDir);
+  // Submit all programs first so that they are compiled in parallel, each
+  // program is waited for when it's first used
+  program_manager.EnableParallelCompile();
+  depth_shader.SubmitPrograms();
+  diff_shader.SubmitPrograms();
+  postproc_shader.SubmitPrograms();
+  scene_shader.SubmitPrograms();
+  skybox_shader.SubmitPrograms();
   // Initialize shaders
   depth_shader.Init();
   diff_shader.Init();
@@ -257,6 +384,21 @@ void InitShaders() {
   scene_shader.ReuseSkyboxTexture();
   // Bind textures
   scene_shader.BindTextures();
+  // Check the programs which haven't been used
+  program_manager.FinishLinkingPrograms();
+  // Report the program linking time for comparing with the cold cache
+  const as::ProgramManager::LinkStats link_stats =
+      program_manager.GetLinkStats();
+  std::cerr << "Linked programs in " << 1e3 * link_stats.link_seconds
+            << " ms (" << link_stats.num_cache_hits << " cached, "
+            << link_stats.num_cache_misses << " compiled)" << std::endl;
+}
+
+void InitRenderGraph() {
+  render_graph.RegisterFramebufferManager(gl_managers.GetFramebufferManager());
+  render_graph.RegisterTextureManager(gl_managers.GetTextureManager());
+  render_graph.RegisterProfilerManager(gl_managers.GetProfilerManager());
+  render_graph.RegisterTraceManager(gl_managers.GetTraceManager());
 }
 
 void ConfigGL() {
@@ -264,6 +406,7 @@ void ConfigGL() {
   ConfigGLSettings();
   InitUiManager();
   InitShaders();
+  InitRenderGraph();
 }
 
 /*******************************************************************************
@@ -392,6 +535,103 @@ void ResetCollision() {
   StartInitialSound();
 }
 
+/*******************************************************************************
+ * Point Light Handlers
+ ******************************************************************************/
+
+/*
+ * The extra lights use a fixed seed, so that the light benchmarks could be
+ * compared between the runs
+ */
+void InitPointLights() {
+  // Lamps at the corners of the industrial building
+  for (int lamp_idx = 0; lamp_idx < 4; lamp_idx++) {
+    const float ofs_x = (lamp_idx & 1) ? kBuildingLampsOfs : -kBuildingLampsOfs;
+    const float ofs_z = (lamp_idx & 2) ? kBuildingLampsOfs : -kBuildingLampsOfs;
+    const glm::vec3 ofs(ofs_x, 0.0f, ofs_z);
+    fixed_point_lights.push_back({kBuildingLampsCenter + ofs, 3.0f,
+                                  glm::vec3(1.0f, 0.8f, 0.5f), 2.0f});
+  }
+  // Two rows of runway lights
+  for (int light_idx = 0; light_idx < kNumRunwayLights; light_idx++) {
+    const glm::vec3 pos = kRunwayLightsBeginPos +
+                          static_cast<float>(light_idx) * kRunwayLightsStep;
+    const glm::vec3 color(0.4f, 0.6f, 1.0f);
+    fixed_point_lights.push_back({pos, 1.5f, color, 3.0f});
+    fixed_point_lights.push_back(
+        {pos + glm::vec3(kRunwayWidth, 0.0f, 0.0f), 1.5f, color, 3.0f});
+  }
+  // Random extra lights
+  std::mt19937 light_rand_engine(kExtraPointLightsSeed);
+  std::uniform_real_distribution<float> pos_distrib(-kExtraPointLightsRange,
+                                                    kExtraPointLightsRange);
+  std::uniform_real_distribution<float> height_distrib(0.5f, 5.0f);
+  std::uniform_real_distribution<float> radius_distrib(1.0f, 4.0f);
+  std::uniform_real_distribution<float> color_distrib(0.2f, 1.0f);
+  for (int light_idx = 0; light_idx < kMaxNumExtraPointLights; light_idx++) {
+    const glm::vec3 pos(pos_distrib(light_rand_engine),
+                        height_distrib(light_rand_engine),
+                        pos_distrib(light_rand_engine));
+    const float radius = radius_distrib(light_rand_engine);
+    const glm::vec3 color(color_distrib(light_rand_engine),
+                          color_distrib(light_rand_engine),
+                          color_distrib(light_rand_engine));
+    extra_point_lights.push_back({pos, radius, color, 2.0f});
+  }
+}
+
+/*******************************************************************************
+ * Light Benchmark
+ ******************************************************************************/
+
+void StartLightBenchmark() {
+  run_light_benchmark = true;
+  light_benchmark_step_idx = 0;
+  light_benchmark_frame_idx = 0;
+  light_benchmark_orig_num_lights = num_extra_point_lights;
+  light_benchmark_gpu_seconds.assign(kLightBenchmarkNumLights.size(), 0.0);
+  light_benchmark_assign_seconds.assign(kLightBenchmarkNumLights.size(), 0.0);
+}
+
+/*
+ * Sweeps the number of extra point lights, each step takes several frames.
+ * The first frames of each step are skipped because the GPU times of the
+ * profiler lag behind, and the scene pass GPU time and the light assignment
+ * time are averaged over the other frames.
+ */
+void StepLightBenchmark() {
+  // Get managers
+  const as::ProfilerManager &profiler_manager =
+      gl_managers.GetProfilerManager();
+  // Accumulate the times of the last frame
+  if (light_benchmark_frame_idx >= kLightBenchmarkNumWarmupFrames) {
+    light_benchmark_gpu_seconds[light_benchmark_step_idx] +=
+        profiler_manager.GetPassTimes("Scene").gpu_seconds;
+    light_benchmark_assign_seconds[light_benchmark_step_idx] +=
+        scene_shader.GetLightClusterStats().assign_seconds;
+  }
+  light_benchmark_frame_idx++;
+  if (light_benchmark_frame_idx <
+      kLightBenchmarkNumWarmupFrames + kLightBenchmarkNumFrames) {
+    num_extra_point_lights = kLightBenchmarkNumLights[light_benchmark_step_idx];
+    return;
+  }
+
+  // Average the times and go to the next step
+  light_benchmark_gpu_seconds[light_benchmark_step_idx] /=
+      kLightBenchmarkNumFrames;
+  light_benchmark_assign_seconds[light_benchmark_step_idx] /=
+      kLightBenchmarkNumFrames;
+  light_benchmark_frame_idx = 0;
+  light_benchmark_step_idx++;
+  if (light_benchmark_step_idx < kLightBenchmarkNumLights.size()) {
+    num_extra_point_lights = kLightBenchmarkNumLights[light_benchmark_step_idx];
+  } else {
+    num_extra_point_lights = light_benchmark_orig_num_lights;
+    run_light_benchmark = false;
+  }
+}
+
 /*******************************************************************************
  * GUI Handlers
  ******************************************************************************/
@@ -437,7 +677,216 @@ void UpdateImGui() {
 
     if (!has_opened) ImGui::SetNextTreeNodeOpen(true);
     if (ImGui::CollapsingHeader("Performance")) {
+      const as::StateManager &state_manager = gl_managers.GetStateManager();
+      const as::StateManager::CallCounts call_counts =
+          state_manager.GetFrameCallCounts();
+      const as::RingBufferManager &ring_buffer_manager =
+          gl_managers.GetRingBufferManager();
+      const as::RingBufferManager::RingBufferStats ring_stats =
+          ring_buffer_manager.GetFrameStats(
+              scene_shader.GetUniformRingBufferName());
+      const as::TraceManager &trace_manager = gl_managers.GetTraceManager();
+      const as::TraceManager::FrameSummary trace_summary =
+          trace_manager.GetFrameSummary();
+      const as::ProfilerManager &profiler_manager =
+          gl_managers.GetProfilerManager();
+      const shader::SceneShader::InstancingStats instancing_stats =
+          scene_shader.GetInstancingStats();
+      const as::UniformManager::UniformStats uniform_stats =
+          gl_managers.GetUniformManager().GetFrameStats();
+      const as::ProgramManager::LinkStats link_stats =
+          gl_managers.GetProgramManager().GetLinkStats();
+      const as::FramebufferManager::RenderTargetStats target_stats =
+          gl_managers.GetFramebufferManager().GetRenderTargetStats();
+      const shader::SceneShader::CullingStats culling_stats =
+          scene_shader.GetCullingStats();
+
       ImGui::Text("FPS: %.1f", io.Framerate);
+      const glm::ivec2 render_size = ui_manager.GetWindowSize();
+      ImGui::Text("Render Size: %dx%d (scale %.3f, GPU frame %.3f ms)",
+                  render_size.x, render_size.y, resolution_ctrl.GetScale(),
+                  1e3f * resolution_ctrl.GetFrameSeconds());
+      ImGui::Text("GL State Calls: %u issued, %u skipped",
+                  call_counts.num_issued, call_counts.num_skipped);
+      ImGui::Text("GL Traced Calls: %u (%.3f ms), Uploads: %lld bytes",
+                  trace_summary.num_calls, 1e3 * trace_summary.call_seconds,
+                  static_cast<long long>(trace_summary.num_uploaded_bytes));
+      ImGui::Text("Uniform Uploads: %lld bytes in %u ranges",
+                  static_cast<long long>(ring_stats.num_uploaded_bytes),
+                  ring_stats.num_allocs);
+      ImGui::Text("Uniform Stalls: %u (%.3f ms)", ring_stats.num_stalls,
+                  1e3 * ring_stats.stall_seconds);
+      ImGui::Text("Uniform Values: %u uploaded, %u skipped",
+                  uniform_stats.num_uploads, uniform_stats.num_skipped);
+      ImGui::Text("Scene Draw Calls: %u", scene_shader.GetNumDrawCalls());
+      ImGui::Text("Instance Uploads: %lld bytes for %u instances",
+                  static_cast<long long>(instancing_stats.num_uploaded_bytes),
+                  instancing_stats.num_updated_instances);
+      ImGui::Text("Instance Buffers Orphaned: %u",
+                  instancing_stats.num_orphaned_buffers);
+      ImGui::Text("Visible Instances: %u camera, %u light of %u",
+                  culling_stats.num_camera_visible_instances,
+                  culling_stats.num_light_visible_instances,
+                  culling_stats.num_instances);
+      ImGui::Text("Occluded Instances: %u (%zu occluder triangles)",
+                  culling_stats.num_occluded_instances,
+                  scene_shader.GetOcclusionBuffer().GetNumTriangles());
+      const shader::SceneShader::BatchingStats batching_stats =
+          scene_shader.GetBatchingStats();
+      ImGui::Text("Batched Draws: %u saved (%u shared meshes)",
+                  batching_stats.num_batched_draws,
+                  batching_stats.num_shared_meshes);
+      const shader::SceneShader::FragmentStats fragment_stats =
+          scene_shader.GetFragmentStats();
+      if (fragment_stats.is_supported) {
+        ImGui::Text("Fragment Invocations: %llu scene, %llu pre-pass",
+                    fragment_stats.num_scene_invocations,
+                    fragment_stats.num_prepass_invocations);
+        ImGui::Text("Scene Fragments: %llu with pre-pass, %llu without",
+                    fragment_stats.num_prepassed_scene_invocations,
+                    fragment_stats.num_unprepassed_scene_invocations);
+      } else {
+        ImGui::Text("Fragment Invocations: Unsupported");
+      }
+      const shader::SceneShader::LightClusterStats light_cluster_stats =
+          scene_shader.GetLightClusterStats();
+      ImGui::Text("Point Lights: %u (%u cluster refs, max %u per cluster)",
+                  light_cluster_stats.num_point_lights,
+                  light_cluster_stats.num_light_refs,
+                  light_cluster_stats.max_num_cluster_lights);
+      ImGui::Text("Light Assignment: %.3f ms",
+                  1e3 * light_cluster_stats.assign_seconds);
+      const shader::DepthShader::ShadowStats shadow_stats =
+          depth_shader.GetShadowStats();
+      ImGui::Text("Shadow Casters: %s (%u tiles), %u static redraws",
+                  shadow_stats.is_static_redrawn ? "redrawn" : "cached",
+                  shadow_stats.num_redrawn_tiles,
+                  shadow_stats.num_static_redraws);
+      ImGui::Text("Shadow Draws: %u static, %u dynamic (%u triangles)",
+                  shadow_stats.num_static_draws,
+                  shadow_stats.num_dynamic_draws, shadow_stats.num_triangles);
+      const as::ShadowCascades &shadow_cascades =
+          depth_shader.GetShadowCascades();
+      ImGui::Text("Shadow Cascade Splits:");
+      for (int cascade_idx = 0;
+           cascade_idx < shadow_cascades.GetNumCascades(); cascade_idx++) {
+        ImGui::SameLine();
+        ImGui::Text("%.1f", shadow_cascades.GetSplitDepth(cascade_idx));
+      }
+      const shader::SceneShader::MaterialLodStats material_lod_stats =
+          scene_shader.GetMaterialLodStats();
+      ImGui::Text("Material Tier Instances:");
+      for (const unsigned int num_tier_instances :
+           material_lod_stats.num_tier_instances) {
+        ImGui::SameLine();
+        ImGui::Text("%u", num_tier_instances);
+      }
+      const float full_fragment_cost = material_lod_stats.full_fragment_cost;
+      ImGui::Text("Estimated Fragment Cost Saved: %.1f%%",
+                  full_fragment_cost > 0.0f
+                      ? 100.0f * (1.0f - material_lod_stats.tier_fragment_cost /
+                                             full_fragment_cost)
+                      : 0.0f);
+      const as::Bvh &instance_bvh = scene_shader.GetInstanceBvh();
+      ImGui::Text("Instance BVH: %zu nodes, %u visited, cost %.1f (built %.1f)",
+                  instance_bvh.GetNumNodes(), culling_stats.num_visited_nodes,
+                  instance_bvh.GetCost(), instance_bvh.GetBuiltCost());
+      ImGui::Text("Shader Permutations: %zu",
+                  scene_shader.GetNumPermutationPrograms());
+      const long long num_requested_kb =
+          static_cast<long long>(target_stats.num_requested_bytes) / 1024;
+      const long long num_allocated_kb =
+          static_cast<long long>(target_stats.num_allocated_bytes) / 1024;
+      const long long num_idle_kb =
+          static_cast<long long>(target_stats.num_idle_bytes) / 1024;
+      ImGui::Text(
+          "Render Targets: %lld KB requested, %lld KB allocated, %lld KB idle",
+          num_requested_kb, num_allocated_kb, num_idle_kb);
+      ImGui::Text("Render Target Aliases: %u, Allocs: %u, Reuses: %u",
+                  target_stats.num_aliases,
+                  target_stats.num_allocs,
+                  target_stats.num_reuses);
+      ImGui::Text("Render Graph: %u passes, %u culled",
+                  render_graph.GetNumPasses(),
+                  render_graph.GetNumCulledPasses());
+      ImGui::Text("Program Linking: %.1f ms (%u cached, %u compiled)",
+                  1e3 * link_stats.link_seconds, link_stats.num_cache_hits,
+                  link_stats.num_cache_misses);
+
+      // Show the state changes between the sorted draw commands
+      const std::vector<std::tuple<std::string, const as::DrawList *>>
+          draw_lists = {{"Scene", &scene_shader.GetDrawList()},
+                        {"Depth", &depth_shader.GetDrawList()}};
+      for (const auto &draw_list_pair : draw_lists) {
+        const std::string &name = std::get<0>(draw_list_pair);
+        const as::DrawList &draw_list = *std::get<1>(draw_list_pair);
+        ImGui::Text(
+            "%s Draws: %zu (Program %u, Material %u, VA %u changes)",
+            name.c_str(), draw_list.GetDrawCmds().size(),
+            draw_list.CountFieldChanges(as::DrawList::KeyFields::kProgram),
+            draw_list.CountFieldChanges(as::DrawList::KeyFields::kMaterial),
+            draw_list.CountFieldChanges(
+                as::DrawList::KeyFields::kVertexArray));
+      }
+
+      // Show the pass times with the graphs of recent frames
+      for (const std::string &pass_name : profiler_manager.GetPassNames()) {
+        const as::ProfilerManager::PassTimes pass_times =
+            profiler_manager.GetPassTimes(pass_name);
+        const std::vector<float> &gpu_history =
+            profiler_manager.GetGpuHistory(pass_name);
+        const std::string label = "##" + pass_name;
+        ImGui::Text("%s: CPU %.3f ms, GPU %.3f ms", pass_name.c_str(),
+                    1e3 * pass_times.cpu_seconds, 1e3 * pass_times.gpu_seconds);
+        ImGui::PlotLines(label.c_str(), gpu_history.data(),
+                         static_cast<int>(gpu_history.size()),
+                         profiler_manager.GetHistoryOfs(), "GPU (ms)", 0.0f,
+                         FLT_MAX, ImVec2(0.0f, kProfileGraphHeight));
+      }
+      if (ImGui::Button("Export Profile")) {
+        profiler_manager.SaveCsv(kProfilePath);
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("Export Render Graph")) {
+        render_graph.SaveTimeline(kRenderGraphTimelinePath);
+      }
+      if (ImGui::Button("Benchmark Culling")) {
+        run_culling_benchmark = true;
+      }
+      ImGui::Text("Culling %d Instances: Bounds %.3f ms, Batch %.3f ms, "
+                  "Scalar %.3f ms, %zu visible",
+                  kCullingBenchmarkNumInstances,
+                  1e3 * culling_benchmark_bounds_seconds,
+                  1e3 * culling_benchmark_batch_seconds,
+                  1e3 * culling_benchmark_scalar_seconds,
+                  culling_benchmark_num_visibles);
+      ImGui::Text("BVH: Build %.3f ms, Refit %d %.3f ms, Traversal %.3f ms, "
+                  "%u nodes visited",
+                  1e3 * culling_benchmark_build_seconds,
+                  kCullingBenchmarkNumMovedInstances,
+                  1e3 * culling_benchmark_refit_seconds,
+                  1e3 * culling_benchmark_bvh_seconds,
+                  culling_benchmark_num_visited_nodes);
+      if (ImGui::Button("Benchmark Vertices")) {
+        run_vertex_benchmark = true;
+      }
+      const double vertex_throughput =
+          vertex_benchmark_seconds > 0.0
+              ? 1e-6 * vertex_benchmark_num_vertices / vertex_benchmark_seconds
+              : 0.0;
+      ImGui::Text("Tower and Ground Vertices: %llu in %.3f ms, %.1f M/s",
+                  vertex_benchmark_num_vertices,
+                  1e3 * vertex_benchmark_seconds, vertex_throughput);
+      if (ImGui::Button("Benchmark Lights") && !run_light_benchmark) {
+        StartLightBenchmark();
+      }
+      for (size_t step_idx = 0; step_idx < light_benchmark_gpu_seconds.size();
+           step_idx++) {
+        ImGui::Text("%d Extra Lights: Scene GPU %.3f ms, Assign %.3f ms",
+                    kLightBenchmarkNumLights[step_idx],
+                    1e3 * light_benchmark_gpu_seconds[step_idx],
+                    1e3 * light_benchmark_assign_seconds[step_idx]);
+      }
     }
 
     if (!has_opened) ImGui::SetNextTreeNodeOpen(true);
@@ -446,6 +895,20 @@ void UpdateImGui() {
                   camera_pos.z);
       ImGui::Text("Angles (Degree): (%.2f, %.2f, %.2f)", camera_angles.x,
                   camera_angles.y, camera_angles.z);
+      // Cast a ray along the view direction
+      const glm::mat4 view = camera_trans.GetTrans();
+      const glm::vec3 camera_dir(-view[0][2], -view[1][2], -view[2][2]);
+      std::string look_at_model_name;
+      size_t look_at_instance_idx;
+      float look_at_dist;
+      if (scene_shader.CastRay(camera_pos, camera_dir, kLookAtMaxDist,
+                               look_at_model_name, look_at_instance_idx,
+                               look_at_dist)) {
+        ImGui::Text("Looking At: %s #%zu (%.1f)", look_at_model_name.c_str(),
+                    look_at_instance_idx, look_at_dist);
+      } else {
+        ImGui::Text("Looking At: Nothing");
+      }
     }
 
     if (!has_opened) ImGui::SetNextTreeNodeOpen(true);
@@ -532,7 +995,28 @@ void UpdateImGui() {
     if (!has_opened) ImGui::SetNextTreeNodeOpen(true);
     if (ImGui::CollapsingHeader("Debug")) {
       ImGui::Checkbox("Quick Render", &limit_window_scaling);
+      ImGui::Checkbox("Dynamic Resolution", &use_dynamic_resolution);
+      ImGui::SliderFloat("Target Frame Time (ms)", &target_frame_time_ms,
+                         5.0f, 50.0f);
       ImGui::Checkbox("Wireframe", &render_wireframe);
+      ImGui::Checkbox("Indirect Drawing", &use_indirect_drawing);
+      ImGui::Checkbox("Frustum Culling", &use_culling);
+      ImGui::Checkbox("Occlusion Culling", &use_occlusion_culling);
+      ImGui::Checkbox("Mesh Batching", &use_mesh_batching);
+      ImGui::Checkbox("Depth Pre-Pass", &use_depth_prepass);
+      ImGui::Checkbox("Material LOD", &use_material_lod);
+      ImGui::SliderFloat("Reduced Material Distance",
+                         &reduced_material_tier_dist, 0.0f, 200.0f);
+      ImGui::SliderFloat("Far Material Distance", &far_material_tier_dist,
+                         0.0f, 200.0f);
+      ImGui::Checkbox("Shadow Caching", &use_shadow_caching);
+      ImGui::SliderInt("Shadow Cascades", &num_shadow_cascades, 1,
+                       as::ShadowCascades::kMaxNumCascades);
+      ImGui::SliderInt("Extra Point Lights", &num_extra_point_lights, 0,
+                       kMaxNumExtraPointLights);
+      ImGui::Checkbox("Shader Permutations", &use_shader_permutations);
+      ImGui::Checkbox("Animate Instances", &animate_instances);
+      ImGui::Checkbox("Record GL Trace", &record_gl_trace);
     }
 
     // Update controllers
@@ -585,6 +1069,80 @@ void UpdateCameraShakingWind() {
       camera_shaking_wind, (-kCameraShakingMaxWind), kCameraShakingMaxWind);
 }
 
+/*******************************************************************************
+ * Dynamic Resolution
+ ******************************************************************************/
+
+/*
+ * Returns the size of the render targets, the postproc pass upscales them to
+ * the actual window size
+ */
+glm::ivec2 GetRenderSize(const glm::ivec2 &actual_window_size) {
+  glm::ivec2 window_size = actual_window_size;
+
+  // Limit texture sizes
+  if (limit_window_scaling) {
+    const int kMaxTextureWidth = 1024;
+    if (window_size.x > kMaxTextureWidth) {
+      const float ratio = (float)window_size.x / (float)window_size.y;
+      window_size.x = kMaxTextureWidth;
+      window_size.y = (int)((float)kMaxTextureWidth / ratio);
+    }
+  }
+
+  // Scale by the dynamic resolution
+  if (use_dynamic_resolution) {
+    const glm::vec2 scaled_size =
+        resolution_ctrl.GetScale() * glm::vec2(window_size);
+    window_size = glm::max(glm::ivec2(scaled_size), glm::ivec2(1));
+  }
+  return window_size;
+}
+
+/*
+ * The textures are acquired from the render target pool, so the targets of a
+ * recently used scale are reused instead of being recreated
+ */
+void ResizeRenderTargets(const glm::ivec2 &window_size) {
+  // Save window size
+  ui_manager.SaveWindowSize(window_size);
+  // Update screen textures
+  postproc_shader.UpdatePostprocTextures(window_size.x, window_size.y);
+  // Update differential rendering stencil renderbuffers
+  diff_shader.UpdateObjDiffRenderbuffer(window_size.x, window_size.y);
+  // Update differential rendering framebuffer textures
+  diff_shader.UpdateDiffFramebufferTextures(window_size.x, window_size.y);
+  // Update FBX, which isn't initialized in the headless runs
+  if (!is_headless) {
+    fbx_ctrl.OnReshape(window_size.x, window_size.y);
+    explosion_fbx_ctrl.OnReshape(window_size.x, window_size.y);
+  }
+}
+
+/*
+ * Adjusts the render scale with the times of the last frame, and resizes the
+ * render targets when the scale or the quick render state changes
+ */
+void UpdateDynamicResolution() {
+  // Get managers
+  const as::ProfilerManager &profiler_manager =
+      gl_managers.GetProfilerManager();
+  if (use_dynamic_resolution) {
+    const as::ProfilerManager::PassTimes frame_times =
+        profiler_manager.GetFrameTimes();
+    resolution_ctrl.SetTargetSeconds(1e-3f * target_frame_time_ms);
+    resolution_ctrl.Update(static_cast<float>(frame_times.gpu_seconds),
+                           static_cast<float>(frame_times.cpu_seconds));
+  } else {
+    resolution_ctrl.Reset();
+  }
+  const glm::ivec2 render_size =
+      GetRenderSize(ui_manager.GetActualWindowSize());
+  if (render_size != ui_manager.GetWindowSize()) {
+    ResizeRenderTargets(render_size);
+  }
+}
+
 /*******************************************************************************
  * GL States Updaters
  ******************************************************************************/
@@ -603,6 +1161,9 @@ dto::GlobalTrans GetCameraTrans() {
 void UpdateGlobalTrans() {
   dto::GlobalTrans global_trans = GetCameraTrans();
 
+  // Fit the shadow cascades to the camera frustum
+  depth_shader.UpdateCascades(global_trans);
+
   // DEBUG: See from light source
   if (kSeeFromLight) {
     global_trans.proj = scene_shader.GetLightProjection();
@@ -616,92 +1177,459 @@ void UpdateLighting() {
   scene_shader.UpdateViewPos(eye);
 }
 
+/*
+ * The explosion flash fades out at the aircraft after the collision
+ */
+void UpdatePointLights() {
+  std::vector<as::LightClusters::PointLight> point_lights = fixed_point_lights;
+  if (has_collided && collision_anim_elapsed_time < kExplosionFlashDuration) {
+    const float flash_ratio =
+        1.0f - collision_anim_elapsed_time / kExplosionFlashDuration;
+    point_lights.push_back({aircraft_ctrl.GetPos(), kExplosionFlashRadius,
+                            glm::vec3(1.0f, 0.6f, 0.2f),
+                            kExplosionFlashIntensity * flash_ratio});
+  }
+  point_lights.insert(point_lights.end(), extra_point_lights.begin(),
+                      extra_point_lights.begin() + num_extra_point_lights);
+  scene_shader.UpdatePointLights(point_lights);
+}
+
 void UpdatePostprocInputs() {
   postproc_shader.UpdateEnabled(cur_mode == Modes::comparison &&
                                 ui_manager.IsMouseDown(GLUT_LEFT_BUTTON));
 }
 
+/*
+ * Applies the rendering states which are changed by the GUI to the shaders
+ */
+void UpdateShaderToggles() {
+  // Update PCF state
+  scene_shader.TogglePcf(use_pcf);
+
+  // Update normal state
+  scene_shader.ToggleNormalHeight(use_normal);
+
+  // Update instantiating state
+  scene_shader.ToggleInstantiating(use_instantiating);
+
+  // Update indirect drawing state
+  scene_shader.ToggleIndirectDrawing(use_indirect_drawing);
+  scene_shader.TogglePermutations(use_shader_permutations);
+
+  // Update culling state
+  scene_shader.ToggleCulling(use_culling);
+  scene_shader.ToggleOcclusionCulling(use_occlusion_culling);
+  scene_shader.ToggleMeshBatching(use_mesh_batching);
+
+  // Update depth pre-pass state
+  scene_shader.ToggleDepthPrepass(use_depth_prepass);
+
+  // Update material LOD state, the far tier is kept behind the reduced tier
+  std::vector<shader::SceneShader::MaterialTier> material_tiers =
+      scene_shader.GetMaterialTiers();
+  material_tiers.at(0).min_distance = reduced_material_tier_dist;
+  material_tiers.at(1).min_distance =
+      std::max(far_material_tier_dist, reduced_material_tier_dist);
+  scene_shader.SetMaterialTiers(material_tiers);
+  scene_shader.ToggleMaterialLod(use_material_lod);
+
+  // Update shadow states
+  depth_shader.ToggleShadowCaching(use_shadow_caching);
+  depth_shader.SetNumCascades(num_shadow_cascades);
+
+  // Update surrounding visibility
+  scene_shader.GetSceneModel("surround").SetVisible(use_surrounding);
+
+  // Update fog state
+  scene_shader.ToggleFog(use_fog);
+  scene_shader.ToggleMixFogWithSkybox(mix_fog_with_skybox);
+
+  // Update gamma correction state
+  postproc_shader.UpdateUseGammaCorrect(use_gamma_correct);
+}
+
 void UpdateStates() {
+  UpdateDynamicResolution();
+  if (run_light_benchmark) {
+    StepLightBenchmark();
+  }
   UpdateGlobalTrans();
   UpdateLighting();
+  UpdatePointLights();
   UpdatePostprocInputs();
 }
 
 /*******************************************************************************
- * GLUT Callbacks / Display
+ * Culling Benchmark
  ******************************************************************************/
 
-void GLUTDisplayCallback() {
-  const glm::ivec2 window_size = ui_manager.GetWindowSize();
-  const glm::ivec2 actual_window_size = ui_manager.GetActualWindowSize();
-
-  // Update states
-  UpdateStates();
-
-  // Draw the scene depth from light source on depth framebuffer
-  depth_shader.UseDepthFramebuffer();
-  depth_shader.DrawFromLight(actual_window_size);
-
-  // Update wireframe rendering
-  if (render_wireframe) {
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-  } else {
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+/*
+ * Culls randomly placed instances against the camera frustum. The batch test
+ * is compared with the test of one box at a time and the BVH traversal, and
+ * each test is averaged over several iterations. The BVH is also refitted
+ * after moving some instances.
+ */
+void BenchmarkCulling() {
+  using Clock = std::chrono::high_resolution_clock;
+  std::uniform_real_distribution<float> pos_distrib(-kCullingBenchmarkRange,
+                                                    kCullingBenchmarkRange);
+  std::uniform_real_distribution<float> angle_distrib(
+      0.0f, 2.0f * glm::pi<float>());
+  // Get the camera frustum
+  const dto::GlobalTrans global_trans = GetCameraTrans();
+  const as::Frustum frustum(global_trans.proj * global_trans.view *
+                            global_trans.model);
+
+  /* Generate instancing transformations */
+  const glm::mat4 identity(1.0f);
+  std::vector<glm::mat4> transforms;
+  for (int instance_idx = 0; instance_idx < kCullingBenchmarkNumInstances;
+       instance_idx++) {
+    const glm::mat4 translate = glm::translate(identity, GenRand(pos_distrib));
+    const glm::mat4 rotate = glm::rotate(identity, angle_distrib(rand_engine),
+                                         glm::vec3(0.0f, 1.0f, 0.0f));
+    transforms.push_back(translate * rotate);
   }
 
-  // Draw the scene on postproc framebuffer "draw original"
-  postproc_shader.UsePostprocFramebuffer(
-      shader::PostprocShader::PostprocFramebufferTypes::kDrawOriginal, 0);
-  postproc_shader.UseDefaultPostprocTextures();
-  as::ClearColorBuffer();
-  as::ClearDepthBuffer();
+  /* Calculate world bounding boxes */
+  const Clock::time_point bounds_start_time = Clock::now();
+  as::AabbBatch aabb_batch;
+  for (const glm::mat4 &transform : transforms) {
+    glm::vec3 center;
+    glm::vec3 extent;
+    as::Frustum::TransformAabb(transform, glm::vec3(-1.0f), glm::vec3(1.0f),
+                               center, extent);
+    aabb_batch.AddAabb(center, extent);
+  }
 
-  skybox_shader.Draw();
-  scene_shader.Draw();
+  /* Test the boxes in batch */
+  const Clock::time_point batch_start_time = Clock::now();
+  std::vector<unsigned char> visibles;
+  for (int iter = 0; iter < kCullingBenchmarkNumIterations; iter++) {
+    culling_benchmark_num_visibles = frustum.TestAabbs(aabb_batch, visibles);
+  }
 
-  if (use_fbx) {
-    if (!has_collided) {
-      fbx_ctrl.Draw();
-    } else {
-      if (!has_collision_anim_finished) {
-        explosion_fbx_ctrl.Draw();
+  /* Test the boxes one at a time */
+  const Clock::time_point scalar_start_time = Clock::now();
+  size_t num_scalar_visibles = 0;
+  for (int iter = 0; iter < kCullingBenchmarkNumIterations; iter++) {
+    num_scalar_visibles = 0;
+    for (size_t aabb_idx = 0; aabb_idx < aabb_batch.GetNumAabbs();
+         aabb_idx++) {
+      const glm::vec3 center(aabb_batch.GetCenters(0)[aabb_idx],
+                             aabb_batch.GetCenters(1)[aabb_idx],
+                             aabb_batch.GetCenters(2)[aabb_idx]);
+      const glm::vec3 extent(aabb_batch.GetExtents(0)[aabb_idx],
+                             aabb_batch.GetExtents(1)[aabb_idx],
+                             aabb_batch.GetExtents(2)[aabb_idx]);
+      if (frustum.TestAabb(center, extent)) {
+        num_scalar_visibles++;
       }
     }
-    // Restore viewport because it's touched by FBX SDK
-    glViewport(0, 0, actual_window_size.x, actual_window_size.y);
   }
+  const Clock::time_point end_time = Clock::now();
+
+  /* Build the BVH */
+  std::vector<glm::vec3> min_poses;
+  std::vector<glm::vec3> max_poses;
+  for (size_t aabb_idx = 0; aabb_idx < aabb_batch.GetNumAabbs(); aabb_idx++) {
+    const glm::vec3 center = aabb_batch.GetCenter(aabb_idx);
+    const glm::vec3 extent = aabb_batch.GetExtent(aabb_idx);
+    min_poses.push_back(center - extent);
+    max_poses.push_back(center + extent);
+  }
+  const Clock::time_point build_start_time = Clock::now();
+  as::Bvh bvh;
+  bvh.Build(min_poses, max_poses);
+
+  /* Traverse the BVH */
+  const Clock::time_point bvh_start_time = Clock::now();
+  std::vector<size_t> item_idxs;
+  as::Bvh::TraversalStats traversal_stats;
+  for (int iter = 0; iter < kCullingBenchmarkNumIterations; iter++) {
+    traversal_stats = bvh.QueryFrustum(frustum, item_idxs);
+  }
+  const Clock::time_point bvh_end_time = Clock::now();
+
+  /* Move some instances and refit the BVH */
+  std::uniform_int_distribution<size_t> item_distrib(0, bvh.GetNumItems() - 1);
+  std::vector<size_t> moved_item_idxs;
+  std::vector<glm::vec3> moved_offsets;
+  for (int move_idx = 0; move_idx < kCullingBenchmarkNumMovedInstances;
+       move_idx++) {
+    moved_item_idxs.push_back(item_distrib(rand_engine));
+    moved_offsets.push_back(1e-2f * GenRand(pos_distrib));
+  }
+  const Clock::time_point refit_start_time = Clock::now();
+  for (int move_idx = 0; move_idx < kCullingBenchmarkNumMovedInstances;
+       move_idx++) {
+    const size_t item_idx = moved_item_idxs[move_idx];
+    const glm::vec3 &offset = moved_offsets[move_idx];
+    bvh.UpdateItem(item_idx, min_poses[item_idx] + offset,
+                   max_poses[item_idx] + offset);
+  }
+  bvh.Refit();
+  const Clock::time_point refit_end_time = Clock::now();
+
+  // All tests should agree
+  if (num_scalar_visibles != culling_benchmark_num_visibles ||
+      item_idxs.size() != culling_benchmark_num_visibles) {
+    std::cerr << "Culling benchmark: " << culling_benchmark_num_visibles
+              << " visible in batch, " << num_scalar_visibles
+              << " visible one at a time, " << item_idxs.size()
+              << " visible in BVH" << std::endl;
+  }
+
+  /* Save the results */
+  const std::chrono::duration<double> bounds_duration =
+      batch_start_time - bounds_start_time;
+  const std::chrono::duration<double> batch_duration =
+      scalar_start_time - batch_start_time;
+  const std::chrono::duration<double> scalar_duration =
+      end_time - scalar_start_time;
+  culling_benchmark_bounds_seconds = bounds_duration.count();
+  culling_benchmark_batch_seconds =
+      batch_duration.count() / kCullingBenchmarkNumIterations;
+  culling_benchmark_scalar_seconds =
+      scalar_duration.count() / kCullingBenchmarkNumIterations;
+  const std::chrono::duration<double> build_duration =
+      bvh_start_time - build_start_time;
+  const std::chrono::duration<double> bvh_duration =
+      bvh_end_time - bvh_start_time;
+  const std::chrono::duration<double> refit_duration =
+      refit_end_time - refit_start_time;
+  culling_benchmark_build_seconds = build_duration.count();
+  culling_benchmark_bvh_seconds =
+      bvh_duration.count() / kCullingBenchmarkNumIterations;
+  culling_benchmark_refit_seconds = refit_duration.count();
+  culling_benchmark_num_visited_nodes = traversal_stats.num_visited_nodes;
+}
+
+/*******************************************************************************
+ * Render Graph
+ ******************************************************************************/
 
+/*
+ * Sets the viewport and the polygon mode for the passes drawing the scene
+ */
+void DrawScenePass(const glm::ivec2 &window_size,
+                   const std::function<void()> &draw_func) {
+  // The scene is drawn in the render size
+  gl_managers.GetStateManager().SetViewport(0, 0, window_size.x,
+                                            window_size.y);
+  as::TraceManager &trace_manager = gl_managers.GetTraceManager();
+  if (render_wireframe) {
+    trace_manager.RecordCall(
+        "glPolygonMode", {GL_FRONT_AND_BACK, GL_LINE}, 0,
+        [] { glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); });
+  }
+  draw_func();
   // Restore polygon mode
-  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  trace_manager.RecordCall("glPolygonMode", {GL_FRONT_AND_BACK, GL_FILL}, 0,
+                           [] { glPolygonMode(GL_FRONT_AND_BACK, GL_FILL); });
+}
 
-  if (use_hdr) {
-    // Draw bloom effects on postproc framebuffers "draw scaling", "blur
-    // scaling"
-    // and "combining"
-    postproc_shader.DrawBloom(window_size);
-    // Restore viewport because it's touched by DrawBloom
-    glViewport(0, 0, actual_window_size.x, actual_window_size.y);
+/*
+ * Declares the passes of the frame. The bloom passes are culled by the graph
+ * when the post-processing pass doesn't read the bloom, which releases the
+ * bloom chain textures, and the depth renderbuffers of the postproc
+ * framebuffers are aliased.
+ */
+void BuildRenderGraph(const glm::ivec2 &window_size,
+                      const glm::ivec2 &actual_window_size) {
+  using PostprocFramebufferTypes =
+      shader::PostprocShader::PostprocFramebufferTypes;
+  // Get names
+  const std::string scene_framebuffer_name =
+      postproc_shader.GetPostprocFramebufferName(
+          PostprocFramebufferTypes::kDrawOriginal, 0);
+  const std::vector<std::string> scene_depth_names =
+      postproc_shader.GetPostprocRenderbufferResourceNames(
+          PostprocFramebufferTypes::kDrawOriginal);
+
+  render_graph.Reset();
+
+  // Add resources
+  render_graph.AddResource(
+      "visible_instances",
+      {as::RenderGraph::ResourceKinds::kExternal, {}, 0, 0});
+  render_graph.AddResource(
+      "light_depth", {as::RenderGraph::ResourceKinds::kExternal, {}, 0, 0});
+  render_graph.AddResource(
+      "scene_color",
+      {as::RenderGraph::ResourceKinds::kExternal, {}, GL_COLOR_BUFFER_BIT, 0});
+  // The bloom is combined into the scene color, so it owns no textures
+  render_graph.AddResource(
+      "bloom", {as::RenderGraph::ResourceKinds::kExternal, {}, 0, 0});
+  render_graph.AddResource(
+      "backbuffer", {as::RenderGraph::ResourceKinds::kExternal, {},
+                     GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, 0});
+  postproc_shader.AddPostprocRenderbufferResources(render_graph, window_size);
+  postproc_shader.AddPostprocTextureResources(render_graph, window_size);
+
+  // Cull the instances against the camera and light frusta, and upload the
+  // visible ones
+  render_graph.AddPass("Culling", "", {}, {"visible_instances"},
+                       []() { scene_shader.UpdateVisibleInstances(); });
+
+  // Draw the scene depth from light source on depth framebuffer
+  render_graph.AddPass("Depth", "", {"visible_instances"}, {"light_depth"},
+                       [actual_window_size]() {
+                         depth_shader.UseDepthFramebuffer();
+                         depth_shader.DrawFromLight(actual_window_size);
+                       });
+
+  // Draw the scene on postproc framebuffer "draw original", the first pass
+  // clears it
+  std::vector<std::string> scene_write_names = {"scene_color"};
+  scene_write_names.insert(scene_write_names.end(), scene_depth_names.begin(),
+                           scene_depth_names.end());
+  render_graph.AddPass(
+      "Skybox", scene_framebuffer_name, {}, scene_write_names, [window_size]() {
+        postproc_shader.UseDefaultPostprocTextures();
+        DrawScenePass(window_size, []() { skybox_shader.Draw(); });
+      });
+  render_graph.AddPass(
+      "Scene", scene_framebuffer_name, {"visible_instances", "light_depth"},
+      scene_write_names, [window_size]() {
+        DrawScenePass(window_size, []() { scene_shader.Draw(); });
+      });
+  if (use_fbx) {
+    render_graph.AddPass(
+        "FBX", scene_framebuffer_name, {}, scene_write_names,
+        [window_size]() {
+          as::StateManager &state_manager = gl_managers.GetStateManager();
+          DrawScenePass(window_size, []() {
+            if (!has_collided) {
+              fbx_ctrl.Draw();
+            } else {
+              if (!has_collision_anim_finished) {
+                explosion_fbx_ctrl.Draw();
+              }
+            }
+          });
+          // Forget GL states and restore viewport because FBX SDK touches
+          // them
+          state_manager.Invalidate();
+          state_manager.SetViewport(0, 0, window_size.x, window_size.y);
+        });
+  }
+
+  // Draw bloom effects on postproc framebuffers "draw scaling", "blur
+  // scaling" and "combining"
+  const std::vector<std::tuple<std::string, PostprocFramebufferTypes>>
+      bloom_passes = {
+          {"Bloom Scaling", PostprocFramebufferTypes::kDrawScaling},
+          {"Bloom Blur Horizontal",
+           PostprocFramebufferTypes::kBlurScalingHorizontal},
+          {"Bloom Blur Vertical",
+           PostprocFramebufferTypes::kBlurScalingVertical},
+          {"Bloom Combining", PostprocFramebufferTypes::kCombining}};
+  for (size_t bloom_pass_idx = 0; bloom_pass_idx < bloom_passes.size();
+       bloom_pass_idx++) {
+    const std::string &pass_name = std::get<0>(bloom_passes[bloom_pass_idx]);
+    const PostprocFramebufferTypes framebuffer_type =
+        std::get<1>(bloom_passes[bloom_pass_idx]);
+    const int pass_idx = static_cast<int>(bloom_pass_idx) + 1;
+    std::vector<std::string> read_names = {"scene_color"};
+    const std::vector<std::string> read_tex_names =
+        postproc_shader.GetPostprocTextureResourceNames(framebuffer_type, true);
+    read_names.insert(read_names.end(), read_tex_names.begin(),
+                      read_tex_names.end());
+    std::vector<std::string> write_names =
+        postproc_shader.GetPostprocTextureResourceNames(framebuffer_type,
+                                                        false);
+    const std::vector<std::string> depth_names =
+        postproc_shader.GetPostprocRenderbufferResourceNames(framebuffer_type);
+    write_names.insert(write_names.end(), depth_names.begin(),
+                       depth_names.end());
+    // The combining pass blends the bloom into the scene color
+    if (framebuffer_type == PostprocFramebufferTypes::kCombining) {
+      write_names.push_back("bloom");
+    }
+    render_graph.AddPass(
+        pass_name, "", read_names, write_names,
+        [pass_idx, window_size, actual_window_size]() {
+          as::StateManager &state_manager = gl_managers.GetStateManager();
+          postproc_shader.DrawBloomPass(pass_idx, window_size);
+          // Restore viewport because it's touched by DrawBloomPass
+          state_manager.SetViewport(0, 0, actual_window_size.x,
+                                    actual_window_size.y);
+        });
   }
 
   // Draw post-processing effects on default framebuffer
-  scene_shader.UseDefaultFramebuffer();
-  as::ClearColorBuffer();
-  as::ClearDepthBuffer();
-  postproc_shader.DrawPostprocEffects();
+  std::vector<std::string> postproc_read_names = {"scene_color"};
+  if (use_hdr) {
+    postproc_read_names.push_back("bloom");
+  }
+  // The scene color in the render size is upscaled to the window here
+  render_graph.AddPass(
+      "Postproc", as::RenderGraph::kDefaultFramebufferName,
+      postproc_read_names, {"backbuffer"}, [actual_window_size]() {
+        gl_managers.GetStateManager().SetViewport(0, 0, actual_window_size.x,
+                                                  actual_window_size.y);
+        postproc_shader.DrawPostprocEffects();
+      });
 
   // Draw ImGui on default framebuffer
-  scene_shader.UseDefaultFramebuffer();
   if (use_gui) {
-    DrawImGui();
+    render_graph.AddPass("ImGui", as::RenderGraph::kDefaultFramebufferName,
+                         {}, {"backbuffer"}, []() {
+                           DrawImGui();
+                           // Forget GL states because they're touched by ImGui
+                           gl_managers.GetStateManager().Invalidate();
+                         });
   }
 
+  render_graph.AddOutput("backbuffer");
+}
+
+/*******************************************************************************
+ * GLUT Callbacks / Display
+ ******************************************************************************/
+
+/*
+ * Draws a frame without swapping the buffers, which is also used by the
+ * headless runs
+ */
+void DrawFrame() {
+  as::StateManager &state_manager = gl_managers.GetStateManager();
+  as::TraceManager &trace_manager = gl_managers.GetTraceManager();
+  as::UniformManager &uniform_manager = gl_managers.GetUniformManager();
+  as::ProfilerManager &profiler_manager = gl_managers.GetProfilerManager();
+  as::FramebufferManager &framebuffer_manager =
+      gl_managers.GetFramebufferManager();
+
+  // Start counting GL state changes of the frame
+  state_manager.StartFrame();
+  trace_manager.StartFrame();
+  uniform_manager.StartFrame();
+  // Delete the render targets which have been idle for too long
+  framebuffer_manager.StartFrame();
+  // Start timing the passes of the frame
+  profiler_manager.StartFrame();
+
+  // Update states, which may change the render size
+  UpdateStates();
+  const glm::ivec2 window_size = ui_manager.GetWindowSize();
+  const glm::ivec2 actual_window_size = ui_manager.GetActualWindowSize();
+
+  // Draw the passes in the render graph
+  BuildRenderGraph(window_size, actual_window_size);
+  render_graph.Compile();
+  render_graph.Execute();
+}
+
+void GLUTDisplayCallback() {
+  DrawFrame();
+
   // Swap double buffers
   glutSwapBuffers();
 }
 
 void GLUTReshapeCallback(const int width, const int height) {
   const glm::ivec2 actual_window_size = glm::vec2(width, height);
-  glm::ivec2 window_size = glm::vec2(width, height);
 
   // Limit the window size
   if (as::LimitGLWindowSize(actual_window_size, kMinWindowSize)) {
@@ -709,37 +1637,17 @@ void GLUTReshapeCallback(const int width, const int height) {
     return;
   }
 
-  // Limit texture sizes
-  if (limit_window_scaling) {
-    const int kMaxTextureWidth = 1024;
-    if (window_size.x > kMaxTextureWidth) {
-      const float ratio = (float)window_size.x / (float)window_size.y;
-      window_size.x = kMaxTextureWidth;
-      window_size.y = (int)((float)kMaxTextureWidth / ratio);
-    }
-  }
-
   // Save window size
-  ui_manager.SaveWindowSize(window_size);
   ui_manager.SaveActualWindowSize(actual_window_size);
   // Set the viewport
-  glViewport(0, 0, width, height);
-  // Update screen textures
-  postproc_shader.UpdatePostprocTextures(window_size.x, window_size.y);
-  // Update screen depth renderbuffers
-  postproc_shader.UpdatePostprocRenderbuffer(window_size.x, window_size.y);
-  // Update differential rendering stencil renderbuffers
-  diff_shader.UpdateObjDiffRenderbuffer(window_size.x, window_size.y);
-  // Update differential rendering framebuffer textures
-  diff_shader.UpdateDiffFramebufferTextures(window_size.x, window_size.y);
-  // Update FBX
-  fbx_ctrl.OnReshape(window_size.x, window_size.y);
-  explosion_fbx_ctrl.OnReshape(window_size.x, window_size.y);
+  gl_managers.GetStateManager().SetViewport(0, 0, width, height);
+  // Update the render targets
+  ResizeRenderTargets(GetRenderSize(actual_window_size));
   // Update ImGui
   ImGui_ImplFreeGLUT_ReshapeFunc(width, height);
 
   // Set the viewport
-  glViewport(0, 0, width, height);
+  gl_managers.GetStateManager().SetViewport(0, 0, width, height);
 }
 
 /*******************************************************************************
@@ -962,14 +1870,12 @@ void GLUTTimerCallback(const int val) {
           editing_model_instance_idx,
           scene_model.GetInstancingScaling(editing_model_instance_idx) *
               glm::vec3(1.0f - kEditingModelScalingStep));
-      scene_shader.UpdateSceneModel(scene_model);
     }
     if (ui_manager.IsKeyDown(']')) {
       scene_model.SetInstancingScaling(
           editing_model_instance_idx,
           scene_model.GetInstancingScaling(editing_model_instance_idx) *
               glm::vec3(1.0f + kEditingModelScalingStep));
-      scene_shader.UpdateSceneModel(scene_model);
     }
     // Rotation
     if (ui_manager.IsKeyDown('1')) {
@@ -977,42 +1883,36 @@ void GLUTTimerCallback(const int val) {
           editing_model_instance_idx,
           scene_model.GetInstancingRotation(editing_model_instance_idx) +
               kEditingModelRotationStep * glm::vec3(-1.0f, 0.0f, 0.0f));
-      scene_shader.UpdateSceneModel(scene_model);
     }
     if (ui_manager.IsKeyDown('2')) {
       scene_model.SetInstancingRotation(
           editing_model_instance_idx,
           scene_model.GetInstancingRotation(editing_model_instance_idx) +
               kEditingModelRotationStep * glm::vec3(1.0f, 0.0f, 0.0f));
-      scene_shader.UpdateSceneModel(scene_model);
     }
     if (ui_manager.IsKeyDown('3')) {
       scene_model.SetInstancingRotation(
           editing_model_instance_idx,
           scene_model.GetInstancingRotation(editing_model_instance_idx) +
               kEditingModelRotationStep * glm::vec3(0.0f, -1.0f, 0.0f));
-      scene_shader.UpdateSceneModel(scene_model);
     }
     if (ui_manager.IsKeyDown('4')) {
       scene_model.SetInstancingRotation(
           editing_model_instance_idx,
           scene_model.GetInstancingRotation(editing_model_instance_idx) +
               kEditingModelRotationStep * glm::vec3(0.0f, 1.0f, 0.0f));
-      scene_shader.UpdateSceneModel(scene_model);
     }
     if (ui_manager.IsKeyDown('5')) {
       scene_model.SetInstancingRotation(
           editing_model_instance_idx,
           scene_model.GetInstancingRotation(editing_model_instance_idx) +
               kEditingModelRotationStep * glm::vec3(0.0f, 0.0f, -1.0f));
-      scene_shader.UpdateSceneModel(scene_model);
     }
     if (ui_manager.IsKeyDown('6')) {
       scene_model.SetInstancingRotation(
           editing_model_instance_idx,
           scene_model.GetInstancingRotation(editing_model_instance_idx) +
               kEditingModelRotationStep * glm::vec3(0.0f, 0.0f, 1.0f));
-      scene_shader.UpdateSceneModel(scene_model);
     }
     // Translation
     if (ui_manager.IsKeyDown('i')) {
@@ -1021,42 +1921,47 @@ void GLUTTimerCallback(const int val) {
               editing_model_instance_idx,
               scene_model.GetInstancingTranslation(editing_model_instance_idx) +
                   kEditingModelTranslationStep * glm::vec3(0.0f, 0.0f, -1.0f));
-      scene_shader.UpdateSceneModel(scene_model);
     }
     if (ui_manager.IsKeyDown('k')) {
       scene_model.SetInstancingTranslation(
           editing_model_instance_idx,
           scene_model.GetInstancingTranslation(editing_model_instance_idx) +
               kEditingModelTranslationStep * glm::vec3(0.0f, 0.0f, 1.0f));
-      scene_shader.UpdateSceneModel(scene_model);
     }
     if (ui_manager.IsKeyDown('j')) {
       scene_model.SetInstancingTranslation(
           editing_model_instance_idx,
           scene_model.GetInstancingTranslation(editing_model_instance_idx) +
               kEditingModelTranslationStep * glm::vec3(-1.0f, 0.0f, 0.0f));
-      scene_shader.UpdateSceneModel(scene_model);
     }
     if (ui_manager.IsKeyDown('l')) {
       scene_model.SetInstancingTranslation(
           editing_model_instance_idx,
           scene_model.GetInstancingTranslation(editing_model_instance_idx) +
               kEditingModelTranslationStep * glm::vec3(1.0f, 0.0f, 0.0f));
-      scene_shader.UpdateSceneModel(scene_model);
     }
     if (ui_manager.IsKeyDown('b')) {
       scene_model.SetInstancingTranslation(
           editing_model_instance_idx,
           scene_model.GetInstancingTranslation(editing_model_instance_idx) +
               kEditingModelTranslationStep * glm::vec3(0.0f, 1.0f, 0.0f));
-      scene_shader.UpdateSceneModel(scene_model);
     }
     if (ui_manager.IsKeyDown('n')) {
       scene_model.SetInstancingTranslation(
           editing_model_instance_idx,
           scene_model.GetInstancingTranslation(editing_model_instance_idx) +
               kEditingModelTranslationStep * glm::vec3(0.0f, -1.0f, 0.0f));
-      scene_shader.UpdateSceneModel(scene_model);
+    }
+    // Animate all instances to measure the instance streaming
+    if (animate_instances) {
+      const int num_instancing = scene_model.GetNumInstancing();
+      for (int instance_idx = 0; instance_idx < num_instancing;
+           instance_idx++) {
+        scene_model.SetInstancingRotation(
+            instance_idx,
+            scene_model.GetInstancingRotation(instance_idx) +
+                kEditingModelRotationStep * glm::vec3(0.0f, 1.0f, 0.0f));
+      }
     }
   }
 
@@ -1196,24 +2101,28 @@ void GLUTTimerCallback(const int val) {
                  glm::vec3(2.0f)));
   }
 
-  // Update PCF state
-  scene_shader.TogglePcf(use_pcf);
-
-  // Update normal state
-  scene_shader.ToggleNormalHeight(use_normal);
+  // Update the shader states from the rendering states
+  UpdateShaderToggles();
 
-  // Update instantiating state
-  scene_shader.ToggleInstantiating(use_instantiating);
-
-  // Update surrounding visibility
-  scene_shader.GetSceneModel("surround").SetVisible(use_surrounding);
-
-  // Update fog state
-  scene_shader.ToggleFog(use_fog);
-  scene_shader.ToggleMixFogWithSkybox(mix_fog_with_skybox);
+  if (run_culling_benchmark) {
+    BenchmarkCulling();
+    run_culling_benchmark = false;
+  }
+  if (run_vertex_benchmark) {
+    vertex_benchmark_seconds = scene_shader.BenchmarkVertexThroughput(
+        kVertexBenchmarkSceneModelNames, kVertexBenchmarkNumIterations,
+        vertex_benchmark_num_vertices);
+    run_vertex_benchmark = false;
+  }
 
-  // Update gamma correction state
-  postproc_shader.UpdateUseGammaCorrect(use_gamma_correct);
+  // Update GL trace recording, the trace is saved when the recording stops
+  as::TraceManager &trace_manager = gl_managers.GetTraceManager();
+  if (record_gl_trace && !trace_manager.IsRecording()) {
+    trace_manager.StartRecording();
+  } else if (!record_gl_trace && trace_manager.IsRecording()) {
+    trace_manager.StopRecording();
+    trace_manager.SaveTrace(kGLTracePath);
+  }
 
   // Update camera shaking wind
   UpdateCameraShakingWind();
@@ -1322,12 +2231,186 @@ void CreateGLUTMenus() {
 
 void EnterGLUTLoop() { glutMainLoop(); }
 
+/*******************************************************************************
+ * Headless Runs
+ ******************************************************************************/
+
+/*
+ * Prints the summary of each frame in the trace, and returns the exit code
+ * which is nonzero if any frame exceeds the budget
+ */
+int CheckTraceBudget(const unsigned int max_num_calls,
+                     const GLsizeiptr max_num_uploaded_bytes) {
+  const as::TraceManager &trace_manager = gl_managers.GetTraceManager();
+  for (const as::TraceManager::FrameSummary &frame_summary :
+       trace_manager.SummarizeTrace()) {
+    std::cerr << "Frame " << frame_summary.frame_idx << ": "
+              << frame_summary.num_calls << " calls, "
+              << frame_summary.num_uploaded_bytes << " uploaded bytes"
+              << std::endl;
+  }
+  try {
+    trace_manager.CheckFrameBudget(max_num_calls, max_num_uploaded_bytes);
+  } catch (const std::runtime_error &ex) {
+    std::cerr << "Frame budget exceeded: " << ex.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Initializes the states without a window or a GL context. The recording
+ * backend records the calls instead of issuing them to the driver. The window,
+ * the GUI, the sound and FBX are skipped.
+ */
+void InitHeadless() {
+  // Get managers
+  as::TraceManager &trace_manager = gl_managers.GetTraceManager();
+  // Initialize the states without the driver
+  is_headless = true;
+  trace_manager.SetBackend(as::TraceManager::Backends::kRecording);
+  ConfigGLSettings();
+  InitUiManager();
+  InitShaders();
+  InitRenderGraph();
+  InitPointLights();
+  UpdateShaderToggles();
+  // Set up the render targets like the reshape of the window
+  ui_manager.SaveActualWindowSize(kInitWindowSize);
+  gl_managers.GetStateManager().SetViewport(0, 0, kInitWindowSize.x,
+                                            kInitWindowSize.y);
+  ResizeRenderTargets(GetRenderSize(kInitWindowSize));
+}
+
+/*
+ * Records the frames after the warmup frames
+ */
+void RecordHeadlessFrames(const int num_frames) {
+  // Get managers
+  as::TraceManager &trace_manager = gl_managers.GetTraceManager();
+  // Draw the frames, the warmup frames aren't recorded
+  for (int frame_idx = 0; frame_idx < kHeadlessNumWarmupFrames + num_frames;
+       frame_idx++) {
+    if (frame_idx == kHeadlessNumWarmupFrames) {
+      trace_manager.StartRecording();
+    }
+    DrawFrame();
+  }
+  trace_manager.StopRecording();
+}
+
+/*
+ * Draws the frames headlessly, so CI could catch the regressions of the calls
+ * and the uploaded bytes per frame
+ */
+int RunHeadless(const int num_frames, const unsigned int max_num_calls,
+                const GLsizeiptr max_num_uploaded_bytes) {
+  InitHeadless();
+  RecordHeadlessFrames(num_frames);
+  gl_managers.GetTraceManager().SaveTrace(kGLTracePath);
+  return CheckTraceBudget(max_num_calls, max_num_uploaded_bytes);
+}
+
+/*
+ * Loads a second oil tank which shares the meshes with the first one, and
+ * records the frames without and with the mesh batching. Returns nonzero if
+ * the batching doesn't reduce the draw calls of all passes.
+ */
+int RunBatchingBenchmark(const int num_frames) {
+  if (num_frames < 1) {
+    throw std::runtime_error("Invalid number of frames '" +
+                             std::to_string(num_frames) + "'");
+  }
+  // Get managers
+  const as::TraceManager &trace_manager = gl_managers.GetTraceManager();
+  // Load the duplicate model before the shaders are initialized
+  scene_shader.ToggleDuplicateModels(true);
+  InitHeadless();
+
+  const bool use_mesh_batchings[] = {false, true};
+  unsigned int num_draw_calls[2] = {0, 0};
+  unsigned int num_batched_draws = 0;
+  for (int run_idx = 0; run_idx < 2; run_idx++) {
+    use_mesh_batching = use_mesh_batchings[run_idx];
+    UpdateShaderToggles();
+    RecordHeadlessFrames(num_frames);
+    // Count the draw calls of all passes
+    for (const as::TraceManager::TraceCall &trace_call :
+         trace_manager.GetTraceCalls()) {
+      if (trace_call.func_name.find("DrawElements") != std::string::npos) {
+        num_draw_calls[run_idx]++;
+      }
+    }
+    num_draw_calls[run_idx] /= static_cast<unsigned int>(num_frames);
+    // Get the batching statistics of the last frame
+    const shader::SceneShader::BatchingStats batching_stats =
+        scene_shader.GetBatchingStats();
+    num_batched_draws = batching_stats.num_batched_draws;
+    std::cerr << "Mesh batching " << (use_mesh_batching ? "on" : "off")
+              << ": " << num_draw_calls[run_idx] << " draw calls per frame, "
+              << batching_stats.num_batched_draws << " saved draws, "
+              << batching_stats.num_shared_meshes << " shared meshes"
+              << std::endl;
+  }
+  if (num_batched_draws == 0 || num_draw_calls[1] >= num_draw_calls[0]) {
+    std::cerr << "Mesh batching saved no draw calls" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Checks the budget of a saved trace, e.g., the one recorded from the GUI
+ */
+int CheckSavedTrace(const std::string &path, const unsigned int max_num_calls,
+                    const GLsizeiptr max_num_uploaded_bytes) {
+  gl_managers.GetTraceManager().LoadTrace(path);
+  return CheckTraceBudget(max_num_calls, max_num_uploaded_bytes);
+}
+
 /*******************************************************************************
  * Entry Point
  ******************************************************************************/
 
+/*
+ * Besides the window, the frame budget could be checked by:
+ *   Final --headless <num_frames> <max_num_calls> <max_num_uploaded_bytes>
+ *   Final --check-trace <path> <max_num_calls> <max_num_uploaded_bytes>
+ * which exit with nonzero if any frame exceeds the budget, and the mesh
+ * batching could be measured by:
+ *   Final --batching-benchmark <num_frames>
+ * which exits with nonzero if the batching saves no draw calls
+ */
 int main(int argc, char *argv[]) {
   try {
+    // Check the frame budget without the window
+    const std::string mode = argc >= 2 ? argv[1] : "";
+    if (mode == "--headless" || mode == "--check-trace") {
+      if (argc != 5) {
+        throw std::runtime_error("Usage: " + std::string(argv[0]) + " " +
+                                 mode +
+                                 " <num_frames|path> <max_num_calls> "
+                                 "<max_num_uploaded_bytes>");
+      }
+      const unsigned int max_num_calls =
+          static_cast<unsigned int>(std::stoul(argv[3]));
+      const GLsizeiptr max_num_uploaded_bytes =
+          static_cast<GLsizeiptr>(std::stoll(argv[4]));
+      if (mode == "--headless") {
+        return RunHeadless(std::stoi(argv[2]), max_num_calls,
+                           max_num_uploaded_bytes);
+      }
+      return CheckSavedTrace(argv[2], max_num_calls, max_num_uploaded_bytes);
+    }
+    // Measure the mesh batching without the window
+    if (mode == "--batching-benchmark") {
+      if (argc != 3) {
+        throw std::runtime_error("Usage: " + std::string(argv[0]) + " " +
+                                 mode + " <num_frames>");
+      }
+      return RunBatchingBenchmark(std::stoi(argv[2]));
+    }
+
     // DEBUG: See from light source
     if (kSeeFromLight) {
       camera_trans.SetEye(scene_shader.GetLightPos());
@@ -1338,6 +2421,7 @@ int main(int argc, char *argv[]) {
     as::InitGLEW();
     ConfigGL();
     InitFbx();
+    InitPointLights();
     InitImGui();
     StartInitialSound();
     RegisterGLUTCallbacks();
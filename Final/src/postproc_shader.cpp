@@ -11,10 +11,9 @@ shader::PostprocShader::PostprocShader() : postproc_inputs_(PostprocInputs()) {
  ******************************************************************************/
 
 void shader::PostprocShader::Init() {
-  CreateShaders();
-  CreatePrograms();
   LoadModel();
   InitFramebuffers();
+  InitDummyTexture();
   InitVertexArrays();
   InitUniformBlocks();
 }
@@ -27,6 +26,7 @@ void shader::PostprocShader::InitFramebuffers() {
   // Get managers
   as::FramebufferManager &framebuffer_manager =
       gl_managers_->GetFramebufferManager();
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
 
   // Set framebuffer types to initialize
   const PostprocFramebufferTypes postproc_framebuffer_types[] = {
@@ -46,10 +46,45 @@ void shader::PostprocShader::InitFramebuffers() {
 
       // Generate framebuffer
       framebuffer_manager.GenFramebuffer(framebuffer_name);
+
+      // Tell GL we're drawing to multiple attachments
+      framebuffer_manager.BindFramebuffer(framebuffer_name);
+      const unsigned int attachments[] = {
+          GL_COLOR_ATTACHMENT0 + 0,
+          GL_COLOR_ATTACHMENT0 + 1,
+      };
+      trace_manager.RecordCall("glDrawBuffers", {2}, 0,
+                               [&] { glDrawBuffers(2, attachments); });
     }
   }
 }
 
+/*
+ * Initializes the 1x1 black texture which is sampled instead of the bloom
+ * chain textures when they are released with the culled bloom passes
+ */
+void shader::PostprocShader::InitDummyTexture() {
+  // Get managers
+  as::TextureManager &texture_manager = gl_managers_->GetTextureManager();
+  // Get names
+  const std::string tex_name = GetDummyTextureName();
+  const std::string unit_name = GetDummyTextureUnitName();
+  // Set the texel
+  const GLubyte texel[] = {0, 0, 0, 0};
+
+  // Generate texture
+  texture_manager.GenTexture(tex_name);
+  // Update texture
+  texture_manager.BindTexture(tex_name, GL_TEXTURE_2D, unit_name);
+  texture_manager.InitTexture2D(tex_name, GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1);
+  texture_manager.UpdateTexture2D(tex_name, GL_TEXTURE_2D, 0, 0, 0, 1, 1,
+                                  GL_RGBA, GL_UNSIGNED_BYTE, texel);
+  texture_manager.SetTextureParamInt(tex_name, GL_TEXTURE_2D,
+                                     GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  texture_manager.SetTextureParamInt(tex_name, GL_TEXTURE_2D,
+                                     GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
 void shader::PostprocShader::InitVertexArrays() {
   InitVertexArray(GetQuadVertexArrayGroupName(), quad_model_);
 }
@@ -63,135 +98,77 @@ void shader::PostprocShader::InitUniformBlocks() {
  * GL Drawing Methods
  ******************************************************************************/
 
+/*
+ * Acquires the textures written by the scene passes. The bloom chain textures
+ * are transient resources of the render graph instead.
+ */
 void shader::PostprocShader::UpdatePostprocTextures(const GLsizei width,
                                                     const GLsizei height) {
   // Get managers
   as::FramebufferManager &framebuffer_manager =
       gl_managers_->GetFramebufferManager();
-  as::TextureManager &texture_manager = gl_managers_->GetTextureManager();
-
-  // Set framebuffer types to attach
-  const PostprocFramebufferTypes postproc_framebuffer_types[] = {
-      PostprocFramebufferTypes::kDrawOriginal,
-      PostprocFramebufferTypes::kDrawScaling,
-      PostprocFramebufferTypes::kBlurScalingHorizontal,
-      PostprocFramebufferTypes::kBlurScalingVertical,
-      PostprocFramebufferTypes::kCombining};
 
   // Set texture types to update
   const PostprocTextureTypes postproc_tex_types[] = {
-      PostprocTextureTypes::kOriginal1, PostprocTextureTypes::kHdr1,
       PostprocTextureTypes::kOriginal2, PostprocTextureTypes::kHdr2};
 
   // Configure textures
   for (const PostprocTextureTypes postproc_tex_type : postproc_tex_types) {
-    const int num_bloom_scaling =
-        GetPostprocTextureTypeNumBloomScaling(postproc_tex_type);
-
-    // Configure each scaling texture
-    GLsizei cur_width = width;
-    GLsizei cur_height = height;
-    for (int scaling_idx = 0; scaling_idx < num_bloom_scaling; scaling_idx++) {
-      // Get names
-      const std::string tex_name =
-          GetPostprocTextureName(postproc_tex_type, scaling_idx);
-      const std::string unit_name =
-          GetPostprocTextureUnitName(postproc_tex_type, scaling_idx);
-      // Get indexes
-      const int color_attachment_idx =
-          PostprocTextureTypeToNum(postproc_tex_type) % 2;
-
-      // Check whether to delete old texture
-      if (texture_manager.HasTexture(tex_name)) {
-        texture_manager.DeleteTexture(tex_name);
-      }
-      // Generate texture
-      texture_manager.GenTexture(tex_name);
-      // Update texture
-      texture_manager.BindTexture(tex_name, GL_TEXTURE_2D, unit_name);
-      texture_manager.InitTexture2D(tex_name, GL_TEXTURE_2D, kNumMipmapLevels,
-                                    GL_BGRA, cur_width, cur_height);
-      texture_manager.SetTextureParamInt(tex_name, GL_TEXTURE_2D,
-                                         GL_TEXTURE_MIN_FILTER,
-                                         GL_LINEAR_MIPMAP_LINEAR);
-      texture_manager.SetTextureParamInt(tex_name, GL_TEXTURE_2D,
-                                         GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      texture_manager.SetTextureParamInt(tex_name, GL_TEXTURE_2D,
-                                         GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-      texture_manager.SetTextureParamInt(tex_name, GL_TEXTURE_2D,
-                                         GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-      // Attach textures to framebuffers
-      for (const PostprocFramebufferTypes postproc_framebuffer_type :
-           postproc_framebuffer_types) {
-        // Get names
-        const std::string framebuffer_name =
-            GetPostprocFramebufferName(postproc_framebuffer_type, scaling_idx);
-
-        framebuffer_manager.AttachTexture2DToFramebuffer(
-            framebuffer_name, tex_name, GL_FRAMEBUFFER,
-            GL_COLOR_ATTACHMENT0 + color_attachment_idx, GL_TEXTURE_2D, 0);
-
-        // Tell GL we're drawing to multiple attachments
-        framebuffer_manager.BindFramebuffer(framebuffer_name);
-        const unsigned int attachments[] = {
-            GL_COLOR_ATTACHMENT0 + 0,
-            GL_COLOR_ATTACHMENT0 + 1,
-        };
-        glDrawBuffers(2, attachments);
-      }
-
-      // Update next texture size
-      cur_width /= 2;
-      cur_height /= 2;
-    }
+    // Get names
+    const std::string tex_name = GetPostprocTextureName(postproc_tex_type, 0);
+
+    // Acquire the texture from the pool, the old one is released
+    const as::FramebufferManager::RenderTargetDesc desc = {
+        GL_BGRA, width, height, kNumMipmapLevels, 0};
+    framebuffer_manager.AcquireTexture2D(tex_name, desc);
+    // Update texture
+    ConfigPostprocTexture(postproc_tex_type, 0);
   }
 }
 
-void shader::PostprocShader::UpdatePostprocRenderbuffer(const GLsizei width,
-                                                        const GLsizei height) {
+/*
+ * Binds the newly acquired texture to its unit. The texture is attached to the
+ * framebuffers by the passes drawing on it.
+ */
+void shader::PostprocShader::ConfigPostprocTexture(
+    const PostprocTextureTypes postproc_tex_type, const int scaling_idx) {
+  // Get managers
+  as::TextureManager &texture_manager = gl_managers_->GetTextureManager();
+  // Get names
+  const std::string tex_name =
+      GetPostprocTextureName(postproc_tex_type, scaling_idx);
+  const std::string unit_name =
+      GetPostprocTextureUnitName(postproc_tex_type, scaling_idx);
+
+  // Update texture
+  texture_manager.BindTexture(tex_name, GL_TEXTURE_2D, unit_name);
+  texture_manager.SetTextureParamInt(tex_name, GL_TEXTURE_2D,
+                                     GL_TEXTURE_MIN_FILTER,
+                                     GL_LINEAR_MIPMAP_LINEAR);
+  texture_manager.SetTextureParamInt(tex_name, GL_TEXTURE_2D,
+                                     GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  texture_manager.SetTextureParamInt(tex_name, GL_TEXTURE_2D,
+                                     GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  texture_manager.SetTextureParamInt(tex_name, GL_TEXTURE_2D,
+                                     GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void shader::PostprocShader::AttachPostprocRenderbuffer(
+    const PostprocFramebufferTypes postproc_framebuffer_type,
+    const int scaling_idx) {
   // Get managers
   as::FramebufferManager &framebuffer_manager =
       gl_managers_->GetFramebufferManager();
+  // Get names
+  const std::string framebuffer_name =
+      GetPostprocFramebufferName(postproc_framebuffer_type, scaling_idx);
+  const std::string renderbuffer_name =
+      GetPostprocDepthRenderbufferName(postproc_framebuffer_type, scaling_idx);
 
-  // Set framebuffer types to attach
-  const PostprocFramebufferTypes postproc_framebuffer_types[] = {
-      PostprocFramebufferTypes::kDrawOriginal,
-      PostprocFramebufferTypes::kDrawScaling,
-      PostprocFramebufferTypes::kBlurScalingHorizontal,
-      PostprocFramebufferTypes::kBlurScalingVertical,
-      PostprocFramebufferTypes::kCombining};
-
-  for (const PostprocFramebufferTypes postproc_framebuffer_type :
-       postproc_framebuffer_types) {
-    // Update each scaling renderbuffer
-    GLsizei cur_width = width;
-    GLsizei cur_height = height;
-    for (int scaling_idx = 0; scaling_idx < kNumBloomScaling; scaling_idx++) {
-      // Get names
-      const std::string framebuffer_name =
-          GetPostprocFramebufferName(postproc_framebuffer_type, scaling_idx);
-      const std::string renderbuffer_name = GetPostprocDepthRenderbufferName(
-          postproc_framebuffer_type, scaling_idx);
-
-      // Check whether to delete old renderbuffer
-      if (framebuffer_manager.HasRenderbuffer(renderbuffer_name)) {
-        framebuffer_manager.DeleteRenderbuffer(renderbuffer_name);
-      }
-      // Create renderbuffers
-      framebuffer_manager.GenRenderbuffer(renderbuffer_name);
-      // Initialize renderbuffers
-      framebuffer_manager.InitRenderbuffer(renderbuffer_name, GL_RENDERBUFFER,
-                                           GL_DEPTH_COMPONENT, cur_width,
-                                           cur_height);
-      // Attach renderbuffers to framebuffers
-      framebuffer_manager.AttachRenderbufferToFramebuffer(
-          framebuffer_name, renderbuffer_name, GL_FRAMEBUFFER,
-          GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER);
-
-      cur_width /= 2;
-      cur_height /= 2;
-    }
-  }
+  // Attach the renderbuffer to the framebuffer
+  framebuffer_manager.AttachRenderbufferToFramebuffer(
+      framebuffer_name, renderbuffer_name, GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+      GL_RENDERBUFFER);
 }
 
 void shader::PostprocShader::UsePostprocFramebuffer(
@@ -259,76 +236,59 @@ void shader::PostprocShader::UsePostprocTexture(
       GL_COLOR_ATTACHMENT0 + color_attachment_idx, GL_TEXTURE_2D, 0);
 }
 
-void shader::PostprocShader::DrawBloom(const glm::ivec2 &window_size) {
-  as::FramebufferManager &framebuffer_manager =
-      gl_managers_->GetFramebufferManager();
-  for (int pass_idx = 1; pass_idx <= 4; pass_idx++) {
-    // Select framebuffer type
-    PostprocFramebufferTypes framebuffer_type;
-    if (pass_idx == 1) {
-      framebuffer_type = PostprocFramebufferTypes::kDrawScaling;
-    } else if (pass_idx == 2) {
-      framebuffer_type = PostprocFramebufferTypes::kBlurScalingHorizontal;
-    } else if (pass_idx == 3) {
-      framebuffer_type = PostprocFramebufferTypes::kBlurScalingVertical;
-    } else if (pass_idx == 4) {
-      framebuffer_type = PostprocFramebufferTypes::kCombining;
-    }
+void shader::PostprocShader::DrawBloomPass(const int pass_idx,
+                                           const glm::ivec2 &window_size) {
+  as::StateManager &state_manager = gl_managers_->GetStateManager();
+  // Use the program, the uniform setters skip it when the values are unchanged
+  UseProgram();
 
-    // Set number of scaling
-    int num_scaling;
-    if (pass_idx == 1) {
-      num_scaling = kNumBloomScaling;
-    } else if (pass_idx == 2) {
-      num_scaling = kNumBloomScaling;
-    } else if (pass_idx == 3) {
-      num_scaling = kNumBloomScaling;
-    } else if (pass_idx == 4) {
-      num_scaling = 1;
-    }
+  // Select framebuffer type
+  const PostprocFramebufferTypes framebuffer_type =
+      GetPassFramebufferType(pass_idx);
+  // Set number of scaling
+  const int num_scaling = GetPassNumScaling(pass_idx);
 
-    // Check whether to set all scaling texture unit indexes
-    if (framebuffer_type == PostprocFramebufferTypes::kCombining) {
-      SetScalingTextureUnitIdxs(pass_idx);
-    }
+  // Check whether to set all scaling texture unit indexes
+  if (framebuffer_type == PostprocFramebufferTypes::kCombining) {
+    SetScalingTextureUnitIdxs(pass_idx);
+  }
 
-    // Draw for each scaling
-    glm::ivec2 cur_size = window_size;
-    for (int scaling_idx = 0; scaling_idx < num_scaling; scaling_idx++) {
-      // Use the framebuffer
-      UsePostprocFramebuffer(framebuffer_type, scaling_idx);
-      as::ClearColorBuffer();
-      as::ClearDepthBuffer();
-
-      // Update pass index
-      UpdatePassIdx(pass_idx);
-      // Update scaling index
-      UpdateScalingIdx(scaling_idx);
-      // Update postproc inputs buffer
-      UpdatePostprocInputs();
-
-      // Set texture unit indexes as inputs
-      SetTextureUnitIdxs(pass_idx, scaling_idx);
-
-      // Use the textures as outputs
-      UsePostprocTexture(framebuffer_type,
-                         GetPassOriginalTextureType(pass_idx, false), 0);
-      UsePostprocTexture(framebuffer_type,
-                         GetPassHdrTextureType(pass_idx, false), scaling_idx);
-
-      // Update view port
-      glViewport(0, 0, cur_size.x, cur_size.y);
-
-      // Draw
-      DrawToTextures();
-
-      // Shrink window size
-      cur_size /= 2;
-    }
+  // Draw for each scaling
+  glm::ivec2 cur_size = window_size;
+  for (int scaling_idx = 0; scaling_idx < num_scaling; scaling_idx++) {
+    // Use the framebuffer
+    UsePostprocFramebuffer(framebuffer_type, scaling_idx);
+    as::ClearColorBuffer();
+    as::ClearDepthBuffer();
+
+    // Update pass index
+    UpdatePassIdx(pass_idx);
+    // Update scaling index
+    UpdateScalingIdx(scaling_idx);
+    // Update postproc inputs buffer
+    UpdatePostprocInputs();
+
+    // Set texture unit indexes as inputs
+    SetTextureUnitIdxs(pass_idx, scaling_idx);
+
+    // Use the textures as outputs
+    UsePostprocTexture(framebuffer_type,
+                       GetPassOriginalTextureType(pass_idx, false), 0);
+    UsePostprocTexture(framebuffer_type,
+                       GetPassHdrTextureType(pass_idx, false), scaling_idx);
+
+    // Update view port
+    state_manager.SetViewport(0, 0, cur_size.x, cur_size.y);
+
+    // Draw
+    DrawToTextures();
+
+    // Shrink window size
+    cur_size /= 2;
   }
 
   // Restore view port
-  glViewport(0, 0, window_size.x, window_size.y);
+  state_manager.SetViewport(0, 0, window_size.x, window_size.y);
 }
 
 void shader::PostprocShader::DrawPostprocEffects() {
@@ -399,18 +359,146 @@ void shader::PostprocShader::UpdateUseGammaCorrect(
 }
 
 /*******************************************************************************
- * Name Management
+ * Render Graph
  ******************************************************************************/
 
-std::string shader::PostprocShader::GetId() const { return "postproc"; }
+/*
+ * Adds the depth renderbuffers of all framebuffers as transient resources.
+ * Each renderbuffer is only used by the passes drawing on its framebuffer and
+ * the depth is cleared in each pass, so the renderbuffers of the same size are
+ * aliased by the render graph.
+ */
+void shader::PostprocShader::AddPostprocRenderbufferResources(
+    as::RenderGraph &render_graph, const glm::ivec2 &window_size) {
+  // Set framebuffer types to add
+  const PostprocFramebufferTypes postproc_framebuffer_types[] = {
+      PostprocFramebufferTypes::kDrawOriginal,
+      PostprocFramebufferTypes::kDrawScaling,
+      PostprocFramebufferTypes::kBlurScalingHorizontal,
+      PostprocFramebufferTypes::kBlurScalingVertical,
+      PostprocFramebufferTypes::kCombining};
+
+  for (const PostprocFramebufferTypes postproc_framebuffer_type :
+       postproc_framebuffer_types) {
+    const int pass_idx =
+        PostprocFramebufferTypeToNum(postproc_framebuffer_type);
+    glm::ivec2 cur_size = window_size;
+    for (int scaling_idx = 0; scaling_idx < GetPassNumScaling(pass_idx);
+         scaling_idx++) {
+      // Get names
+      const std::string renderbuffer_name = GetPostprocDepthRenderbufferName(
+          postproc_framebuffer_type, scaling_idx);
+
+      // The bloom passes clear their own framebuffers
+      const GLbitfield clear_mask =
+          postproc_framebuffer_type == PostprocFramebufferTypes::kDrawOriginal
+              ? GL_DEPTH_BUFFER_BIT
+              : 0;
+      const as::RenderGraph::ResourceDesc desc = {
+          as::RenderGraph::ResourceKinds::kTransientRenderbuffer,
+          {GL_DEPTH_COMPONENT, cur_size.x, cur_size.y, 1, 0},
+          clear_mask,
+          0};
+      render_graph.AddResource(
+          renderbuffer_name, desc,
+          [this, postproc_framebuffer_type, scaling_idx]() {
+            AttachPostprocRenderbuffer(postproc_framebuffer_type, scaling_idx);
+          });
+
+      cur_size /= 2;
+    }
+  }
+}
+
+/*
+ * Adds the bloom chain textures as transient resources. They are only used by
+ * the bloom passes, so they are released when the bloom passes are culled.
+ */
+void shader::PostprocShader::AddPostprocTextureResources(
+    as::RenderGraph &render_graph, const glm::ivec2 &window_size) {
+  // Set texture types to add
+  const PostprocTextureTypes postproc_tex_types[] = {
+      PostprocTextureTypes::kOriginal1, PostprocTextureTypes::kHdr1,
+      PostprocTextureTypes::kOriginal2, PostprocTextureTypes::kHdr2};
+
+  for (const PostprocTextureTypes postproc_tex_type : postproc_tex_types) {
+    const int num_bloom_scaling =
+        GetPostprocTextureTypeNumBloomScaling(postproc_tex_type);
+    glm::ivec2 cur_size = window_size;
+    for (int scaling_idx = 0; scaling_idx < num_bloom_scaling; scaling_idx++) {
+      if (IsBloomChainTexture(postproc_tex_type, scaling_idx)) {
+        // Get names
+        const std::string tex_name =
+            GetPostprocTextureName(postproc_tex_type, scaling_idx);
+
+        // The bloom passes clear their own framebuffers
+        const as::RenderGraph::ResourceDesc desc = {
+            as::RenderGraph::ResourceKinds::kTransientTexture2D,
+            {GL_BGRA, cur_size.x, cur_size.y, kNumMipmapLevels, 0},
+            0,
+            0};
+        render_graph.AddResource(
+            tex_name, desc, [this, postproc_tex_type, scaling_idx]() {
+              ConfigPostprocTexture(postproc_tex_type, scaling_idx);
+            });
+      }
+
+      cur_size /= 2;
+    }
+  }
+}
+
+/*
+ * Returns the bloom chain textures read or written by the pass drawing on the
+ * framebuffer type
+ */
+std::vector<std::string>
+shader::PostprocShader::GetPostprocTextureResourceNames(
+    const PostprocFramebufferTypes postproc_framebuffer_type,
+    const bool read) const {
+  const int pass_idx = PostprocFramebufferTypeToNum(postproc_framebuffer_type);
+  // The combining pass reads all scaling HDR textures at once
+  const int num_hdr_scaling =
+      read && postproc_framebuffer_type == PostprocFramebufferTypes::kCombining
+          ? kNumBloomScaling
+          : GetPassNumScaling(pass_idx);
+  // Get texture types
+  const PostprocTextureTypes original_tex_type =
+      GetPassOriginalTextureType(pass_idx, read);
+  const PostprocTextureTypes hdr_tex_type =
+      GetPassHdrTextureType(pass_idx, read);
+
+  std::vector<std::string> resource_names;
+  if (IsBloomChainTexture(original_tex_type, 0)) {
+    resource_names.push_back(GetPostprocTextureName(original_tex_type, 0));
+  }
+  for (int scaling_idx = 0; scaling_idx < num_hdr_scaling; scaling_idx++) {
+    if (IsBloomChainTexture(hdr_tex_type, scaling_idx)) {
+      resource_names.push_back(
+          GetPostprocTextureName(hdr_tex_type, scaling_idx));
+    }
+  }
+  return resource_names;
+}
+
+std::vector<std::string>
+shader::PostprocShader::GetPostprocRenderbufferResourceNames(
+    const PostprocFramebufferTypes postproc_framebuffer_type) const {
+  const int pass_idx = PostprocFramebufferTypeToNum(postproc_framebuffer_type);
+  std::vector<std::string> resource_names;
+  for (int scaling_idx = 0; scaling_idx < GetPassNumScaling(pass_idx);
+       scaling_idx++) {
+    resource_names.push_back(GetPostprocDepthRenderbufferName(
+        postproc_framebuffer_type, scaling_idx));
+  }
+  return resource_names;
+}
 
 /*******************************************************************************
- * Name Management (Protected)
+ * Name Management
  ******************************************************************************/
 
-std::string shader::PostprocShader::GetPostprocInputsBufferName() const {
-  return GetProgramName() + "/buffer/postproc_inputs";
-}
+std::string shader::PostprocShader::GetId() const { return "postproc"; }
 
 std::string shader::PostprocShader::GetPostprocFramebufferName(
     const PostprocFramebufferTypes postproc_framebuffer_type,
@@ -420,6 +508,14 @@ std::string shader::PostprocShader::GetPostprocFramebufferName(
          "/scaling-" + std::to_string(scaling_idx);
 }
 
+/*******************************************************************************
+ * Name Management (Protected)
+ ******************************************************************************/
+
+std::string shader::PostprocShader::GetPostprocInputsBufferName() const {
+  return GetProgramName() + "/buffer/postproc_inputs";
+}
+
 std::string shader::PostprocShader::GetQuadVertexArrayGroupName() const {
   return GetProgramName() + "/vertex_array/group";
 }
@@ -446,6 +542,14 @@ std::string shader::PostprocShader::GetPostprocDepthRenderbufferName(
          "/scaling-" + std::to_string(scaling_idx);
 }
 
+std::string shader::PostprocShader::GetDummyTextureName() const {
+  return GetProgramName() + "/texture/postproc/dummy";
+}
+
+std::string shader::PostprocShader::GetDummyTextureUnitName() const {
+  return GetProgramName() + "/texture_unit_name/postproc/dummy";
+}
+
 std::string shader::PostprocShader::GetPostprocInputsUniformBlockName() const {
   return "PostprocInputs";
 }
@@ -481,6 +585,46 @@ shader::PostprocShader::GetPassHdrTextureType(const int pass_idx,
   }
 }
 
+/*
+ * Returns the framebuffer type drawn in the pass, pass 0 draws the scene
+ */
+shader::PostprocShader::PostprocFramebufferTypes
+shader::PostprocShader::GetPassFramebufferType(const int pass_idx) const {
+  switch (pass_idx) {
+    case 0:
+      return PostprocFramebufferTypes::kDrawOriginal;
+    case 1:
+      return PostprocFramebufferTypes::kDrawScaling;
+    case 2:
+      return PostprocFramebufferTypes::kBlurScalingHorizontal;
+    case 3:
+      return PostprocFramebufferTypes::kBlurScalingVertical;
+    case 4:
+      return PostprocFramebufferTypes::kCombining;
+    default:
+      throw std::runtime_error("Unknown postproc pass index " +
+                               std::to_string(pass_idx));
+  }
+}
+
+int shader::PostprocShader::GetPassNumScaling(const int pass_idx) const {
+  if (pass_idx >= 1 && pass_idx <= 3) {
+    return kNumBloomScaling;
+  } else {
+    return 1;
+  }
+}
+
+/*
+ * Only the first scaling of "write" textures is drawn by the scene passes, the
+ * others are only used by the bloom passes
+ */
+bool shader::PostprocShader::IsBloomChainTexture(
+    const PostprocTextureTypes postproc_tex_type, const int scaling_idx) const {
+  return postproc_tex_type == PostprocTextureTypes::kOriginal1 ||
+         postproc_tex_type == PostprocTextureTypes::kHdr1 || scaling_idx > 0;
+}
+
 /*******************************************************************************
  * State Updaters (Private)
  ******************************************************************************/
@@ -539,8 +683,14 @@ void shader::PostprocShader::SetScalingTextureUnitIdxs(const int pass_idx) {
 
   for (int scaling_idx = 0; scaling_idx < kNumBloomScaling; scaling_idx++) {
     // Get names
-    const std::string hdr_tex_name = GetPostprocTextureName(
+    std::string hdr_tex_name = GetPostprocTextureName(
         GetPassHdrTextureType(pass_idx, true), scaling_idx);
+    // Use the dummy texture if the bloom chain texture has been released with
+    // the culled bloom passes
+    if (!texture_manager.HasTexture(hdr_tex_name)) {
+      hdr_tex_name = GetDummyTextureName();
+      texture_manager.BindTexture(hdr_tex_name);
+    }
     // Get unit indexes
     const GLuint hdr_unit_idx = texture_manager.GetUnitIdx(hdr_tex_name);
 
@@ -552,6 +702,8 @@ void shader::PostprocShader::SetScalingTextureUnitIdxs(const int pass_idx) {
 }
 
 void shader::PostprocShader::DrawToTextures() {
+  // Get managers
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
   // Get names
   const std::string group_name = GetQuadVertexArrayGroupName();
   // Get the mesh
@@ -559,11 +711,14 @@ void shader::PostprocShader::DrawToTextures() {
   const as::Mesh &mesh = meshes.front();
   // Get the array indexes
   const std::vector<size_t> &idxs = mesh.GetIdxs();
+  const GLsizei num_idxs = static_cast<GLsizei>(idxs.size());
 
   // Use the first mesh
   UseMesh(group_name, 0);
   // Draw the mesh
-  glDrawElements(GL_TRIANGLES, idxs.size(), GL_UNSIGNED_INT, nullptr);
+  trace_manager.RecordCall("glDrawElements", {GL_TRIANGLES, num_idxs}, 0, [&] {
+    glDrawElements(GL_TRIANGLES, num_idxs, GL_UNSIGNED_INT, nullptr);
+  });
 }
 
 /*******************************************************************************
@@ -0,0 +1,124 @@
+#include "resolution_controller.hpp"
+
+ctrl::ResolutionController::ResolutionController(const float target_seconds,
+                                                 const float min_scale,
+                                                 const float max_scale,
+                                                 const float scale_step)
+    : target_seconds_(target_seconds),
+      min_scale_(min_scale),
+      max_scale_(max_scale),
+      scale_step_(scale_step) {
+  if (min_scale <= 0.0f || min_scale > max_scale || scale_step <= 0.0f) {
+    throw std::runtime_error("Invalid resolution scale range (" +
+                             std::to_string(min_scale) + ", " +
+                             std::to_string(max_scale) + ", " +
+                             std::to_string(scale_step) + ")");
+  }
+  SetTargetSeconds(target_seconds);
+  Reset();
+}
+
+float ctrl::ResolutionController::GetScale() const { return scale_; }
+
+float ctrl::ResolutionController::GetFrameSeconds() const {
+  return frame_seconds_;
+}
+
+float ctrl::ResolutionController::GetTargetSeconds() const {
+  return target_seconds_;
+}
+
+void ctrl::ResolutionController::SetTargetSeconds(const float target_seconds) {
+  if (target_seconds <= 0.0f) {
+    throw std::runtime_error("Invalid target frame time '" +
+                             std::to_string(target_seconds) + "'");
+  }
+  target_seconds_ = target_seconds;
+}
+
+void ctrl::ResolutionController::Reset() {
+  scale_ = max_scale_;
+  desired_scale_ = max_scale_;
+  frame_seconds_ = 0.0f;
+  integral_ = 0.0f;
+  prev_error_ = 0.0f;
+  num_held_frames_ = 0;
+}
+
+/*
+ * Runs the PID controller on the relative error of the smoothed GPU frame
+ * time, and returns whether the scale has changed. Lowering the resolution
+ * doesn't help when the CPU is slower than the GPU, so the scale isn't lowered
+ * then. The scale only moves to another step when the output is well past the
+ * current step and the scale has been held for several frames, so that it
+ * doesn't flicker between two steps.
+ */
+bool ctrl::ResolutionController::Update(const float gpu_seconds,
+                                        const float cpu_seconds) {
+  // Smooth the frame time
+  if (frame_seconds_ <= 0.0f) {
+    frame_seconds_ = gpu_seconds;
+  } else {
+    frame_seconds_ += kFrameSecondsSmoothing * (gpu_seconds - frame_seconds_);
+  }
+
+  // Get the relative error, which is positive when there is time to spare
+  float error = (target_seconds_ - frame_seconds_) / target_seconds_;
+  if (std::abs(error) < kDeadBand) {
+    error = 0.0f;
+  }
+  if (error < 0.0f && cpu_seconds > gpu_seconds) {
+    error = 0.0f;
+  }
+
+  // Limit the integral to the scale range so that it doesn't wind up
+  integral_ = glm::clamp(integral_ + error,
+                         (min_scale_ - max_scale_) / kIntegralGain, 0.0f);
+  const float derivative = error - prev_error_;
+  prev_error_ = error;
+  desired_scale_ =
+      glm::clamp(max_scale_ + kProportionalGain * error +
+                     kIntegralGain * integral_ + kDerivativeGain * derivative,
+                 min_scale_, max_scale_);
+
+  // Apply the output with hysteresis
+  num_held_frames_++;
+  if (num_held_frames_ < kNumHoldFrames) {
+    return false;
+  }
+  if (std::abs(desired_scale_ - scale_) <
+      (0.5f + kScaleHysteresis) * scale_step_) {
+    return false;
+  }
+  const float scale = QuantizeScale(desired_scale_);
+  if (scale == scale_) {
+    return false;
+  }
+  scale_ = scale;
+  num_held_frames_ = 0;
+  return true;
+}
+
+const float ctrl::ResolutionController::kProportionalGain = 0.2f;
+
+const float ctrl::ResolutionController::kIntegralGain = 0.02f;
+
+const float ctrl::ResolutionController::kDerivativeGain = 0.1f;
+
+const float ctrl::ResolutionController::kFrameSecondsSmoothing = 0.1f;
+
+// Relative frame time errors below it are ignored
+const float ctrl::ResolutionController::kDeadBand = 0.05f;
+
+// Extra distance in steps before moving to another step
+const float ctrl::ResolutionController::kScaleHysteresis = 0.25f;
+
+// The GPU times lag behind by two frames and are smoothed, so the scale is
+// held until the times of the new scale are measured
+const int ctrl::ResolutionController::kNumHoldFrames = 30;
+
+float ctrl::ResolutionController::QuantizeScale(const float scale) const {
+  const float num_steps = std::round((scale - min_scale_) / scale_step_);
+  return glm::clamp(min_scale_ + num_steps * scale_step_, min_scale_,
+                    max_scale_);
+}
@@ -1,13 +1,22 @@
 #include "scene_model_dto.hpp"
 
-dto::SceneModel::SceneModel() {}
+#include <xmmintrin.h>
+
+dto::SceneModel::SceneModel()
+    : dirty_instance_begin_(0),
+      dirty_instance_end_(0),
+      baked_trans_(glm::mat4(1.0f)) {}
 
 dto::SceneModel::SceneModel(const std::string &id, const std::string &path,
                             const unsigned int flags,
                             const std::string &tex_unit_group_name,
                             const GLsizei num_mipmap_levels,
                             as::GLManagers *gl_managers)
-    : use_env_map_(false), is_visible_(true) {
+    : dirty_instance_begin_(0),
+      dirty_instance_end_(0),
+      baked_trans_(glm::mat4(1.0f)),
+      use_env_map_(false),
+      is_visible_(true) {
   id_ = id;
   LoadFile(path, flags);
   InitTextures(tex_unit_group_name, num_mipmap_levels, gl_managers);
@@ -84,31 +93,37 @@ void dto::SceneModel::SetScaling(const glm::vec3 &scaling) {
 void dto::SceneModel::SetInstancingTranslations(
     const std::vector<glm::vec3> &translations) {
   instancing_translations_ = translations;
+  MarkAllDirtyInstances();
 }
 
 void dto::SceneModel::SetInstancingRotations(
     const std::vector<glm::vec3> &rotations) {
   instancing_rotations_ = rotations;
+  MarkAllDirtyInstances();
 }
 
 void dto::SceneModel::SetInstancingScalings(
     const std::vector<glm::vec3> &scalings) {
   instancing_scalings_ = scalings;
+  MarkAllDirtyInstances();
 }
 
 void dto::SceneModel::SetDefaultInstancingTranslations() {
   const glm::vec3 default_translation = glm::vec3(0.0f);
   instancing_translations_.assign(GetNumInstancing(), default_translation);
+  MarkAllDirtyInstances();
 }
 
 void dto::SceneModel::SetDefaultInstancingRotations() {
   const glm::vec3 default_rotation = glm::vec3(0.0f);
   instancing_rotations_.assign(GetNumInstancing(), default_rotation);
+  MarkAllDirtyInstances();
 }
 
 void dto::SceneModel::SetDefaultInstancingScalings() {
   const glm::vec3 default_scaling = glm::vec3(1.0f);
   instancing_scalings_.assign(GetNumInstancing(), default_scaling);
+  MarkAllDirtyInstances();
 }
 
 void dto::SceneModel::SetInstancingTranslation(const int instance_idx,
@@ -118,6 +133,7 @@ void dto::SceneModel::SetInstancingTranslation(const int instance_idx,
     SetTranslation(translation);
   } else {
     instancing_translations_[instance_idx] = translation;
+    MarkDirtyInstances(instance_idx, instance_idx + 1);
   }
 }
 
@@ -128,6 +144,7 @@ void dto::SceneModel::SetInstancingRotation(const int instance_idx,
     SetRotation(rotation);
   } else {
     instancing_rotations_[instance_idx] = rotation;
+    MarkDirtyInstances(instance_idx, instance_idx + 1);
   }
 }
 
@@ -138,6 +155,7 @@ void dto::SceneModel::SetInstancingScaling(const int instance_idx,
     SetScaling(scaling);
   } else {
     instancing_scalings_[instance_idx] = scaling;
+    MarkDirtyInstances(instance_idx, instance_idx + 1);
   }
 }
 
@@ -203,6 +221,20 @@ std::vector<glm::mat4> dto::SceneModel::GetInstancingTransforms() const {
   return transforms;
 }
 
+glm::mat4 dto::SceneModel::GetInstancingTransform(
+    const size_t instance_idx) const {
+  const glm::vec3 translation = instancing_translations_.empty()
+                                    ? glm::vec3(0.0f)
+                                    : instancing_translations_[instance_idx];
+  const glm::vec3 rotation = instancing_rotations_.empty()
+                                 ? glm::vec3(0.0f)
+                                 : instancing_rotations_[instance_idx];
+  const glm::vec3 scaling = instancing_scalings_.empty()
+                                ? glm::vec3(1.0f)
+                                : instancing_scalings_[instance_idx];
+  return GetTransformMatrix(translation, rotation, scaling);
+}
+
 size_t dto::SceneModel::GetNumInstancing() const {
   size_t num = 0;
   if (!instancing_translations_.empty()) {
@@ -230,7 +262,7 @@ size_t dto::SceneModel::GetNumInstancing() const {
 }
 
 size_t dto::SceneModel::GetInstancingMemSize() const {
-  return GetNumInstancing() * sizeof(glm::vec3);
+  return GetNumInstancing() * sizeof(InstanceMatrices);
 }
 
 glm::vec3 dto::SceneModel::GetLightPos() const { return light_pos_; }
@@ -243,6 +275,68 @@ glm::vec3 dto::SceneModel::GetLightIntensity() const {
 
 bool dto::SceneModel::GetUseEnvMap() const { return use_env_map_; }
 
+/*******************************************************************************
+ * Instancing Updates
+ ******************************************************************************/
+
+bool dto::SceneModel::HasDirtyInstances() const {
+  return dirty_instance_begin_ < dirty_instance_end_;
+}
+
+size_t dto::SceneModel::GetDirtyInstanceBegin() const {
+  return dirty_instance_begin_;
+}
+
+size_t dto::SceneModel::GetDirtyInstanceEnd() const {
+  return dirty_instance_end_;
+}
+
+void dto::SceneModel::ClearDirtyInstances() {
+  dirty_instance_begin_ = 0;
+  dirty_instance_end_ = 0;
+}
+
+/*******************************************************************************
+ * Instance Matrices
+ ******************************************************************************/
+
+/*
+ * Bakes the matrices of the dirty instances, so the dirty range should be
+ * baked before it is cleared. All instances are baked and marked dirty when
+ * the model transformation or the number of instances changes.
+ */
+void dto::SceneModel::BakeInstanceMatrices() {
+  const glm::mat4 trans = GetTrans();
+  const size_t num_instancing = GetNumInstancing();
+  if (trans != baked_trans_ || instance_matrices_.size() != num_instancing) {
+    baked_trans_ = trans;
+    instance_matrices_.resize(num_instancing);
+    MarkAllDirtyInstances();
+  }
+  if (!HasDirtyInstances()) {
+    return;
+  }
+  const size_t end = std::min(dirty_instance_end_, num_instancing);
+  for (size_t instance_idx = dirty_instance_begin_; instance_idx < end;
+       instance_idx++) {
+    BakeInstanceMatrix(trans, GetInstancingTransform(instance_idx),
+                       instance_matrices_[instance_idx]);
+  }
+}
+
+const std::vector<dto::SceneModel::InstanceMatrices>
+    &dto::SceneModel::GetInstanceMatrices() const {
+  return instance_matrices_;
+}
+
+glm::mat4 dto::SceneModel::GetInstanceModel(const size_t instance_idx) const {
+  const InstanceMatrices &instance_matrices = instance_matrices_[instance_idx];
+  return glm::transpose(glm::mat4(instance_matrices.model_rows[0],
+                                  instance_matrices.model_rows[1],
+                                  instance_matrices.model_rows[2],
+                                  glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
 /*******************************************************************************
  * Model Initialization (Private)
  ******************************************************************************/
@@ -338,6 +432,93 @@ std::vector<glm::vec3> dto::SceneModel::GetDefaultInstancingTransforms(
   return std::vector<glm::vec3>(GetNumInstancing(), default_transform);
 }
 
+/*******************************************************************************
+ * Instancing Updates (Private)
+ ******************************************************************************/
+
+/*
+ * Extends the dirty range to cover the instances, the ranges are merged into
+ * a single range so that they could be uploaded by a single call
+ */
+void dto::SceneModel::MarkDirtyInstances(const size_t begin, const size_t end) {
+  if (HasDirtyInstances()) {
+    dirty_instance_begin_ = std::min(dirty_instance_begin_, begin);
+    dirty_instance_end_ = std::max(dirty_instance_end_, end);
+  } else {
+    dirty_instance_begin_ = begin;
+    dirty_instance_end_ = end;
+  }
+}
+
+void dto::SceneModel::MarkAllDirtyInstances() {
+  MarkDirtyInstances(0, GetNumInstancing());
+}
+
+/*******************************************************************************
+ * Instance Matrices (Private)
+ ******************************************************************************/
+
+/*
+ * Each column of the model matrix is the sum of the columns of the model
+ * transformation weighted by a column of the instancing transformation. The
+ * normal matrix is the inverse transpose of the upper-left 3x3 matrix, whose
+ * columns are the cross products of its columns divided by the determinant.
+ */
+void dto::SceneModel::BakeInstanceMatrix(const glm::mat4 &trans,
+                                         const glm::mat4 &instancing_trans,
+                                         InstanceMatrices &instance_matrices) {
+  // Multiply the transformations
+  __m128 trans_cols[4];
+  for (int col_idx = 0; col_idx < 4; col_idx++) {
+    trans_cols[col_idx] = _mm_loadu_ps(glm::value_ptr(trans[col_idx]));
+  }
+  __m128 cols[4];
+  for (int col_idx = 0; col_idx < 4; col_idx++) {
+    const glm::vec4 &weights = instancing_trans[col_idx];
+    cols[col_idx] = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(trans_cols[0], _mm_set1_ps(weights.x)),
+                   _mm_mul_ps(trans_cols[1], _mm_set1_ps(weights.y))),
+        _mm_add_ps(_mm_mul_ps(trans_cols[2], _mm_set1_ps(weights.z)),
+                   _mm_mul_ps(trans_cols[3], _mm_set1_ps(weights.w))));
+  }
+
+  // Calculate the cross products, the last components are zeros
+  __m128 cofactor_cols[4];
+  for (int col_idx = 0; col_idx < 3; col_idx++) {
+    const __m128 a = cols[(col_idx + 1) % 3];
+    const __m128 b = cols[(col_idx + 2) % 3];
+    const __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    const __m128 a_zxy = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+    const __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    const __m128 b_zxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+    cofactor_cols[col_idx] =
+        _mm_sub_ps(_mm_mul_ps(a_yzx, b_zxy), _mm_mul_ps(a_zxy, b_yzx));
+  }
+  cofactor_cols[3] = _mm_setzero_ps();
+  // Sum the components of the dot product into all lanes
+  const __m128 products = _mm_mul_ps(cols[0], cofactor_cols[0]);
+  __m128 dets = _mm_add_ps(
+      products, _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 3, 0, 1)));
+  dets = _mm_add_ps(dets, _mm_shuffle_ps(dets, dets, _MM_SHUFFLE(1, 0, 3, 2)));
+  // The normals of a degenerate transformation are zeros
+  const float det = _mm_cvtss_f32(dets);
+  const __m128 inv_dets = _mm_set1_ps(det == 0.0f ? 0.0f : 1.0f / det);
+  for (int col_idx = 0; col_idx < 3; col_idx++) {
+    cofactor_cols[col_idx] = _mm_mul_ps(cofactor_cols[col_idx], inv_dets);
+  }
+
+  // Store the rows
+  _MM_TRANSPOSE4_PS(cols[0], cols[1], cols[2], cols[3]);
+  _MM_TRANSPOSE4_PS(cofactor_cols[0], cofactor_cols[1], cofactor_cols[2],
+                    cofactor_cols[3]);
+  for (int row_idx = 0; row_idx < 3; row_idx++) {
+    _mm_storeu_ps(glm::value_ptr(instance_matrices.model_rows[row_idx]),
+                  cols[row_idx]);
+    _mm_storeu_ps(glm::value_ptr(instance_matrices.normal_rows[row_idx]),
+                  cofactor_cols[row_idx]);
+  }
+}
+
 /*******************************************************************************
  * Name Management (Private)
  ******************************************************************************/
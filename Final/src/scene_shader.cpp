@@ -1,13 +1,45 @@
 #include "scene_shader.hpp"
 
+#include <future>
+
+#include "depth_shader.hpp"
+
 shader::SceneShader::SceneShader()
     : model_rotation(glm::radians(0.0f)),
       global_trans_(dto::GlobalTrans()),
-      model_trans_(dto::ModelTrans()),
       model_material_(ModelMaterial()),
       lighting_(Lighting()),
+      cascaded_shadows_(CascadedShadows()),
+      light_cluster_params_(LightClusterParams()),
       use_instantiating_(true),
-      use_normal_height_(true) {}
+      use_normal_height_(true),
+      use_indirect_drawing_(false),
+      use_permutations_(true),
+      use_culling_(true),
+      use_occlusion_culling_(true),
+      use_mesh_batching_(true),
+      use_depth_prepass_(false),
+      use_pcf_(false),
+      use_material_lod_(true),
+      use_duplicate_models_(false),
+      occlusion_buffer_(kOcclusionBufferWidth, kOcclusionBufferHeight),
+      material_tiers_(kDefaultMaterialTiers),
+      light_clusters_(kLightClusterNumTilesX, kLightClusterNumTilesY,
+                      kLightClusterNumSlices),
+      static_casters_version_(0),
+      num_draw_calls_(0),
+      instancing_stats_(InstancingStats{0, 0, 0}),
+      culling_stats_(CullingStats{0, 0, 0, 0, 0}),
+      batching_stats_(BatchingStats{0, 0}),
+      light_cluster_stats_(LightClusterStats{0, 0, 0, 0.0}),
+      material_lod_stats_(MaterialLodStats{
+          std::vector<unsigned int>(kMaxNumMaterialTiers, 0), 0.0f, 0.0f}),
+      prepass_query_hdlrs_{0, 0},
+      scene_query_hdlrs_{0, 0},
+      has_fragment_queries_{false, false},
+      was_prepassed_{false, false},
+      fragment_query_frame_idx_(0),
+      fragment_stats_(FragmentStats{false, 0, 0, 0, 0}) {}
 
 /*******************************************************************************
  * Shader Registrations
@@ -31,6 +63,11 @@ const std::map<std::string, dto::SceneModel>
   return scene_models_;
 }
 
+const std::vector<shader::SceneShader::MeshDrawInfo>
+    &shader::SceneShader::GetMeshDrawInfos() const {
+  return mesh_draw_infos_;
+}
+
 dto::SceneModel &shader::SceneShader::GetSceneModel(
     const std::string &scene_model_name) {
   if (scene_models_.count(scene_model_name) == 0) {
@@ -45,14 +82,25 @@ dto::SceneModel &shader::SceneShader::GetSceneModel(
  ******************************************************************************/
 
 void shader::SceneShader::Init() {
-  CreateShaders();
-  CreatePrograms();
   LoadModels();
   InitModels();
+  InitOccluderMeshes();
   InitVertexArrays();
   InitInstancingVertexArrays();
+  InitMeshDrawInfos();
+  InitIndirectBuffers();
+  InitLightClusterBuffers();
+  InitIndirectVertexArray();
+  InitPrepassVertexArrays();
   InitUniformBlocks();
-  InitLightTrans();
+  InitUniformRingBuffer();
+  InitFragmentQueries();
+}
+
+void shader::SceneShader::SubmitPrograms() {
+  Shader::SubmitPrograms();
+  InitIndirectProgram();
+  InitPrepassProgram();
 }
 
 void shader::SceneShader::ReuseSkyboxTexture() {
@@ -69,17 +117,15 @@ void shader::SceneShader::ReuseSkyboxTexture() {
 void shader::SceneShader::BindTextures() {
   // Get managers
   as::TextureManager &texture_manager = gl_managers_->GetTextureManager();
-  as::UniformManager &uniform_manager = gl_managers_->GetUniformManager();
   // Get names
-  const std::string program_name = GetProgramName();
+  const std::string program_names[] = {GetProgramName(),
+                                       GetIndirectProgramName()};
   const std::string skybox_tex_name = skybox_shader_->GetTextureName();
   const std::string skybox_unit_name = GetSkyboxTextureUnitName();
 
   // Bind the skybox texture
-  const GLuint skybox_unit_idx = texture_manager.GetUnitIdx(skybox_tex_name);
   texture_manager.BindTexture(skybox_tex_name, GL_TEXTURE_CUBE_MAP,
                               skybox_unit_name);
-  uniform_manager.SetUniform1Int(program_name, "skybox_tex", skybox_unit_idx);
 
   // Bind the depth texture from light view
   const std::string light_depth_tex_name = depth_shader_->GetDepthTextureName(
@@ -89,34 +135,108 @@ void shader::SceneShader::BindTextures() {
           shader::DepthShader::DepthTextureTypes::kFromLight);
   texture_manager.BindTexture(light_depth_tex_name, GL_TEXTURE_2D,
                               light_depth_unit_name);
-  uniform_manager.SetUniform1Int(
-      program_name, "light_depth_map_tex",
-      texture_manager.GetUnitIdx(light_depth_tex_name));
+
+  // Set the texture units
+  for (const std::string &program_name : program_names) {
+    SetSceneTextureUniforms(program_name);
+  }
 }
 
 /*******************************************************************************
  * GL Drawing Methods
  ******************************************************************************/
 
-void shader::SceneShader::Draw() {
-  // Use the program
-  UseProgram();
-
-  for (const auto &pair : scene_models_) {
-    const dto::SceneModel &scene_model = pair.second;
+/*
+ * Uploads the instances of this frame before the depth and scene passes read
+ * them. The instance bounds and the BVH are updated first so that the queries
+ * could use them. With culling, only the instances visible from the camera or
+ * the light are uploaded, and only the changed ones are sent again while the
+ * visible instances stay the same. Without culling, only the instances changed
+ * since the last frame are uploaded. The point lights are assigned to the
+ * light clusters by another thread at the same time.
+ */
+void shader::SceneShader::UpdateVisibleInstances() {
+  std::future<void> light_clusters_job =
+      std::async(std::launch::async, [this]() { AssignLightClusters(); });
+  UpdateBvh();
+  if (use_culling_) {
+    CullInstances();
+  } else {
+    culling_stats_ = CullingStats{0, 0, 0, 0, 0};
+    ResetMaterialLodStats();
+    StreamInstancing();
+  }
+  light_clusters_job.get();
+  UploadLightClusters();
+}
 
-    // Check whether the scene model isn't visible
-    if (!scene_model.IsVisible()) {
-      continue;
+void shader::SceneShader::Draw() {
+  // Get managers
+  as::RingBufferManager &ring_buffer_manager =
+      gl_managers_->GetRingBufferManager();
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
+  // Get names
+  const std::string ring_buffer_name = GetUniformRingBufferName();
+
+  // Update the shadow cascades of this frame
+  UpdateCascadedShadows();
+  // Bind the lights assigned to the clusters
+  BindLightClusterBuffers();
+
+  // Start writing the per-draw data of this frame
+  ring_buffer_manager.StartRingBufferFrame(ring_buffer_name);
+  num_draw_calls_ = 0;
+  // Read the queries issued two frames ago
+  const int query_idx = fragment_query_frame_idx_ % 2;
+  ReadFragmentQueries(query_idx);
+  fragment_query_frame_idx_++;
+
+  // Fill the depths first, so that the scene pass only shades the nearest
+  // fragments of the pre-passed meshes
+  if (use_depth_prepass_) {
+    if (fragment_stats_.is_supported) {
+      const GLuint query_hdlr = prepass_query_hdlrs_[query_idx];
+      trace_manager.RecordCall(
+          "glBeginQuery", {GL_FRAGMENT_SHADER_INVOCATIONS_ARB, query_hdlr}, 0,
+          [&] {
+            glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, query_hdlr);
+          });
+    }
+    DrawDepthPrepass();
+    if (fragment_stats_.is_supported) {
+      trace_manager.RecordCall(
+          "glEndQuery", {GL_FRAGMENT_SHADER_INVOCATIONS_ARB}, 0,
+          [&] { glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB); });
     }
+  }
 
-    // Update states
-    UpdateModelTrans(scene_model);
-    UpdateLighting(scene_model);
-    UpdateModelMaterial(scene_model);
-    // Draw the model
-    DrawModel(scene_model);
+  if (fragment_stats_.is_supported) {
+    const GLuint query_hdlr = scene_query_hdlrs_[query_idx];
+    trace_manager.RecordCall(
+        "glBeginQuery", {GL_FRAGMENT_SHADER_INVOCATIONS_ARB, query_hdlr}, 0,
+        [&] { glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, query_hdlr); });
+  }
+  if (use_indirect_drawing_) {
+    DrawIndirect();
+  } else {
+    // Record, sort and submit the draw commands, each of which uses its own
+    // program
+    RecordDrawCmds();
+    draw_list_.Sort();
+    SubmitDrawCmds();
   }
+  if (fragment_stats_.is_supported) {
+    trace_manager.RecordCall(
+        "glEndQuery", {GL_FRAGMENT_SHADER_INVOCATIONS_ARB}, 0,
+        [&] { glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB); });
+    has_fragment_queries_[query_idx] = true;
+    was_prepassed_[query_idx] = use_depth_prepass_;
+  }
+  // Restore the default depth test
+  UseSceneDepthTest(false);
+
+  // Guard the per-draw data until the GPU has finished reading it
+  ring_buffer_manager.FinishRingBufferFrame(ring_buffer_name);
 }
 
 /*******************************************************************************
@@ -139,32 +259,67 @@ glm::mat4 shader::SceneShader::GetLightProjection() const {
   return glm::ortho(-30.0f, 30.0f, -30.0f, 30.0f, 1e-3f, 1e3f);
 }
 
+const std::vector<shader::SceneShader::MaterialTier>
+    &shader::SceneShader::GetMaterialTiers() const {
+  return material_tiers_;
+}
+
+/*
+ * Only checks the vertices of the instances near the position. Each vertex is
+ * inside the bounds of its instance, so the nearest vertex is not farther than
+ * the farthest corner of any bounds, and the instances whose bounds are
+ * farther than it are skipped by the BVH.
+ */
 float shader::SceneShader::GetMinDistanceToModel(
     const glm::vec3 &pos, const std::string &scene_model_name) const {
   const dto::SceneModel &scene_model = scene_models_.at(scene_model_name);
   const as::Model &model = scene_model.GetModel();
   const std::vector<as::Mesh> &meshes = model.GetMeshes();
 
-  // Get model global transformations
-  const glm::mat4 model_trans = scene_model.GetTrans();
-
   float min_dist = std::numeric_limits<float>::max();
 
-  // Check each mesh
-  for (size_t mesh_idx = 0; mesh_idx < meshes.size(); mesh_idx++) {
-    const as::Mesh &mesh = meshes.at(mesh_idx);
-    const std::vector<as::Vertex> &vertices = mesh.GetVertices();
+  // The bounds are calculated when the instances are updated
+  if (instance_bounds_.count(scene_model_name) == 0 ||
+      bvh_item_ofses_.count(scene_model_name) == 0) {
+    return min_dist;
+  }
+  const InstanceBounds &instance_bounds = instance_bounds_.at(scene_model_name);
+  const as::AabbBatch &aabb_batch = instance_bounds.aabb_batch;
+  const size_t item_ofs = bvh_item_ofses_.at(scene_model_name);
+  const size_t num_instancing = instance_bounds.instance_transforms.size();
+
+  // Find the nearest farthest corner of the bounds
+  float max_dist = std::numeric_limits<float>::max();
+  for (size_t instance_idx = 0; instance_idx < num_instancing;
+       instance_idx++) {
+    const glm::vec3 farthest_diff =
+        glm::abs(aabb_batch.GetCenter(instance_idx) - pos) +
+        aabb_batch.GetExtent(instance_idx);
+    max_dist = glm::min(max_dist, glm::length(farthest_diff));
+  }
+
+  // Find the instances near the position
+  std::vector<size_t> item_idxs;
+  bvh_.QuerySphere(pos, max_dist, item_idxs);
+
+  // Check each instance
+  for (const size_t item_idx : item_idxs) {
+    if (item_idx < item_ofs || item_idx >= item_ofs + num_instancing) {
+      continue;
+    }
+    const glm::mat4 &instance_transform =
+        instance_bounds.instance_transforms[item_idx - item_ofs];
 
-    // Check each vertex
-    for (size_t vertex_idx = 0; vertex_idx < vertices.size(); vertex_idx++) {
-      const as::Vertex &vertex = vertices[vertex_idx];
+    // Check each mesh
+    for (size_t mesh_idx = 0; mesh_idx < meshes.size(); mesh_idx++) {
+      const as::Mesh &mesh = meshes.at(mesh_idx);
+      const std::vector<as::Vertex> &vertices = mesh.GetVertices();
 
-      // Check each instancing transformations
-      const std::vector<glm::mat4> instancing_transforms =
-          scene_model.GetInstancingTransforms();
-      for (const glm::mat4 &instancing_transform : instancing_transforms) {
+      // Check each vertex
+      for (size_t vertex_idx = 0; vertex_idx < vertices.size(); vertex_idx++) {
+        const as::Vertex &vertex = vertices[vertex_idx];
         const glm::vec4 trans_pos =
-            model_trans * instancing_transform * glm::vec4(vertex.pos, 1.0f);
+            instance_transform * glm::vec4(vertex.pos, 1.0f);
 
         min_dist = glm::min(min_dist, glm::distance(pos, glm::vec3(trans_pos)));
       }
@@ -174,6 +329,258 @@ float shader::SceneShader::GetMinDistanceToModel(
   return min_dist;
 }
 
+/*
+ * Finds the nearest instance whose bounds are hit by the ray. The invisible
+ * models and the instances which aren't drawn are skipped.
+ */
+bool shader::SceneShader::CastRay(const glm::vec3 &origin,
+                                  const glm::vec3 &dir, const float max_dist,
+                                  std::string &scene_model_name,
+                                  size_t &instance_idx, float &dist) const {
+  // Skip the instances which aren't drawn from the camera
+  const auto filter_func = [&](const size_t item_idx) {
+    std::string item_scene_model_name;
+    size_t item_instance_idx;
+    if (!FindBvhItem(item_idx, item_scene_model_name, item_instance_idx)) {
+      return false;
+    }
+    const dto::SceneModel &scene_model =
+        scene_models_.at(item_scene_model_name);
+    return scene_model.IsVisible() &&
+           (use_instantiating_ || item_instance_idx == 0);
+  };
+  // Find the nearest instance
+  as::Bvh::RayHit ray_hit;
+  bvh_.QueryRay(origin, dir, max_dist, ray_hit, filter_func);
+  if (!ray_hit.is_hit) {
+    return false;
+  }
+  dist = ray_hit.dist;
+  return FindBvhItem(ray_hit.item_idx, scene_model_name, instance_idx);
+}
+
+/*******************************************************************************
+ * Shadow Caster Getters
+ ******************************************************************************/
+
+/*
+ * The model is a dynamic caster until it stays still for several frames, so
+ * that a model moved by the editing keys doesn't invalidate the cached shadow
+ * map in every frame
+ */
+bool shader::SceneShader::IsShadowCaster(
+    const std::string &scene_model_name) const {
+  return std::find(kReceiverOnlySceneModelNames.begin(),
+                   kReceiverOnlySceneModelNames.end(),
+                   scene_model_name) == kReceiverOnlySceneModelNames.end();
+}
+
+bool shader::SceneShader::IsDynamicCaster(
+    const std::string &scene_model_name) const {
+  return num_still_frames_.count(scene_model_name) > 0 &&
+         num_still_frames_.at(scene_model_name) < kNumStaticCasterFrames;
+}
+
+bool shader::SceneShader::HasDynamicCasters() const {
+  for (const auto &pair : num_still_frames_) {
+    if (IsDynamicCaster(pair.first)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * The version changes whenever a static caster moves or a caster changes
+ * between static and dynamic
+ */
+unsigned int shader::SceneShader::GetStaticCastersVersion() const {
+  return static_casters_version_;
+}
+
+/*******************************************************************************
+ * Statistics Getters
+ ******************************************************************************/
+
+const as::DrawList &shader::SceneShader::GetDrawList() const {
+  return draw_list_;
+}
+
+unsigned int shader::SceneShader::GetNumDrawCalls() const {
+  return num_draw_calls_;
+}
+
+size_t shader::SceneShader::GetNumPermutationPrograms() const {
+  return ready_permutation_masks_.size();
+}
+
+shader::SceneShader::InstancingStats shader::SceneShader::GetInstancingStats()
+    const {
+  return instancing_stats_;
+}
+
+shader::SceneShader::CullingStats shader::SceneShader::GetCullingStats() const {
+  return culling_stats_;
+}
+
+shader::SceneShader::BatchingStats shader::SceneShader::GetBatchingStats()
+    const {
+  return batching_stats_;
+}
+
+shader::SceneShader::FragmentStats shader::SceneShader::GetFragmentStats()
+    const {
+  return fragment_stats_;
+}
+
+shader::SceneShader::LightClusterStats
+shader::SceneShader::GetLightClusterStats() const {
+  return light_cluster_stats_;
+}
+
+shader::SceneShader::MaterialLodStats shader::SceneShader::GetMaterialLodStats()
+    const {
+  return material_lod_stats_;
+}
+
+const as::Bvh &shader::SceneShader::GetInstanceBvh() const { return bvh_; }
+
+const as::OcclusionBuffer &shader::SceneShader::GetOcclusionBuffer() const {
+  return occlusion_buffer_;
+}
+
+/*******************************************************************************
+ * Benchmarks
+ ******************************************************************************/
+
+/*
+ * Draws the meshes of the models several times with the rasterizer discarded,
+ * so that the GPU time is spent on the vertices. The instances visible from
+ * the camera are drawn, which are all instances when the culling is disabled.
+ * Returns the GPU seconds of each iteration, and the number of submitted
+ * vertices of each iteration.
+ */
+double shader::SceneShader::BenchmarkVertexThroughput(
+    const std::vector<std::string> &scene_model_names,
+    const int num_iterations, GLuint64 &num_vertices) {
+  // Get managers
+  const as::ProgramManager &program_manager =
+      gl_managers_->GetProgramManager();
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
+  // Use the uber program
+  program_manager.UseProgram(GetProgramName());
+
+  GLuint query_hdlr = 0;
+  trace_manager.RecordCall("glGenQueries", {1}, 0,
+                           [&] { glGenQueries(1, &query_hdlr); });
+  trace_manager.RecordCall("glEnable", {GL_RASTERIZER_DISCARD}, 0,
+                           [&] { glEnable(GL_RASTERIZER_DISCARD); });
+  trace_manager.RecordCall("glBeginQuery", {GL_TIME_ELAPSED, query_hdlr}, 0,
+                           [&] { glBeginQuery(GL_TIME_ELAPSED, query_hdlr); });
+  num_vertices = 0;
+  for (int iter = 0; iter < num_iterations; iter++) {
+    for (size_t info_idx = 0; info_idx < mesh_draw_infos_.size(); info_idx++) {
+      const MeshDrawInfo &mesh_draw_info = mesh_draw_infos_.at(info_idx);
+      if (std::find(scene_model_names.begin(), scene_model_names.end(),
+                    mesh_draw_info.scene_model_name) ==
+          scene_model_names.end()) {
+        continue;
+      }
+      const dto::SceneModel &scene_model =
+          scene_models_.at(mesh_draw_info.scene_model_name);
+      const VisibleRange visible_range =
+          GetVisibleRange(CullingViews::kCamera, info_idx);
+      // Draw the visible instances of the mesh
+      UseMesh(scene_model.GetVertexArrayGroupName(), mesh_draw_info.mesh_idx);
+      const GLsizei num_instances =
+          static_cast<GLsizei>(visible_range.num_instances);
+      trace_manager.RecordCall(
+          "glDrawElementsInstancedBaseInstance",
+          {GL_TRIANGLES, mesh_draw_info.num_idxs, num_instances,
+           visible_range.base_instance},
+          0, [&] {
+            glDrawElementsInstancedBaseInstance(
+                GL_TRIANGLES, mesh_draw_info.num_idxs, GL_UNSIGNED_INT,
+                nullptr, num_instances, visible_range.base_instance);
+          });
+      if (iter == 0) {
+        num_vertices += static_cast<GLuint64>(mesh_draw_info.num_idxs) *
+                        visible_range.num_instances;
+      }
+    }
+  }
+  trace_manager.RecordCall("glEndQuery", {GL_TIME_ELAPSED}, 0,
+                           [&] { glEndQuery(GL_TIME_ELAPSED); });
+  trace_manager.RecordCall("glDisable", {GL_RASTERIZER_DISCARD}, 0,
+                           [&] { glDisable(GL_RASTERIZER_DISCARD); });
+
+  // Wait for the GPU to finish
+  GLuint64 elapsed_ns = 0;
+  trace_manager.RecordCall(
+      "glGetQueryObjectui64v", {query_hdlr, GL_QUERY_RESULT}, 0, [&] {
+        glGetQueryObjectui64v(query_hdlr, GL_QUERY_RESULT, &elapsed_ns);
+      });
+  trace_manager.RecordCall("glDeleteQueries", {1, query_hdlr}, 0,
+                           [&] { glDeleteQueries(1, &query_hdlr); });
+  return 1e-9 * static_cast<double>(elapsed_ns) / num_iterations;
+}
+
+/*******************************************************************************
+ * Visibility Getters
+ ******************************************************************************/
+
+shader::SceneShader::VisibleRange shader::SceneShader::GetVisibleRange(
+    const CullingViews view, const size_t mesh_draw_info_idx) const {
+  // The light has the visible ranges of each cascade
+  if (view != CullingViews::kCamera) {
+    throw std::runtime_error("Unknown culling view");
+  }
+  if (use_culling_) {
+    return camera_visible_ranges_.at(mesh_draw_info_idx);
+  }
+  // Draw all instances, the camera only draws the first instance without
+  // instantiating
+  const MeshDrawInfo &mesh_draw_info = mesh_draw_infos_.at(mesh_draw_info_idx);
+  const dto::SceneModel &scene_model =
+      scene_models_.at(mesh_draw_info.scene_model_name);
+  const GLuint num_instances =
+      use_instantiating_ ? static_cast<GLuint>(scene_model.GetNumInstancing())
+                         : 1;
+  return VisibleRange{0, num_instances};
+}
+
+shader::SceneShader::VisibleRange shader::SceneShader::GetCascadeVisibleRange(
+    const int cascade_idx, const size_t mesh_draw_info_idx) const {
+  if (use_culling_) {
+    return cascade_visible_ranges_.at(cascade_idx).at(mesh_draw_info_idx);
+  }
+  // Draw all instances of the shadow casters
+  const MeshDrawInfo &mesh_draw_info = mesh_draw_infos_.at(mesh_draw_info_idx);
+  if (!IsShadowCaster(mesh_draw_info.scene_model_name)) {
+    return VisibleRange{0, 0};
+  }
+  const dto::SceneModel &scene_model =
+      scene_models_.at(mesh_draw_info.scene_model_name);
+  return VisibleRange{0, static_cast<GLuint>(scene_model.GetNumInstancing())};
+}
+
+/*
+ * The camera instances of each mesh are grouped by the material tiers, so the
+ * ranges of the tiers split the camera visible range
+ */
+shader::SceneShader::VisibleRange shader::SceneShader::GetMaterialTierRange(
+    const GLuint material_tier_idx, const size_t mesh_draw_info_idx) const {
+  if (use_culling_) {
+    return camera_tier_ranges_.at(material_tier_idx).at(mesh_draw_info_idx);
+  }
+  // The tiers are selected while culling, so all instances use the full
+  // material
+  if (material_tier_idx == 0) {
+    return GetVisibleRange(CullingViews::kCamera, mesh_draw_info_idx);
+  }
+  return VisibleRange{0, 0};
+}
+
 /*******************************************************************************
  * State Updaters
  ******************************************************************************/
@@ -196,53 +603,97 @@ void shader::SceneShader::UpdateSceneModelTrans(const float add_rotation) {
 }
 
 void shader::SceneShader::UpdateViewPos(const glm::vec3 &view_pos) {
-  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
-  // Update lighting
+  // The buffer will be updated in the draw method
   lighting_.view_pos = view_pos;
-  // Update the buffer
-  const std::string buffer_name = GetLightingBufferName();
-  buffer_manager.UpdateBuffer(buffer_name);
 }
 
-void shader::SceneShader::UpdateSceneModel(const dto::SceneModel &scene_model) {
-  // Get managers
-  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
-  // Get names
-  const std::string translations_buffer_name =
-      GetInstancingTranslationsBufferName(scene_model);
-  const std::string rotations_buffer_name =
-      GetInstancingRotationsBufferName(scene_model);
-  const std::string scalings_buffer_name =
-      GetInstancingScalingsBufferName(scene_model);
-  // Get instancing transformations
-  // TODO: Should use a DTO class
-  const std::vector<glm::vec3> instancing_translations =
-      scene_model.GetInstancingTranslations();
-  const std::vector<glm::vec3> instancing_rotations =
-      scene_model.GetInstancingRotations();
-  const std::vector<glm::vec3> instancing_scalings =
-      scene_model.GetInstancingScalings();
-  // Get memory sizes
-  const size_t instancing_mem_size = scene_model.GetInstancingMemSize();
-
-  /* Update buffers */
-  buffer_manager.UpdateBuffer(translations_buffer_name, GL_ARRAY_BUFFER, 0,
-                              instancing_mem_size,
-                              instancing_translations.data());
-  buffer_manager.UpdateBuffer(rotations_buffer_name, GL_ARRAY_BUFFER, 0,
-                              instancing_mem_size, instancing_rotations.data());
-  buffer_manager.UpdateBuffer(scalings_buffer_name, GL_ARRAY_BUFFER, 0,
-                              instancing_mem_size, instancing_scalings.data());
+void shader::SceneShader::UpdatePointLights(
+    const std::vector<as::LightClusters::PointLight> &point_lights) {
+  // The lights will be assigned when updating the visible instances
+  point_lights_ = point_lights;
 }
 
-void shader::SceneShader::TogglePcf(const bool toggle) {
-  model_material_.use_pcf = toggle;
+/*
+ * The tiers should be ordered from the nearest, and the farther tiers should
+ * have larger distances and smaller screen sizes
+ */
+void shader::SceneShader::SetMaterialTiers(
+    const std::vector<MaterialTier> &material_tiers) {
+  if (material_tiers.size() >= static_cast<size_t>(kMaxNumMaterialTiers)) {
+    throw std::runtime_error("Too many material tiers '" +
+                             std::to_string(material_tiers.size()) + "'");
+  }
+  for (size_t tier_idx = 0; tier_idx < material_tiers.size(); tier_idx++) {
+    const MaterialTier &material_tier = material_tiers[tier_idx];
+    const bool is_ordered =
+        tier_idx == 0 ||
+        (material_tier.min_distance >=
+             material_tiers[tier_idx - 1].min_distance &&
+         material_tier.max_screen_size <=
+             material_tiers[tier_idx - 1].max_screen_size);
+    if (material_tier.min_distance < 0.0f ||
+        material_tier.parallax_layers_scale < 0.0f ||
+        material_tier.parallax_layers_scale > 1.0f || !is_ordered) {
+      throw std::runtime_error("Invalid material tier '" +
+                               std::to_string(tier_idx) + "'");
+    }
+  }
+  material_tiers_ = material_tiers;
 }
 
+void shader::SceneShader::TogglePcf(const bool toggle) { use_pcf_ = toggle; }
+
 void shader::SceneShader::ToggleInstantiating(const bool toggle) {
   use_instantiating_ = toggle;
 }
 
+void shader::SceneShader::ToggleIndirectDrawing(const bool toggle) {
+  use_indirect_drawing_ = toggle;
+}
+
+void shader::SceneShader::ToggleCulling(const bool toggle) {
+  if (toggle == use_culling_) {
+    return;
+  }
+  use_culling_ = toggle;
+  if (!use_culling_) {
+    // The buffers only contain the visible instances, so all instances are
+    // uploaded again
+    for (const auto &pair : scene_models_) {
+      UploadSceneModelInstancing(pair.first);
+    }
+    UpdateIndirectInstancing();
+  }
+}
+
+/*
+ * Loads a second oil tank which shares the meshes with the first one, so that
+ * the mesh batching could be measured. It only takes effect before Init.
+ */
+void shader::SceneShader::ToggleDuplicateModels(const bool toggle) {
+  use_duplicate_models_ = toggle;
+}
+
+void shader::SceneShader::ToggleOcclusionCulling(const bool toggle) {
+  use_occlusion_culling_ = toggle;
+}
+
+void shader::SceneShader::ToggleMeshBatching(const bool toggle) {
+  use_mesh_batching_ = toggle;
+}
+
+void shader::SceneShader::ToggleDepthPrepass(const bool toggle) {
+  use_depth_prepass_ = toggle;
+}
+
+void shader::SceneShader::ToggleMaterialLod(const bool toggle) {
+  use_material_lod_ = toggle;
+}
+
+void shader::SceneShader::TogglePermutations(const bool toggle) {
+  use_permutations_ = toggle;
+}
+
 void shader::SceneShader::ToggleNormalHeight(const bool toggle) {
   use_normal_height_ = toggle;
   model_material_.use_normal = toggle;
@@ -270,6 +721,10 @@ std::string shader::SceneShader::GetGlobalTransUniformBlockName() const {
   return "GlobalTrans";
 }
 
+std::string shader::SceneShader::GetUniformRingBufferName() const {
+  return GetProgramName() + "/buffer/uniform_ring";
+}
+
 /*******************************************************************************
  * GL Initializations (Protected)
  ******************************************************************************/
@@ -280,10 +735,6 @@ GLsizei shader::SceneShader::GetNumMipmapLevels() const { return 5; }
  * Name Management (Protected)
  ******************************************************************************/
 
-std::string shader::SceneShader::GetModelTransBufferName() const {
-  return GetProgramName() + "model_trans";
-}
-
 std::string shader::SceneShader::GetModelMaterialBufferName() const {
   return GetProgramName() + "model_material";
 }
@@ -292,29 +743,108 @@ std::string shader::SceneShader::GetLightingBufferName() const {
   return GetProgramName() + "lighting";
 }
 
-std::string shader::SceneShader::GetInstancingTranslationsBufferName(
-    const dto::SceneModel &scene_model) const {
-  return "buffer/instancing/translations/" + scene_model.GetId();
+std::string shader::SceneShader::GetCascadedShadowsBufferName() const {
+  return GetProgramName() + "cascaded_shadows";
+}
+
+std::string shader::SceneShader::GetLightClustersBufferName() const {
+  return GetProgramName() + "light_clusters";
+}
+
+std::string shader::SceneShader::GetPointLightsBufferName() const {
+  return GetProgramName() + "/buffer/light_clusters/point_lights";
+}
+
+std::string shader::SceneShader::GetClusterRangesBufferName() const {
+  return GetProgramName() + "/buffer/light_clusters/ranges";
+}
+
+std::string shader::SceneShader::GetClusterLightIdxsBufferName() const {
+  return GetProgramName() + "/buffer/light_clusters/light_idxs";
+}
+
+std::string shader::SceneShader::GetIndirectProgramName() const {
+  return GetProgramName() + "/indirect";
+}
+
+std::string shader::SceneShader::GetPermutationProgramName(
+    const GLuint permutation_mask) const {
+  return GetProgramName() + "/permutation/" + std::to_string(permutation_mask);
+}
+
+std::string shader::SceneShader::GetPermutationFragmentShaderName(
+    const GLuint permutation_mask) const {
+  return GetShaderPath(ShaderTypes::kFragment) + "#" +
+         std::to_string(permutation_mask);
+}
+
+std::string shader::SceneShader::GetIndirectVertexShaderPath() const {
+  const fs::path path("assets/shaders");
+  return (path / (GetId() + "_indirect.vert")).string();
+}
+
+std::string shader::SceneShader::GetPrepassProgramName() const {
+  return GetProgramName() + "/prepass";
+}
+
+std::string shader::SceneShader::GetPrepassVertexShaderPath() const {
+  const fs::path path("assets/shaders");
+  return (path / (GetId() + "_prepass.vert")).string();
+}
+
+std::string shader::SceneShader::GetPrepassFragmentShaderPath() const {
+  const fs::path path("assets/shaders");
+  return (path / (GetId() + "_prepass.frag")).string();
 }
 
-std::string shader::SceneShader::GetInstancingRotationsBufferName(
+std::string shader::SceneShader::GetPrepassVertexArrayName(
     const dto::SceneModel &scene_model) const {
-  return "buffer/instancing/rotations/" + scene_model.GetId();
+  return GetProgramName() + "/vertex_array/prepass/" + scene_model.GetId();
+}
+
+std::string shader::SceneShader::GetPrepassPositionsBufferName() const {
+  return GetProgramName() + "/buffer/prepass/positions";
+}
+
+std::string shader::SceneShader::GetIndirectVertexArrayName() const {
+  return GetProgramName() + "/vertex_array/indirect";
+}
+
+std::string shader::SceneShader::GetIndirectVerticesBufferName() const {
+  return GetProgramName() + "/buffer/indirect/vertices";
+}
+
+std::string shader::SceneShader::GetIndirectIdxsBufferName() const {
+  return GetProgramName() + "/buffer/indirect/idxs";
+}
+
+std::string shader::SceneShader::GetIndirectInstancingMatricesBufferName()
+    const {
+  return GetProgramName() + "/buffer/indirect/instancing/matrices";
+}
+
+std::string shader::SceneShader::GetIndirectInstancingModelIdxsBufferName()
+    const {
+  return GetProgramName() + "/buffer/indirect/instancing/model_idxs";
+}
+
+std::string shader::SceneShader::GetIndirectModelParamsBufferName() const {
+  return GetProgramName() + "/buffer/indirect/model_params";
+}
+
+std::string shader::SceneShader::GetIndirectCmdsBufferName() const {
+  return GetProgramName() + "/buffer/indirect/cmds";
 }
 
-std::string shader::SceneShader::GetInstancingScalingsBufferName(
+std::string shader::SceneShader::GetInstancingMatricesBufferName(
     const dto::SceneModel &scene_model) const {
-  return "buffer/instancing/scalings/" + scene_model.GetId();
+  return "buffer/instancing/matrices/" + scene_model.GetId();
 }
 
 std::string shader::SceneShader::GetSkyboxTextureUnitName() const {
   return GetProgramName() + "/skybox";
 }
 
-std::string shader::SceneShader::GetModelTransUniformBlockName() const {
-  return "ModelTrans";
-}
-
 std::string shader::SceneShader::GetModelMaterialUniformBlockName() const {
   return "ModelMaterial";
 }
@@ -323,6 +853,14 @@ std::string shader::SceneShader::GetLightingUniformBlockName() const {
   return "Lighting";
 }
 
+std::string shader::SceneShader::GetCascadedShadowsUniformBlockName() const {
+  return "CascadedShadows";
+}
+
+std::string shader::SceneShader::GetLightClustersUniformBlockName() const {
+  return "LightClusters";
+}
+
 /*******************************************************************************
  * Model Initialization (Private)
  ******************************************************************************/
@@ -357,6 +895,12 @@ void shader::SceneShader::LoadModels() {
   scene_models_["oil_tank"] =
       dto::SceneModel("oil_tank", "assets/models/oil_tank/big_cistern.obj",
                       flags, "oil_tank", 3, gl_managers_);
+  // Another oil tank which shares the meshes with the first one
+  if (use_duplicate_models_) {
+    scene_models_["oil_tank_2"] =
+        dto::SceneModel("oil_tank_2", "assets/models/oil_tank/big_cistern.obj",
+                        flags, "oil_tank", 3, gl_managers_);
+  }
   // Electric tower
   scene_models_["tower"] =
       dto::SceneModel("tower", "assets/models/tower/tower.obj", flags, "tower",
@@ -408,6 +952,18 @@ void shader::SceneShader::InitModels() {
   scene_models_.at("oil_tank").SetLightColor(glm::vec3(1.0f));
   scene_models_.at("oil_tank").SetLightIntensity(glm::vec3(0.5f, 0.5f, 0.5f));
   scene_models_.at("oil_tank").SetUseEnvMap(false);
+  // Another oil tank
+  if (use_duplicate_models_) {
+    scene_models_.at("oil_tank_2")
+        .SetTranslation(glm::vec3(12.2f, 0.8f, 16.6f));
+    scene_models_.at("oil_tank_2").SetRotation(glm::vec3(0.0f, 1.2f, 0.0f));
+    scene_models_.at("oil_tank_2").SetScaling(2e-4f * glm::vec3(1.0f));
+    scene_models_.at("oil_tank_2").SetLightPos(GetLightPos());
+    scene_models_.at("oil_tank_2").SetLightColor(glm::vec3(1.0f));
+    scene_models_.at("oil_tank_2")
+        .SetLightIntensity(glm::vec3(0.5f, 0.5f, 0.5f));
+    scene_models_.at("oil_tank_2").SetUseEnvMap(false);
+  }
   // Electric tower
   scene_models_.at("tower").SetTranslation(glm::vec3(13.6f, 1.8f, -3.8f));
   scene_models_.at("tower").SetRotation(glm::vec3(0.0f, 0.0f, 0.0f));
@@ -452,6 +1008,27 @@ void shader::SceneShader::InitModels() {
       glm::vec3(-0.25f, -1.29f, 0.04f)});
 }
 
+/*
+ * Copies the positions and indices of the occluders once, so that they could
+ * be rasterized in each frame without copying the model data
+ */
+void shader::SceneShader::InitOccluderMeshes() {
+  for (const std::string &scene_model_name : kOccluderSceneModelNames) {
+    const dto::SceneModel &scene_model = scene_models_.at(scene_model_name);
+    const std::vector<as::Mesh> &meshes = scene_model.GetModel().GetMeshes();
+    std::vector<OccluderMesh> &occluder_meshes =
+        occluder_meshes_[scene_model_name];
+    for (const as::Mesh &mesh : meshes) {
+      OccluderMesh occluder_mesh;
+      for (const as::Vertex &vertex : mesh.GetVertices()) {
+        occluder_mesh.poses.push_back(vertex.pos);
+      }
+      occluder_mesh.idxs = mesh.GetIdxs();
+      occluder_meshes.push_back(occluder_mesh);
+    }
+  }
+}
+
 /*******************************************************************************
  * GL Initialization (Private)
  ******************************************************************************/
@@ -467,159 +1044,785 @@ void shader::SceneShader::InitVertexArrays() {
 void shader::SceneShader::InitInstancingVertexArrays() {
   // Get managers
   as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
-  as::VertexSpecManager &vertex_spec_manager =
-      gl_managers_->GetVertexSpecManager();
 
-  for (const auto &pair : scene_models_) {
-    const dto::SceneModel &scene_model = pair.second;
+  for (auto &pair : scene_models_) {
+    dto::SceneModel &scene_model = pair.second;
 
     // Get model
     const as::Model &model = scene_model.GetModel();
     // Get meshes
     const std::vector<as::Mesh> &meshes = model.GetMeshes();
-    // Get instancing transformations
-    // TODO: Should use a DTO class
-    const std::vector<glm::vec3> instancing_translations =
-        scene_model.GetInstancingTranslations();
-    const std::vector<glm::vec3> instancing_rotations =
-        scene_model.GetInstancingRotations();
-    const std::vector<glm::vec3> instancing_scalings =
-        scene_model.GetInstancingScalings();
+    // Get instance matrices
+    scene_model.BakeInstanceMatrices();
+    const std::vector<dto::SceneModel::InstanceMatrices> &instance_matrices =
+        scene_model.GetInstanceMatrices();
     // Get memory sizes
     const size_t instancing_mem_size = scene_model.GetInstancingMemSize();
     // Get names
     const std::string group_name = scene_model.GetVertexArrayGroupName();
-    const std::string translations_buffer_name =
-        GetInstancingTranslationsBufferName(scene_model);
-    const std::string rotations_buffer_name =
-        GetInstancingRotationsBufferName(scene_model);
-    const std::string scalings_buffer_name =
-        GetInstancingScalingsBufferName(scene_model);
+    const std::string matrices_buffer_name =
+        GetInstancingMatricesBufferName(scene_model);
 
     /* Generate buffers */
-    buffer_manager.GenBuffer(translations_buffer_name);
-    buffer_manager.GenBuffer(rotations_buffer_name);
-    buffer_manager.GenBuffer(scalings_buffer_name);
+    buffer_manager.GenBuffer(matrices_buffer_name);
 
     /* Initialize buffers */
-    buffer_manager.InitBuffer(translations_buffer_name, GL_ARRAY_BUFFER,
-                              instancing_mem_size, nullptr, GL_STATIC_DRAW);
-    buffer_manager.InitBuffer(rotations_buffer_name, GL_ARRAY_BUFFER,
-                              instancing_mem_size, nullptr, GL_STATIC_DRAW);
-    buffer_manager.InitBuffer(scalings_buffer_name, GL_ARRAY_BUFFER,
-                              instancing_mem_size, nullptr, GL_STATIC_DRAW);
+    buffer_manager.InitBuffer(matrices_buffer_name, GL_ARRAY_BUFFER,
+                              instancing_mem_size, nullptr, GL_DYNAMIC_DRAW);
 
     /* Update buffers */
-    buffer_manager.UpdateBuffer(translations_buffer_name, GL_ARRAY_BUFFER, 0,
-                                instancing_mem_size,
-                                instancing_translations.data());
-    buffer_manager.UpdateBuffer(rotations_buffer_name, GL_ARRAY_BUFFER, 0,
-                                instancing_mem_size,
-                                instancing_rotations.data());
-    buffer_manager.UpdateBuffer(scalings_buffer_name, GL_ARRAY_BUFFER, 0,
-                                instancing_mem_size,
-                                instancing_scalings.data());
+    buffer_manager.UpdateBuffer(matrices_buffer_name, GL_ARRAY_BUFFER, 0,
+                                instancing_mem_size, instance_matrices.data());
 
     // Apply to all meshes
     for (size_t mesh_idx = 0; mesh_idx < meshes.size(); mesh_idx++) {
       const std::string va_name = GetMeshVertexArrayName(group_name, mesh_idx);
+      SpecifyInstanceMatrices(va_name, matrices_buffer_name);
+    }
 
-      /* Bind vertex arrays to buffers */
-      vertex_spec_manager.SpecifyVertexArrayOrg(va_name, 4, 3, GL_FLOAT,
-                                                GL_FALSE, 0);
-      vertex_spec_manager.SpecifyVertexArrayOrg(va_name, 5, 3, GL_FLOAT,
-                                                GL_FALSE, 0);
-      vertex_spec_manager.SpecifyVertexArrayOrg(va_name, 6, 3, GL_FLOAT,
-                                                GL_FALSE, 0);
-
-      vertex_spec_manager.AssocVertexAttribToBindingPoint(va_name, 4, 4);
-      vertex_spec_manager.AssocVertexAttribToBindingPoint(va_name, 5, 5);
-      vertex_spec_manager.AssocVertexAttribToBindingPoint(va_name, 6, 6);
+    // All instances have been uploaded
+    scene_model.ClearDirtyInstances();
+  }
+}
 
-      vertex_spec_manager.BindBufferToBindingPoint(
-          va_name, translations_buffer_name, 4, 0, sizeof(glm::vec3));
-      vertex_spec_manager.BindBufferToBindingPoint(
-          va_name, rotations_buffer_name, 5, 0, sizeof(glm::vec3));
-      vertex_spec_manager.BindBufferToBindingPoint(
-          va_name, scalings_buffer_name, 6, 0, sizeof(glm::vec3));
+/*
+ * Records the static draw information of every mesh so that the draw commands
+ * could be recorded without touching the model data in each frame
+ */
+void shader::SceneShader::InitMeshDrawInfos() {
+  // Material indexes which are identified by the texture sets and the colors
+  std::map<std::tuple<std::set<as::Texture>, std::vector<float>>, GLuint>
+      material_idxs;
+  // First meshes of the shared meshes which are identified by the geometry
+  // hashes and the material indexes
+  std::map<std::tuple<uint64_t, GLuint>, std::vector<size_t>> shared_info_idxs;
+
+  mesh_draw_infos_.clear();
+  for (const auto &pair : scene_models_) {
+    const dto::SceneModel &scene_model = pair.second;
+    // Get meshes
+    const std::vector<as::Mesh> &meshes = scene_model.GetModel().GetMeshes();
 
-      /* Modify vertex array updating rates */
-      glVertexAttribDivisor(4, 1);
-      glVertexAttribDivisor(5, 1);
-      glVertexAttribDivisor(6, 1);
+    for (size_t mesh_idx = 0; mesh_idx < meshes.size(); mesh_idx++) {
+      const as::Mesh &mesh = meshes.at(mesh_idx);
+      const std::vector<as::Vertex> vertices = mesh.GetVertices();
+      const as::Material material = mesh.GetMaterial();
+      const glm::vec4 ambient_color = material.GetAmbientColor();
+      const glm::vec4 diffuse_color = material.GetDiffuseColor();
+      const glm::vec4 specular_color = material.GetSpecularColor();
+      const std::vector<float> colors = {
+          ambient_color.r,  ambient_color.g,  ambient_color.b,
+          ambient_color.a,  diffuse_color.r,  diffuse_color.g,
+          diffuse_color.b,  diffuse_color.a,  specular_color.r,
+          specular_color.g, specular_color.b, specular_color.a,
+          material.GetShininess()};
+      const auto material_key = std::make_tuple(material.GetTextures(), colors);
+      // Assign the material index
+      if (material_idxs.count(material_key) == 0) {
+        const GLuint material_idx = static_cast<GLuint>(material_idxs.size());
+        material_idxs[material_key] = material_idx;
+      }
+      // Find the first mesh with the same geometry and material
+      const GLuint material_idx = material_idxs.at(material_key);
+      const std::vector<size_t> idxs = mesh.GetIdxs();
+      std::vector<size_t> &candidate_idxs = shared_info_idxs[std::make_tuple(
+          HashMeshGeometry(vertices, idxs), material_idx)];
+      size_t shared_info_idx = mesh_draw_infos_.size();
+      for (const size_t candidate_idx : candidate_idxs) {
+        if (HasSameGeometry(candidate_idx, vertices, idxs)) {
+          shared_info_idx = candidate_idx;
+          break;
+        }
+      }
+      if (shared_info_idx == mesh_draw_infos_.size()) {
+        candidate_idxs.push_back(shared_info_idx);
+      }
+      // Calculate the bounding box
+      glm::vec3 min_pos(std::numeric_limits<float>::max());
+      glm::vec3 max_pos(std::numeric_limits<float>::lowest());
+      for (const as::Vertex &vertex : vertices) {
+        min_pos = glm::min(min_pos, vertex.pos);
+        max_pos = glm::max(max_pos, vertex.pos);
+      }
+      // Save the draw information
+      MeshDrawInfo mesh_draw_info;
+      mesh_draw_info.scene_model_name = pair.first;
+      mesh_draw_info.mesh_idx = mesh_idx;
+      mesh_draw_info.va_idx = static_cast<GLuint>(mesh_draw_infos_.size());
+      mesh_draw_info.material_idx = material_idx;
+      mesh_draw_info.num_idxs = static_cast<GLsizei>(idxs.size());
+      mesh_draw_info.min_pos = min_pos;
+      mesh_draw_info.max_pos = max_pos;
+      mesh_draw_info.center = 0.5f * (min_pos + max_pos);
+      mesh_draw_info.material = material;
+      mesh_draw_info.shared_info_idx = shared_info_idx;
+      mesh_draw_info.use_depth_prepass =
+          !material.HasAmbientTexture() && ambient_color.a >= kMinPrepassAlpha;
+      mesh_draw_infos_.push_back(mesh_draw_info);
     }
   }
+  // Each mesh draws itself until the batches are updated
+  batched_info_idxs_.clear();
+  for (size_t info_idx = 0; info_idx < mesh_draw_infos_.size(); info_idx++) {
+    batched_info_idxs_.push_back(std::vector<size_t>{info_idx});
+  }
+  // Nothing is visible until the instances are culled
+  camera_visible_ranges_.assign(mesh_draw_infos_.size(), VisibleRange{0, 0});
+  cascade_visible_ranges_.assign(
+      as::ShadowCascades::kMaxNumCascades,
+      std::vector<VisibleRange>(mesh_draw_infos_.size(), VisibleRange{0, 0}));
+  camera_tier_ranges_.assign(
+      kMaxNumMaterialTiers,
+      std::vector<VisibleRange>(mesh_draw_infos_.size(), VisibleRange{0, 0}));
 }
 
-void shader::SceneShader::InitUniformBlocks() {
-  LinkDataToUniformBlock(GetGlobalTransBufferName(),
-                         GetGlobalTransUniformBlockName(), global_trans_);
-  LinkDataToUniformBlock(GetModelTransBufferName(),
-                         GetModelTransUniformBlockName(), model_trans_);
-  LinkDataToUniformBlock(GetModelMaterialBufferName(),
-                         GetModelMaterialUniformBlockName(), model_material_);
-  LinkDataToUniformBlock(GetLightingBufferName(), GetLightingUniformBlockName(),
-                         lighting_);
+void shader::SceneShader::InitIndirectProgram() {
+  // Get managers
+  as::ProgramManager &program_manager = gl_managers_->GetProgramManager();
+  as::ShaderManager &shader_manager = gl_managers_->GetShaderManager();
+  // Get names
+  const std::string program_name = GetIndirectProgramName();
+  const std::string vertex_path = GetIndirectVertexShaderPath();
+  const std::string fragment_path = GetShaderPath(ShaderTypes::kFragment);
+  // Create the program which shares the fragment shader
+  shader_manager.CreateShader(vertex_path, GL_VERTEX_SHADER, vertex_path);
+  program_manager.CreateProgram(program_name);
+  program_manager.AttachShader(program_name, vertex_path);
+  program_manager.AttachShader(program_name, fragment_path);
+  program_manager.LinkProgram(program_name);
 }
 
-void shader::SceneShader::InitLightTrans() {
+/*
+ * Merges the geometry of all meshes into a single vertex array so that all
+ * meshes could be drawn by glMultiDrawElementsIndirect
+ */
+void shader::SceneShader::InitIndirectVertexArray() {
   // Get managers
   as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
+  as::VertexSpecManager &vertex_spec_manager =
+      gl_managers_->GetVertexSpecManager();
   // Get names
-  const std::string buffer_name = GetLightingBufferName();
-  // Get light space transformation
-  const dto::GlobalTrans global_trans = depth_shader_->GetLightTrans();
-  lighting_.light_trans =
-      global_trans.proj * global_trans.view * global_trans.model;
-  // Update the buffer
-  buffer_manager.UpdateBuffer(buffer_name);
-}
+  const std::string va_name = GetIndirectVertexArrayName();
+  const std::string vertices_buffer_name = GetIndirectVerticesBufferName();
+  const std::string idxs_buffer_name = GetIndirectIdxsBufferName();
+  const std::string matrices_buffer_name =
+      GetIndirectInstancingMatricesBufferName();
+  const std::string model_idxs_buffer_name =
+      GetIndirectInstancingModelIdxsBufferName();
+
+  /* Merge meshes */
+  std::vector<as::Vertex> merged_vertices;
+  std::vector<GLuint> merged_idxs;
+  mesh_indirect_cmds_.clear();
+  for (const MeshDrawInfo &mesh_draw_info : mesh_draw_infos_) {
+    const dto::SceneModel &scene_model =
+        scene_models_.at(mesh_draw_info.scene_model_name);
+    const as::Mesh &mesh =
+        scene_model.GetModel().GetMeshes().at(mesh_draw_info.mesh_idx);
+    const std::vector<as::Vertex> vertices = mesh.GetVertices();
+    const std::vector<size_t> idxs = mesh.GetIdxs();
+    // Save the ranges of the mesh
+    DrawElementsIndirectCmd indirect_cmd;
+    indirect_cmd.count = static_cast<GLuint>(idxs.size());
+    indirect_cmd.instance_count = 0;
+    indirect_cmd.first_idx = static_cast<GLuint>(merged_idxs.size());
+    indirect_cmd.base_vertex = static_cast<GLint>(merged_vertices.size());
+    indirect_cmd.base_instance = 0;
+    mesh_indirect_cmds_.push_back(indirect_cmd);
+    // Append the geometry
+    merged_vertices.insert(merged_vertices.end(), vertices.begin(),
+                           vertices.end());
+    for (const size_t idx : idxs) {
+      merged_idxs.push_back(static_cast<GLuint>(idx));
+    }
+  }
 
-/*******************************************************************************
- * State Updaters (Private)
- ******************************************************************************/
+  /* Generate buffers */
+  buffer_manager.GenBuffer(vertices_buffer_name);
+  buffer_manager.GenBuffer(idxs_buffer_name);
+  buffer_manager.GenBuffer(matrices_buffer_name);
+  buffer_manager.GenBuffer(model_idxs_buffer_name);
+
+  /* Initialize buffers */
+  buffer_manager.InitBuffer(vertices_buffer_name, GL_ARRAY_BUFFER,
+                            merged_vertices.size() * sizeof(as::Vertex),
+                            merged_vertices.data(), GL_STATIC_DRAW);
+  buffer_manager.InitBuffer(idxs_buffer_name, GL_ELEMENT_ARRAY_BUFFER,
+                            merged_idxs.size() * sizeof(GLuint),
+                            merged_idxs.data(), GL_STATIC_DRAW);
+  UpdateIndirectInstancing();
+
+  /* Create vertex arrays */
+  vertex_spec_manager.GenVertexArray(va_name);
+
+  /* Bind vertex arrays to buffers */
+  vertex_spec_manager.SpecifyVertexArrayOrg(va_name, 0, 3, GL_FLOAT, GL_FALSE,
+                                            0);
+  vertex_spec_manager.SpecifyVertexArrayOrg(va_name, 1, 2, GL_FLOAT, GL_FALSE,
+                                            0);
+  vertex_spec_manager.SpecifyVertexArrayOrg(va_name, 2, 3, GL_FLOAT, GL_FALSE,
+                                            0);
+  vertex_spec_manager.SpecifyVertexArrayOrg(va_name, 3, 3, GL_FLOAT, GL_FALSE,
+                                            0);
+  vertex_spec_manager.SpecifyVertexArrayOrg(va_name, 7, 1, GL_FLOAT, GL_FALSE,
+                                            0);
+  for (GLuint attrib_idx = 0; attrib_idx <= 3; attrib_idx++) {
+    vertex_spec_manager.AssocVertexAttribToBindingPoint(va_name, attrib_idx,
+                                                        attrib_idx);
+  }
+  vertex_spec_manager.AssocVertexAttribToBindingPoint(va_name, 7, 7);
+  vertex_spec_manager.BindBufferToBindingPoint(
+      va_name, vertices_buffer_name, 0, offsetof(as::Vertex, pos),
+      sizeof(as::Vertex));
+  vertex_spec_manager.BindBufferToBindingPoint(
+      va_name, vertices_buffer_name, 1, offsetof(as::Vertex, tex_coords),
+      sizeof(as::Vertex));
+  vertex_spec_manager.BindBufferToBindingPoint(
+      va_name, vertices_buffer_name, 2, offsetof(as::Vertex, normal),
+      sizeof(as::Vertex));
+  vertex_spec_manager.BindBufferToBindingPoint(
+      va_name, vertices_buffer_name, 3, offsetof(as::Vertex, tangent),
+      sizeof(as::Vertex));
+  vertex_spec_manager.BindBufferToBindingPoint(va_name, model_idxs_buffer_name,
+                                               7, 0, sizeof(GLfloat));
+  SpecifyInstanceMatrices(va_name, matrices_buffer_name);
+
+  /* Modify vertex array updating rates */
+  trace_manager.RecordCall("glVertexAttribDivisor", {7, 1}, 0,
+                           [&] { glVertexAttribDivisor(7, 1); });
+}
 
-void shader::SceneShader::UpdateModelTrans(const dto::SceneModel &scene_model) {
+void shader::SceneShader::InitPrepassProgram() {
   // Get managers
-  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  as::ProgramManager &program_manager = gl_managers_->GetProgramManager();
+  as::ShaderManager &shader_manager = gl_managers_->GetShaderManager();
   // Get names
-  const std::string buffer_name = GetModelTransBufferName();
-
-  // Update transformation
-  model_trans_.trans = scene_model.GetTrans();
-  // Update the buffer
-  buffer_manager.UpdateBuffer(buffer_name);
+  const std::string program_name = GetPrepassProgramName();
+  const std::string vertex_path = GetPrepassVertexShaderPath();
+  const std::string fragment_path = GetPrepassFragmentShaderPath();
+  // Create the program
+  shader_manager.CreateShader(vertex_path, GL_VERTEX_SHADER, vertex_path);
+  shader_manager.CreateShader(fragment_path, GL_FRAGMENT_SHADER,
+                              fragment_path);
+  program_manager.CreateProgram(program_name);
+  program_manager.AttachShader(program_name, vertex_path);
+  program_manager.AttachShader(program_name, fragment_path);
+  program_manager.LinkProgram(program_name);
 }
 
-void shader::SceneShader::UpdateLighting(const dto::SceneModel &scene_model) {
+/*
+ * Packs the positions of all meshes tightly, so that the pre-pass doesn't
+ * fetch the other vertex attributes. The positions have the same layout as
+ * the merged vertices of indirect drawing, so the merged indexes and the
+ * ranges in the indirect commands are reused. Each model has its own vertex
+ * array because the instance matrices are in the buffers of the models.
+ */
+void shader::SceneShader::InitPrepassVertexArrays() {
   // Get managers
   as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  as::VertexSpecManager &vertex_spec_manager =
+      gl_managers_->GetVertexSpecManager();
   // Get names
-  const std::string buffer_name = GetLightingBufferName();
+  const std::string positions_buffer_name = GetPrepassPositionsBufferName();
+
+  /* Merge positions */
+  std::vector<glm::vec3> merged_poses;
+  for (const MeshDrawInfo &mesh_draw_info : mesh_draw_infos_) {
+    const dto::SceneModel &scene_model =
+        scene_models_.at(mesh_draw_info.scene_model_name);
+    const as::Mesh &mesh =
+        scene_model.GetModel().GetMeshes().at(mesh_draw_info.mesh_idx);
+    for (const as::Vertex &vertex : mesh.GetVertices()) {
+      merged_poses.push_back(vertex.pos);
+    }
+  }
 
-  // Update lighting
-  lighting_.light_pos = scene_model.GetLightPos();
-  lighting_.light_color = scene_model.GetLightColor();
-  lighting_.light_intensity = scene_model.GetLightIntensity();
+  /* Generate buffers */
+  buffer_manager.GenBuffer(positions_buffer_name);
 
-  // Update the buffer
-  buffer_manager.UpdateBuffer(buffer_name);
+  /* Initialize buffers */
+  buffer_manager.InitBuffer(positions_buffer_name, GL_ARRAY_BUFFER,
+                            merged_poses.size() * sizeof(glm::vec3),
+                            merged_poses.data(), GL_STATIC_DRAW);
+
+  for (const auto &pair : scene_models_) {
+    const dto::SceneModel &scene_model = pair.second;
+    // Get names
+    const std::string va_name = GetPrepassVertexArrayName(scene_model);
+
+    /* Create vertex arrays */
+    vertex_spec_manager.GenVertexArray(va_name);
+
+    /* Bind vertex arrays to buffers */
+    vertex_spec_manager.SpecifyVertexArrayOrg(va_name, 0, 3, GL_FLOAT,
+                                              GL_FALSE, 0);
+    vertex_spec_manager.AssocVertexAttribToBindingPoint(va_name, 0, 0);
+    vertex_spec_manager.BindBufferToBindingPoint(
+        va_name, positions_buffer_name, 0, 0, sizeof(glm::vec3));
+    SpecifyInstanceMatrices(va_name,
+                            GetInstancingMatricesBufferName(scene_model));
+  }
 }
 
-void shader::SceneShader::UpdateModelMaterial(
-    const dto::SceneModel &scene_model) {
-  // The buffer will be updated in the draw method
-  model_material_.use_env_map = scene_model.GetUseEnvMap();
+/*
+ * The fragment shader invocations are counted only when the pipeline
+ * statistics queries are supported
+ */
+void shader::SceneShader::InitFragmentQueries() {
+  fragment_stats_.is_supported = GLEW_ARB_pipeline_statistics_query == GL_TRUE;
+  if (!fragment_stats_.is_supported) {
+    return;
+  }
+  // Get managers
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
+  // Generate the queries of both frame parities
+  trace_manager.RecordCall("glGenQueries", {2}, 0,
+                           [&] { glGenQueries(2, prepass_query_hdlrs_); });
+  trace_manager.RecordCall("glGenQueries", {2}, 0,
+                           [&] { glGenQueries(2, scene_query_hdlrs_); });
+}
+
+/*
+ * Each row of the instance matrices is a vertex attribute, the rows of the
+ * model matrix are at locations 4 to 6 and the rows of the normal matrix are
+ * at locations 8 to 10
+ */
+void shader::SceneShader::SpecifyInstanceMatrices(
+    const std::string &va_name, const std::string &buffer_name) {
+  // Get managers
+  as::VertexSpecManager &vertex_spec_manager =
+      gl_managers_->GetVertexSpecManager();
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
+  // Get the row offsets
+  const GLsizei stride = sizeof(dto::SceneModel::InstanceMatrices);
+  const GLintptr model_rows_ofs =
+      offsetof(dto::SceneModel::InstanceMatrices, model_rows);
+  const GLintptr normal_rows_ofs =
+      offsetof(dto::SceneModel::InstanceMatrices, normal_rows);
+
+  for (GLuint row_idx = 0; row_idx < 3; row_idx++) {
+    const GLuint model_attrib_idx = 4 + row_idx;
+    const GLuint normal_attrib_idx = 8 + row_idx;
+    const GLintptr row_ofs = row_idx * sizeof(glm::vec4);
+
+    /* Bind vertex arrays to buffers */
+    vertex_spec_manager.SpecifyVertexArrayOrg(va_name, model_attrib_idx, 4,
+                                              GL_FLOAT, GL_FALSE, 0);
+    vertex_spec_manager.SpecifyVertexArrayOrg(va_name, normal_attrib_idx, 4,
+                                              GL_FLOAT, GL_FALSE, 0);
+
+    vertex_spec_manager.AssocVertexAttribToBindingPoint(
+        va_name, model_attrib_idx, model_attrib_idx);
+    vertex_spec_manager.AssocVertexAttribToBindingPoint(
+        va_name, normal_attrib_idx, normal_attrib_idx);
+
+    vertex_spec_manager.BindBufferToBindingPoint(
+        va_name, buffer_name, model_attrib_idx, model_rows_ofs + row_ofs,
+        stride);
+    vertex_spec_manager.BindBufferToBindingPoint(
+        va_name, buffer_name, normal_attrib_idx, normal_rows_ofs + row_ofs,
+        stride);
+
+    /* Modify vertex array updating rates */
+    trace_manager.RecordCall(
+        "glVertexAttribDivisor", {model_attrib_idx, 1}, 0,
+        [&] { glVertexAttribDivisor(model_attrib_idx, 1); });
+    trace_manager.RecordCall(
+        "glVertexAttribDivisor", {normal_attrib_idx, 1}, 0,
+        [&] { glVertexAttribDivisor(normal_attrib_idx, 1); });
+  }
+}
+
+void shader::SceneShader::InitIndirectBuffers() {
+  // Get managers
+  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  // Get names
+  const std::string model_params_buffer_name =
+      GetIndirectModelParamsBufferName();
+  const std::string cmds_buffer_name = GetIndirectCmdsBufferName();
+  // Assign the model indexes
+  scene_model_idxs_.clear();
+  for (const auto &pair : scene_models_) {
+    const GLuint scene_model_idx = static_cast<GLuint>(scene_model_idxs_.size());
+    scene_model_idxs_[pair.first] = scene_model_idx;
+  }
+  model_params_.resize(scene_models_.size());
+  /* Generate buffers */
+  buffer_manager.GenBuffer(model_params_buffer_name);
+  buffer_manager.GenBuffer(cmds_buffer_name);
+  /* Initialize buffers */
+  buffer_manager.InitBuffer(model_params_buffer_name, GL_SHADER_STORAGE_BUFFER,
+                            model_params_.size() * sizeof(ModelParams),
+                            nullptr, GL_DYNAMIC_DRAW);
+  buffer_manager.InitBuffer(
+      cmds_buffer_name, GL_DRAW_INDIRECT_BUFFER,
+      mesh_draw_infos_.size() * sizeof(DrawElementsIndirectCmd), nullptr,
+      GL_DYNAMIC_DRAW);
 }
 
-void shader::SceneShader::UpdateModelMaterial(const as::Material &material) {
+/*
+ * The buffers are resized in each frame, so they only get one element of
+ * storage here
+ */
+void shader::SceneShader::InitLightClusterBuffers() {
+  // Get managers
   as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  // Get names
+  const std::string point_lights_buffer_name = GetPointLightsBufferName();
+  const std::string ranges_buffer_name = GetClusterRangesBufferName();
+  const std::string light_idxs_buffer_name = GetClusterLightIdxsBufferName();
+  /* Generate buffers */
+  buffer_manager.GenBuffer(point_lights_buffer_name);
+  buffer_manager.GenBuffer(ranges_buffer_name);
+  buffer_manager.GenBuffer(light_idxs_buffer_name);
+  /* Initialize buffers */
+  buffer_manager.InitBuffer(point_lights_buffer_name, GL_SHADER_STORAGE_BUFFER,
+                            sizeof(as::LightClusters::PointLight), nullptr,
+                            GL_DYNAMIC_DRAW);
+  buffer_manager.InitBuffer(ranges_buffer_name, GL_SHADER_STORAGE_BUFFER,
+                            sizeof(as::LightClusters::ClusterRange), nullptr,
+                            GL_DYNAMIC_DRAW);
+  buffer_manager.InitBuffer(light_idxs_buffer_name, GL_SHADER_STORAGE_BUFFER,
+                            sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+}
+
+void shader::SceneShader::InitUniformBlocks() {
+  LinkDataToUniformBlock(GetGlobalTransBufferName(),
+                         GetGlobalTransUniformBlockName(), global_trans_);
+  LinkDataToUniformBlock(GetModelMaterialBufferName(),
+                         GetModelMaterialUniformBlockName(), model_material_);
+  LinkDataToUniformBlock(GetLightingBufferName(), GetLightingUniformBlockName(),
+                         lighting_);
+  LinkDataToUniformBlock(GetCascadedShadowsBufferName(),
+                         GetCascadedShadowsUniformBlockName(),
+                         cascaded_shadows_);
+  LinkDataToUniformBlock(GetLightClustersBufferName(),
+                         GetLightClustersUniformBlockName(),
+                         light_cluster_params_);
+
+  // Share the binding points with the indirect program and the pre-pass
+  // program
+  as::UniformManager &uniform_manager = gl_managers_->GetUniformManager();
+  const std::string indirect_program_name = GetIndirectProgramName();
+  uniform_manager.AssignUniformBlockToBindingPoint(
+      GetPrepassProgramName(), GetGlobalTransUniformBlockName(),
+      GetGlobalTransBufferName());
+  uniform_manager.AssignUniformBlockToBindingPoint(
+      indirect_program_name, GetGlobalTransUniformBlockName(),
+      GetGlobalTransBufferName());
+  uniform_manager.AssignUniformBlockToBindingPoint(
+      indirect_program_name, GetModelMaterialUniformBlockName(),
+      GetModelMaterialBufferName());
+  uniform_manager.AssignUniformBlockToBindingPoint(
+      indirect_program_name, GetLightingUniformBlockName(),
+      GetLightingBufferName());
+  uniform_manager.AssignUniformBlockToBindingPoint(
+      indirect_program_name, GetCascadedShadowsUniformBlockName(),
+      GetCascadedShadowsBufferName());
+  uniform_manager.AssignUniformBlockToBindingPoint(
+      indirect_program_name, GetLightClustersUniformBlockName(),
+      GetLightClustersBufferName());
+}
+
+void shader::SceneShader::InitUniformRingBuffer() {
+  // Get managers
+  as::RingBufferManager &ring_buffer_manager =
+      gl_managers_->GetRingBufferManager();
+  // Get names
+  const std::string ring_buffer_name = GetUniformRingBufferName();
+  // Get aligned sizes
+  const GLsizeiptr lighting_size =
+      ring_buffer_manager.GetAlignedSize(GL_UNIFORM_BUFFER, sizeof(lighting_));
+  const GLsizeiptr model_material_size = ring_buffer_manager.GetAlignedSize(
+      GL_UNIFORM_BUFFER, sizeof(model_material_));
+
+  // Calculate the size of the per-draw data in a frame, each mesh could be
+  // drawn with every material tier
+  GLsizeiptr segment_size = 0;
+  for (const auto &pair : scene_models_) {
+    const dto::SceneModel &scene_model = pair.second;
+    const size_t num_meshes = scene_model.GetModel().GetMeshes().size();
+    segment_size += lighting_size;
+    segment_size += num_meshes * kMaxNumMaterialTiers * model_material_size;
+  }
+
+  // Initialize the ring buffer
+  ring_buffer_manager.InitRingBuffer(ring_buffer_name, GL_UNIFORM_BUFFER,
+                                     segment_size, kNumUniformRingSegments);
+}
+
+void shader::SceneShader::SetSceneTextureUniforms(
+    const std::string &program_name) {
+  // Get managers
+  as::TextureManager &texture_manager = gl_managers_->GetTextureManager();
+  as::UniformManager &uniform_manager = gl_managers_->GetUniformManager();
+  // Get names
+  const std::string skybox_tex_name = skybox_shader_->GetTextureName();
+  const std::string light_depth_tex_name = depth_shader_->GetDepthTextureName(
+      shader::DepthShader::DepthTextureTypes::kFromLight);
+  // Set the unit indexes of the textures shared by all meshes
+  uniform_manager.SetProgramUniform1Int(
+      program_name, "skybox_tex", texture_manager.GetUnitIdx(skybox_tex_name));
+  uniform_manager.SetProgramUniform1Int(
+      program_name, "light_depth_map_tex",
+      texture_manager.GetUnitIdx(light_depth_tex_name));
+}
+
+/*******************************************************************************
+ * Shader Permutations (Private)
+ ******************************************************************************/
+
+/*
+ * Builds the feature bitmask from the material states which have been updated
+ * for the current mesh, bit i is set when the i-th feature define is enabled
+ */
+GLuint shader::SceneShader::GetPermutationMask() const {
+  const bool features[] = {
+      model_material_.use_ambient_tex,  model_material_.use_diffuse_tex,
+      model_material_.use_specular_tex, model_material_.use_height_tex,
+      model_material_.use_normals_tex,  model_material_.use_env_map,
+      model_material_.use_fog,          model_material_.mix_fog_with_skybox,
+      model_material_.use_normal,       model_material_.use_pcf};
+  GLuint permutation_mask = 0;
+  for (size_t feature_idx = 0; feature_idx < kPermutationFeatureDefines.size();
+       feature_idx++) {
+    if (features[feature_idx]) {
+      permutation_mask |= 1u << feature_idx;
+    }
+  }
+  return permutation_mask;
+}
+
+/*
+ * Returns the program of the permutation if it has been linked, otherwise
+ * submits it lazily and falls back to the uber program for this frame. The
+ * uber program is also used when no more permutations could be created.
+ */
+std::string shader::SceneShader::SelectPermutationProgram(
+    const GLuint permutation_mask) {
+  // Get managers
+  const as::ProgramManager &program_manager =
+      gl_managers_->GetProgramManager();
+  // Get names
+  const std::string program_name = GetPermutationProgramName(permutation_mask);
+  // Check whether the permutation is ready
+  if (ready_permutation_masks_.count(permutation_mask) > 0) {
+    return program_name;
+  }
+  // Submit the permutation lazily
+  if (submitted_permutation_masks_.count(permutation_mask) == 0) {
+    if (submitted_permutation_masks_.size() >= kMaxNumPermutationPrograms) {
+      return GetProgramName();
+    }
+    SubmitPermutationProgram(permutation_mask);
+  }
+  // Check whether the linking has finished without blocking
+  if (!program_manager.IsProgramReady(program_name)) {
+    return GetProgramName();
+  }
+  InitPermutationProgram(permutation_mask);
+  return program_name;
+}
+
+void shader::SceneShader::SubmitPermutationProgram(
+    const GLuint permutation_mask) {
+  // Get managers
+  as::ProgramManager &program_manager = gl_managers_->GetProgramManager();
+  as::ShaderManager &shader_manager = gl_managers_->GetShaderManager();
+  // Get names
+  const std::string program_name = GetPermutationProgramName(permutation_mask);
+  const std::string vertex_path = GetShaderPath(ShaderTypes::kVertex);
+  const std::string fragment_path = GetShaderPath(ShaderTypes::kFragment);
+  const std::string fragment_name =
+      GetPermutationFragmentShaderName(permutation_mask);
+  // Get the defines of the enabled features
+  std::vector<std::string> defines = {"USE_PERMUTATION"};
+  for (size_t feature_idx = 0; feature_idx < kPermutationFeatureDefines.size();
+       feature_idx++) {
+    if ((permutation_mask & (1u << feature_idx)) != 0) {
+      defines.push_back(kPermutationFeatureDefines.at(feature_idx));
+    }
+  }
+  // Create the program which shares the vertex shader, which also registers
+  // its sort index of the draw list keys
+  shader_manager.CreateShader(fragment_name, GL_FRAGMENT_SHADER, fragment_path,
+                              defines);
+  program_manager.CreateProgram(program_name);
+  program_manager.AttachShader(program_name, vertex_path);
+  program_manager.AttachShader(program_name, fragment_name);
+  program_manager.LinkProgram(program_name);
+  submitted_permutation_masks_.insert(permutation_mask);
+}
+
+void shader::SceneShader::InitPermutationProgram(
+    const GLuint permutation_mask) {
+  // Get managers
+  as::UniformManager &uniform_manager = gl_managers_->GetUniformManager();
+  // Get names
+  const std::string program_name = GetPermutationProgramName(permutation_mask);
+  // Share the binding points with the uber program
+  uniform_manager.AssignUniformBlockToBindingPoint(
+      program_name, GetGlobalTransUniformBlockName(),
+      GetGlobalTransBufferName());
+  uniform_manager.AssignUniformBlockToBindingPoint(
+      program_name, GetModelMaterialUniformBlockName(),
+      GetModelMaterialBufferName());
+  uniform_manager.AssignUniformBlockToBindingPoint(
+      program_name, GetLightingUniformBlockName(), GetLightingBufferName());
+  uniform_manager.AssignUniformBlockToBindingPoint(
+      program_name, GetCascadedShadowsUniformBlockName(),
+      GetCascadedShadowsBufferName());
+  uniform_manager.AssignUniformBlockToBindingPoint(
+      program_name, GetLightClustersUniformBlockName(),
+      GetLightClustersBufferName());
+  // Set the texture units
+  SetSceneTextureUniforms(program_name);
+  ready_permutation_masks_.insert(permutation_mask);
+}
+
+/*******************************************************************************
+ * Constants (Private)
+ ******************************************************************************/
+
+const int shader::SceneShader::kNumUniformRingSegments = 3;
+
+const GLuint shader::SceneShader::kDrawPass = 1;
+
+const float shader::SceneShader::kMaxDrawDepth = 1e3f;
+
+const GLuint shader::SceneShader::kModelParamsBindingIdx = 0;
+
+// The order should match the features in GetPermutationMask
+const std::vector<std::string> shader::SceneShader::kPermutationFeatureDefines =
+    {"FEATURE_AMBIENT_TEX",  "FEATURE_DIFFUSE_TEX",
+     "FEATURE_SPECULAR_TEX", "FEATURE_HEIGHT_TEX",
+     "FEATURE_NORMALS_TEX",  "FEATURE_ENV_MAP",
+     "FEATURE_FOG",          "FEATURE_MIX_FOG_WITH_SKYBOX",
+     "FEATURE_NORMAL",       "FEATURE_PCF"};
+
+// The program field of the draw list keys has 8 bits, so the permutations
+// could only take part of the 256 sort indexes and leave the rest to the
+// other programs
+const size_t shader::SceneShader::kMaxNumPermutationPrograms = 128;
+
+const float shader::SceneShader::kBvhRebuildCostRatio = 1.5f;
+
+const int shader::SceneShader::kOcclusionBufferWidth = 256;
+
+const int shader::SceneShader::kOcclusionBufferHeight = 128;
+
+// The large models which hide the others
+const std::vector<std::string> shader::SceneShader::kOccluderSceneModelNames =
+    {"ground", "surround"};
+
+const unsigned int shader::SceneShader::kNumStaticCasterFrames = 30;
+
+// The models which only receive shadows, e.g., the surrounding tube which
+// encloses the others
+const std::vector<std::string>
+    shader::SceneShader::kReceiverOnlySceneModelNames = {"surround"};
+
+// Same as the alpha below which the fragment shader discards the fragments
+const float shader::SceneShader::kMinPrepassAlpha = 0.1f;
+
+// 16x9 tiles match the aspect ratio of the window
+const int shader::SceneShader::kLightClusterNumTilesX = 16;
+
+const int shader::SceneShader::kLightClusterNumTilesY = 9;
+
+const int shader::SceneShader::kLightClusterNumSlices = 24;
+
+// The slices are spaced logarithmically between the depths, the nearer and
+// farther fragments are in the first and last slices
+const float shader::SceneShader::kLightClusterNearDepth = 0.1f;
+
+const float shader::SceneShader::kLightClusterFarDepth = 200.0f;
+
+// Binding 0 is used by the model parameters of indirect drawing
+const GLuint shader::SceneShader::kPointLightsBindingIdx = 1;
+
+const GLuint shader::SceneShader::kClusterRangesBindingIdx = 2;
+
+const GLuint shader::SceneShader::kClusterLightIdxsBindingIdx = 3;
+
+const shader::SceneShader::MaterialTier
+    shader::SceneShader::kFullMaterialTier = {0.0f, 0.0f, 1.0f, true, true};
+
+// The reduced tier halves the parallax layers and takes a single shadow tap,
+// the far tier also skips the parallax mapping and the environment mapping
+const std::vector<shader::SceneShader::MaterialTier>
+    shader::SceneShader::kDefaultMaterialTiers = {
+        {40.0f, 0.1f, 0.5f, false, true}, {100.0f, 0.02f, 0.0f, false, false}};
+
+// Average of the minimum and maximum layers, and the fetches before and after
+// the loop
+const float shader::SceneShader::kNumParallaxFetches = 8.0f;
+
+const float shader::SceneShader::kNumPcfFetches = 9.0f;
+
+/*******************************************************************************
+ * State Updaters (Private)
+ ******************************************************************************/
+
+/*
+ * The update methods below write the data into the uniform ring buffer and
+ * return the offset of the written range
+ */
+
+GLintptr shader::SceneShader::UpdateLighting(
+    const dto::SceneModel &scene_model) {
+  // Update lighting
+  lighting_.light_pos = scene_model.GetLightPos();
+  lighting_.light_color = scene_model.GetLightColor();
+  lighting_.light_intensity = scene_model.GetLightIntensity();
+
+  // Write the buffer range
+  return WriteUniformRingBuffer(lighting_);
+}
+
+void shader::SceneShader::UpdateCascadedShadows() {
+  // Get managers
+  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  // Get names
+  const std::string buffer_name = GetCascadedShadowsBufferName();
+  // Update the cascades fitted by the depth shader
+  const as::ShadowCascades &shadow_cascades =
+      depth_shader_->GetShadowCascades();
+  const int num_cascades = shadow_cascades.GetNumCascades();
+  for (int cascade_idx = 0; cascade_idx < num_cascades; cascade_idx++) {
+    cascaded_shadows_.light_transes[cascade_idx] =
+        depth_shader_->GetCascadeTrans(cascade_idx);
+    cascaded_shadows_.split_depths[cascade_idx] =
+        shadow_cascades.GetSplitDepth(cascade_idx);
+  }
+  cascaded_shadows_.num_cascades = num_cascades;
+  // Update the buffer
+  buffer_manager.UpdateBuffer(buffer_name);
+}
+
+void shader::SceneShader::UpdateModelMaterial(
+    const dto::SceneModel &scene_model) {
+  // The buffer will be updated with the mesh material
+  model_material_.use_env_map = scene_model.GetUseEnvMap();
+}
+
+/*
+ * The model flags should be updated before, since the material tier could
+ * disable the environment mapping of the model
+ */
+GLintptr shader::SceneShader::UpdateModelMaterial(
+    const as::Material &material, const GLuint material_tier_idx) {
+  // Get the material tier
+  const MaterialTier &material_tier = GetMaterialTier(material_tier_idx);
   // Update material
   model_material_.use_ambient_tex = material.HasAmbientTexture();
   model_material_.use_diffuse_tex = material.HasDiffuseTexture();
   model_material_.use_specular_tex = material.HasSpecularTexture();
   if (use_normal_height_) {
-    model_material_.use_height_tex = material.HasHeightTexture();
+    model_material_.use_height_tex =
+        material.HasHeightTexture() &&
+        material_tier.parallax_layers_scale > 0.0f;
     model_material_.use_normals_tex = material.HasNormalsTexture();
   } else {
     model_material_.use_height_tex = false;
@@ -629,78 +1832,1603 @@ void shader::SceneShader::UpdateModelMaterial(const as::Material &material) {
   model_material_.diffuse_color = material.GetDiffuseColor();
   model_material_.specular_color = material.GetSpecularColor();
   model_material_.shininess = material.GetShininess();
+  // Reduce the features with the tier
+  model_material_.use_env_map =
+      model_material_.use_env_map && material_tier.use_env_map;
+  model_material_.use_pcf = use_pcf_ && material_tier.use_pcf;
+  model_material_.parallax_layers_scale = material_tier.parallax_layers_scale;
+  // Write the buffer range
+  return WriteUniformRingBuffer(model_material_);
+}
+
+void shader::SceneShader::BindUniformRingBufferRange(
+    const std::string &binding_name, const GLintptr ofs,
+    const GLsizeiptr size) {
+  // Get managers
+  as::UniformManager &uniform_manager = gl_managers_->GetUniformManager();
+  // Get names
+  const std::string ring_buffer_name = GetUniformRingBufferName();
+  // Bind the written range to the binding point which is named after the
+  // original uniform buffer
+  uniform_manager.BindBufferRangeToBindingPoint(ring_buffer_name, binding_name,
+                                                ofs, size);
+}
+
+/*
+ * Each mesh gets its own copy of the instance matrices of its model, so that
+ * the base instance of each indirect command points to them
+ */
+void shader::SceneShader::UpdateIndirectInstancing() {
+  // Get managers
+  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  // Get names
+  const std::string matrices_buffer_name =
+      GetIndirectInstancingMatricesBufferName();
+  const std::string model_idxs_buffer_name =
+      GetIndirectInstancingModelIdxsBufferName();
+
+  /* Merge instance matrices */
+  std::vector<dto::SceneModel::InstanceMatrices> merged_matrices;
+  std::vector<GLfloat> merged_model_idxs;
+  for (size_t info_idx = 0; info_idx < mesh_draw_infos_.size(); info_idx++) {
+    const MeshDrawInfo &mesh_draw_info = mesh_draw_infos_.at(info_idx);
+    const dto::SceneModel &scene_model =
+        scene_models_.at(mesh_draw_info.scene_model_name);
+    const std::vector<dto::SceneModel::InstanceMatrices> &instance_matrices =
+        scene_model.GetInstanceMatrices();
+    const GLfloat scene_model_idx = static_cast<GLfloat>(
+        scene_model_idxs_.at(mesh_draw_info.scene_model_name));
+    // Save the base instance
+    mesh_indirect_cmds_.at(info_idx).base_instance =
+        static_cast<GLuint>(merged_matrices.size());
+    // Append the instance matrices
+    merged_matrices.insert(merged_matrices.end(), instance_matrices.begin(),
+                           instance_matrices.end());
+    merged_model_idxs.insert(merged_model_idxs.end(), instance_matrices.size(),
+                             scene_model_idx);
+  }
+
+  /* Initialize buffers */
+  // The sizes may change, so the buffers are re-initialized
+  buffer_manager.InitBuffer(
+      matrices_buffer_name, GL_ARRAY_BUFFER,
+      merged_matrices.size() * sizeof(dto::SceneModel::InstanceMatrices),
+      merged_matrices.data(), GL_DYNAMIC_DRAW);
+  buffer_manager.InitBuffer(model_idxs_buffer_name, GL_ARRAY_BUFFER,
+                            merged_model_idxs.size() * sizeof(GLfloat),
+                            merged_model_idxs.data(), GL_DYNAMIC_DRAW);
+  // The buffer no longer holds the compacted instances
+  compacted_instances_.erase(matrices_buffer_name);
+}
+
+/*
+ * Uploads only the dirty ranges of the instance matrices. The whole
+ * buffers are orphaned when all instances are dirty, so that the driver could
+ * allocate new storage instead of waiting for the GPU to finish reading.
+ */
+void shader::SceneShader::StreamInstancing() {
+  instancing_stats_ = InstancingStats{0, 0, 0};
+  for (const auto &pair : scene_models_) {
+    if (pair.second.HasDirtyInstances()) {
+      StreamSceneModelInstancing(pair.first);
+    }
+  }
+}
+
+void shader::SceneShader::StreamSceneModelInstancing(
+    const std::string &scene_model_name) {
+  // Get the scene model
+  dto::SceneModel &scene_model = scene_models_.at(scene_model_name);
+  // Get names
+  const std::string matrices_buffer_name =
+      GetInstancingMatricesBufferName(scene_model);
+  // Get instance matrices
+  const std::vector<dto::SceneModel::InstanceMatrices> &instance_matrices =
+      scene_model.GetInstanceMatrices();
+  // Get the dirty range
+  const size_t num_instancing = scene_model.GetNumInstancing();
+  const size_t begin = scene_model.GetDirtyInstanceBegin();
+  const size_t end =
+      std::min(scene_model.GetDirtyInstanceEnd(), num_instancing);
+
+  if (begin == 0 && end == num_instancing) {
+    /* Orphan buffers */
+    UploadSceneModelInstancing(scene_model_name);
+    /* Update merged buffers */
+    // The number of instances may change, so the merged buffers are rebuilt
+    UpdateIndirectInstancing();
+  } else {
+    const size_t num_instances = end - begin;
+    /* Update buffer ranges */
+    StreamInstancingRange(matrices_buffer_name, instance_matrices, begin,
+                          begin, num_instances);
+    /* Update merged buffer ranges */
+    for (size_t info_idx = 0; info_idx < mesh_draw_infos_.size(); info_idx++) {
+      if (mesh_draw_infos_.at(info_idx).scene_model_name != scene_model_name) {
+        continue;
+      }
+      const size_t base_instance =
+          mesh_indirect_cmds_.at(info_idx).base_instance;
+      StreamInstancingRange(GetIndirectInstancingMatricesBufferName(),
+                            instance_matrices, begin, base_instance + begin,
+                            num_instances);
+    }
+  }
+  instancing_stats_.num_updated_instances +=
+      static_cast<unsigned int>(end - begin);
+  scene_model.ClearDirtyInstances();
+}
+
+void shader::SceneShader::StreamInstancingRange(
+    const std::string &buffer_name,
+    const std::vector<dto::SceneModel::InstanceMatrices> &instance_matrices,
+    const size_t src_begin, const size_t dst_begin,
+    const size_t num_instances) {
+  // Get managers
+  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  // Update the buffer range
+  const GLintptr ofs = dst_begin * sizeof(dto::SceneModel::InstanceMatrices);
+  const GLsizeiptr size =
+      num_instances * sizeof(dto::SceneModel::InstanceMatrices);
+  buffer_manager.UpdateBuffer(buffer_name, GL_ARRAY_BUFFER, ofs, size,
+                              instance_matrices.data() + src_begin);
+  instancing_stats_.num_uploaded_bytes += size;
+}
+
+void shader::SceneShader::UploadSceneModelInstancing(
+    const std::string &scene_model_name) {
+  // Get the scene model
+  const dto::SceneModel &scene_model = scene_models_.at(scene_model_name);
+  // Upload all instances
+  UploadInstancing(GetInstancingMatricesBufferName(scene_model),
+                   scene_model.GetInstanceMatrices());
+}
+
+/*
+ * Orphans the buffer with the new matrices, the size may differ from the
+ * previous one
+ */
+void shader::SceneShader::UploadInstancing(
+    const std::string &buffer_name,
+    const std::vector<dto::SceneModel::InstanceMatrices> &instance_matrices) {
+  // Get managers
+  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  // Orphan the buffer
+  const GLsizeiptr size =
+      instance_matrices.size() * sizeof(dto::SceneModel::InstanceMatrices);
+  buffer_manager.InitBuffer(buffer_name, GL_ARRAY_BUFFER, size,
+                            instance_matrices.data(), GL_DYNAMIC_DRAW);
+  instancing_stats_.num_uploaded_bytes += size;
+  instancing_stats_.num_orphaned_buffers++;
+  // The buffer no longer holds the compacted instances
+  compacted_instances_.erase(buffer_name);
+}
+
+void shader::SceneShader::UpdateIndirectModelParams() {
+  // Get managers
+  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  // Get names
+  const std::string buffer_name = GetIndirectModelParamsBufferName();
+  // Update model parameters
+  for (const auto &pair : scene_models_) {
+    const dto::SceneModel &scene_model = pair.second;
+    ModelParams &model_params = model_params_.at(scene_model_idxs_.at(pair.first));
+    model_params.light_pos = glm::vec4(scene_model.GetLightPos(), 1.0f);
+    model_params.light_color = glm::vec4(scene_model.GetLightColor(), 1.0f);
+    model_params.light_intensity =
+        glm::vec4(scene_model.GetLightIntensity(), 1.0f);
+  }
   // Update the buffer
-  const std::string buffer_name = GetModelMaterialBufferName();
-  buffer_manager.UpdateBuffer(buffer_name);
+  buffer_manager.UpdateBuffer(buffer_name, GL_SHADER_STORAGE_BUFFER, 0,
+                              model_params_.size() * sizeof(ModelParams),
+                              model_params_.data());
+  buffer_manager.BindBufferBase(buffer_name, GL_SHADER_STORAGE_BUFFER,
+                                kModelParamsBindingIdx);
+}
+
+/*******************************************************************************
+ * Culling (Private)
+ ******************************************************************************/
+
+/*
+ * Finds the instances in the camera and light frusta with the BVH. The light
+ * instances are then tested against the frustum of each shadow cascade, which
+ * is extended from the camera slice toward the light. The visible instances
+ * of each mesh are compacted into the instancing buffers of its model, the
+ * camera instances are followed by the instances of each cascade, and each
+ * draw selects its instances by the base instance. The instances of the
+ * batched meshes in other models are compacted together with the mesh which
+ * draws them.
+ */
+void shader::SceneShader::CullInstances() {
+  // Get managers
+  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  // Get names
+  const std::string model_idxs_buffer_name =
+      GetIndirectInstancingModelIdxsBufferName();
+  // Get the frusta
+  const dto::GlobalTrans light_trans = depth_shader_->GetLightTrans();
+  const glm::mat4 camera_view_proj =
+      global_trans_.proj * global_trans_.view * global_trans_.model;
+  const as::Frustum camera_frustum(camera_view_proj);
+  const as::Frustum light_frustum(light_trans.proj * light_trans.view *
+                                  light_trans.model);
+  const as::ShadowCascades &shadow_cascades =
+      depth_shader_->GetShadowCascades();
+  std::vector<as::Frustum> cascade_frusta;
+  for (int cascade_idx = 0; cascade_idx < shadow_cascades.GetNumCascades();
+       cascade_idx++) {
+    cascade_frusta.emplace_back(shadow_cascades.GetProj(cascade_idx) *
+                                light_trans.view * light_trans.model);
+  }
+
+  instancing_stats_ = InstancingStats{0, 0, 0};
+  culling_stats_ = CullingStats{0, 0, 0, 0, 0};
+  ResetMaterialLodStats();
+
+  /* Query the visible instances */
+  std::vector<size_t> camera_item_idxs;
+  std::vector<size_t> light_item_idxs;
+  const as::Bvh::TraversalStats camera_traversal_stats =
+      bvh_.QueryFrustum(camera_frustum, camera_item_idxs);
+  const as::Bvh::TraversalStats light_traversal_stats =
+      bvh_.QueryFrustum(light_frustum, light_item_idxs);
+  culling_stats_.num_visited_nodes = camera_traversal_stats.num_visited_nodes +
+                                     light_traversal_stats.num_visited_nodes;
+  // Mark the visible items
+  std::vector<unsigned char> camera_visibles(bvh_.GetNumItems(), 0);
+  std::vector<unsigned char> light_visibles(bvh_.GetNumItems(), 0);
+  for (const size_t item_idx : camera_item_idxs) {
+    camera_visibles[item_idx] = 1;
+  }
+  for (const size_t item_idx : light_item_idxs) {
+    light_visibles[item_idx] = 1;
+  }
+  // Remove the instances behind the occluders from the camera view
+  if (use_occlusion_culling_) {
+    CullOccludedInstances(camera_view_proj, camera_visibles);
+  }
+
+  /* Collect the visible instances */
+  std::map<std::string, VisibleInstances> visible_instances;
+  for (const auto &pair : scene_models_) {
+    const size_t item_ofs = bvh_item_ofses_.at(pair.first);
+    visible_instances[pair.first] = CollectVisibleInstances(
+        pair.first, cascade_frusta, camera_visibles.data() + item_ofs,
+        light_visibles.data() + item_ofs);
+    SelectMaterialTiers(pair.first,
+                        visible_instances.at(pair.first).camera_instance_idxs);
+  }
+
+  /* Compact the visible instances */
+  UpdateMeshBatches();
+  // The cascades which aren't fitted have no instances
+  for (std::vector<VisibleRange> &visible_ranges : cascade_visible_ranges_) {
+    std::fill(visible_ranges.begin(), visible_ranges.end(),
+              VisibleRange{0, 0});
+  }
+  for (std::vector<VisibleRange> &tier_ranges : camera_tier_ranges_) {
+    std::fill(tier_ranges.begin(), tier_ranges.end(), VisibleRange{0, 0});
+  }
+  // Get the models by the model indexes, whose dirty ranges are kept until
+  // all buffers are updated
+  std::vector<const dto::SceneModel *> indexed_scene_models(
+      scene_model_idxs_.size());
+  for (const auto &pair : scene_models_) {
+    indexed_scene_models.at(scene_model_idxs_.at(pair.first)) = &pair.second;
+  }
+  std::vector<CompactedInstance> merged_compacted_instances;
+  for (const auto &pair : scene_models_) {
+    CompactSceneModelInstances(pair.first, camera_frustum, cascade_frusta,
+                               visible_instances, indexed_scene_models,
+                               merged_compacted_instances);
+  }
+
+  /* Update merged buffers */
+  if (use_indirect_drawing_) {
+    const bool is_merged_orphaned = UploadCompactedInstances(
+        GetIndirectInstancingMatricesBufferName(), merged_compacted_instances,
+        indexed_scene_models);
+    // The model indexes only change with the compacted instances
+    if (is_merged_orphaned) {
+      std::vector<GLfloat> merged_model_idxs;
+      for (const CompactedInstance &compacted_instance :
+           merged_compacted_instances) {
+        merged_model_idxs.push_back(
+            static_cast<GLfloat>(std::get<0>(compacted_instance)));
+      }
+      buffer_manager.InitBuffer(model_idxs_buffer_name, GL_ARRAY_BUFFER,
+                                merged_model_idxs.size() * sizeof(GLfloat),
+                                merged_model_idxs.data(), GL_DYNAMIC_DRAW);
+    }
+  } else {
+    // The merged buffers miss the changes, so they're uploaded again when the
+    // indirect drawing is enabled
+    compacted_instances_.erase(GetIndirectInstancingMatricesBufferName());
+  }
+
+  // All changed instances have been sent
+  for (auto &pair : scene_models_) {
+    pair.second.ClearDirtyInstances();
+  }
+}
+
+/*
+ * Bakes the instance matrices and recalculates the bounds of the instances
+ * changed since the last frame, and returns the changed range. All bounds are
+ * recalculated when the model transformation or the number of instances
+ * changes.
+ */
+void shader::SceneShader::UpdateInstanceBounds(
+    const std::string &scene_model_name, size_t &changed_begin,
+    size_t &changed_end) {
+  // Get the scene model
+  dto::SceneModel &scene_model = scene_models_.at(scene_model_name);
+  scene_model.BakeInstanceMatrices();
+  const glm::mat4 model_trans = scene_model.GetTrans();
+  const size_t num_instancing = scene_model.GetNumInstancing();
+  // Get the dirty range
+  size_t begin = 0;
+  size_t end = 0;
+  if (scene_model.HasDirtyInstances()) {
+    begin = scene_model.GetDirtyInstanceBegin();
+    end = std::min(scene_model.GetDirtyInstanceEnd(), num_instancing);
+  }
+
+  // Calculate the local bounding box of all meshes
+  if (instance_bounds_.count(scene_model_name) == 0) {
+    InstanceBounds instance_bounds;
+    instance_bounds.model_trans = model_trans;
+    instance_bounds.min_pos = glm::vec3(std::numeric_limits<float>::max());
+    instance_bounds.max_pos = glm::vec3(std::numeric_limits<float>::lowest());
+    for (const MeshDrawInfo &mesh_draw_info : mesh_draw_infos_) {
+      if (mesh_draw_info.scene_model_name != scene_model_name) {
+        continue;
+      }
+      instance_bounds.min_pos =
+          glm::min(instance_bounds.min_pos, mesh_draw_info.min_pos);
+      instance_bounds.max_pos =
+          glm::max(instance_bounds.max_pos, mesh_draw_info.max_pos);
+    }
+    instance_bounds_[scene_model_name] = instance_bounds;
+  }
+  InstanceBounds &instance_bounds = instance_bounds_.at(scene_model_name);
+
+  // Check whether all bounds should be recalculated
+  if (instance_bounds.model_trans != model_trans ||
+      instance_bounds.instance_transforms.size() != num_instancing) {
+    instance_bounds.model_trans = model_trans;
+    instance_bounds.instance_transforms.resize(num_instancing);
+    instance_bounds.aabb_batch.Resize(num_instancing);
+    begin = 0;
+    end = num_instancing;
+  }
+
+  // Calculate the world bounding boxes
+  for (size_t instance_idx = begin; instance_idx < end; instance_idx++) {
+    const glm::mat4 instance_transform =
+        scene_model.GetInstanceModel(instance_idx);
+    glm::vec3 center;
+    glm::vec3 extent;
+    as::Frustum::TransformAabb(instance_transform, instance_bounds.min_pos,
+                               instance_bounds.max_pos, center, extent);
+    instance_bounds.instance_transforms[instance_idx] = instance_transform;
+    instance_bounds.aabb_batch.SetAabb(instance_idx, center, extent);
+  }
+
+  changed_begin = begin;
+  changed_end = end;
+}
+
+/*
+ * Refits the BVH with the changed bounds. The BVH is rebuilt when the number
+ * of instances changes, or when the refitted tree costs much more than the
+ * built tree because the instances have moved far.
+ */
+void shader::SceneShader::UpdateBvh() {
+  std::map<std::string, size_t> item_ofses;
+  std::vector<std::tuple<size_t, size_t, size_t>> changed_item_ranges;
+  size_t num_items = 0;
+
+  // Update the bounds
+  for (const auto &pair : scene_models_) {
+    const std::string &scene_model_name = pair.first;
+    size_t changed_begin;
+    size_t changed_end;
+    UpdateInstanceBounds(scene_model_name, changed_begin, changed_end);
+    UpdateCasterState(scene_model_name, changed_begin < changed_end);
+    const InstanceBounds &instance_bounds =
+        instance_bounds_.at(scene_model_name);
+    item_ofses[scene_model_name] = num_items;
+    changed_item_ranges.push_back(
+        std::make_tuple(num_items, changed_begin, changed_end));
+    num_items += instance_bounds.instance_transforms.size();
+  }
+
+  // Rebuild the BVH when the items are rearranged
+  if (item_ofses != bvh_item_ofses_ || num_items != bvh_.GetNumItems()) {
+    bvh_item_ofses_ = item_ofses;
+    BuildBvh();
+    return;
+  }
+
+  // Update the changed items
+  size_t scene_model_idx = 0;
+  for (const auto &pair : scene_models_) {
+    const as::AabbBatch &aabb_batch =
+        instance_bounds_.at(pair.first).aabb_batch;
+    const size_t item_ofs = std::get<0>(changed_item_ranges[scene_model_idx]);
+    const size_t begin = std::get<1>(changed_item_ranges[scene_model_idx]);
+    const size_t end = std::get<2>(changed_item_ranges[scene_model_idx]);
+    for (size_t instance_idx = begin; instance_idx < end; instance_idx++) {
+      const glm::vec3 center = aabb_batch.GetCenter(instance_idx);
+      const glm::vec3 extent = aabb_batch.GetExtent(instance_idx);
+      bvh_.UpdateItem(item_ofs + instance_idx, center - extent,
+                      center + extent);
+    }
+    scene_model_idx++;
+  }
+
+  // Refit the BVH and check whether its quality has degraded
+  bvh_.Refit();
+  if (bvh_.GetCost() > kBvhRebuildCostRatio * bvh_.GetBuiltCost()) {
+    BuildBvh();
+  }
+}
+
+void shader::SceneShader::BuildBvh() {
+  std::vector<glm::vec3> min_poses;
+  std::vector<glm::vec3> max_poses;
+  for (const auto &pair : scene_models_) {
+    const as::AabbBatch &aabb_batch =
+        instance_bounds_.at(pair.first).aabb_batch;
+    for (size_t instance_idx = 0; instance_idx < aabb_batch.GetNumAabbs();
+         instance_idx++) {
+      const glm::vec3 center = aabb_batch.GetCenter(instance_idx);
+      const glm::vec3 extent = aabb_batch.GetExtent(instance_idx);
+      min_poses.push_back(center - extent);
+      max_poses.push_back(center + extent);
+    }
+  }
+  bvh_.Build(min_poses, max_poses);
+}
+
+void shader::SceneShader::UpdateCasterState(
+    const std::string &scene_model_name, const bool is_changed) {
+  // The models start as static casters
+  if (num_still_frames_.count(scene_model_name) == 0) {
+    num_still_frames_[scene_model_name] = kNumStaticCasterFrames;
+    static_casters_version_++;
+    return;
+  }
+  // Count the frames since the last change
+  const bool was_dynamic = IsDynamicCaster(scene_model_name);
+  unsigned int &num_still_frames = num_still_frames_.at(scene_model_name);
+  if (is_changed) {
+    num_still_frames = 0;
+  } else if (num_still_frames < kNumStaticCasterFrames) {
+    num_still_frames++;
+  }
+  // Invalidate the static casters when the model starts or stops moving
+  if (IsDynamicCaster(scene_model_name) != was_dynamic) {
+    static_casters_version_++;
+  }
+}
+
+bool shader::SceneShader::FindBvhItem(const size_t item_idx,
+                                      std::string &scene_model_name,
+                                      size_t &instance_idx) const {
+  for (const auto &pair : bvh_item_ofses_) {
+    const size_t item_ofs = pair.second;
+    const size_t num_instancing =
+        instance_bounds_.at(pair.first).instance_transforms.size();
+    if (item_idx >= item_ofs && item_idx < item_ofs + num_instancing) {
+      scene_model_name = pair.first;
+      instance_idx = item_idx - item_ofs;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Rasterizes the occluders visible from the camera into the occlusion buffer,
+ * and removes the other instances whose bounds are hidden behind them from the
+ * camera view. The occluders themselves are never occlusion-culled.
+ */
+void shader::SceneShader::CullOccludedInstances(
+    const glm::mat4 &view_proj, std::vector<unsigned char> &camera_visibles) {
+  /* Rasterize the occluders */
+  occlusion_buffer_.Clear(view_proj);
+  for (const std::string &scene_model_name : kOccluderSceneModelNames) {
+    const dto::SceneModel &scene_model = scene_models_.at(scene_model_name);
+    const InstanceBounds &instance_bounds =
+        instance_bounds_.at(scene_model_name);
+    const size_t item_ofs = bvh_item_ofses_.at(scene_model_name);
+    const size_t num_camera_instances = GetNumCameraInstances(scene_model);
+    for (size_t instance_idx = 0; instance_idx < num_camera_instances;
+         instance_idx++) {
+      if (!camera_visibles[item_ofs + instance_idx]) {
+        continue;
+      }
+      for (const OccluderMesh &occluder_mesh :
+           occluder_meshes_.at(scene_model_name)) {
+        occlusion_buffer_.AddOccluder(
+            instance_bounds.instance_transforms[instance_idx],
+            occluder_mesh.poses, occluder_mesh.idxs);
+      }
+    }
+  }
+  occlusion_buffer_.Rasterize();
+
+  /* Test the other instances */
+  for (const auto &pair : scene_models_) {
+    const std::string &scene_model_name = pair.first;
+    if (std::find(kOccluderSceneModelNames.begin(),
+                  kOccluderSceneModelNames.end(),
+                  scene_model_name) != kOccluderSceneModelNames.end()) {
+      continue;
+    }
+    const as::AabbBatch &aabb_batch =
+        instance_bounds_.at(scene_model_name).aabb_batch;
+    const size_t item_ofs = bvh_item_ofses_.at(scene_model_name);
+    const size_t num_camera_instances = GetNumCameraInstances(pair.second);
+    for (size_t instance_idx = 0; instance_idx < num_camera_instances;
+         instance_idx++) {
+      unsigned char &camera_visible = camera_visibles[item_ofs + instance_idx];
+      if (!camera_visible) {
+        continue;
+      }
+      const glm::vec3 center = aabb_batch.GetCenter(instance_idx);
+      const glm::vec3 extent = aabb_batch.GetExtent(instance_idx);
+      if (!occlusion_buffer_.TestAabb(center - extent, center + extent)) {
+        camera_visible = 0;
+        culling_stats_.num_occluded_instances++;
+      }
+    }
+  }
+}
+
+/*
+ * The camera only draws the first instance without instantiating, and draws
+ * nothing when the model isn't visible
+ */
+size_t shader::SceneShader::GetNumCameraInstances(
+    const dto::SceneModel &scene_model) const {
+  if (!scene_model.IsVisible()) {
+    return 0;
+  }
+  const size_t num_instancing = scene_model.GetNumInstancing();
+  return use_instantiating_ ? num_instancing
+                            : std::min(num_instancing, static_cast<size_t>(1));
+}
+
+shader::SceneShader::VisibleInstances
+shader::SceneShader::CollectVisibleInstances(
+    const std::string &scene_model_name,
+    const std::vector<as::Frustum> &cascade_frusta,
+    const unsigned char *camera_visibles,
+    const unsigned char *light_visibles) {
+  // Get the scene model
+  const dto::SceneModel &scene_model = scene_models_.at(scene_model_name);
+  // Get the bounds
+  const InstanceBounds &instance_bounds = instance_bounds_.at(scene_model_name);
+  const size_t num_instancing = instance_bounds.instance_transforms.size();
+
+  // The light always draws all instances of the shadow casters
+  const size_t num_camera_instances = GetNumCameraInstances(scene_model);
+  const bool is_shadow_caster = IsShadowCaster(scene_model_name);
+  VisibleInstances visible_instances;
+  std::vector<size_t> light_instance_idxs;
+  for (size_t instance_idx = 0; instance_idx < num_instancing; instance_idx++) {
+    if (instance_idx < num_camera_instances && camera_visibles[instance_idx]) {
+      visible_instances.camera_instance_idxs.push_back(instance_idx);
+    }
+    if (is_shadow_caster && light_visibles[instance_idx]) {
+      light_instance_idxs.push_back(instance_idx);
+    }
+  }
+  // Test the light instances against each cascade
+  visible_instances.cascade_instance_idxs.resize(cascade_frusta.size());
+  if (!light_instance_idxs.empty()) {
+    std::vector<unsigned char> cascade_visibles;
+    for (size_t cascade_idx = 0; cascade_idx < cascade_frusta.size();
+         cascade_idx++) {
+      cascade_frusta[cascade_idx].TestAabbs(instance_bounds.aabb_batch,
+                                            cascade_visibles);
+      for (const size_t instance_idx : light_instance_idxs) {
+        if (cascade_visibles[instance_idx]) {
+          visible_instances.cascade_instance_idxs[cascade_idx].push_back(
+              instance_idx);
+        }
+      }
+    }
+  }
+  culling_stats_.num_instances += static_cast<unsigned int>(num_instancing);
+  culling_stats_.num_camera_visible_instances += static_cast<unsigned int>(
+      visible_instances.camera_instance_idxs.size());
+  culling_stats_.num_light_visible_instances +=
+      static_cast<unsigned int>(light_instance_idxs.size());
+  return visible_instances;
+}
+
+/*
+ * Each mesh appends the visible instances of the meshes it draws, so the
+ * batched meshes get empty ranges and are skipped by all passes. The model
+ * indexes in the merged buffers still select the parameters of each model.
+ * The camera instances of each mesh are grouped by the material tiers, and
+ * the fragment costs of the tiers are estimated at the same time. Only the
+ * sources of the instances are compacted here, the matrices are copied when
+ * the buffers are updated.
+ */
+void shader::SceneShader::CompactSceneModelInstances(
+    const std::string &scene_model_name, const as::Frustum &camera_frustum,
+    const std::vector<as::Frustum> &cascade_frusta,
+    const std::map<std::string, VisibleInstances> &visible_instances,
+    const std::vector<const dto::SceneModel *> &indexed_scene_models,
+    std::vector<CompactedInstance> &merged_compacted_instances) {
+  // Get the scene model
+  const dto::SceneModel &scene_model = scene_models_.at(scene_model_name);
+  // Get names
+  const std::string matrices_buffer_name =
+      GetInstancingMatricesBufferName(scene_model);
+
+  // The camera is followed by the cascades
+  std::vector<CompactedInstance> compacted_instances;
+  for (size_t view_idx = 0; view_idx <= cascade_frusta.size(); view_idx++) {
+    const bool is_camera = view_idx == 0;
+    const as::Frustum &frustum =
+        is_camera ? camera_frustum : cascade_frusta[view_idx - 1];
+    std::vector<VisibleRange> &visible_ranges =
+        is_camera ? camera_visible_ranges_
+                  : cascade_visible_ranges_[view_idx - 1];
+    for (size_t info_idx = 0; info_idx < mesh_draw_infos_.size(); info_idx++) {
+      const MeshDrawInfo &mesh_draw_info = mesh_draw_infos_.at(info_idx);
+      if (mesh_draw_info.scene_model_name != scene_model_name) {
+        continue;
+      }
+      const GLuint base_instance =
+          static_cast<GLuint>(compacted_instances.size());
+      // Save the base instance in the merged buffers
+      if (is_camera) {
+        mesh_indirect_cmds_.at(info_idx).base_instance =
+            static_cast<GLuint>(merged_compacted_instances.size());
+      }
+      const std::vector<size_t> &batched_info_idxs =
+          batched_info_idxs_.at(info_idx);
+      // Test the meshes in the visible instances of the batched models
+      std::vector<std::vector<size_t>> batched_instance_idxs;
+      for (const size_t batched_info_idx : batched_info_idxs) {
+        const MeshDrawInfo &batched_info =
+            mesh_draw_infos_.at(batched_info_idx);
+        const std::string &batched_name = batched_info.scene_model_name;
+        const VisibleInstances &batched_instances =
+            visible_instances.at(batched_name);
+        const std::vector<size_t> &instance_idxs =
+            is_camera ? batched_instances.camera_instance_idxs
+                      : batched_instances.cascade_instance_idxs[view_idx - 1];
+        batched_instance_idxs.push_back(
+            CullMeshInstances(frustum, instance_bounds_.at(batched_name),
+                              batched_info, instance_idxs));
+        if (batched_info_idx != info_idx &&
+            !batched_instance_idxs.back().empty()) {
+          batching_stats_.num_batched_draws++;
+        }
+      }
+      // Append the instance matrices of each tier, the cascades only have the
+      // full tier
+      const GLuint num_tiers = is_camera ? GetNumMaterialTiers() : 1;
+      for (GLuint tier_idx = 0; tier_idx < num_tiers; tier_idx++) {
+        const GLuint tier_base_instance =
+            static_cast<GLuint>(compacted_instances.size());
+        for (size_t batch_idx = 0; batch_idx < batched_info_idxs.size();
+             batch_idx++) {
+          const MeshDrawInfo &batched_info =
+              mesh_draw_infos_.at(batched_info_idxs[batch_idx]);
+          const std::string &batched_name = batched_info.scene_model_name;
+          const dto::SceneModel &batched_model = scene_models_.at(batched_name);
+          const GLuint batched_model_idx = scene_model_idxs_.at(batched_name);
+          // Get the fragment costs of the mesh
+          float full_cost = 0.0f;
+          float tier_cost = 0.0f;
+          if (is_camera) {
+            const bool use_env_map = batched_model.GetUseEnvMap();
+            full_cost = EstimateFragmentCost(batched_info, use_env_map,
+                                             kFullMaterialTier);
+            tier_cost = EstimateFragmentCost(batched_info, use_env_map,
+                                             GetMaterialTier(tier_idx));
+          }
+          for (const size_t instance_idx : batched_instance_idxs[batch_idx]) {
+            if (is_camera) {
+              const InstanceLod &instance_lod =
+                  instance_lods_.at(batched_name).at(instance_idx);
+              if (instance_lod.material_tier_idx != tier_idx) {
+                continue;
+              }
+              material_lod_stats_.full_fragment_cost +=
+                  instance_lod.screen_coverage * full_cost;
+              material_lod_stats_.tier_fragment_cost +=
+                  instance_lod.screen_coverage * tier_cost;
+            }
+            const CompactedInstance compacted_instance =
+                std::make_tuple(batched_model_idx, instance_idx);
+            compacted_instances.push_back(compacted_instance);
+            if (is_camera) {
+              merged_compacted_instances.push_back(compacted_instance);
+            }
+          }
+        }
+        // Save the range of the tier
+        if (is_camera) {
+          camera_tier_ranges_.at(tier_idx).at(info_idx) = VisibleRange{
+              tier_base_instance,
+              static_cast<GLuint>(compacted_instances.size()) -
+                  tier_base_instance};
+        }
+      }
+      // Save the range in the model buffers
+      visible_ranges.at(info_idx) = VisibleRange{
+          base_instance,
+          static_cast<GLuint>(compacted_instances.size()) - base_instance};
+    }
+  }
+
+  /* Update buffers */
+  UploadCompactedInstances(matrices_buffer_name, compacted_instances,
+                           indexed_scene_models);
+}
+
+/*
+ * Orphans the buffer with the compacted instances when they differ from the
+ * last upload, which happens when the visible sets, the tiers or the batches
+ * change. Otherwise only the compacted instances in the dirty ranges of their
+ * models are sent again, so nothing is sent when no instance has changed.
+ * Returns whether the buffer is orphaned.
+ */
+bool shader::SceneShader::UploadCompactedInstances(
+    const std::string &buffer_name,
+    const std::vector<CompactedInstance> &compacted_instances,
+    const std::vector<const dto::SceneModel *> &indexed_scene_models) {
+  // Check whether the buffer holds the same instances
+  const auto it = compacted_instances_.find(buffer_name);
+  if (it == compacted_instances_.end() || it->second != compacted_instances) {
+    std::vector<dto::SceneModel::InstanceMatrices> matrices;
+    matrices.reserve(compacted_instances.size());
+    for (const CompactedInstance &compacted_instance : compacted_instances) {
+      const dto::SceneModel &scene_model =
+          *indexed_scene_models.at(std::get<0>(compacted_instance));
+      matrices.push_back(
+          scene_model.GetInstanceMatrices()[std::get<1>(compacted_instance)]);
+    }
+    UploadInstancing(buffer_name, matrices);
+    compacted_instances_[buffer_name] = compacted_instances;
+    instancing_stats_.num_updated_instances +=
+        static_cast<unsigned int>(matrices.size());
+    return true;
+  }
+
+  // Send each run of the dirty instances
+  std::vector<dto::SceneModel::InstanceMatrices> run_matrices;
+  size_t run_begin = 0;
+  for (size_t idx = 0; idx <= compacted_instances.size(); idx++) {
+    if (idx < compacted_instances.size()) {
+      const dto::SceneModel &scene_model =
+          *indexed_scene_models.at(std::get<0>(compacted_instances[idx]));
+      const size_t instance_idx = std::get<1>(compacted_instances[idx]);
+      if (scene_model.HasDirtyInstances() &&
+          instance_idx >= scene_model.GetDirtyInstanceBegin() &&
+          instance_idx < scene_model.GetDirtyInstanceEnd()) {
+        if (run_matrices.empty()) {
+          run_begin = idx;
+        }
+        run_matrices.push_back(scene_model.GetInstanceMatrices()[instance_idx]);
+        continue;
+      }
+    }
+    if (!run_matrices.empty()) {
+      StreamInstancingRange(buffer_name, run_matrices, 0, run_begin,
+                            run_matrices.size());
+      instancing_stats_.num_updated_instances +=
+          static_cast<unsigned int>(run_matrices.size());
+      run_matrices.clear();
+    }
+  }
+  return false;
+}
+
+/*
+ * Tests the bounds of the mesh in the visible instances. The test is skipped
+ * when the model only has one mesh, whose bounds are the instance bounds.
+ */
+std::vector<size_t> shader::SceneShader::CullMeshInstances(
+    const as::Frustum &frustum, const InstanceBounds &instance_bounds,
+    const MeshDrawInfo &mesh_draw_info,
+    const std::vector<size_t> &instance_idxs) const {
+  const dto::SceneModel &scene_model =
+      scene_models_.at(mesh_draw_info.scene_model_name);
+  if (scene_model.GetModel().GetMeshes().size() <= 1) {
+    return instance_idxs;
+  }
+  // Calculate the world bounding boxes of the mesh
+  as::AabbBatch aabb_batch;
+  for (const size_t instance_idx : instance_idxs) {
+    glm::vec3 center;
+    glm::vec3 extent;
+    as::Frustum::TransformAabb(
+        instance_bounds.instance_transforms.at(instance_idx),
+        mesh_draw_info.min_pos, mesh_draw_info.max_pos, center, extent);
+    aabb_batch.AddAabb(center, extent);
+  }
+  // Test the bounding boxes
+  std::vector<unsigned char> visibles;
+  frustum.TestAabbs(aabb_batch, visibles);
+  std::vector<size_t> visible_instance_idxs;
+  for (size_t idx = 0; idx < instance_idxs.size(); idx++) {
+    if (visibles[idx]) {
+      visible_instance_idxs.push_back(instance_idxs[idx]);
+    }
+  }
+  return visible_instance_idxs;
+}
+
+/*******************************************************************************
+ * Mesh Batching (Private)
+ ******************************************************************************/
+
+/*
+ * Hashes the bytes of the vertices and the indexes with FNV-1a, the vertices
+ * have no paddings
+ */
+uint64_t shader::SceneShader::HashMeshGeometry(
+    const std::vector<as::Vertex> &vertices, const std::vector<size_t> &idxs) {
+  GLuint64 hash = as::kHashOffsetBasis;
+  hash = as::HashBytes(vertices.data(), vertices.size() * sizeof(as::Vertex),
+                       hash);
+  hash = as::HashBytes(idxs.data(), idxs.size() * sizeof(size_t), hash);
+  return hash;
+}
+
+/*
+ * Compares the geometry byte by byte, so that the meshes with colliding hashes
+ * are never batched
+ */
+bool shader::SceneShader::HasSameGeometry(
+    const size_t mesh_draw_info_idx, const std::vector<as::Vertex> &vertices,
+    const std::vector<size_t> &idxs) const {
+  const MeshDrawInfo &mesh_draw_info = mesh_draw_infos_.at(mesh_draw_info_idx);
+  const as::Mesh &mesh = scene_models_.at(mesh_draw_info.scene_model_name)
+                             .GetModel()
+                             .GetMeshes()
+                             .at(mesh_draw_info.mesh_idx);
+  const std::vector<as::Vertex> other_vertices = mesh.GetVertices();
+  if (other_vertices.size() != vertices.size() || mesh.GetIdxs() != idxs) {
+    return false;
+  }
+  return std::memcmp(other_vertices.data(), vertices.data(),
+                     vertices.size() * sizeof(as::Vertex)) == 0;
+}
+
+/*
+ * The models could share draws when the draws of one model would look the
+ * same with the other model. The draws without indirect drawing use the
+ * lighting of the drawing model, and the shadow caster states decide which
+ * shadow passes draw the instances.
+ */
+bool shader::SceneShader::CanBatchSceneModels(
+    const std::string &scene_model_name1,
+    const std::string &scene_model_name2) const {
+  if (scene_model_name1 == scene_model_name2) {
+    return true;
+  }
+  const dto::SceneModel &scene_model1 = scene_models_.at(scene_model_name1);
+  const dto::SceneModel &scene_model2 = scene_models_.at(scene_model_name2);
+  return scene_model1.IsVisible() == scene_model2.IsVisible() &&
+         scene_model1.GetUseEnvMap() == scene_model2.GetUseEnvMap() &&
+         scene_model1.GetLightPos() == scene_model2.GetLightPos() &&
+         scene_model1.GetLightColor() == scene_model2.GetLightColor() &&
+         scene_model1.GetLightIntensity() ==
+             scene_model2.GetLightIntensity() &&
+         IsShadowCaster(scene_model_name1) ==
+             IsShadowCaster(scene_model_name2) &&
+         IsDynamicCaster(scene_model_name1) ==
+             IsDynamicCaster(scene_model_name2);
+}
+
+/*
+ * Each shared mesh is drawn by the first mesh of the same geometry and
+ * material whose model could be batched with its model. The batches are
+ * updated in each frame because the model states could change.
+ */
+void shader::SceneShader::UpdateMeshBatches() {
+  batching_stats_ = BatchingStats{0, 0};
+  batched_info_idxs_.assign(mesh_draw_infos_.size(), std::vector<size_t>());
+  for (size_t info_idx = 0; info_idx < mesh_draw_infos_.size(); info_idx++) {
+    const MeshDrawInfo &mesh_draw_info = mesh_draw_infos_.at(info_idx);
+    const size_t shared_info_idx = mesh_draw_info.shared_info_idx;
+    if (shared_info_idx != info_idx) {
+      batching_stats_.num_shared_meshes++;
+    }
+    // Find the mesh which draws the same mesh of a compatible model
+    size_t drawing_info_idx = info_idx;
+    if (use_mesh_batching_) {
+      for (size_t other_idx = shared_info_idx; other_idx < info_idx;
+           other_idx++) {
+        const MeshDrawInfo &other_info = mesh_draw_infos_.at(other_idx);
+        if (!batched_info_idxs_.at(other_idx).empty() &&
+            other_info.shared_info_idx == shared_info_idx &&
+            CanBatchSceneModels(other_info.scene_model_name,
+                                mesh_draw_info.scene_model_name)) {
+          drawing_info_idx = other_idx;
+          break;
+        }
+      }
+    }
+    batched_info_idxs_.at(drawing_info_idx).push_back(info_idx);
+  }
+}
+
+/*******************************************************************************
+ * Material LOD (Private)
+ ******************************************************************************/
+
+GLuint shader::SceneShader::GetNumMaterialTiers() const {
+  return static_cast<GLuint>(material_tiers_.size()) + 1;
+}
+
+/*
+ * Tier 0 is the full material, the reduced tiers follow
+ */
+const shader::SceneShader::MaterialTier &shader::SceneShader::GetMaterialTier(
+    const GLuint material_tier_idx) const {
+  if (material_tier_idx == 0) {
+    return kFullMaterialTier;
+  }
+  return material_tiers_.at(material_tier_idx - 1);
+}
+
+void shader::SceneShader::ResetMaterialLodStats() {
+  material_lod_stats_.num_tier_instances.assign(kMaxNumMaterialTiers, 0);
+  material_lod_stats_.full_fragment_cost = 0.0f;
+  material_lod_stats_.tier_fragment_cost = 0.0f;
+}
+
+/*
+ * Selects the farthest tier whose distance or screen size is reached by the
+ * bounding sphere of each camera instance. The sphere covers the whole screen
+ * when the camera is inside it.
+ */
+void shader::SceneShader::SelectMaterialTiers(
+    const std::string &scene_model_name,
+    const std::vector<size_t> &instance_idxs) {
+  // Get the bounds
+  const as::AabbBatch &aabb_batch =
+      instance_bounds_.at(scene_model_name).aabb_batch;
+  std::vector<InstanceLod> &instance_lods = instance_lods_[scene_model_name];
+  instance_lods.resize(aabb_batch.GetNumAabbs());
+  // Get the projection scales and the viewing position
+  const float proj_scale_x = global_trans_.proj[0][0];
+  const float proj_scale_y = global_trans_.proj[1][1];
+  const glm::vec3 view_pos = lighting_.view_pos;
+
+  for (const size_t instance_idx : instance_idxs) {
+    // Get the bounding sphere in the world space
+    const glm::vec3 center = glm::vec3(
+        global_trans_.model *
+        glm::vec4(aabb_batch.GetCenter(instance_idx), 1.0f));
+    const float radius = glm::length(aabb_batch.GetExtent(instance_idx));
+    const float dist = glm::distance(view_pos, center);
+    // Project the radius into the NDC, which is 2 by 2
+    float screen_size = std::numeric_limits<float>::max();
+    float screen_coverage = 1.0f;
+    if (dist > radius) {
+      const glm::vec2 ndc_radius =
+          radius * glm::vec2(proj_scale_x, proj_scale_y) / dist;
+      screen_size = ndc_radius.y;
+      screen_coverage = std::min(
+          glm::pi<float>() * ndc_radius.x * ndc_radius.y / 4.0f, 1.0f);
+    }
+    // Select the tier
+    GLuint tier_idx = 0;
+    if (use_material_lod_) {
+      for (size_t idx = 0; idx < material_tiers_.size(); idx++) {
+        const MaterialTier &material_tier = material_tiers_[idx];
+        if (dist >= material_tier.min_distance ||
+            screen_size <= material_tier.max_screen_size) {
+          tier_idx = static_cast<GLuint>(idx) + 1;
+        }
+      }
+    }
+    instance_lods[instance_idx] = InstanceLod{tier_idx, screen_coverage};
+    material_lod_stats_.num_tier_instances.at(tier_idx)++;
+  }
+}
+
+/*
+ * Estimates the texture fetches of a fragment. Each color texture runs its own
+ * parallax loop, and the fetches of the point lights and the fog are the same
+ * in all tiers, so they aren't counted.
+ */
+float shader::SceneShader::EstimateFragmentCost(
+    const MeshDrawInfo &mesh_draw_info, const bool use_env_map,
+    const MaterialTier &material_tier) const {
+  const as::Material &material = mesh_draw_info.material;
+  const bool use_height_tex = use_normal_height_ &&
+                              material.HasHeightTexture() &&
+                              material_tier.parallax_layers_scale > 0.0f;
+  const float num_color_fetches =
+      use_height_tex
+          ? 1.0f + kNumParallaxFetches * material_tier.parallax_layers_scale
+          : 1.0f;
+  float cost = 0.0f;
+  // Color textures
+  const bool use_color_texes[] = {material.HasAmbientTexture(),
+                                  material.HasDiffuseTexture(),
+                                  material.HasSpecularTexture()};
+  for (const bool use_color_tex : use_color_texes) {
+    if (use_color_tex) {
+      cost += num_color_fetches;
+    }
+  }
+  // Normals texture
+  if (use_normal_height_ && material.HasNormalsTexture()) {
+    cost += 1.0f;
+  }
+  // Shadow taps
+  cost += use_pcf_ && material_tier.use_pcf ? kNumPcfFetches : 1.0f;
+  // Environment map
+  if (use_env_map && material_tier.use_env_map) {
+    cost += 1.0f;
+  }
+  return cost;
+}
+
+/*******************************************************************************
+ * Light Clusters (Private)
+ ******************************************************************************/
+
+/*
+ * Runs on another thread while the instances are culled, so it only touches
+ * the light states
+ */
+void shader::SceneShader::AssignLightClusters() {
+  const auto start_time = std::chrono::steady_clock::now();
+  light_clusters_.Assign(global_trans_.proj,
+                         global_trans_.view * global_trans_.model,
+                         kLightClusterNearDepth, kLightClusterFarDepth,
+                         point_lights_);
+  const auto end_time = std::chrono::steady_clock::now();
+  // Update the statistics
+  const std::chrono::duration<double> assign_duration = end_time - start_time;
+  light_cluster_stats_.num_point_lights =
+      static_cast<unsigned int>(point_lights_.size());
+  light_cluster_stats_.num_light_refs =
+      static_cast<unsigned int>(light_clusters_.GetLightIdxs().size());
+  light_cluster_stats_.max_num_cluster_lights =
+      light_clusters_.GetMaxNumClusterLights();
+  light_cluster_stats_.assign_seconds = assign_duration.count();
+}
+
+/*
+ * Orphans the storage buffers with the lights of this frame, the sizes change
+ * with the number of lights. The buffers keep at least one element.
+ */
+void shader::SceneShader::UploadLightClusters() {
+  // Get managers
+  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  // Get names
+  const std::string params_buffer_name = GetLightClustersBufferName();
+  const std::string point_lights_buffer_name = GetPointLightsBufferName();
+  const std::string ranges_buffer_name = GetClusterRangesBufferName();
+  const std::string light_idxs_buffer_name = GetClusterLightIdxsBufferName();
+  // Get the assigned lights
+  const std::vector<as::LightClusters::ClusterRange> &cluster_ranges =
+      light_clusters_.GetClusterRanges();
+  const std::vector<GLuint> &light_idxs = light_clusters_.GetLightIdxs();
+
+  /* Update storage buffers */
+  buffer_manager.InitBuffer(
+      point_lights_buffer_name, GL_SHADER_STORAGE_BUFFER,
+      std::max(point_lights_.size(), static_cast<size_t>(1)) *
+          sizeof(as::LightClusters::PointLight),
+      nullptr, GL_DYNAMIC_DRAW);
+  if (!point_lights_.empty()) {
+    buffer_manager.UpdateBuffer(
+        point_lights_buffer_name, GL_SHADER_STORAGE_BUFFER, 0,
+        point_lights_.size() * sizeof(as::LightClusters::PointLight),
+        point_lights_.data());
+  }
+  buffer_manager.InitBuffer(
+      ranges_buffer_name, GL_SHADER_STORAGE_BUFFER,
+      cluster_ranges.size() * sizeof(as::LightClusters::ClusterRange),
+      cluster_ranges.data(), GL_DYNAMIC_DRAW);
+  buffer_manager.InitBuffer(
+      light_idxs_buffer_name, GL_SHADER_STORAGE_BUFFER,
+      std::max(light_idxs.size(), static_cast<size_t>(1)) * sizeof(GLuint),
+      nullptr, GL_DYNAMIC_DRAW);
+  if (!light_idxs.empty()) {
+    buffer_manager.UpdateBuffer(light_idxs_buffer_name,
+                                GL_SHADER_STORAGE_BUFFER, 0,
+                                light_idxs.size() * sizeof(GLuint),
+                                light_idxs.data());
+  }
+
+  /* Update uniform buffer */
+  const glm::mat4 &proj = global_trans_.proj;
+  light_cluster_params_.grid_size = glm::uvec4(
+      light_clusters_.GetNumTilesX(), light_clusters_.GetNumTilesY(),
+      light_clusters_.GetNumSlices(), point_lights_.size());
+  light_cluster_params_.proj_params =
+      glm::vec4(proj[0][0], proj[1][1], proj[2][0], proj[2][1]);
+  light_cluster_params_.slice_params = glm::vec4(
+      light_clusters_.GetSliceScale(), light_clusters_.GetSliceBias(), 0.0f,
+      0.0f);
+  buffer_manager.UpdateBuffer(params_buffer_name);
+}
+
+void shader::SceneShader::BindLightClusterBuffers() {
+  // Get managers
+  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  // Bind the storage buffers
+  buffer_manager.BindBufferBase(GetPointLightsBufferName(),
+                                GL_SHADER_STORAGE_BUFFER,
+                                kPointLightsBindingIdx);
+  buffer_manager.BindBufferBase(GetClusterRangesBufferName(),
+                                GL_SHADER_STORAGE_BUFFER,
+                                kClusterRangesBindingIdx);
+  buffer_manager.BindBufferBase(GetClusterLightIdxsBufferName(),
+                                GL_SHADER_STORAGE_BUFFER,
+                                kClusterLightIdxsBindingIdx);
 }
 
 /*******************************************************************************
  * GL Drawing Methods (Private)
  ******************************************************************************/
 
-void shader::SceneShader::DrawModel(const dto::SceneModel &scene_model) {
+/*
+ * Draws the visible instances of the pre-passed meshes into the depth buffer
+ * with the positions only. The colors aren't written.
+ */
+void shader::SceneShader::DrawDepthPrepass() {
   // Get managers
-  as::TextureManager &texture_manager = gl_managers_->GetTextureManager();
-  as::UniformManager &uniform_manager = gl_managers_->GetUniformManager();
+  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
+  const as::ProgramManager &program_manager =
+      gl_managers_->GetProgramManager();
+  const as::VertexSpecManager &vertex_spec_manager =
+      gl_managers_->GetVertexSpecManager();
+  // Get names
+  const std::string idxs_buffer_name = GetIndirectIdxsBufferName();
+
+  program_manager.UseProgram(GetPrepassProgramName());
+  trace_manager.RecordCall(
+      "glColorMask", {GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE}, 0,
+      [&] { glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE); });
+  UseSceneDepthTest(false);
+
+  std::string prev_scene_model_name;
+  for (size_t info_idx = 0; info_idx < mesh_draw_infos_.size(); info_idx++) {
+    const MeshDrawInfo &mesh_draw_info = mesh_draw_infos_.at(info_idx);
+    const dto::SceneModel &scene_model =
+        scene_models_.at(mesh_draw_info.scene_model_name);
+    const VisibleRange visible_range =
+        GetVisibleRange(CullingViews::kCamera, info_idx);
+    if (!mesh_draw_info.use_depth_prepass || !scene_model.IsVisible() ||
+        visible_range.num_instances == 0) {
+      continue;
+    }
+    // Use the vertex array of the model
+    if (mesh_draw_info.scene_model_name != prev_scene_model_name) {
+      vertex_spec_manager.BindVertexArray(
+          GetPrepassVertexArrayName(scene_model));
+      buffer_manager.BindBuffer(idxs_buffer_name, GL_ELEMENT_ARRAY_BUFFER);
+      prev_scene_model_name = mesh_draw_info.scene_model_name;
+    }
+    // Draw the visible instances of the mesh
+    const DrawElementsIndirectCmd &mesh_cmd = mesh_indirect_cmds_.at(info_idx);
+    const GLsizei num_idxs = static_cast<GLsizei>(mesh_cmd.count);
+    const GLvoid *idxs_ofs = reinterpret_cast<const GLvoid *>(
+        mesh_cmd.first_idx * sizeof(GLuint));
+    const GLsizei num_instances =
+        static_cast<GLsizei>(visible_range.num_instances);
+    trace_manager.RecordCall(
+        "glDrawElementsInstancedBaseVertexBaseInstance",
+        {GL_TRIANGLES, num_idxs, num_instances, mesh_cmd.base_vertex,
+         visible_range.base_instance},
+        0, [&] {
+          glDrawElementsInstancedBaseVertexBaseInstance(
+              GL_TRIANGLES, num_idxs, GL_UNSIGNED_INT, idxs_ofs, num_instances,
+              mesh_cmd.base_vertex, visible_range.base_instance);
+        });
+    num_draw_calls_++;
+  }
+
+  trace_manager.RecordCall(
+      "glColorMask", {GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE}, 0,
+      [&] { glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE); });
+}
+
+/*
+ * The pre-passed meshes are drawn with the equal test and without writing the
+ * depths, so that only the nearest fragments are shaded
+ */
+void shader::SceneShader::UseSceneDepthTest(const bool is_prepassed) {
+  // Get managers
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
+  // Get the depth states
+  const GLenum depth_func = is_prepassed ? GL_EQUAL : GL_LEQUAL;
+  const GLboolean depth_mask = is_prepassed ? GL_FALSE : GL_TRUE;
+  trace_manager.RecordCall("glDepthFunc", {depth_func}, 0,
+                           [&] { glDepthFunc(depth_func); });
+  trace_manager.RecordCall("glDepthMask", {depth_mask}, 0,
+                           [&] { glDepthMask(depth_mask); });
+}
+
+void shader::SceneShader::RecordDrawCmds() {
+  // Get managers
+  const as::ProgramManager &program_manager =
+      gl_managers_->GetProgramManager();
+  // Get the viewing position for sorting from front to back
+  const glm::vec3 view_pos = lighting_.view_pos;
+
+  draw_list_.Clear();
+  draw_items_.clear();
+
+  std::string prev_scene_model_name;
+  GLintptr lighting_ofs = 0;
+  for (size_t info_idx = 0; info_idx < mesh_draw_infos_.size(); info_idx++) {
+    const MeshDrawInfo &mesh_draw_info = mesh_draw_infos_.at(info_idx);
+    const dto::SceneModel &scene_model =
+        scene_models_.at(mesh_draw_info.scene_model_name);
+
+    // Check whether the scene model isn't visible or all instances of the mesh
+    // are culled
+    if (!scene_model.IsVisible() ||
+        GetVisibleRange(CullingViews::kCamera, info_idx).num_instances == 0) {
+      continue;
+    }
+
+    // Update per-model states once for all meshes of the model
+    if (mesh_draw_info.scene_model_name != prev_scene_model_name) {
+      lighting_ofs = UpdateLighting(scene_model);
+      prev_scene_model_name = mesh_draw_info.scene_model_name;
+    }
+
+    // Calculate the depth of the mesh center
+    const glm::vec4 center =
+        scene_model.GetTrans() * glm::vec4(mesh_draw_info.center, 1.0f);
+    const float depth = glm::distance(view_pos, glm::vec3(center));
+
+    // Each material tier of the mesh is drawn separately
+    for (GLuint tier_idx = 0; tier_idx < GetNumMaterialTiers(); tier_idx++) {
+      if (GetMaterialTierRange(tier_idx, info_idx).num_instances == 0) {
+        continue;
+      }
+      // Update the mesh material with the tier
+      UpdateModelMaterial(scene_model);
+      const GLintptr model_material_ofs =
+          UpdateModelMaterial(mesh_draw_info.material, tier_idx);
+      // Select the program, the sort index identifies the program in the
+      // sort keys
+      const std::string program_name =
+          use_permutations_ ? SelectPermutationProgram(GetPermutationMask())
+                            : GetProgramName();
+      const GLuint program_sort_idx =
+          program_manager.GetProgramSortIdx(program_name);
+
+      // Record the draw command
+      const GLuint64 sort_key = as::DrawList::MakeSortKey(
+          kDrawPass, program_sort_idx, mesh_draw_info.material_idx,
+          as::DrawList::QuantizeDepth(depth, kMaxDrawDepth),
+          mesh_draw_info.va_idx);
+      draw_list_.AddDrawCmd(sort_key, draw_items_.size());
+      draw_items_.push_back(SceneDrawItem{info_idx, tier_idx, program_name,
+                                          lighting_ofs, model_material_ofs});
+    }
+  }
+}
+
+void shader::SceneShader::SubmitDrawCmds() {
+  // Get managers
+  const as::ProgramManager &program_manager =
+      gl_managers_->GetProgramManager();
+
+  bool was_prepassed = false;
+  for (const as::DrawList::DrawCmd &draw_cmd : draw_list_.GetDrawCmds()) {
+    const SceneDrawItem &draw_item = draw_items_.at(draw_cmd.item_idx);
+    const MeshDrawInfo &mesh_draw_info =
+        mesh_draw_infos_.at(draw_item.mesh_draw_info_idx);
+    const dto::SceneModel &scene_model =
+        scene_models_.at(mesh_draw_info.scene_model_name);
+    // Change the depth test only when the pre-pass state changes
+    const bool is_prepassed =
+        use_depth_prepass_ && mesh_draw_info.use_depth_prepass;
+    if (is_prepassed != was_prepassed) {
+      UseSceneDepthTest(is_prepassed);
+      was_prepassed = is_prepassed;
+    }
+    // Use the program and bind the per-draw data, the redundant bindings are
+    // skipped by the state manager
+    program_manager.UseProgram(draw_item.program_name);
+    BindUniformRingBufferRange(GetLightingBufferName(), draw_item.lighting_ofs,
+                               sizeof(lighting_));
+    BindUniformRingBufferRange(GetModelMaterialBufferName(),
+                               draw_item.model_material_ofs,
+                               sizeof(model_material_));
+    // Draw the visible instances of the mesh in the tier
+    DrawMesh(draw_item.program_name, scene_model, mesh_draw_info,
+             GetMaterialTierRange(draw_item.material_tier_idx,
+                                  draw_item.mesh_draw_info_idx));
+    num_draw_calls_++;
+  }
+}
+
+void shader::SceneShader::DrawMesh(const std::string &program_name,
+                                   const dto::SceneModel &scene_model,
+                                   const MeshDrawInfo &mesh_draw_info,
+                                   const VisibleRange &visible_range) {
+  // Get managers
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
   // Get names
-  const std::string program_name = GetProgramName();
   const std::string group_name = scene_model.GetVertexArrayGroupName();
-  // Get model
-  const as::Model &model = scene_model.GetModel();
-  // Get meshes
-  const std::vector<as::Mesh> &meshes = model.GetMeshes();
 
-  // Draw each mesh with its own texture
-  for (size_t mesh_idx = 0; mesh_idx < meshes.size(); mesh_idx++) {
-    const as::Mesh &mesh = meshes.at(mesh_idx);
-    // Get the array indexes
-    const std::vector<size_t> &idxs = mesh.GetIdxs();
-    // Get the material
-    const as::Material &material = mesh.GetMaterial();
-    // Get the textures
-    const std::set<as::Texture> &textures = material.GetTextures();
-    /* Update Material Colors */
-    UpdateModelMaterial(material);
-    /* Update Textures */
-    for (const as::Texture &texture : textures) {
-      const std::string &path = texture.GetPath();
-      const aiTextureType type = texture.GetType();
-      // Bind the texture
-      texture_manager.BindTexture(path);
-      // Get the unit index
-      const GLuint unit_idx = texture_manager.GetUnitIdx(path);
-      // Set the texture handler to the unit index
-      switch (type) {
-        case aiTextureType_AMBIENT: {
-          uniform_manager.SetUniform1Int(program_name, "ambient_tex", unit_idx);
-        } break;
-        case aiTextureType_DIFFUSE: {
-          uniform_manager.SetUniform1Int(program_name, "diffuse_tex", unit_idx);
-        } break;
-        case aiTextureType_SPECULAR: {
-          uniform_manager.SetUniform1Int(program_name, "specular_tex",
-                                         unit_idx);
-        } break;
-        case aiTextureType_HEIGHT: {
-          uniform_manager.SetUniform1Int(program_name, "height_tex", unit_idx);
-        } break;
-        case aiTextureType_NORMALS: {
-          uniform_manager.SetUniform1Int(program_name, "normals_tex", unit_idx);
-        } break;
-        default: {
-          throw std::runtime_error("Unknown texture type '" +
-                                   std ::to_string(type) + "'");
-        }
+  /* Update Textures */
+  BindMaterialTextures(program_name, mesh_draw_info.material);
+  /* Draw Vertex Arrays */
+  UseMesh(group_name, mesh_draw_info.mesh_idx);
+  const GLsizei num_idxs = mesh_draw_info.num_idxs;
+  const GLsizei num_instances =
+      static_cast<GLsizei>(visible_range.num_instances);
+  const GLuint base_instance = visible_range.base_instance;
+  trace_manager.RecordCall(
+      "glDrawElementsInstancedBaseInstance",
+      {GL_TRIANGLES, num_idxs, num_instances, base_instance}, 0, [&] {
+        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, num_idxs,
+                                            GL_UNSIGNED_INT, nullptr,
+                                            num_instances, base_instance);
+      });
+}
+
+void shader::SceneShader::DrawIndirect() {
+  // Get managers
+  const as::ProgramManager &program_manager =
+      gl_managers_->GetProgramManager();
+  // Get names
+  const std::string program_name = GetIndirectProgramName();
+  // Use the program
+  program_manager.UseProgram(program_name);
+  // Update the per-model parameters in the shader storage buffer
+  UpdateIndirectModelParams();
+  // Update the lighting which is shared by all draws
+  const GLintptr lighting_ofs = WriteUniformRingBuffer(lighting_);
+  BindUniformRingBufferRange(GetLightingBufferName(), lighting_ofs,
+                             sizeof(lighting_));
+  // Record and submit the indirect commands
+  RecordIndirectCmds();
+  SubmitIndirectCmds();
+}
+
+/*
+ * The textures could not be changed within a multi-draw without bindless
+ * textures, so the commands are batched by materials. The model flag which
+ * affects the material buffer and the material tiers also split the batches,
+ * each tier of a mesh gets its own command.
+ */
+void shader::SceneShader::RecordIndirectCmds() {
+  // Get managers
+  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  const as::ProgramManager &program_manager =
+      gl_managers_->GetProgramManager();
+  // Get names
+  const std::string cmds_buffer_name = GetIndirectCmdsBufferName();
+  // Get the index which identifies the program in the sort keys
+  const GLuint program_sort_idx =
+      program_manager.GetProgramSortIdx(GetIndirectProgramName());
+  // Get the viewing position for sorting from front to back
+  const glm::vec3 view_pos = lighting_.view_pos;
+
+  /* Record the draw commands */
+  draw_list_.Clear();
+  for (size_t info_idx = 0; info_idx < mesh_draw_infos_.size(); info_idx++) {
+    const MeshDrawInfo &mesh_draw_info = mesh_draw_infos_.at(info_idx);
+    const dto::SceneModel &scene_model =
+        scene_models_.at(mesh_draw_info.scene_model_name);
+    // Check whether the scene model isn't visible or all instances of the mesh
+    // are culled
+    if (!scene_model.IsVisible() ||
+        GetVisibleRange(CullingViews::kCamera, info_idx).num_instances == 0) {
+      continue;
+    }
+    // Calculate the depth of the mesh center
+    const glm::vec4 center =
+        scene_model.GetTrans() * glm::vec4(mesh_draw_info.center, 1.0f);
+    const float depth = glm::distance(view_pos, glm::vec3(center));
+    // Record the draw command of each tier, the item identifies the mesh and
+    // the tier
+    for (GLuint tier_idx = 0; tier_idx < GetNumMaterialTiers(); tier_idx++) {
+      if (GetMaterialTierRange(tier_idx, info_idx).num_instances == 0) {
+        continue;
       }
+      const GLuint batch_idx =
+          (2 * mesh_draw_info.material_idx +
+           (scene_model.GetUseEnvMap() ? 1 : 0)) *
+              kMaxNumMaterialTiers +
+          tier_idx;
+      const GLuint64 sort_key = as::DrawList::MakeSortKey(
+          kDrawPass, program_sort_idx, batch_idx,
+          as::DrawList::QuantizeDepth(depth, kMaxDrawDepth),
+          mesh_draw_info.va_idx);
+      draw_list_.AddDrawCmd(sort_key,
+                            info_idx * kMaxNumMaterialTiers + tier_idx);
+    }
+  }
+  draw_list_.Sort();
+
+  /* Build the indirect commands and the batches */
+  indirect_cmds_.clear();
+  indirect_batches_.clear();
+  GLuint prev_batch_idx = std::numeric_limits<GLuint>::max();
+  for (const as::DrawList::DrawCmd &draw_cmd : draw_list_.GetDrawCmds()) {
+    const size_t info_idx = draw_cmd.item_idx / kMaxNumMaterialTiers;
+    const GLuint tier_idx =
+        static_cast<GLuint>(draw_cmd.item_idx % kMaxNumMaterialTiers);
+    // Start a new batch when the material or the tier changes
+    const GLuint batch_idx = as::DrawList::GetKeyField(
+        draw_cmd.sort_key, as::DrawList::KeyFields::kMaterial);
+    if (batch_idx != prev_batch_idx) {
+      const GLintptr cmds_ofs =
+          indirect_cmds_.size() * sizeof(DrawElementsIndirectCmd);
+      indirect_batches_.push_back(
+          IndirectBatch{info_idx, tier_idx, cmds_ofs, 0});
+      prev_batch_idx = batch_idx;
     }
-    /* Draw Vertex Arrays */
-    UseMesh(group_name, mesh_idx);
-    if (use_instantiating_) {
-      glDrawElementsInstanced(GL_TRIANGLES, idxs.size(), GL_UNSIGNED_INT,
-                              nullptr, scene_model.GetNumInstancing());
-    } else {
-      glDrawElementsInstanced(GL_TRIANGLES, idxs.size(), GL_UNSIGNED_INT,
-                              nullptr, 1);
+    // Append the indirect command with the instances of the tier, which are
+    // in the same order in the merged buffers
+    const VisibleRange visible_range =
+        GetVisibleRange(CullingViews::kCamera, info_idx);
+    const VisibleRange tier_range = GetMaterialTierRange(tier_idx, info_idx);
+    DrawElementsIndirectCmd indirect_cmd = mesh_indirect_cmds_.at(info_idx);
+    indirect_cmd.instance_count = tier_range.num_instances;
+    indirect_cmd.base_instance +=
+        tier_range.base_instance - visible_range.base_instance;
+    indirect_cmds_.push_back(indirect_cmd);
+    indirect_batches_.back().num_cmds++;
+  }
+
+  /* Update the buffer */
+  buffer_manager.UpdateBuffer(
+      cmds_buffer_name, GL_DRAW_INDIRECT_BUFFER, 0,
+      indirect_cmds_.size() * sizeof(DrawElementsIndirectCmd),
+      indirect_cmds_.data());
+}
+
+void shader::SceneShader::SubmitIndirectCmds() {
+  // Get managers
+  as::BufferManager &buffer_manager = gl_managers_->GetBufferManager();
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
+  const as::VertexSpecManager &vertex_spec_manager =
+      gl_managers_->GetVertexSpecManager();
+  // Get names
+  const std::string program_name = GetIndirectProgramName();
+  // Use the merged vertex array and the indirect commands
+  vertex_spec_manager.BindVertexArray(GetIndirectVertexArrayName());
+  buffer_manager.BindBuffer(GetIndirectIdxsBufferName(),
+                            GL_ELEMENT_ARRAY_BUFFER);
+  buffer_manager.BindBuffer(GetIndirectCmdsBufferName(),
+                            GL_DRAW_INDIRECT_BUFFER);
+
+  for (const IndirectBatch &indirect_batch : indirect_batches_) {
+    const MeshDrawInfo &mesh_draw_info =
+        mesh_draw_infos_.at(indirect_batch.mesh_draw_info_idx);
+    const dto::SceneModel &scene_model =
+        scene_models_.at(mesh_draw_info.scene_model_name);
+    // Update the material of the batch
+    UpdateModelMaterial(scene_model);
+    const GLintptr model_material_ofs = UpdateModelMaterial(
+        mesh_draw_info.material, indirect_batch.material_tier_idx);
+    BindUniformRingBufferRange(GetModelMaterialBufferName(),
+                               model_material_ofs, sizeof(model_material_));
+    BindMaterialTextures(program_name, mesh_draw_info.material);
+    // The meshes of a batch share the material, so they are all pre-passed
+    // or not
+    UseSceneDepthTest(use_depth_prepass_ && mesh_draw_info.use_depth_prepass);
+    // Draw all meshes of the batch
+    trace_manager.RecordCall(
+        "glMultiDrawElementsIndirect",
+        {GL_TRIANGLES, indirect_batch.cmds_ofs, indirect_batch.num_cmds}, 0,
+        [&] {
+          glMultiDrawElementsIndirect(
+              GL_TRIANGLES, GL_UNSIGNED_INT,
+              reinterpret_cast<const GLvoid *>(indirect_batch.cmds_ofs),
+              indirect_batch.num_cmds, 0);
+        });
+    num_draw_calls_++;
+  }
+}
+
+void shader::SceneShader::BindMaterialTextures(const std::string &program_name,
+                                               const as::Material &material) {
+  // Get managers
+  as::TextureManager &texture_manager = gl_managers_->GetTextureManager();
+  as::UniformManager &uniform_manager = gl_managers_->GetUniformManager();
+  // Get the textures
+  const std::set<as::Texture> textures = material.GetTextures();
+
+  for (const as::Texture &texture : textures) {
+    const std::string &path = texture.GetPath();
+    const aiTextureType type = texture.GetType();
+    // Bind the texture
+    texture_manager.BindTexture(path);
+    // Get the unit index
+    const GLuint unit_idx = texture_manager.GetUnitIdx(path);
+    // Set the texture handler to the unit index
+    switch (type) {
+      case aiTextureType_AMBIENT: {
+        uniform_manager.SetProgramUniform1Int(program_name, "ambient_tex",
+                                              unit_idx);
+      } break;
+      case aiTextureType_DIFFUSE: {
+        uniform_manager.SetProgramUniform1Int(program_name, "diffuse_tex",
+                                              unit_idx);
+      } break;
+      case aiTextureType_SPECULAR: {
+        uniform_manager.SetProgramUniform1Int(program_name, "specular_tex",
+                                              unit_idx);
+      } break;
+      case aiTextureType_HEIGHT: {
+        uniform_manager.SetProgramUniform1Int(program_name, "height_tex",
+                                              unit_idx);
+      } break;
+      case aiTextureType_NORMALS: {
+        uniform_manager.SetProgramUniform1Int(program_name, "normals_tex",
+                                              unit_idx);
+      } break;
+      default: {
+        throw std::runtime_error("Unknown texture type '" +
+                                 std ::to_string(type) + "'");
+      }
     }
   }
 }
+
+/*******************************************************************************
+ * Fragment Statistics (Private)
+ ******************************************************************************/
+
+/*
+ * The results should be available after two frames, so it rarely waits
+ */
+void shader::SceneShader::ReadFragmentQueries(const int query_idx) {
+  if (!has_fragment_queries_[query_idx]) {
+    return;
+  }
+  // Get managers
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
+  // Get the handlers
+  const GLuint prepass_query_hdlr = prepass_query_hdlrs_[query_idx];
+  const GLuint scene_query_hdlr = scene_query_hdlrs_[query_idx];
+
+  GLuint64 num_prepass_invocations = 0;
+  GLuint64 num_scene_invocations = 0;
+  if (was_prepassed_[query_idx]) {
+    trace_manager.RecordCall(
+        "glGetQueryObjectui64v", {prepass_query_hdlr, GL_QUERY_RESULT}, 0,
+        [&] {
+          glGetQueryObjectui64v(prepass_query_hdlr, GL_QUERY_RESULT,
+                                &num_prepass_invocations);
+        });
+  }
+  trace_manager.RecordCall(
+      "glGetQueryObjectui64v", {scene_query_hdlr, GL_QUERY_RESULT}, 0, [&] {
+        glGetQueryObjectui64v(scene_query_hdlr, GL_QUERY_RESULT,
+                              &num_scene_invocations);
+      });
+  // Keep the last invocations of each mode for comparing
+  fragment_stats_.num_prepass_invocations = num_prepass_invocations;
+  fragment_stats_.num_scene_invocations = num_scene_invocations;
+  if (was_prepassed_[query_idx]) {
+    fragment_stats_.num_prepassed_scene_invocations = num_scene_invocations;
+  } else {
+    fragment_stats_.num_unprepassed_scene_invocations = num_scene_invocations;
+  }
+  has_fragment_queries_[query_idx] = false;
+}
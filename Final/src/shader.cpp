@@ -12,6 +12,15 @@ void shader::Shader::RegisterGLManagers(as::GLManagers& gl_managers) {
   gl_managers_ = &gl_managers;
 }
 
+/*
+ * Submits compiling and linking the programs, which should be called for all
+ * shaders before Init so that the programs are compiled in parallel
+ */
+void shader::Shader::SubmitPrograms() {
+  CreateShaders();
+  CreatePrograms();
+}
+
 /*******************************************************************************
  * GL Drawing Methods
  ******************************************************************************/
@@ -174,7 +183,7 @@ std::string shader::Shader::GetMeshVertexArrayIdxsBufferName(
 }
 
 /*******************************************************************************
- * Path Management (Private)
+ * Path Management (Protected)
  ******************************************************************************/
 
 std::string shader::Shader::GetShaderPath(
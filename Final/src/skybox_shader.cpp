@@ -23,8 +23,6 @@ void shader::SkyboxShader::LoadModel() {
  ******************************************************************************/
 
 void shader::SkyboxShader::Init() {
-  CreateShaders();
-  CreatePrograms();
   LoadModel();
   InitVertexArrays();
   InitUniformBlocks();
@@ -140,6 +138,7 @@ void shader::SkyboxShader::BindTextures() {
 void shader::SkyboxShader::Draw() {
   // Get managers
   as::TextureManager &texture_manager = gl_managers_->GetTextureManager();
+  as::TraceManager &trace_manager = gl_managers_->GetTraceManager();
   // Get names
   const std::string program_name = GetProgramName();
   const std::string tex_name = GetTextureName();
@@ -156,10 +155,14 @@ void shader::SkyboxShader::Draw() {
     const as::Mesh &mesh = meshes.at(mesh_idx);
     // Get the array indexes
     const std::vector<size_t> &idxs = mesh.GetIdxs();
+    const GLsizei num_idxs = static_cast<GLsizei>(idxs.size());
 
     /* Draw vertex arrays */
     UseMesh(program_name, mesh_idx);
-    glDrawElements(GL_TRIANGLES, idxs.size(), GL_UNSIGNED_INT, nullptr);
+    trace_manager.RecordCall(
+        "glDrawElements", {GL_TRIANGLES, num_idxs}, 0, [&] {
+          glDrawElements(GL_TRIANGLES, num_idxs, GL_UNSIGNED_INT, nullptr);
+        });
   }
 }
 
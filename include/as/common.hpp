@@ -15,8 +15,10 @@
 #include <cassert>
 #include <chrono>
 #include <climits>
+#include <cstring>
 #include <cstdlib>
 #include <filesystem>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <queue>
@@ -62,3 +64,16 @@
 #pragma comment(lib, "glew32.lib")
 #pragma comment(lib, "irrKlang.lib")
 #pragma comment(lib, "libfbxsdk-md.lib")
+
+/*******************************************************************************
+ * Hash Functions
+ ******************************************************************************/
+
+namespace as {
+// FNV-1a offset basis, which is the hash of nothing
+const GLuint64 kHashOffsetBasis = 14695981039346656037ull;
+
+GLuint64 HashBytes(const void *data, const size_t size, GLuint64 hash);
+
+GLuint64 HashString(const std::string &str, const GLuint64 hash);
+}  // namespace as
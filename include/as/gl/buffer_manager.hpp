@@ -1,6 +1,8 @@
 #pragma once
 
 #include "as/common.hpp"
+#include "as/gl/state_manager.hpp"
+#include "as/gl/trace_manager.hpp"
 
 namespace as {
 class BufferManager {
@@ -16,8 +18,16 @@ class BufferManager {
     const GLvoid *data;
   };
 
+  BufferManager();
+
   ~BufferManager();
 
+  /* Manager Registrations */
+
+  void RegisterStateManager(StateManager &state_manager);
+
+  void RegisterTraceManager(TraceManager &trace_manager);
+
   /* Generations */
 
   void GenBuffer(const std::string &buffer_name);
@@ -28,6 +38,9 @@ class BufferManager {
 
   void BindBuffer(const std::string &buffer_name);
 
+  void BindBufferBase(const std::string &buffer_name, const GLenum target,
+                      const GLuint binding_idx);
+
   /* Deselections */
 
   void DeselectBuffer(const GLenum target);
@@ -38,6 +51,16 @@ class BufferManager {
                   const GLsizeiptr size, const GLvoid *data,
                   const GLenum usage);
 
+  void InitBufferStorage(const std::string &buffer_name, const GLenum target,
+                         const GLsizeiptr size, const GLvoid *data,
+                         const GLbitfield flags);
+
+  /* Memory Mappings */
+
+  GLvoid *MapBufferRange(const std::string &buffer_name, const GLenum target,
+                         const GLintptr ofs, const GLsizeiptr size,
+                         const GLbitfield access);
+
   /* Memory Updaters */
 
   void UpdateBuffer(const std::string &buffer_name, const GLenum target,
@@ -55,12 +78,23 @@ class BufferManager {
   GLuint GetBufferHdlr(const std::string &buffer_name) const;
 
  private:
+  StateManager *state_manager_;
+
+  TraceManager *trace_manager_;
+
   std::map<std::string, GLuint> hdlrs_;
 
   std::map<std::string, BindBufferPrevParams> bind_buffer_prev_params_;
 
   std::map<std::string, UpdateBufferPrevParams> update_buffer_prev_params_;
 
+  /* Call Issuings */
+
+  template <class TCall>
+  void IssueCall(const char *func_name,
+                 const std::initializer_list<GLint64> args,
+                 const GLsizeiptr num_bytes, const TCall &call);
+
   /* Previous Parameter Getters */
 
   const BindBufferPrevParams &GetBindBufferPrevParams(
@@ -69,4 +103,23 @@ class BufferManager {
   const UpdateBufferPrevParams &GetUpdateBufferPrevParams(
       const std::string &buffer_name) const;
 };
+
+/*******************************************************************************
+ * Call Issuings (Private)
+ ******************************************************************************/
+
+/*
+ * Issues the call through the trace manager if it is registered
+ */
+template <class TCall>
+inline void BufferManager::IssueCall(const char *func_name,
+                                     const std::initializer_list<GLint64> args,
+                                     const GLsizeiptr num_bytes,
+                                     const TCall &call) {
+  if (trace_manager_ != nullptr) {
+    trace_manager_->RecordCall(func_name, args, num_bytes, call);
+  } else {
+    call();
+  }
+}
 }  // namespace as
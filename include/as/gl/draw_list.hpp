@@ -0,0 +1,81 @@
+/**
+ * Draw List
+ *
+ * Records draw commands with 64-bit sort keys, sorts them with a radix sort
+ * and lets the caller submit them in the sorted order so that the state
+ * changes between consecutive draws are minimized.
+ *
+ * Sort key layout (from the most significant bit):
+ * | Pass (4) | Program (8) | Material (16) | Depth (20) | Vertex Array (16) |
+ *
+ * The program and the material are the most expensive state changes, so they
+ * take the higher bits. The depth is placed above the vertex array so that
+ * the draws sharing the states are drawn from front to back, which lets the
+ * depth test reject more fragments. The vertex array only groups the draws
+ * at the same quantized depth, e.g., the material tiers or the shadow
+ * cascades which draw one vertex array several times in a pass.
+ */
+#pragma once
+
+#include "as/common.hpp"
+
+namespace as {
+class DrawList {
+ public:
+  enum class KeyFields {
+    kPass,
+    kProgram,
+    kMaterial,
+    kDepth,
+    kVertexArray,
+  };
+
+  struct DrawCmd {
+    GLuint64 sort_key;
+    size_t item_idx;
+  };
+
+  /* Sort Keys */
+
+  static GLuint64 MakeSortKey(const GLuint pass, const GLuint program_idx,
+                              const GLuint material_idx, const GLuint depth,
+                              const GLuint va_idx);
+
+  static GLuint QuantizeDepth(const float depth, const float max_depth);
+
+  static GLuint GetKeyField(const GLuint64 sort_key, const KeyFields field);
+
+  /* Recordings */
+
+  void Clear();
+
+  void AddDrawCmd(const GLuint64 sort_key, const size_t item_idx);
+
+  /* Sortings */
+
+  void Sort();
+
+  /* Draw Command Getters */
+
+  const std::vector<DrawCmd> &GetDrawCmds() const;
+
+  /* Statistics Getters */
+
+  unsigned int CountFieldChanges(const KeyFields field) const;
+
+ private:
+  std::vector<DrawCmd> draw_cmds_;
+
+  std::vector<DrawCmd> sorted_draw_cmds_;
+
+  /* Key Field Packings */
+
+  static GLuint64 PackKeyField(const KeyFields field, const GLuint value);
+
+  /* Key Field Getters */
+
+  static GLuint GetKeyFieldShift(const KeyFields field);
+
+  static GLuint GetKeyFieldNumBits(const KeyFields field);
+};
+}  // namespace as
@@ -1,7 +1,18 @@
+/**
+ * Framebuffer Manager
+ *
+ * Also pools the render targets (renderbuffers and 2D textures) which are
+ * keyed by their formats, sizes and samples. A render target could be reused
+ * after it is released, and aliased by other names whose pass ranges in a
+ * frame don't overlap. Released render targets are deleted after they have
+ * been idle for several frames.
+ */
 #pragma once
 
 #include "as/common.hpp"
+#include "as/gl/state_manager.hpp"
 #include "as/gl/texture_manager.hpp"
+#include "as/gl/trace_manager.hpp"
 
 namespace as {
 class FramebufferManager {
@@ -14,13 +25,39 @@ class FramebufferManager {
     GLenum target;
   };
 
+  struct RenderTargetDesc {
+    GLenum internal_fmt;
+    GLsizei width;
+    GLsizei height;
+    GLsizei num_mipmap_levels;  // Only used by textures
+    GLsizei num_samples;        // 0 means not multisampled
+  };
+
+  struct RenderTargetStats {
+    GLsizeiptr num_requested_bytes;
+    GLsizeiptr num_allocated_bytes;
+    GLsizeiptr num_idle_bytes;
+    unsigned int num_render_targets;
+    unsigned int num_aliases;
+    unsigned int num_allocs;
+    unsigned int num_reuses;
+  };
+
   FramebufferManager();
 
   ~FramebufferManager();
 
   /* Manager Registrations */
 
-  void RegisterTextureManager(const TextureManager &texture_manager);
+  void RegisterTextureManager(TextureManager &texture_manager);
+
+  void RegisterStateManager(StateManager &state_manager);
+
+  void RegisterTraceManager(TraceManager &trace_manager);
+
+  /* Frame Controls */
+
+  void StartFrame();
 
   /* Generations */
 
@@ -49,6 +86,29 @@ class FramebufferManager {
                         const GLenum internal_fmt, const GLsizei width,
                         const GLsizei height);
 
+  /* Render Target Pool */
+
+  void AcquireRenderbuffer(const std::string &renderbuffer_name,
+                           const RenderTargetDesc &desc,
+                           const int first_pass_idx, const int last_pass_idx);
+
+  void AcquireRenderbuffer(const std::string &renderbuffer_name,
+                           const RenderTargetDesc &desc);
+
+  void AcquireTexture2D(const std::string &tex_name,
+                        const RenderTargetDesc &desc, const int first_pass_idx,
+                        const int last_pass_idx);
+
+  void AcquireTexture2D(const std::string &tex_name,
+                        const RenderTargetDesc &desc);
+
+  void ReleaseRenderbuffer(const std::string &renderbuffer_name);
+
+  void ReleaseTexture2D(const std::string &tex_name);
+
+  static bool IsSameRenderTargetDesc(const RenderTargetDesc &desc1,
+                                     const RenderTargetDesc &desc2);
+
   /* Binding Connections */
 
   void AttachTextureToFramebuffer(const std::string &framebuffer_name,
@@ -88,8 +148,27 @@ class FramebufferManager {
 
   bool HasRenderbuffer(const std::string &renderbuffer_name) const;
 
+  /* Statistics Getters */
+
+  RenderTargetStats GetRenderTargetStats() const;
+
  private:
-  const TextureManager *texture_manager_;
+  enum class RenderTargetKinds { kRenderbuffer, kTexture2D };
+
+  struct RenderTarget {
+    RenderTargetKinds kind;
+    RenderTargetDesc desc;
+    GLuint hdlr;
+    // Pass ranges of the names which currently use the render target
+    std::map<std::string, std::tuple<int, int>> pass_ranges;
+    GLuint64 released_frame_idx;
+  };
+
+  TextureManager *texture_manager_;
+
+  StateManager *state_manager_;
+
+  TraceManager *trace_manager_;
 
   std::map<std::string, GLuint> framebuffer_hdlrs_;
 
@@ -101,6 +180,19 @@ class FramebufferManager {
   std::map<std::string, BindRenderbufferPrevParams>
       bind_renderbuffer_prev_params_;
 
+  GLuint64 frame_idx_;
+
+  std::map<unsigned int, RenderTarget> render_targets_;
+
+  std::map<std::tuple<RenderTargetKinds, std::string>, unsigned int>
+      render_target_ids_;
+
+  unsigned int next_render_target_id_;
+
+  unsigned int num_render_target_allocs_;
+
+  unsigned int num_render_target_reuses_;
+
   /* Previous Parameter Getters */
 
   const BindFramebufferPrevParams &GetFramebufferPrevParams(
@@ -108,5 +200,53 @@ class FramebufferManager {
 
   const BindRenderbufferPrevParams &GetRenderbufferPrevParams(
       const std::string &renderbuffer_name) const;
+
+  /* Render Target Pool */
+
+  GLuint AcquireRenderTarget(const RenderTargetKinds kind,
+                             const std::string &name,
+                             const RenderTargetDesc &desc,
+                             const int first_pass_idx, const int last_pass_idx);
+
+  void ReleaseRenderTarget(const RenderTargetKinds kind,
+                           const std::string &name);
+
+  unsigned int FindRenderTarget(const RenderTargetKinds kind,
+                                const RenderTargetDesc &desc,
+                                const int first_pass_idx,
+                                const int last_pass_idx);
+
+  GLuint CreateRenderTarget(const RenderTargetKinds kind,
+                            const RenderTargetDesc &desc);
+
+  void DeleteRenderTarget(const RenderTarget &render_target);
+
+  static GLsizeiptr GetRenderTargetNumBytes(const RenderTargetDesc &desc);
+
+  /* Call Issuings */
+
+  template <class TCall>
+  void IssueCall(const char *func_name,
+                 const std::initializer_list<GLint64> args, const TCall &call);
+
+  GLuint GenStubHdlr(const GLuint hdlr);
 };
+
+/*******************************************************************************
+ * Call Issuings (Private)
+ ******************************************************************************/
+
+/*
+ * Issues the call through the trace manager if it is registered
+ */
+template <class TCall>
+inline void FramebufferManager::IssueCall(
+    const char *func_name, const std::initializer_list<GLint64> args,
+    const TCall &call) {
+  if (trace_manager_ != nullptr) {
+    trace_manager_->RecordCall(func_name, args, 0, call);
+  } else {
+    call();
+  }
+}
 }  // namespace as
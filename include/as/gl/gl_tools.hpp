@@ -6,9 +6,13 @@
 
 #include "as/gl/buffer_manager.hpp"
 #include "as/gl/framebuffer_manager.hpp"
+#include "as/gl/profiler_manager.hpp"
 #include "as/gl/program_manager.hpp"
+#include "as/gl/ring_buffer_manager.hpp"
 #include "as/gl/shader_manager.hpp"
+#include "as/gl/state_manager.hpp"
 #include "as/gl/texture_manager.hpp"
+#include "as/gl/trace_manager.hpp"
 #include "as/gl/ui_manager.hpp"
 #include "as/gl/uniform_manager.hpp"
 #include "as/gl/vertex_spec_manager.hpp"
@@ -59,12 +63,20 @@ class GLManagers {
 
   FramebufferManager &GetFramebufferManager();
 
+  ProfilerManager &GetProfilerManager();
+
   ProgramManager &GetProgramManager();
 
+  RingBufferManager &GetRingBufferManager();
+
   ShaderManager &GetShaderManager();
 
+  StateManager &GetStateManager();
+
   TextureManager &GetTextureManager();
 
+  TraceManager &GetTraceManager();
+
   UiManager &GetUiManager();
 
   UniformManager &GetUniformManager();
@@ -72,10 +84,16 @@ class GLManagers {
   VertexSpecManager &GetVertexSpecManager();
 
  private:
+  // The trace manager is declared first so that it outlives the other
+  // managers, which issue their calls through it when destroyed
+  TraceManager trace_manager_;
   BufferManager buffer_manager_;
   FramebufferManager framebuffer_manager_;
+  ProfilerManager profiler_manager_;
   ProgramManager program_manager_;
+  RingBufferManager ring_buffer_manager_;
   ShaderManager shader_manager_;
+  StateManager state_manager_;
   TextureManager texture_manager_;
   UiManager ui_manager_;
   UniformManager uniform_manager_;
@@ -39,6 +39,8 @@ class IndexManager {
 
   TIndex GetTarget2Idx(const TTarget1 &target) const;
 
+  TIndex GetNameIdx(const std::string &name) const;
+
  private:
   TIndex max_idx_;
 
@@ -136,6 +138,15 @@ inline TIndex IndexManager<TTarget1, TTarget2, TIndex>::GetTarget2Idx(
   return name_to_idx_.at(name);
 }
 
+template <class TTarget1, class TTarget2, class TIndex>
+inline TIndex IndexManager<TTarget1, TTarget2, TIndex>::GetNameIdx(
+    const std::string &name) const {
+  if (name_to_idx_.count(name) == 0) {
+    throw std::runtime_error("Could not find the name '" + name + "'");
+  }
+  return name_to_idx_.at(name);
+}
+
 template <class TTarget1, class TTarget2, class TIndex>
 inline void IndexManager<TTarget1, TTarget2, TIndex>::InitUsedIdxs() {
   // Use 0 as default index to avoid programming errors
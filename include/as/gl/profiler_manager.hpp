@@ -0,0 +1,141 @@
+/**
+ * Profiler Manager
+ *
+ * Measures the CPU and GPU time of each pass in a frame. The GPU time comes
+ * from GL_TIME_ELAPSED queries which are double-buffered, so the results of
+ * the last frame are read without stalling the pipeline. A pass could be
+ * started several times in a frame, each time with its own query, and the
+ * times are summed. The times of recent frames are kept for plotting and
+ * exporting.
+ *
+ * Note that GL_TIME_ELAPSED queries could not be nested, so the passes should
+ * not overlap.
+ *
+ * Reference: https://www.khronos.org/opengl/wiki/Query_Object#Timer_queries
+ */
+#pragma once
+
+#include "as/common.hpp"
+#include "as/gl/trace_manager.hpp"
+
+namespace as {
+class ProfilerManager {
+ public:
+  struct PassTimes {
+    double cpu_seconds;
+    double gpu_seconds;
+  };
+
+  /* Scoped Timers */
+
+  class ScopedPass {
+   public:
+    ScopedPass(ProfilerManager &profiler_manager, const std::string &pass_name);
+
+    ~ScopedPass();
+
+    ScopedPass(const ScopedPass &) = delete;
+
+    ScopedPass &operator=(const ScopedPass &) = delete;
+
+   private:
+    ProfilerManager &profiler_manager_;
+
+    std::string pass_name_;
+  };
+
+  ProfilerManager();
+
+  ~ProfilerManager();
+
+  /* Manager Registrations */
+
+  void RegisterTraceManager(TraceManager &trace_manager);
+
+  /* Frame Controls */
+
+  void StartFrame();
+
+  /* Pass Controls */
+
+  void StartPass(const std::string &pass_name);
+
+  void FinishPass(const std::string &pass_name);
+
+  /* Exports */
+
+  void SaveCsv(const std::string &path) const;
+
+  /* Time Getters */
+
+  const std::vector<std::string> &GetPassNames() const;
+
+  PassTimes GetPassTimes(const std::string &pass_name) const;
+
+  PassTimes GetFrameTimes() const;
+
+  const std::vector<float> &GetCpuHistory(const std::string &pass_name) const;
+
+  const std::vector<float> &GetGpuHistory(const std::string &pass_name) const;
+
+  int GetHistoryOfs() const;
+
+ private:
+  struct Pass {
+    // Queries of each frame parity, one for each time the pass is started
+    std::vector<GLuint> query_hdlrs[2];
+    size_t num_queries[2];
+    std::chrono::high_resolution_clock::time_point cpu_start_time;
+    double cur_cpu_seconds;
+    PassTimes times;
+    // Times in milliseconds of recent frames
+    std::vector<float> cpu_history;
+    std::vector<float> gpu_history;
+  };
+
+  TraceManager *trace_manager_;
+
+  unsigned int frame_idx_;
+
+  int history_ofs_;
+
+  std::vector<std::string> pass_names_;
+
+  std::map<std::string, Pass> passes_;
+
+  /* Pass Getters */
+
+  Pass &GetPass(const std::string &pass_name);
+
+  const Pass &GetPass(const std::string &pass_name) const;
+
+  /* Query Readings */
+
+  void ReadQuery(Pass &pass, const int query_idx);
+
+  /* Call Issuings */
+
+  template <class TCall>
+  void IssueCall(const char *func_name,
+                 const std::initializer_list<GLint64> args,
+                 const TCall &call);
+};
+
+/*******************************************************************************
+ * Call Issuings (Private)
+ ******************************************************************************/
+
+/*
+ * Issues the call through the trace manager if it is registered
+ */
+template <class TCall>
+inline void ProfilerManager::IssueCall(
+    const char *func_name, const std::initializer_list<GLint64> args,
+    const TCall &call) {
+  if (trace_manager_ != nullptr) {
+    trace_manager_->RecordCall(func_name, args, 0, call);
+  } else {
+    call();
+  }
+}
+}  // namespace as
@@ -2,23 +2,43 @@
 
 #include "as/common.hpp"
 #include "as/gl/shader_manager.hpp"
+#include "as/gl/state_manager.hpp"
+#include "as/gl/trace_manager.hpp"
 
 namespace as {
 
 class ProgramManager {
  public:
+  struct LinkStats {
+    unsigned int num_cache_hits;
+    unsigned int num_cache_misses;
+    double link_seconds;
+  };
+
   ProgramManager();
 
   ~ProgramManager();
 
-  void RegisterShaderManager(const ShaderManager &shader_manager);
+  void RegisterShaderManager(ShaderManager &shader_manager);
+
+  void RegisterStateManager(StateManager &state_manager);
+
+  void RegisterTraceManager(TraceManager &trace_manager);
+
+  void EnableBinaryCache(const std::string &cache_dir);
+
+  void EnableParallelCompile();
 
   void CreateProgram(const std::string &program_name);
 
   void AttachShader(const std::string &program_name,
-                    const std::string &shader_name) const;
+                    const std::string &shader_name);
+
+  void LinkProgram(const std::string &program_name);
+
+  bool IsProgramReady(const std::string &program_name) const;
 
-  void LinkProgram(const std::string &program_name) const;
+  void FinishLinkingPrograms() const;
 
   void UseProgram(const std::string &program_name) const;
 
@@ -28,12 +48,78 @@ class ProgramManager {
 
   GLuint GetProgramHdlr(const std::string &program_name) const;
 
+  GLuint GetProgramSortIdx(const std::string &program_name) const;
+
+  LinkStats GetLinkStats() const;
+
  private:
-  const ShaderManager *shader_manager_;
+  ShaderManager *shader_manager_;
+
+  StateManager *state_manager_;
+
+  TraceManager *trace_manager_;
 
   std::map<std::string, GLuint> hdlrs_;
 
+  // Dense indexes in the order of creation, the handlers aren't dense enough
+  // for the program field of the sort keys
+  std::map<std::string, GLuint> sort_idxs_;
+
+  std::map<std::string, std::vector<std::string>> attached_shader_names_;
+
+  // Empty means the binary cache is disabled
+  std::string cache_dir_;
+
+  bool use_parallel_compile_;
+
+  bool has_parallel_compile_ext_;
+
+  // Programs whose linking has been submitted but not checked, they are
+  // finished lazily when their handlers are first requested
+  mutable std::set<std::string> pending_program_names_;
+
+  mutable LinkStats link_stats_;
+
+  void CompileAttachedShaders(const std::string &program_name);
+
+  void FinishLinkingProgram(const std::string &program_name) const;
+
+  std::string GetBinaryCachePath(const std::string &program_name) const;
+
+  bool LoadProgramBinary(const GLuint program_hdlr,
+                         const std::string &path) const;
+
+  void SaveProgramBinary(const GLuint program_hdlr,
+                         const std::string &path) const;
+
+  bool IsProgramLinked(const GLuint program_hdlr) const;
+
   void CheckProgramLinkingStatus(const GLuint program_hdlr) const;
+
+  /* Call Issuings */
+
+  template <class TCall>
+  void IssueCall(const char *func_name,
+                 const std::initializer_list<GLint64> args,
+                 const TCall &call) const;
 };
 
+/*******************************************************************************
+ * Call Issuings (Private)
+ ******************************************************************************/
+
+/*
+ * Issues the call through the trace manager if it is registered
+ */
+template <class TCall>
+inline void ProgramManager::IssueCall(const char *func_name,
+                                      const std::initializer_list<GLint64> args,
+                                      const TCall &call) const {
+  if (trace_manager_ != nullptr) {
+    trace_manager_->RecordCall(func_name, args, 0, call);
+  } else {
+    call();
+  }
+}
+
 }  // namespace as
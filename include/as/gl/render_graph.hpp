@@ -0,0 +1,192 @@
+/**
+ * Render Graph
+ *
+ * Builds the passes of a frame declaratively. Each pass declares the
+ * resources it reads and writes, and compiling the graph:
+ * 1. Culls the passes whose writes never reach the output resources
+ * 2. Computes the lifetimes of the resources over the remaining passes
+ * 3. Acquires the transient resources from the render target pool of the
+ *    framebuffer manager with their lifetimes, so the transient resources whose
+ *    lifetimes don't overlap are aliased, and the resources of the culled
+ *    passes are released
+ * 4. Clears each resource in its first writing pass, and inserts the memory
+ *    barriers before the passes reading the resources written by earlier passes
+ *
+ * The graph is rebuilt every frame, but the transient resources are only
+ * re-acquired when their descriptions or lifetimes change.
+ */
+#pragma once
+
+#include "as/common.hpp"
+#include "as/gl/framebuffer_manager.hpp"
+#include "as/gl/profiler_manager.hpp"
+#include "as/gl/texture_manager.hpp"
+#include "as/gl/trace_manager.hpp"
+
+namespace as {
+class RenderGraph {
+ public:
+  enum class ResourceKinds {
+    kExternal,
+    kTransientRenderbuffer,
+    kTransientTexture2D,
+  };
+
+  struct ResourceDesc {
+    ResourceKinds kind;
+    // Only used by transient resources
+    FramebufferManager::RenderTargetDesc target_desc;
+    // Buffers to clear in the first writing pass
+    GLbitfield clear_mask;
+    // Barriers to insert before reading the resource written by earlier passes
+    GLbitfield barrier_bits;
+  };
+
+  /* Constants */
+  static const std::string kDefaultFramebufferName;
+
+  RenderGraph();
+
+  /* Manager Registrations */
+
+  void RegisterFramebufferManager(FramebufferManager &framebuffer_manager);
+
+  void RegisterTextureManager(TextureManager &texture_manager);
+
+  void RegisterProfilerManager(ProfilerManager &profiler_manager);
+
+  void RegisterTraceManager(TraceManager &trace_manager);
+
+  /* Graph Buildings */
+
+  void Reset();
+
+  void AddResource(const std::string &resource_name, const ResourceDesc &desc,
+                   const std::function<void()> &attach_func = nullptr);
+
+  void AddPass(const std::string &pass_name,
+               const std::string &framebuffer_name,
+               const std::vector<std::string> &read_resource_names,
+               const std::vector<std::string> &write_resource_names,
+               const std::function<void()> &execute_func);
+
+  void AddOutput(const std::string &resource_name);
+
+  /* Compilations */
+
+  void Compile();
+
+  /* Executions */
+
+  void Execute();
+
+  /* Exports */
+
+  void SaveTimeline(const std::string &path) const;
+
+  /* Statistics Getters */
+
+  unsigned int GetNumPasses() const;
+
+  unsigned int GetNumCulledPasses() const;
+
+ private:
+  struct Resource {
+    ResourceDesc desc;
+    std::function<void()> attach_func;
+    // Indexes of the live passes, -1 means the resource is unused
+    int first_pass_idx;
+    int last_pass_idx;
+  };
+
+  struct Pass {
+    std::string name;
+    // Empty name means the pass binds its own framebuffers
+    std::string framebuffer_name;
+    std::vector<std::string> read_resource_names;
+    std::vector<std::string> write_resource_names;
+    std::function<void()> execute_func;
+    bool culled;
+    int live_pass_idx;
+    GLbitfield clear_mask;
+    GLbitfield barrier_bits;
+  };
+
+  struct AcquiredResource {
+    ResourceDesc desc;
+    int first_pass_idx;
+    int last_pass_idx;
+  };
+
+  FramebufferManager *framebuffer_manager_;
+
+  TextureManager *texture_manager_;
+
+  ProfilerManager *profiler_manager_;
+
+  TraceManager *trace_manager_;
+
+  std::map<std::string, Resource> resources_;
+
+  std::vector<Pass> passes_;
+
+  std::set<std::string> output_resource_names_;
+
+  std::map<std::string, AcquiredResource> acquired_resources_;
+
+  bool compiled_;
+
+  /* Resource Getters */
+
+  Resource &GetResource(const std::string &resource_name);
+
+  const Resource &GetResource(const std::string &resource_name) const;
+
+  /* Compilations */
+
+  void CullPasses();
+
+  void ComputeLifetimes();
+
+  void ComputeClearsAndBarriers();
+
+  void AcquireTransientResources();
+
+  void ReleaseTransientResource(const std::string &resource_name);
+
+  /* Handler Getters */
+
+  GLuint GetTransientResourceHdlr(const std::string &resource_name) const;
+
+  /* Type Conversions */
+
+  static bool IsTransientResourceKind(const ResourceKinds kind);
+
+  static std::string ResourceKindToName(const ResourceKinds kind);
+
+  /* Call Issuings */
+
+  template <class TCall>
+  void IssueCall(const char *func_name,
+                 const std::initializer_list<GLint64> args,
+                 const TCall &call);
+};
+
+/*******************************************************************************
+ * Call Issuings (Private)
+ ******************************************************************************/
+
+/*
+ * Issues the call through the trace manager if it is registered
+ */
+template <class TCall>
+inline void RenderGraph::IssueCall(const char *func_name,
+                                   const std::initializer_list<GLint64> args,
+                                   const TCall &call) {
+  if (trace_manager_ != nullptr) {
+    trace_manager_->RecordCall(func_name, args, 0, call);
+  } else {
+    call();
+  }
+}
+}  // namespace as
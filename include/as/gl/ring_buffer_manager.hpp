@@ -0,0 +1,128 @@
+/**
+ * Ring Buffer Manager
+ *
+ * Manages persistently mapped buffers which are split into per-frame
+ * segments. Data is written once into the current segment at aligned offsets,
+ * and each segment is guarded by a fence so that the CPU never overwrites data
+ * which the GPU is still reading.
+ *
+ * References:
+ * https://www.khronos.org/opengl/wiki/Buffer_Object#Persistent_mapping
+ * https://www.khronos.org/opengl/wiki/Sync_Object
+ */
+#pragma once
+
+#include "as/common.hpp"
+#include "as/gl/buffer_manager.hpp"
+#include "as/gl/trace_manager.hpp"
+
+namespace as {
+class RingBufferManager {
+ public:
+  struct RingBufferStats {
+    GLsizeiptr num_uploaded_bytes;
+    unsigned int num_allocs;
+    unsigned int num_stalls;
+    double stall_seconds;
+  };
+
+  RingBufferManager();
+
+  ~RingBufferManager();
+
+  /* Manager Registrations */
+
+  void RegisterBufferManager(BufferManager &buffer_manager);
+
+  void RegisterTraceManager(TraceManager &trace_manager);
+
+  /* Memory Initializations */
+
+  void InitRingBuffer(const std::string &buffer_name, const GLenum target,
+                      const GLsizeiptr segment_size, const int num_segments);
+
+  /* Frame Controls */
+
+  void StartRingBufferFrame(const std::string &buffer_name);
+
+  void FinishRingBufferFrame(const std::string &buffer_name);
+
+  /* Memory Allocations */
+
+  GLintptr AllocRingBuffer(const std::string &buffer_name,
+                           const GLsizeiptr size, const GLvoid *data);
+
+  /* Deletions */
+
+  void DeleteRingBuffer(const std::string &buffer_name);
+
+  /* Alignment Getters */
+
+  GLsizeiptr GetAlignedSize(const GLenum target, const GLsizeiptr size);
+
+  /* Statistics Getters */
+
+  RingBufferStats GetFrameStats(const std::string &buffer_name) const;
+
+ private:
+  struct RingBuffer {
+    GLenum target;
+    GLsizeiptr segment_size;
+    GLsizeiptr ofs_alignment;
+    int num_segments;
+    int segment_idx;
+    GLsizeiptr segment_ofs;
+    GLubyte *mapped_ptr;
+    std::vector<GLsync> fences;
+    RingBufferStats cur_stats;
+    RingBufferStats frame_stats;
+  };
+
+  BufferManager *buffer_manager_;
+
+  TraceManager *trace_manager_;
+
+  std::map<std::string, RingBuffer> ring_buffers_;
+
+  std::map<GLenum, GLsizeiptr> ofs_alignments_;
+
+  /* Ring Buffer Getters */
+
+  RingBuffer &GetRingBuffer(const std::string &buffer_name);
+
+  const RingBuffer &GetRingBuffer(const std::string &buffer_name) const;
+
+  /* Alignment Getters */
+
+  GLsizeiptr GetOfsAlignment(const GLenum target);
+
+  /* Synchronizations */
+
+  void WaitFence(RingBuffer &ring_buffer, const int segment_idx);
+
+  /* Call Issuings */
+
+  template <class TCall>
+  void IssueCall(const char *func_name,
+                 const std::initializer_list<GLint64> args,
+                 const GLsizeiptr num_bytes, const TCall &call);
+};
+
+/*******************************************************************************
+ * Call Issuings (Private)
+ ******************************************************************************/
+
+/*
+ * Issues the call through the trace manager if it is registered
+ */
+template <class TCall>
+inline void RingBufferManager::IssueCall(
+    const char *func_name, const std::initializer_list<GLint64> args,
+    const GLsizeiptr num_bytes, const TCall &call) {
+  if (trace_manager_ != nullptr) {
+    trace_manager_->RecordCall(func_name, args, num_bytes, call);
+  } else {
+    call();
+  }
+}
+}  // namespace as
@@ -1,24 +1,77 @@
 #pragma once
 
 #include "as/common.hpp"
+#include "as/gl/trace_manager.hpp"
 
 namespace as {
 class ShaderManager {
  public:
+  ShaderManager();
+
   ~ShaderManager();
 
+  void RegisterTraceManager(TraceManager& trace_manager);
+
   void CreateShader(const std::string& shader_name, const GLenum type,
-                    const std::string& path);
+                    const std::string& path,
+                    const std::vector<std::string>& defines = {});
+
+  void CompileShader(const std::string& shader_name);
+
+  void CheckShaderCompilation(const std::string& shader_name) const;
 
   void DeleteShader(const std::string& shader_name) const;
 
   GLuint GetShaderHdlr(const std::string& shader_name) const;
 
+  GLenum GetShaderType(const std::string& shader_name) const;
+
+  const std::string& GetShaderSource(const std::string& shader_name) const;
+
  private:
+  TraceManager* trace_manager_;
+
   std::map<std::string, GLuint> hdlrs_;
 
+  std::map<std::string, GLenum> types_;
+
+  std::map<std::string, std::string> srcs_;
+
+  std::set<std::string> compiled_shader_names_;
+
   std::string LoadShaderSource(const std::string& file) const;
 
+  std::string PreprocessShaderSource(
+      const std::string& path, const std::vector<std::string>& defines) const;
+
+  std::string ResolveShaderIncludes(const std::string& path,
+                                    const int depth) const;
+
   void CheckShaderCompilation(const GLuint shader_hdlr) const;
+
+  /* Call Issuings */
+
+  template <class TCall>
+  void IssueCall(const char* func_name,
+                 const std::initializer_list<GLint64> args,
+                 const TCall& call) const;
 };
+
+/*******************************************************************************
+ * Call Issuings (Private)
+ ******************************************************************************/
+
+/*
+ * Issues the call through the trace manager if it is registered
+ */
+template <class TCall>
+inline void ShaderManager::IssueCall(const char* func_name,
+                                     const std::initializer_list<GLint64> args,
+                                     const TCall& call) const {
+  if (trace_manager_ != nullptr) {
+    trace_manager_->RecordCall(func_name, args, 0, call);
+  } else {
+    call();
+  }
+}
 }  // namespace as
@@ -0,0 +1,147 @@
+/**
+ * State Manager
+ *
+ * Shadows the GL binding states so that redundant binds and program switches
+ * are skipped. Every state change is counted as either issued or skipped, and
+ * the counts are kept per frame.
+ */
+#pragma once
+
+#include "as/common.hpp"
+#include "as/gl/trace_manager.hpp"
+
+namespace as {
+class StateManager {
+ public:
+  enum class CallTypes {
+    kUseProgram,
+    kBindVertexArray,
+    kBindBuffer,
+    kBindBufferBase,
+    kBindBufferRange,
+    kActiveTexture,
+    kBindTexture,
+    kBindFramebuffer,
+    kSetViewport,
+  };
+
+  struct CallCounts {
+    unsigned int num_issued;
+    unsigned int num_skipped;
+  };
+
+  struct IndexedBufferBinding {
+    GLuint buffer_hdlr;
+    GLintptr ofs;
+    GLsizeiptr size;  // -1 means the whole buffer
+  };
+
+  StateManager();
+
+  /* Manager Registrations */
+
+  void RegisterTraceManager(TraceManager &trace_manager);
+
+  /* Frame Controls */
+
+  void StartFrame();
+
+  /* State Changes */
+
+  void UseProgram(const GLuint program_hdlr);
+
+  void BindVertexArray(const GLuint va_hdlr);
+
+  void BindBuffer(const GLenum target, const GLuint buffer_hdlr);
+
+  void BindBufferBase(const GLenum target, const GLuint binding_idx,
+                      const GLuint buffer_hdlr);
+
+  void BindBufferRange(const GLenum target, const GLuint binding_idx,
+                       const GLuint buffer_hdlr, const GLintptr ofs,
+                       const GLsizeiptr size);
+
+  void ActiveTexture(const GLuint unit_idx);
+
+  void BindTexture(const GLenum target, const GLuint unit_idx,
+                   const GLuint tex_hdlr);
+
+  void BindFramebuffer(const GLenum target, const GLuint framebuffer_hdlr);
+
+  void SetViewport(const GLint x, const GLint y, const GLsizei width,
+                   const GLsizei height);
+
+  /* Invalidations */
+
+  void Invalidate();
+
+  void InvalidateProgram(const GLuint program_hdlr);
+
+  void InvalidateVertexArray(const GLuint va_hdlr);
+
+  void InvalidateBuffer(const GLuint buffer_hdlr);
+
+  void InvalidateTexture(const GLuint tex_hdlr);
+
+  void InvalidateFramebuffer(const GLuint framebuffer_hdlr);
+
+  /* Statistics Getters */
+
+  CallCounts GetFrameCallCounts(const CallTypes call_type) const;
+
+  CallCounts GetFrameCallCounts() const;
+
+ private:
+  TraceManager *trace_manager_;
+
+  /* Bound States */
+  GLuint program_hdlr_;
+  GLuint va_hdlr_;
+  std::map<GLenum, GLuint> buffer_hdlrs_;
+  std::map<GLuint, GLuint> va_idxs_buffer_hdlrs_;
+  std::map<std::tuple<GLenum, GLuint>, IndexedBufferBinding>
+      indexed_buffer_bindings_;
+  GLuint active_unit_idx_;
+  std::map<std::tuple<GLuint, GLenum>, GLuint> tex_hdlrs_;
+  GLuint draw_framebuffer_hdlr_;
+  GLuint read_framebuffer_hdlr_;
+  glm::ivec4 viewport_;
+
+  /* Statistics */
+  std::map<CallTypes, CallCounts> cur_call_counts_;
+  std::map<CallTypes, CallCounts> frame_call_counts_;
+
+  /* State Checkings */
+
+  bool IsIndexedBufferBound(const GLenum target, const GLuint binding_idx,
+                            const IndexedBufferBinding &binding) const;
+
+  /* Call Issuings */
+
+  template <class TCall>
+  void IssueCall(const char *func_name,
+                 const std::initializer_list<GLint64> args, const TCall &call);
+
+  /* Statistics Updaters */
+
+  void CountCall(const CallTypes call_type, const bool is_issued);
+};
+
+/*******************************************************************************
+ * Call Issuings (Private)
+ ******************************************************************************/
+
+/*
+ * Issues the call through the trace manager if it is registered
+ */
+template <class TCall>
+inline void StateManager::IssueCall(const char *func_name,
+                                    const std::initializer_list<GLint64> args,
+                                    const TCall &call) {
+  if (trace_manager_ != nullptr) {
+    trace_manager_->RecordCall(func_name, args, 0, call);
+  } else {
+    call();
+  }
+}
+}  // namespace as
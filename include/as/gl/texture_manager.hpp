@@ -2,6 +2,8 @@
 
 #include "as/common.hpp"
 #include "as/gl/index_manager.hpp"
+#include "as/gl/state_manager.hpp"
+#include "as/gl/trace_manager.hpp"
 
 namespace as {
 class TextureManager {
@@ -31,10 +33,18 @@ class TextureManager {
 
   void Init();
 
+  /* Manager Registrations */
+
+  void RegisterStateManager(StateManager &state_manager);
+
+  void RegisterTraceManager(TraceManager &trace_manager);
+
   /* Generations */
 
   void GenTexture(const std::string &tex_name);
 
+  void RegisterTexture(const std::string &tex_name, const GLuint tex_hdlr);
+
   /* Bindings */
 
   void BindTexture(const std::string &tex_name, const GLenum target,
@@ -103,6 +113,8 @@ class TextureManager {
 
   void DeleteTexture(const std::string &tex_name);
 
+  void UnregisterTexture(const std::string &tex_name);
+
   /* Handler Getters */
 
   GLuint GetTextureHdlr(const std::string &tex_name) const;
@@ -118,8 +130,14 @@ class TextureManager {
   GLuint GetUnitIdx(const std::string &tex_name) const;
 
  private:
+  StateManager *state_manager_;
+
+  TraceManager *trace_manager_;
+
   std::map<std::string, GLuint> hdlrs_;
 
+  std::set<std::string> registered_tex_names_;
+
   IndexManager<std::tuple<std::string, GLenum>, std::string, GLuint>
       index_manager_;
 
@@ -139,5 +157,35 @@ class TextureManager {
   /* Initializations */
 
   void InitLimits();
+
+  /* Call Issuings */
+
+  template <class TCall>
+  void IssueCall(const char *func_name,
+                 const std::initializer_list<GLint64> args,
+                 const GLsizeiptr num_bytes, const TCall &call);
+
+  /* Type Conversions */
+
+  static GLsizeiptr GetPixelNumBytes(const GLenum fmt, const GLenum type);
 };
+
+/*******************************************************************************
+ * Call Issuings (Private)
+ ******************************************************************************/
+
+/*
+ * Issues the call through the trace manager if it is registered
+ */
+template <class TCall>
+inline void TextureManager::IssueCall(const char *func_name,
+                                      const std::initializer_list<GLint64> args,
+                                      const GLsizeiptr num_bytes,
+                                      const TCall &call) {
+  if (trace_manager_ != nullptr) {
+    trace_manager_->RecordCall(func_name, args, num_bytes, call);
+  } else {
+    call();
+  }
+}
 }  // namespace as
@@ -0,0 +1,141 @@
+/**
+ * Trace Manager
+ *
+ * Interposes the GL calls issued by the other managers. Every call could be
+ * recorded with its arguments, uploaded bytes and CPU time into a trace, which
+ * could be saved, loaded and summarized per frame. With the recording backend
+ * the calls are only recorded and never issued to the driver, so the cost of
+ * a frame could be analyzed without a GPU.
+ */
+#pragma once
+
+#include "as/common.hpp"
+
+namespace as {
+class TraceManager {
+ public:
+  enum class Backends {
+    kDriver,
+    kRecording,
+  };
+
+  struct TraceCall {
+    unsigned int frame_idx;
+    std::string func_name;
+    std::vector<GLint64> args;
+    GLsizeiptr num_bytes;
+    double seconds;
+  };
+
+  struct FrameSummary {
+    unsigned int frame_idx;
+    unsigned int num_calls;
+    GLsizeiptr num_uploaded_bytes;
+    // The calls are only timed while recording
+    double call_seconds;
+  };
+
+  TraceManager();
+
+  /* Backend Controls */
+
+  void SetBackend(const Backends backend);
+
+  Backends GetBackend() const;
+
+  /* Recording Controls */
+
+  void StartRecording();
+
+  void StopRecording();
+
+  bool IsRecording() const;
+
+  /* Frame Controls */
+
+  void StartFrame();
+
+  /* Call Interpositions */
+
+  template <class TCall>
+  void RecordCall(const char *func_name,
+                  const std::initializer_list<GLint64> args,
+                  const GLsizeiptr num_bytes, const TCall &call);
+
+  /* Stub Resources */
+
+  GLuint GenStubHdlr();
+
+  GLvoid *AllocStubMemory(const GLsizeiptr size);
+
+  /* Trace Files */
+
+  void SaveTrace(const std::string &path) const;
+
+  void LoadTrace(const std::string &path);
+
+  /* Summaries */
+
+  std::vector<FrameSummary> SummarizeTrace() const;
+
+  FrameSummary GetFrameSummary() const;
+
+  void CheckFrameBudget(const unsigned int max_num_calls,
+                        const GLsizeiptr max_num_uploaded_bytes) const;
+
+  /* Trace Getters */
+
+  const std::vector<TraceCall> &GetTraceCalls() const;
+
+ private:
+  Backends backend_;
+
+  bool is_recording_;
+
+  unsigned int frame_idx_;
+
+  std::vector<TraceCall> trace_calls_;
+
+  /* Stub Resources */
+  GLuint stub_hdlr_;
+  std::vector<std::vector<GLubyte>> stub_memories_;
+
+  /* Statistics */
+  FrameSummary cur_summary_;
+  FrameSummary frame_summary_;
+
+  /* Call Interpositions */
+
+  void RecordTraceCall(const char *func_name,
+                       const std::initializer_list<GLint64> args,
+                       const GLsizeiptr num_bytes,
+                       const std::function<void()> &call);
+};
+
+/*******************************************************************************
+ * Call Interpositions
+ ******************************************************************************/
+
+/*
+ * Issues the call to the driver unless the recording backend is used. The
+ * number of bytes is the size of data uploaded to the GPU by the call. Outside
+ * the recordings the call is issued directly and only counted, so the
+ * arguments aren't copied and the call isn't timed.
+ */
+template <class TCall>
+inline void TraceManager::RecordCall(const char *func_name,
+                                     const std::initializer_list<GLint64> args,
+                                     const GLsizeiptr num_bytes,
+                                     const TCall &call) {
+  if (is_recording_) {
+    RecordTraceCall(func_name, args, num_bytes, call);
+    return;
+  }
+  if (backend_ == Backends::kDriver) {
+    call();
+  }
+  // Update statistics
+  cur_summary_.num_calls++;
+  cur_summary_.num_uploaded_bytes += num_bytes;
+}
+}  // namespace as
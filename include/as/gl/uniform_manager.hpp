@@ -1,6 +1,9 @@
 /**
  * Uniform Manager
  *
+ * The uniform values are shadowed per program and location, so that setting
+ * an unchanged value skips both the program switch and the upload.
+ *
  * References:
  * https://github.com/progschj/OpenGL-Examples/blob/master/06instancing3_uniform_buffer.cpp
  */
@@ -10,10 +13,17 @@
 #include "as/gl/buffer_manager.hpp"
 #include "as/gl/index_manager.hpp"
 #include "as/gl/program_manager.hpp"
+#include "as/gl/state_manager.hpp"
+#include "as/gl/trace_manager.hpp"
 
 namespace as {
 class UniformManager {
  public:
+  struct UniformStats {
+    unsigned int num_uploads;
+    unsigned int num_skipped;
+  };
+
   UniformManager();
 
   /* Initializations */
@@ -26,6 +36,14 @@ class UniformManager {
 
   void RegisterBufferManager(const BufferManager &buffer_manager);
 
+  void RegisterStateManager(StateManager &state_manager);
+
+  void RegisterTraceManager(TraceManager &trace_manager);
+
+  /* Frame Controls */
+
+  void StartFrame();
+
   /* Uniform Value Setters */
 
   void SetUniform1Float(const std::string &program_name,
@@ -34,6 +52,12 @@ class UniformManager {
   void SetUniform1Int(const std::string &program_name,
                       const std::string &var_name, const GLint v0);
 
+  void SetProgramUniform1Float(const std::string &program_name,
+                               const std::string &var_name, const GLfloat v0);
+
+  void SetProgramUniform1Int(const std::string &program_name,
+                             const std::string &var_name, const GLint v0);
+
   /* Binding Connections */
 
   void AssignUniformBlockToBindingPoint(const std::string &program_name,
@@ -50,6 +74,14 @@ class UniformManager {
   void BindBufferBaseToBindingPoint(const std::string &buffer_name,
                                     const std::string &binding_name);
 
+  void BindBufferRangeToBindingPoint(const std::string &buffer_name,
+                                     const GLuint binding_idx,
+                                     const GLintptr ofs, const GLsizeiptr size);
+
+  void BindBufferRangeToBindingPoint(const std::string &buffer_name,
+                                     const std::string &binding_name,
+                                     const GLintptr ofs, const GLsizeiptr size);
+
   void UnassignUniformBlock(const std::string &program_name,
                             const std::string &block_name);
 
@@ -73,20 +105,70 @@ class UniformManager {
   GLint GetUniformBlockMemoryOfs(const std::string &program_name,
                                  const std::string &block_member_name) const;
 
+  /* Statistics Getters */
+
+  UniformStats GetFrameStats() const;
+
  private:
+  struct UniformValue {
+    GLenum type;
+    GLint int_value;
+    GLfloat float_value;
+  };
+
   const ProgramManager *program_manager_;
 
   const BufferManager *buffer_manager_;
 
+  StateManager *state_manager_;
+
+  TraceManager *trace_manager_;
+
   std::map<std::string, std::map<std::string, GLint>> var_hdlrs_;
 
   std::map<std::string, std::map<std::string, GLuint>> block_hdlrs_;
 
+  std::map<std::string, std::map<GLint, UniformValue>> uniform_values_;
+
+  UniformStats cur_stats_;
+
+  UniformStats frame_stats_;
+
   IndexManager<std::tuple<std::string, std::string>, std::string, GLuint>
       index_manager_;
 
   /* Initializations */
 
   void InitLimits();
+
+  /* Uniform Value Caches */
+
+  bool UpdateUniformValue(const std::string &program_name,
+                          const GLint var_hdlr, const UniformValue &value);
+
+  /* Call Issuings */
+
+  template <class TCall>
+  void IssueCall(const char *func_name,
+                 const std::initializer_list<GLint64> args,
+                 const TCall &call) const;
 };
+
+/*******************************************************************************
+ * Call Issuings (Private)
+ ******************************************************************************/
+
+/*
+ * Issues the call through the trace manager if it is registered
+ */
+template <class TCall>
+inline void UniformManager::IssueCall(const char *func_name,
+                                      const std::initializer_list<GLint64> args,
+                                      const TCall &call) const {
+  if (trace_manager_ != nullptr) {
+    trace_manager_->RecordCall(func_name, args, 0, call);
+  } else {
+    call();
+  }
+}
 }  // namespace as
@@ -2,6 +2,8 @@
 
 #include "as/common.hpp"
 #include "as/gl/buffer_manager.hpp"
+#include "as/gl/state_manager.hpp"
+#include "as/gl/trace_manager.hpp"
 
 namespace as {
 class VertexSpecManager {
@@ -19,6 +21,10 @@ class VertexSpecManager {
 
   void RegisterBufferManager(const BufferManager &buffer_manager);
 
+  void RegisterStateManager(StateManager &state_manager);
+
+  void RegisterTraceManager(TraceManager &trace_manager);
+
   /* Generations */
 
   void GenVertexArray(const std::string &va_name);
@@ -69,6 +75,10 @@ class VertexSpecManager {
  private:
   const BufferManager *buffer_manager_;
 
+  StateManager *state_manager_;
+
+  TraceManager *trace_manager_;
+
   std::map<std::string, GLuint> hdlrs_;
 
   std::map<std::string, std::map<GLuint, GLuint>> binding_points_;
@@ -81,5 +91,30 @@ class VertexSpecManager {
   const BindBufferToBindingPointPrevParams &
   GetBindBufferToBindingPointPrevParams(const std::string &va_name,
                                         const GLuint binding_idx) const;
+
+  /* Call Issuings */
+
+  template <class TCall>
+  void IssueCall(const char *func_name,
+                 const std::initializer_list<GLint64> args,
+                 const TCall &call) const;
 };
+
+/*******************************************************************************
+ * Call Issuings (Private)
+ ******************************************************************************/
+
+/*
+ * Issues the call through the trace manager if it is registered
+ */
+template <class TCall>
+inline void VertexSpecManager::IssueCall(
+    const char *func_name, const std::initializer_list<GLint64> args,
+    const TCall &call) const {
+  if (trace_manager_ != nullptr) {
+    trace_manager_->RecordCall(func_name, args, 0, call);
+  } else {
+    call();
+  }
+}
 }  // namespace as
@@ -0,0 +1,129 @@
+/**
+ * Bounding Volume Hierarchy
+ *
+ * Binary tree of axis-aligned bounding boxes over items, e.g., instances.
+ * The tree is built top-down with the binned surface area heuristic (SAH),
+ * which estimates the cost of traversing the tree by the surface areas of the
+ * nodes. The bounds of the moved items are refitted bottom-up without changing
+ * the topology, and the caller should rebuild the tree when the refitted cost
+ * grows too much compared to the built cost.
+ *
+ * The items of each subtree are contiguous, so the traversals add all items of
+ * the subtrees which are entirely inside the query volumes without testing
+ * them.
+ *
+ * Reference: On fast Construction of SAH-based Bounding Volume Hierarchies
+ * (Wald)
+ */
+#pragma once
+
+#include "as/common.hpp"
+#include "as/trans/frustum.hpp"
+
+namespace as {
+class Bvh {
+ public:
+  struct TraversalStats {
+    unsigned int num_visited_nodes;
+    unsigned int num_tested_items;
+  };
+
+  struct RayHit {
+    bool is_hit;
+    size_t item_idx;
+    float dist;
+  };
+
+  Bvh();
+
+  /* Buildings */
+
+  void Build(const std::vector<glm::vec3> &min_poses,
+             const std::vector<glm::vec3> &max_poses);
+
+  void UpdateItem(const size_t item_idx, const glm::vec3 &min_pos,
+                  const glm::vec3 &max_pos);
+
+  void Refit();
+
+  /* Traversals */
+
+  TraversalStats QueryFrustum(const Frustum &frustum,
+                              std::vector<size_t> &item_idxs) const;
+
+  TraversalStats QuerySphere(const glm::vec3 &center, const float radius,
+                             std::vector<size_t> &item_idxs) const;
+
+  TraversalStats QueryRay(
+      const glm::vec3 &origin, const glm::vec3 &dir, const float max_dist,
+      RayHit &ray_hit,
+      const std::function<bool(size_t)> &filter_func = nullptr) const;
+
+  /* Statistics Getters */
+
+  size_t GetNumItems() const;
+
+  size_t GetNumNodes() const;
+
+  float GetCost() const;
+
+  float GetBuiltCost() const;
+
+ private:
+  struct Node {
+    glm::vec3 min_pos;
+    glm::vec3 max_pos;
+    // Index of the left child, the right child follows it. 0 means the node
+    // is a leaf because the root is never a child.
+    size_t left_idx;
+    // Range of the items in the subtree
+    size_t first_item_idx;
+    size_t num_items;
+    // The parent of the root is itself
+    size_t parent_idx;
+  };
+
+  /* Constants */
+  static const size_t kMaxLeafItems;
+  static const int kNumBins;
+  static const float kTraversalCost;
+  static const float kIntersectionCost;
+  static const size_t kFullRefitRatio;
+
+  std::vector<Node> nodes_;
+
+  // Items ordered by the leaves
+  std::vector<size_t> item_idxs_;
+
+  std::vector<glm::vec3> item_min_poses_;
+
+  std::vector<glm::vec3> item_max_poses_;
+
+  std::vector<size_t> item_leaf_idxs_;
+
+  std::vector<size_t> dirty_leaf_idxs_;
+
+  float built_cost_;
+
+  /* Buildings */
+
+  void BuildNode(const size_t node_idx);
+
+  bool FindSplit(const Node &node, int &split_axis, float &split_pos) const;
+
+  void UpdateNodeBounds(const size_t node_idx);
+
+  /* Traversals */
+
+  void AddSubtreeItems(const Node &node, std::vector<size_t> &item_idxs) const;
+
+  static bool IntersectRay(const glm::vec3 &origin, const glm::vec3 &inv_dir,
+                           const glm::vec3 &min_pos, const glm::vec3 &max_pos,
+                           const float max_dist, float &dist);
+
+  /* Statistics Getters */
+
+  static float GetSurfaceArea(const glm::vec3 &min_pos,
+                              const glm::vec3 &max_pos);
+};
+}  // namespace as
@@ -0,0 +1,84 @@
+/**
+ * Frustum
+ *
+ * Extracts the six clipping planes from a view-projection matrix and tests
+ * axis-aligned bounding boxes against them. The boxes are stored as a
+ * structure of arrays so that four boxes are tested against each plane at a
+ * time with SSE.
+ *
+ * Reference: Fast Extraction of Viewing Frustum Planes from the
+ * World-View-Projection Matrix (Gribb and Hartmann)
+ */
+#pragma once
+
+#include "as/common.hpp"
+
+namespace as {
+class AabbBatch {
+ public:
+  /* Recordings */
+
+  void Clear();
+
+  void Resize(const size_t num_aabbs);
+
+  void AddAabb(const glm::vec3 &center, const glm::vec3 &extent);
+
+  void SetAabb(const size_t aabb_idx, const glm::vec3 &center,
+               const glm::vec3 &extent);
+
+  /* Getters */
+
+  size_t GetNumAabbs() const;
+
+  glm::vec3 GetCenter(const size_t aabb_idx) const;
+
+  glm::vec3 GetExtent(const size_t aabb_idx) const;
+
+  const float *GetCenters(const int axis) const;
+
+  const float *GetExtents(const int axis) const;
+
+ private:
+  std::vector<float> centers_[3];
+
+  std::vector<float> extents_[3];
+};
+
+class Frustum {
+ public:
+  enum class Containments {
+    kOutside,
+    kIntersecting,
+    kInside,
+  };
+
+  Frustum();
+
+  Frustum(const glm::mat4 &view_proj);
+
+  /* State Setters */
+
+  void SetViewProj(const glm::mat4 &view_proj);
+
+  /* Tests */
+
+  bool TestAabb(const glm::vec3 &center, const glm::vec3 &extent) const;
+
+  Containments ClassifyAabb(const glm::vec3 &center,
+                            const glm::vec3 &extent) const;
+
+  size_t TestAabbs(const AabbBatch &aabb_batch,
+                   std::vector<unsigned char> &visibles) const;
+
+  /* Bounds */
+
+  static void TransformAabb(const glm::mat4 &trans, const glm::vec3 &min_pos,
+                            const glm::vec3 &max_pos, glm::vec3 &center,
+                            glm::vec3 &extent);
+
+ private:
+  // (normal, distance) with the normals pointing inside
+  glm::vec4 planes_[6];
+};
+}  // namespace as
@@ -0,0 +1,111 @@
+/**
+ * Light Clusters
+ *
+ * Splits the view frustum of the camera into clusters, the screen tiles in x
+ * and y and the logarithmic slices in depth, and assigns each point light to
+ * the clusters which its sphere overlaps. The lights of each cluster are
+ * stored contiguously in a light index list, so that the fragment shader only
+ * loops over the lights near the fragment instead of all lights.
+ *
+ * Reference: Clustered Deferred and Forward Shading (Olsson et al.)
+ */
+#pragma once
+
+#include "as/common.hpp"
+
+namespace as {
+class LightClusters {
+ public:
+  // Same layout as the point lights in the shader storage buffer
+  struct PointLight {
+    glm::vec3 pos;
+    float radius;
+    glm::vec3 color;
+    float intensity;
+  };
+
+  // Range of the lights of a cluster in the light indexes
+  struct ClusterRange {
+    GLuint offset;
+    GLuint num_lights;
+  };
+
+  LightClusters(const int num_tiles_x, const int num_tiles_y,
+                const int num_slices);
+
+  /* Assignments */
+
+  void Assign(const glm::mat4 &proj, const glm::mat4 &view,
+              const float near_depth, const float far_depth,
+              const std::vector<PointLight> &point_lights);
+
+  /* Getters */
+
+  int GetNumTilesX() const;
+
+  int GetNumTilesY() const;
+
+  int GetNumSlices() const;
+
+  float GetSliceScale() const;
+
+  float GetSliceBias() const;
+
+  const std::vector<ClusterRange> &GetClusterRanges() const;
+
+  const std::vector<GLuint> &GetLightIdxs() const;
+
+  GLuint GetMaxNumClusterLights() const;
+
+ private:
+  int num_tiles_x_;
+  int num_tiles_y_;
+  int num_slices_;
+
+  // Projection and depths which the clusters are built from
+  glm::mat4 proj_;
+  float near_depth_;
+  float far_depth_;
+
+  // Near and far planes of the camera
+  float camera_near_;
+  float camera_far_;
+
+  // The slice of a view depth is floor(log(depth) * scale + bias)
+  float slice_scale_;
+  float slice_bias_;
+
+  // Camera space boxes of the clusters
+  std::vector<glm::vec3> cluster_min_poses_;
+  std::vector<glm::vec3> cluster_max_poses_;
+
+  std::vector<ClusterRange> cluster_ranges_;
+
+  std::vector<GLuint> light_idxs_;
+
+  GLuint max_num_cluster_lights_;
+
+  // Cluster and light of each assignment, reused between the frames
+  std::vector<GLuint> ref_cluster_idxs_;
+  std::vector<GLuint> ref_light_idxs_;
+
+  /* Clusters */
+
+  void BuildClusters(const glm::mat4 &proj, const float near_depth,
+                     const float far_depth);
+
+  float GetSliceDepth(const int slice_idx) const;
+
+  int FindSlice(const float depth) const;
+
+  bool FindTileRange(const glm::vec3 &center, const float radius,
+                     glm::ivec2 &begin_tile, glm::ivec2 &end_tile) const;
+
+  static glm::vec3 Unproject(const glm::mat4 &inv_proj,
+                             const glm::vec3 &ndc_pos);
+
+  static bool TestSphereAabb(const glm::vec3 &center, const float radius,
+                             const glm::vec3 &min_pos,
+                             const glm::vec3 &max_pos);
+};
+}  // namespace as
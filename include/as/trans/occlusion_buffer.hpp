@@ -0,0 +1,99 @@
+/**
+ * Occlusion Buffer
+ *
+ * Low-resolution depth buffer rasterized on the CPU. The triangles of a few
+ * large occluders are clipped, projected and binned into the screen tiles,
+ * and the tiles are rasterized by several threads, each of which fills four
+ * pixels at a time with SSE. The bounding boxes are then tested against the
+ * buffer, so that the instances behind the occluders are skipped without
+ * touching the GPU.
+ *
+ * Reference: A Parallel Algorithm for Polygon Rasterization (Pineda)
+ */
+#pragma once
+
+#include <atomic>
+
+#include "as/common.hpp"
+
+namespace as {
+class OcclusionBuffer {
+ public:
+  OcclusionBuffer(const int width, const int height);
+
+  /* Recordings */
+
+  void Clear(const glm::mat4 &view_proj);
+
+  void AddOccluder(const glm::mat4 &trans, const std::vector<glm::vec3> &poses,
+                   const std::vector<size_t> &idxs);
+
+  void Rasterize();
+
+  /* Tests */
+
+  bool TestAabb(const glm::vec3 &min_pos, const glm::vec3 &max_pos) const;
+
+  /* Getters */
+
+  int GetWidth() const;
+
+  int GetHeight() const;
+
+  const std::vector<float> &GetDepths() const;
+
+  size_t GetNumTriangles() const;
+
+ private:
+  // Screen position in pixels and window depth in [0, 1]
+  struct Triangle {
+    glm::vec3 poses[3];
+  };
+
+  /* Constants */
+  static const int kTileWidth;
+  static const int kTileHeight;
+  static const unsigned int kMaxNumThreads;
+  static const float kMinArea;
+
+  int width_;
+  int height_;
+  int num_tiles_x_;
+  int num_tiles_y_;
+
+  glm::mat4 view_proj_;
+
+  std::vector<Triangle> triangles_;
+
+  // Triangles overlapping each tile
+  std::vector<std::vector<size_t>> tile_triangle_idxs_;
+
+  // Row-major depths of the pixels
+  std::vector<float> depths_;
+
+  // Farthest depth of each tile
+  std::vector<float> tile_max_depths_;
+
+  /* Recordings */
+
+  void AddClipTriangle(const glm::vec4 &clip_pos0, const glm::vec4 &clip_pos1,
+                       const glm::vec4 &clip_pos2);
+
+  void AddScreenTriangle(const glm::vec3 &pos0, const glm::vec3 &pos1,
+                         const glm::vec3 &pos2);
+
+  glm::vec3 ToScreenPos(const glm::vec4 &clip_pos) const;
+
+  static bool GetPixelRange(const float min_coord, const float max_coord,
+                            const int size, int &begin, int &end);
+
+  /* Rasterization */
+
+  void RasterizeTiles(std::atomic<size_t> &next_tile_idx);
+
+  void RasterizeTile(const size_t tile_idx);
+
+  void RasterizeTriangle(const Triangle &triangle, const int tile_x,
+                         const int tile_y);
+};
+}  // namespace as
@@ -0,0 +1,63 @@
+/**
+ * Shadow Cascades
+ *
+ * Splits the view depths of the camera into slices and fits an orthographic
+ * light projection to each slice, so that the near slices get more shadow map
+ * texels than the far ones. The split depths blend the logarithmic and the
+ * uniform splits. Each slice is enclosed by a sphere so that the size of its
+ * projection doesn't change when the camera rotates, and the projection is
+ * moved in whole texels so that the shadow edges don't shimmer when the
+ * camera moves.
+ *
+ * Reference: Parallel-Split Shadow Maps on Programmable GPUs (Zhang et al.)
+ */
+#pragma once
+
+#include "as/common.hpp"
+
+namespace as {
+class ShadowCascades {
+ public:
+  static const int kMaxNumCascades = 4;
+
+  ShadowCascades();
+
+  /* Fittings */
+
+  void Fit(const glm::mat4 &camera_proj, const glm::mat4 &camera_view,
+           const glm::mat4 &light_view, const int num_cascades,
+           const float max_dist, const float caster_dist, const int map_size);
+
+  /* Getters */
+
+  int GetNumCascades() const;
+
+  const glm::mat4 &GetProj(const int cascade_idx) const;
+
+  float GetSplitDepth(const int cascade_idx) const;
+
+  glm::mat4 GetBoundingProj() const;
+
+ private:
+  /* Constants */
+  static const float kSplitLambda;
+  static const float kRadiusStep;
+
+  int num_cascades_;
+
+  glm::mat4 projs_[kMaxNumCascades];
+
+  // Farthest view depth of each cascade
+  float split_depths_[kMaxNumCascades];
+
+  // Light space box of all cascades, the z components are the depths from the
+  // light
+  glm::vec3 bounding_min_;
+  glm::vec3 bounding_max_;
+
+  /* Fittings */
+
+  static glm::vec3 Unproject(const glm::mat4 &inv_proj,
+                             const glm::vec3 &ndc_pos);
+};
+}  // namespace as
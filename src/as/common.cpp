@@ -16,3 +16,25 @@
 #include <stb/stb_image.h>
 
 #pragma warning(pop)
+
+/*******************************************************************************
+ * Hash Functions
+ ******************************************************************************/
+
+/*
+ * Hashes the bytes by FNV-1a, continuing from the given hash
+ *
+ * Reference: https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
+ */
+GLuint64 as::HashBytes(const void *data, const size_t size, GLuint64 hash) {
+  const GLubyte *bytes = static_cast<const GLubyte *>(data);
+  for (size_t byte_idx = 0; byte_idx < size; byte_idx++) {
+    hash ^= bytes[byte_idx];
+    hash *= 1099511628211ull;  // FNV prime
+  }
+  return hash;
+}
+
+GLuint64 as::HashString(const std::string &str, const GLuint64 hash) {
+  return HashBytes(str.data(), str.size(), hash);
+}
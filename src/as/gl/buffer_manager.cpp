@@ -1,20 +1,40 @@
 #include "as/gl/buffer_manager.hpp"
 
+as::BufferManager::BufferManager()
+    : state_manager_(nullptr), trace_manager_(nullptr) {}
+
 as::BufferManager::~BufferManager() {
   // Delete all buffer objects
   for (const auto &pair : hdlrs_) {
-    glDeleteBuffers(1, &pair.second);
+    IssueCall("glDeleteBuffers", {1, pair.second}, 0,
+              [&] { glDeleteBuffers(1, &pair.second); });
   }
 }
 
+/*******************************************************************************
+ * Manager Registrations
+ ******************************************************************************/
+
+void as::BufferManager::RegisterStateManager(StateManager &state_manager) {
+  state_manager_ = &state_manager;
+}
+
+void as::BufferManager::RegisterTraceManager(TraceManager &trace_manager) {
+  trace_manager_ = &trace_manager;
+}
+
 /*******************************************************************************
  * Generations
  ******************************************************************************/
 
 void as::BufferManager::GenBuffer(const std::string &buffer_name) {
   // Generate a buffer object
-  GLuint hdlr;
-  glGenBuffers(1, &hdlr);
+  GLuint hdlr = 0;
+  IssueCall("glGenBuffers", {1}, 0, [&] { glGenBuffers(1, &hdlr); });
+  // Use a fake handler if the call is not issued by the recording backend
+  if (hdlr == 0 && trace_manager_ != nullptr) {
+    hdlr = trace_manager_->GenStubHdlr();
+  }
   // Save the handler
   hdlrs_[buffer_name] = hdlr;
 }
@@ -26,7 +46,13 @@ void as::BufferManager::GenBuffer(const std::string &buffer_name) {
 void as::BufferManager::BindBuffer(const std::string &buffer_name,
                                    const GLenum target) {
   const GLuint hdlr = GetBufferHdlr(buffer_name);
-  glBindBuffer(target, hdlr);
+  // Skip the redundant binding if the state manager is registered
+  if (state_manager_ != nullptr) {
+    state_manager_->BindBuffer(target, hdlr);
+  } else {
+    IssueCall("glBindBuffer", {target, hdlr}, 0,
+              [&] { glBindBuffer(target, hdlr); });
+  }
   // Save the parameters
   BindBufferPrevParams prev_params = {target};
   bind_buffer_prev_params_[buffer_name] = prev_params;
@@ -38,12 +64,34 @@ void as::BufferManager::BindBuffer(const std::string &buffer_name) {
   BindBuffer(buffer_name, prev_params.target);
 }
 
+/*
+ * Binds the buffer to the indexed binding point, which is used by the targets
+ * like GL_SHADER_STORAGE_BUFFER whose binding points are fixed in shaders
+ */
+void as::BufferManager::BindBufferBase(const std::string &buffer_name,
+                                       const GLenum target,
+                                       const GLuint binding_idx) {
+  const GLuint hdlr = GetBufferHdlr(buffer_name);
+  // Skip the redundant binding if the state manager is registered
+  if (state_manager_ != nullptr) {
+    state_manager_->BindBufferBase(target, binding_idx, hdlr);
+  } else {
+    IssueCall("glBindBufferBase", {target, binding_idx, hdlr}, 0,
+              [&] { glBindBufferBase(target, binding_idx, hdlr); });
+  }
+}
+
 /*******************************************************************************
  * Deselections
  ******************************************************************************/
 
 void as::BufferManager::DeselectBuffer(const GLenum target) {
-  glBindBuffer(target, 0);
+  if (state_manager_ != nullptr) {
+    state_manager_->BindBuffer(target, 0);
+  } else {
+    IssueCall("glBindBuffer", {target, 0}, 0,
+              [&] { glBindBuffer(target, 0); });
+  }
 }
 
 /*******************************************************************************
@@ -54,7 +102,48 @@ void as::BufferManager::InitBuffer(const std::string &buffer_name,
                                    const GLenum target, const GLsizeiptr size,
                                    const GLvoid *data, const GLenum usage) {
   BindBuffer(buffer_name, target);
-  glBufferData(target, size, data, usage);
+  IssueCall("glBufferData", {target, size, usage}, data != nullptr ? size : 0,
+            [&] { glBufferData(target, size, data, usage); });
+}
+
+/*
+ * Note that the storage is immutable, so it could only be updated by
+ * glBufferSubData (with GL_DYNAMIC_STORAGE_BIT) or mapping
+ */
+void as::BufferManager::InitBufferStorage(const std::string &buffer_name,
+                                          const GLenum target,
+                                          const GLsizeiptr size,
+                                          const GLvoid *data,
+                                          const GLbitfield flags) {
+  BindBuffer(buffer_name, target);
+  IssueCall("glBufferStorage", {target, size, flags},
+            data != nullptr ? size : 0,
+            [&] { glBufferStorage(target, size, data, flags); });
+}
+
+/*******************************************************************************
+ * Memory Mappings
+ ******************************************************************************/
+
+GLvoid *as::BufferManager::MapBufferRange(const std::string &buffer_name,
+                                          const GLenum target,
+                                          const GLintptr ofs,
+                                          const GLsizeiptr size,
+                                          const GLbitfield access) {
+  BindBuffer(buffer_name, target);
+  GLvoid *ptr = nullptr;
+  IssueCall("glMapBufferRange", {target, ofs, size, access}, 0,
+            [&] { ptr = glMapBufferRange(target, ofs, size, access); });
+  // Use host memory if the call is not issued by the recording backend
+  if (ptr == nullptr && trace_manager_ != nullptr &&
+      trace_manager_->GetBackend() == TraceManager::Backends::kRecording) {
+    ptr = trace_manager_->AllocStubMemory(size);
+  }
+  if (ptr == nullptr) {
+    throw std::runtime_error("Could not map the buffer name '" + buffer_name +
+                             "'");
+  }
+  return ptr;
 }
 
 /*******************************************************************************
@@ -66,7 +155,8 @@ void as::BufferManager::UpdateBuffer(const std::string &buffer_name,
                                      const GLsizeiptr size,
                                      const GLvoid *data) {
   BindBuffer(buffer_name, target);
-  glBufferSubData(target, ofs, size, data);
+  IssueCall("glBufferSubData", {target, ofs, size}, size,
+            [&] { glBufferSubData(target, ofs, size, data); });
   // Save the parameters
   UpdateBufferPrevParams prev_params = {target, ofs, size, data};
   update_buffer_prev_params_[buffer_name] = prev_params;
@@ -85,7 +175,12 @@ void as::BufferManager::UpdateBuffer(const std::string &buffer_name) {
 
 void as::BufferManager::DeleteBuffer(const std::string &buffer_name) {
   const GLuint hdlr = GetBufferHdlr(buffer_name);
-  glDeleteBuffers(1, &hdlr);
+  IssueCall("glDeleteBuffers", {1, hdlr}, 0,
+            [&] { glDeleteBuffers(1, &hdlr); });
+  // Forget the buffer state
+  if (state_manager_ != nullptr) {
+    state_manager_->InvalidateBuffer(hdlr);
+  }
   // Delete previous parameters
   bind_buffer_prev_params_.erase(buffer_name);
   update_buffer_prev_params_.erase(buffer_name);
@@ -0,0 +1,171 @@
+#include "as/gl/draw_list.hpp"
+
+/*******************************************************************************
+ * Constants
+ ******************************************************************************/
+
+// Number of bits sorted in each radix sort pass
+static const GLuint kRadixNumBits = 8;
+
+// Number of buckets in each radix sort pass
+static const size_t kRadixNumBuckets = 1 << kRadixNumBits;
+
+/*******************************************************************************
+ * Sort Keys
+ ******************************************************************************/
+
+GLuint64 as::DrawList::MakeSortKey(const GLuint pass, const GLuint program_idx,
+                                   const GLuint material_idx,
+                                   const GLuint depth, const GLuint va_idx) {
+  return PackKeyField(KeyFields::kPass, pass) |
+         PackKeyField(KeyFields::kProgram, program_idx) |
+         PackKeyField(KeyFields::kMaterial, material_idx) |
+         PackKeyField(KeyFields::kDepth, depth) |
+         PackKeyField(KeyFields::kVertexArray, va_idx);
+}
+
+/*
+ * Quantizes the non-negative depth into the depth field, nearer depth gets
+ * smaller value so that the draws are sorted from front to back
+ */
+GLuint as::DrawList::QuantizeDepth(const float depth, const float max_depth) {
+  const GLuint max_value = (1 << GetKeyFieldNumBits(KeyFields::kDepth)) - 1;
+  const float ratio = glm::clamp(depth / max_depth, 0.0f, 1.0f);
+  return static_cast<GLuint>(ratio * max_value);
+}
+
+GLuint as::DrawList::GetKeyField(const GLuint64 sort_key,
+                                 const KeyFields field) {
+  const GLuint64 mask = (GLuint64(1) << GetKeyFieldNumBits(field)) - 1;
+  return static_cast<GLuint>((sort_key >> GetKeyFieldShift(field)) & mask);
+}
+
+/*******************************************************************************
+ * Recordings
+ ******************************************************************************/
+
+void as::DrawList::Clear() { draw_cmds_.clear(); }
+
+void as::DrawList::AddDrawCmd(const GLuint64 sort_key, const size_t item_idx) {
+  draw_cmds_.push_back(DrawCmd{sort_key, item_idx});
+}
+
+/*******************************************************************************
+ * Sortings
+ ******************************************************************************/
+
+/*
+ * Sorts the draw commands by the LSD radix sort, which is stable. The passes in
+ * which all keys share the same digit are skipped.
+ *
+ * Reference: https://en.wikipedia.org/wiki/Radix_sort
+ */
+void as::DrawList::Sort() {
+  const size_t num_cmds = draw_cmds_.size();
+  sorted_draw_cmds_.resize(num_cmds);
+  for (GLuint shift = 0; shift < 64; shift += kRadixNumBits) {
+    // Count the digits
+    std::vector<size_t> counts(kRadixNumBuckets, 0);
+    for (const DrawCmd &draw_cmd : draw_cmds_) {
+      counts[(draw_cmd.sort_key >> shift) & (kRadixNumBuckets - 1)]++;
+    }
+    // Skip the pass if all keys share the same digit
+    if (std::find(counts.begin(), counts.end(), num_cmds) != counts.end()) {
+      continue;
+    }
+    // Calculate the starting positions of the buckets
+    size_t pos = 0;
+    for (size_t &count : counts) {
+      const size_t bucket_size = count;
+      count = pos;
+      pos += bucket_size;
+    }
+    // Scatter the draw commands
+    for (const DrawCmd &draw_cmd : draw_cmds_) {
+      const size_t digit =
+          (draw_cmd.sort_key >> shift) & (kRadixNumBuckets - 1);
+      sorted_draw_cmds_[counts[digit]++] = draw_cmd;
+    }
+    draw_cmds_.swap(sorted_draw_cmds_);
+  }
+}
+
+/*******************************************************************************
+ * Draw Command Getters
+ ******************************************************************************/
+
+const std::vector<as::DrawList::DrawCmd> &as::DrawList::GetDrawCmds() const {
+  return draw_cmds_;
+}
+
+/*******************************************************************************
+ * Statistics Getters
+ ******************************************************************************/
+
+/*
+ * Counts how many times the field changes between consecutive draw commands,
+ * including the first draw command
+ */
+unsigned int as::DrawList::CountFieldChanges(const KeyFields field) const {
+  unsigned int num_changes = 0;
+  for (size_t cmd_idx = 0; cmd_idx < draw_cmds_.size(); cmd_idx++) {
+    const GLuint value = GetKeyField(draw_cmds_[cmd_idx].sort_key, field);
+    if (cmd_idx == 0 ||
+        value != GetKeyField(draw_cmds_[cmd_idx - 1].sort_key, field)) {
+      num_changes++;
+    }
+  }
+  return num_changes;
+}
+
+/*******************************************************************************
+ * Key Field Packings (Private)
+ ******************************************************************************/
+
+GLuint64 as::DrawList::PackKeyField(const KeyFields field, const GLuint value) {
+  // Check whether the value fits in the field
+  const GLuint num_bits = GetKeyFieldNumBits(field);
+  if (static_cast<GLuint64>(value) >= (GLuint64(1) << num_bits)) {
+    throw std::runtime_error("Sort key field value " + std::to_string(value) +
+                             " is out of range");
+  }
+  return static_cast<GLuint64>(value) << GetKeyFieldShift(field);
+}
+
+/*******************************************************************************
+ * Key Field Getters (Private)
+ ******************************************************************************/
+
+GLuint as::DrawList::GetKeyFieldShift(const KeyFields field) {
+  switch (field) {
+    case KeyFields::kPass:
+      return 60;
+    case KeyFields::kProgram:
+      return 52;
+    case KeyFields::kMaterial:
+      return 36;
+    case KeyFields::kDepth:
+      return 16;
+    case KeyFields::kVertexArray:
+      return 0;
+    default:
+      throw std::runtime_error("Unknown sort key field");
+  }
+}
+
+GLuint as::DrawList::GetKeyFieldNumBits(const KeyFields field) {
+  switch (field) {
+    case KeyFields::kPass:
+      return 4;
+    case KeyFields::kProgram:
+      return 8;
+    case KeyFields::kMaterial:
+      return 16;
+    case KeyFields::kDepth:
+      return 20;
+    case KeyFields::kVertexArray:
+      return 16;
+    default:
+      throw std::runtime_error("Unknown sort key field");
+  }
+}
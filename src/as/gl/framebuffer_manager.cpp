@@ -1,15 +1,46 @@
 #include "as/gl/framebuffer_manager.hpp"
 
-as::FramebufferManager::FramebufferManager() : texture_manager_(nullptr) {}
+/*******************************************************************************
+ * Constants
+ ******************************************************************************/
+
+// Number of frames a released render target stays in the pool before deletion
+static const GLuint64 kMaxRenderTargetIdleFrames = 60;
+
+// Pass range which overlaps every other pass range
+static const int kPersistentFirstPassIdx = INT_MIN;
+static const int kPersistentLastPassIdx = INT_MAX;
+
+as::FramebufferManager::FramebufferManager()
+    : texture_manager_(nullptr),
+      state_manager_(nullptr),
+      trace_manager_(nullptr),
+      frame_idx_(0),
+      next_render_target_id_(0),
+      num_render_target_allocs_(0),
+      num_render_target_reuses_(0) {}
 
 as::FramebufferManager::~FramebufferManager() {
   // Delete all framebuffers
   for (const auto& pair : framebuffer_hdlrs_) {
-    glDeleteFramebuffers(1, &pair.second);
+    IssueCall("glDeleteFramebuffers", {1, pair.second},
+              [&] { glDeleteFramebuffers(1, &pair.second); });
   }
   // Delete all renderbuffers
   for (const auto& pair : renderbuffer_hdlrs_) {
-    glDeleteRenderbuffers(1, &pair.second);
+    IssueCall("glDeleteRenderbuffers", {1, pair.second},
+              [&] { glDeleteRenderbuffers(1, &pair.second); });
+  }
+  // Delete all render targets
+  for (const auto& pair : render_targets_) {
+    const RenderTarget& render_target = pair.second;
+    if (render_target.kind == RenderTargetKinds::kRenderbuffer) {
+      IssueCall("glDeleteRenderbuffers", {1, render_target.hdlr},
+                [&] { glDeleteRenderbuffers(1, &render_target.hdlr); });
+    } else {
+      IssueCall("glDeleteTextures", {1, render_target.hdlr},
+                [&] { glDeleteTextures(1, &render_target.hdlr); });
+    }
   }
 }
 
@@ -18,26 +49,56 @@ as::FramebufferManager::~FramebufferManager() {
  ******************************************************************************/
 
 void as::FramebufferManager::RegisterTextureManager(
-    const TextureManager& texture_manager) {
+    TextureManager& texture_manager) {
   texture_manager_ = &texture_manager;
 }
 
+void as::FramebufferManager::RegisterStateManager(StateManager& state_manager) {
+  state_manager_ = &state_manager;
+}
+
+void as::FramebufferManager::RegisterTraceManager(TraceManager& trace_manager) {
+  trace_manager_ = &trace_manager;
+}
+
+/*******************************************************************************
+ * Frame Controls
+ ******************************************************************************/
+
+/*
+ * Deletes the render targets which have been released for too many frames
+ */
+void as::FramebufferManager::StartFrame() {
+  frame_idx_++;
+  for (auto it = render_targets_.begin(); it != render_targets_.end();) {
+    const RenderTarget& render_target = it->second;
+    if (render_target.pass_ranges.empty() &&
+        frame_idx_ - render_target.released_frame_idx >
+            kMaxRenderTargetIdleFrames) {
+      DeleteRenderTarget(render_target);
+      it = render_targets_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
 /*******************************************************************************
  * Generations
  ******************************************************************************/
 
 void as::FramebufferManager::GenFramebuffer(
     const std::string& framebuffer_name) {
-  GLuint hdlr;
-  glGenFramebuffers(1, &hdlr);
-  framebuffer_hdlrs_[framebuffer_name] = hdlr;
+  GLuint hdlr = 0;
+  IssueCall("glGenFramebuffers", {1}, [&] { glGenFramebuffers(1, &hdlr); });
+  framebuffer_hdlrs_[framebuffer_name] = GenStubHdlr(hdlr);
 }
 
 void as::FramebufferManager::GenRenderbuffer(
     const std::string& renderbuffer_name) {
-  GLuint hdlr;
-  glGenRenderbuffers(1, &hdlr);
-  renderbuffer_hdlrs_[renderbuffer_name] = hdlr;
+  GLuint hdlr = 0;
+  IssueCall("glGenRenderbuffers", {1}, [&] { glGenRenderbuffers(1, &hdlr); });
+  renderbuffer_hdlrs_[renderbuffer_name] = GenStubHdlr(hdlr);
 }
 
 /*******************************************************************************
@@ -47,7 +108,13 @@ void as::FramebufferManager::GenRenderbuffer(
 void as::FramebufferManager::BindFramebuffer(
     const std::string& framebuffer_name, const GLenum framebuffer_target) {
   const GLuint hdlr = GetFramebufferHdlr(framebuffer_name);
-  glBindFramebuffer(framebuffer_target, hdlr);
+  // Skip the redundant binding if the state manager is registered
+  if (state_manager_ != nullptr) {
+    state_manager_->BindFramebuffer(framebuffer_target, hdlr);
+  } else {
+    IssueCall("glBindFramebuffer", {framebuffer_target, hdlr},
+              [&] { glBindFramebuffer(framebuffer_target, hdlr); });
+  }
   // Save the parameters
   BindFramebufferPrevParams prev_params = {framebuffer_target};
   bind_framebuffer_prev_params_[framebuffer_name] = prev_params;
@@ -62,13 +129,19 @@ void as::FramebufferManager::BindFramebuffer(
 
 void as::FramebufferManager::BindDefaultFramebuffer(
     const GLenum framebuffer_target) {
-  glBindFramebuffer(framebuffer_target, 0);
+  if (state_manager_ != nullptr) {
+    state_manager_->BindFramebuffer(framebuffer_target, 0);
+  } else {
+    IssueCall("glBindFramebuffer", {framebuffer_target, 0},
+              [&] { glBindFramebuffer(framebuffer_target, 0); });
+  }
 }
 
 void as::FramebufferManager::BindRenderbuffer(
     const std::string& renderbuffer_name, const GLenum renderbuffer_target) {
   const GLuint hdlr = GetRenderbufferHdlr(renderbuffer_name);
-  glBindRenderbuffer(renderbuffer_target, hdlr);
+  IssueCall("glBindRenderbuffer", {renderbuffer_target, hdlr},
+            [&] { glBindRenderbuffer(renderbuffer_target, hdlr); });
   // Save the parameters
   BindRenderbufferPrevParams prev_params = {renderbuffer_target};
   bind_renderbuffer_prev_params_[renderbuffer_name] = prev_params;
@@ -89,7 +162,98 @@ void as::FramebufferManager::InitRenderbuffer(
     const std::string& renderbuffer_name, const GLenum renderbuffer_target,
     const GLenum internal_fmt, const GLsizei width, const GLsizei height) {
   BindRenderbuffer(renderbuffer_name, renderbuffer_target);
-  glRenderbufferStorage(renderbuffer_target, internal_fmt, width, height);
+  IssueCall("glRenderbufferStorage",
+            {renderbuffer_target, internal_fmt, width, height}, [&] {
+              glRenderbufferStorage(renderbuffer_target, internal_fmt, width,
+                                    height);
+            });
+}
+
+/*******************************************************************************
+ * Render Target Pool
+ ******************************************************************************/
+
+/*
+ * Acquires a pooled renderbuffer which is only used in the passes from
+ * first_pass_idx to last_pass_idx, so it could be aliased by other
+ * renderbuffers used outside the passes. The previous renderbuffer of the name
+ * is released back to the pool.
+ */
+void as::FramebufferManager::AcquireRenderbuffer(
+    const std::string& renderbuffer_name, const RenderTargetDesc& desc,
+    const int first_pass_idx, const int last_pass_idx) {
+  if (renderbuffer_hdlrs_.count(renderbuffer_name) > 0) {
+    throw std::runtime_error("Renderbuffer name '" + renderbuffer_name +
+                             "' is not pooled");
+  }
+  AcquireRenderTarget(RenderTargetKinds::kRenderbuffer, renderbuffer_name,
+                      desc, first_pass_idx, last_pass_idx);
+}
+
+/*
+ * Acquires a pooled renderbuffer which is used in all passes
+ */
+void as::FramebufferManager::AcquireRenderbuffer(
+    const std::string& renderbuffer_name, const RenderTargetDesc& desc) {
+  AcquireRenderbuffer(renderbuffer_name, desc, kPersistentFirstPassIdx,
+                      kPersistentLastPassIdx);
+}
+
+/*
+ * Acquires a pooled 2D texture and registers it to the texture manager, so
+ * that it could be configured and bound by name
+ */
+void as::FramebufferManager::AcquireTexture2D(const std::string& tex_name,
+                                              const RenderTargetDesc& desc,
+                                              const int first_pass_idx,
+                                              const int last_pass_idx) {
+  const auto key = std::make_tuple(RenderTargetKinds::kTexture2D, tex_name);
+  if (render_target_ids_.count(key) == 0 &&
+      texture_manager_->HasTexture(tex_name)) {
+    throw std::runtime_error("Texture name '" + tex_name + "' is not pooled");
+  }
+  const GLuint tex_hdlr =
+      AcquireRenderTarget(RenderTargetKinds::kTexture2D, tex_name, desc,
+                          first_pass_idx, last_pass_idx);
+  // Let the texture manager know the new handler
+  if (texture_manager_->HasTexture(tex_name)) {
+    texture_manager_->UnregisterTexture(tex_name);
+  }
+  texture_manager_->RegisterTexture(tex_name, tex_hdlr);
+}
+
+/*
+ * Acquires a pooled 2D texture which is used in all passes
+ */
+void as::FramebufferManager::AcquireTexture2D(const std::string& tex_name,
+                                              const RenderTargetDesc& desc) {
+  AcquireTexture2D(tex_name, desc, kPersistentFirstPassIdx,
+                   kPersistentLastPassIdx);
+}
+
+/*
+ * Releases the renderbuffer back to the pool, the name could no longer be used
+ * until it is acquired again
+ */
+void as::FramebufferManager::ReleaseRenderbuffer(
+    const std::string& renderbuffer_name) {
+  ReleaseRenderTarget(RenderTargetKinds::kRenderbuffer, renderbuffer_name);
+  bind_renderbuffer_prev_params_.erase(renderbuffer_name);
+}
+
+void as::FramebufferManager::ReleaseTexture2D(const std::string& tex_name) {
+  ReleaseRenderTarget(RenderTargetKinds::kTexture2D, tex_name);
+  if (texture_manager_->HasTexture(tex_name)) {
+    texture_manager_->UnregisterTexture(tex_name);
+  }
+}
+
+bool as::FramebufferManager::IsSameRenderTargetDesc(
+    const RenderTargetDesc& desc1, const RenderTargetDesc& desc2) {
+  return desc1.internal_fmt == desc2.internal_fmt &&
+         desc1.width == desc2.width && desc1.height == desc2.height &&
+         desc1.num_mipmap_levels == desc2.num_mipmap_levels &&
+         desc1.num_samples == desc2.num_samples;
 }
 
 /*******************************************************************************
@@ -102,7 +266,11 @@ void as::FramebufferManager::AttachTextureToFramebuffer(
     const GLint mipmap_level) {
   BindFramebuffer(framebuffer_name, framebuffer_target);
   const GLuint tex_hdlr = texture_manager_->GetTextureHdlr(tex_name);
-  glFramebufferTexture(framebuffer_target, attachment, tex_hdlr, mipmap_level);
+  IssueCall("glFramebufferTexture",
+            {framebuffer_target, attachment, tex_hdlr, mipmap_level}, [&] {
+              glFramebufferTexture(framebuffer_target, attachment, tex_hdlr,
+                                   mipmap_level);
+            });
 }
 
 void as::FramebufferManager::AttachTexture2DToFramebuffer(
@@ -111,8 +279,13 @@ void as::FramebufferManager::AttachTexture2DToFramebuffer(
     const GLenum tex_target, const GLint mipmap_level) {
   BindFramebuffer(framebuffer_name, framebuffer_target);
   const GLuint tex_hdlr = texture_manager_->GetTextureHdlr(tex_name);
-  glFramebufferTexture2D(framebuffer_target, attachment, tex_target, tex_hdlr,
-                         mipmap_level);
+  IssueCall("glFramebufferTexture2D",
+            {framebuffer_target, attachment, tex_target, tex_hdlr,
+             mipmap_level},
+            [&] {
+              glFramebufferTexture2D(framebuffer_target, attachment,
+                                     tex_target, tex_hdlr, mipmap_level);
+            });
 }
 
 void as::FramebufferManager::AttachRenderbufferToFramebuffer(
@@ -121,8 +294,13 @@ void as::FramebufferManager::AttachRenderbufferToFramebuffer(
     const GLenum renderbuffer_target) {
   BindFramebuffer(framebuffer_name, framebuffer_target);
   const GLuint renderbuffer_hdlr = GetRenderbufferHdlr(renderbuffer_name);
-  glFramebufferRenderbuffer(framebuffer_target, attachment, renderbuffer_target,
-                            renderbuffer_hdlr);
+  IssueCall("glFramebufferRenderbuffer",
+            {framebuffer_target, attachment, renderbuffer_target,
+             renderbuffer_hdlr},
+            [&] {
+              glFramebufferRenderbuffer(framebuffer_target, attachment,
+                                        renderbuffer_target, renderbuffer_hdlr);
+            });
 }
 
 /*******************************************************************************
@@ -132,7 +310,12 @@ void as::FramebufferManager::AttachRenderbufferToFramebuffer(
 void as::FramebufferManager::DeleteFramebuffer(
     const std::string& framebuffer_name) {
   const GLuint hdlr = GetFramebufferHdlr(framebuffer_name);
-  glDeleteFramebuffers(1, &hdlr);
+  IssueCall("glDeleteFramebuffers", {1, hdlr},
+            [&] { glDeleteFramebuffers(1, &hdlr); });
+  // Forget the framebuffer state
+  if (state_manager_ != nullptr) {
+    state_manager_->InvalidateFramebuffer(hdlr);
+  }
   // Delete previous parameters
   bind_framebuffer_prev_params_.erase(framebuffer_name);
 }
@@ -140,7 +323,8 @@ void as::FramebufferManager::DeleteFramebuffer(
 void as::FramebufferManager::DeleteRenderbuffer(
     const std::string& renderbuffer_name) {
   const GLuint hdlr = GetRenderbufferHdlr(renderbuffer_name);
-  glDeleteRenderbuffers(1, &hdlr);
+  IssueCall("glDeleteRenderbuffers", {1, hdlr},
+            [&] { glDeleteRenderbuffers(1, &hdlr); });
   // Delete previous parameters
   bind_renderbuffer_prev_params_.erase(renderbuffer_name);
 }
@@ -164,6 +348,12 @@ GLuint as::FramebufferManager::GetRenderbufferHdlr(
     throw std::runtime_error("Could not find the renderbuffer name '" +
                              renderbuffer_name + "'");
   }
+  // Check whether the renderbuffer is pooled
+  const auto key =
+      std::make_tuple(RenderTargetKinds::kRenderbuffer, renderbuffer_name);
+  if (render_target_ids_.count(key) > 0) {
+    return render_targets_.at(render_target_ids_.at(key)).hdlr;
+  }
   return renderbuffer_hdlrs_.at(renderbuffer_name);
 }
 
@@ -178,7 +368,39 @@ bool as::FramebufferManager::HasFramebuffer(
 
 bool as::FramebufferManager::HasRenderbuffer(
     const std::string& renderbuffer_name) const {
-  return renderbuffer_hdlrs_.count(renderbuffer_name) > 0;
+  const auto key =
+      std::make_tuple(RenderTargetKinds::kRenderbuffer, renderbuffer_name);
+  return renderbuffer_hdlrs_.count(renderbuffer_name) > 0 ||
+         render_target_ids_.count(key) > 0;
+}
+
+/*******************************************************************************
+ * Statistics Getters
+ ******************************************************************************/
+
+/*
+ * The requested bytes are what the names would use without the pool, and the
+ * difference from the allocated bytes in use is saved by aliasing
+ */
+as::FramebufferManager::RenderTargetStats
+as::FramebufferManager::GetRenderTargetStats() const {
+  RenderTargetStats stats = {0, 0, 0, 0, 0, num_render_target_allocs_,
+                             num_render_target_reuses_};
+  for (const auto& pair : render_targets_) {
+    const RenderTarget& render_target = pair.second;
+    const GLsizeiptr num_bytes = GetRenderTargetNumBytes(render_target.desc);
+    const unsigned int num_names =
+        static_cast<unsigned int>(render_target.pass_ranges.size());
+    stats.num_requested_bytes += num_bytes * num_names;
+    stats.num_allocated_bytes += num_bytes;
+    if (num_names == 0) {
+      stats.num_idle_bytes += num_bytes;
+    } else {
+      stats.num_aliases += num_names - 1;
+    }
+    stats.num_render_targets++;
+  }
+  return stats;
 }
 
 /*******************************************************************************
@@ -206,3 +428,225 @@ as::FramebufferManager::GetRenderbufferPrevParams(
   }
   return bind_renderbuffer_prev_params_.at(renderbuffer_name);
 }
+
+/*******************************************************************************
+ * Render Target Pool (Private)
+ ******************************************************************************/
+
+GLuint as::FramebufferManager::AcquireRenderTarget(
+    const RenderTargetKinds kind, const std::string& name,
+    const RenderTargetDesc& desc, const int first_pass_idx,
+    const int last_pass_idx) {
+  if (first_pass_idx > last_pass_idx) {
+    throw std::runtime_error("Invalid pass range for render target name '" +
+                             name + "'");
+  }
+  // Release the previous render target of the name
+  ReleaseRenderTarget(kind, name);
+  // Find a compatible render target, or create a new one
+  unsigned int id = FindRenderTarget(kind, desc, first_pass_idx, last_pass_idx);
+  if (render_targets_.count(id) == 0) {
+    RenderTarget render_target;
+    render_target.kind = kind;
+    render_target.desc = desc;
+    render_target.hdlr = CreateRenderTarget(kind, desc);
+    render_target.released_frame_idx = frame_idx_;
+    render_targets_[id] = render_target;
+    next_render_target_id_++;
+    num_render_target_allocs_++;
+  } else if (render_targets_.at(id).pass_ranges.empty()) {
+    num_render_target_reuses_++;
+  }
+  // Assign the render target to the name
+  RenderTarget& render_target = render_targets_.at(id);
+  render_target.pass_ranges[name] =
+      std::make_tuple(first_pass_idx, last_pass_idx);
+  render_target_ids_[std::make_tuple(kind, name)] = id;
+  return render_target.hdlr;
+}
+
+void as::FramebufferManager::ReleaseRenderTarget(const RenderTargetKinds kind,
+                                                 const std::string& name) {
+  const auto key = std::make_tuple(kind, name);
+  if (render_target_ids_.count(key) == 0) {
+    return;
+  }
+  RenderTarget& render_target = render_targets_.at(render_target_ids_.at(key));
+  render_target.pass_ranges.erase(name);
+  // Start counting the idle frames
+  if (render_target.pass_ranges.empty()) {
+    render_target.released_frame_idx = frame_idx_;
+  }
+  render_target_ids_.erase(key);
+}
+
+/*
+ * Returns the ID of the render target with the same description whose passes
+ * don't overlap with the given pass range. Render targets already in use are
+ * preferred so that the memory is aliased. Returns the next unused ID if no
+ * render target is found.
+ */
+unsigned int as::FramebufferManager::FindRenderTarget(
+    const RenderTargetKinds kind, const RenderTargetDesc& desc,
+    const int first_pass_idx, const int last_pass_idx) {
+  unsigned int idle_id = next_render_target_id_;
+  for (const auto& pair : render_targets_) {
+    const RenderTarget& render_target = pair.second;
+    if (render_target.kind != kind ||
+        !IsSameRenderTargetDesc(render_target.desc, desc)) {
+      continue;
+    }
+    // Remember the idle render target in case no one could be aliased
+    if (render_target.pass_ranges.empty()) {
+      if (idle_id == next_render_target_id_) {
+        idle_id = pair.first;
+      }
+      continue;
+    }
+    // Check whether all pass ranges don't overlap
+    bool is_disjoint = true;
+    for (const auto& pass_range_pair : render_target.pass_ranges) {
+      const int other_first_pass_idx = std::get<0>(pass_range_pair.second);
+      const int other_last_pass_idx = std::get<1>(pass_range_pair.second);
+      if (first_pass_idx <= other_last_pass_idx &&
+          other_first_pass_idx <= last_pass_idx) {
+        is_disjoint = false;
+        break;
+      }
+    }
+    if (is_disjoint) {
+      return pair.first;
+    }
+  }
+  return idle_id;
+}
+
+GLuint as::FramebufferManager::CreateRenderTarget(
+    const RenderTargetKinds kind, const RenderTargetDesc& desc) {
+  GLuint hdlr = 0;
+  if (kind == RenderTargetKinds::kRenderbuffer) {
+    IssueCall("glGenRenderbuffers", {1},
+              [&] { glGenRenderbuffers(1, &hdlr); });
+    hdlr = GenStubHdlr(hdlr);
+    IssueCall("glBindRenderbuffer", {GL_RENDERBUFFER, hdlr},
+              [&] { glBindRenderbuffer(GL_RENDERBUFFER, hdlr); });
+    if (desc.num_samples > 0) {
+      IssueCall("glRenderbufferStorageMultisample",
+                {GL_RENDERBUFFER, desc.num_samples, desc.internal_fmt,
+                 desc.width, desc.height},
+                [&] {
+                  glRenderbufferStorageMultisample(
+                      GL_RENDERBUFFER, desc.num_samples, desc.internal_fmt,
+                      desc.width, desc.height);
+                });
+    } else {
+      IssueCall("glRenderbufferStorage",
+                {GL_RENDERBUFFER, desc.internal_fmt, desc.width, desc.height},
+                [&] {
+                  glRenderbufferStorage(GL_RENDERBUFFER, desc.internal_fmt,
+                                        desc.width, desc.height);
+                });
+    }
+  } else {
+    const GLenum target = desc.num_samples > 0 ? GL_TEXTURE_2D_MULTISAMPLE
+                                               : GL_TEXTURE_2D;
+    IssueCall("glGenTextures", {1}, [&] { glGenTextures(1, &hdlr); });
+    hdlr = GenStubHdlr(hdlr);
+    // Bind the texture on the first unit
+    if (state_manager_ != nullptr) {
+      state_manager_->BindTexture(target, 0, hdlr);
+    } else {
+      IssueCall("glActiveTexture", {GL_TEXTURE0},
+                [&] { glActiveTexture(GL_TEXTURE0); });
+      IssueCall("glBindTexture", {target, hdlr},
+                [&] { glBindTexture(target, hdlr); });
+    }
+    if (desc.num_samples > 0) {
+      IssueCall("glTexStorage2DMultisample",
+                {target, desc.num_samples, desc.internal_fmt, desc.width,
+                 desc.height},
+                [&] {
+                  glTexStorage2DMultisample(target, desc.num_samples,
+                                            desc.internal_fmt, desc.width,
+                                            desc.height, GL_TRUE);
+                });
+    } else {
+      IssueCall("glTexStorage2D",
+                {target, desc.num_mipmap_levels, desc.internal_fmt, desc.width,
+                 desc.height},
+                [&] {
+                  glTexStorage2D(target, desc.num_mipmap_levels,
+                                 desc.internal_fmt, desc.width, desc.height);
+                });
+    }
+  }
+  return hdlr;
+}
+
+void as::FramebufferManager::DeleteRenderTarget(
+    const RenderTarget& render_target) {
+  if (render_target.kind == RenderTargetKinds::kRenderbuffer) {
+    IssueCall("glDeleteRenderbuffers", {1, render_target.hdlr},
+              [&] { glDeleteRenderbuffers(1, &render_target.hdlr); });
+  } else {
+    IssueCall("glDeleteTextures", {1, render_target.hdlr},
+              [&] { glDeleteTextures(1, &render_target.hdlr); });
+    // Forget the texture state
+    if (state_manager_ != nullptr) {
+      state_manager_->InvalidateTexture(render_target.hdlr);
+    }
+  }
+}
+
+/*
+ * Estimates the number of bytes of the render target from its format
+ */
+GLsizeiptr as::FramebufferManager::GetRenderTargetNumBytes(
+    const RenderTargetDesc& desc) {
+  GLsizeiptr num_pixel_bytes;
+  switch (desc.internal_fmt) {
+    case GL_R8: {
+      num_pixel_bytes = 1;
+    } break;
+    case GL_RGB8: {
+      num_pixel_bytes = 3;
+    } break;
+    case GL_RGBA16F: {
+      num_pixel_bytes = 8;
+    } break;
+    case GL_RGBA32F: {
+      num_pixel_bytes = 16;
+    } break;
+    default: {
+      // Most color and depth formats use 4 bytes
+      num_pixel_bytes = 4;
+    }
+  }
+  const GLsizeiptr num_samples = std::max(desc.num_samples, 1);
+  // Sum up the sizes of all mipmap levels
+  const GLsizei num_levels = std::max(desc.num_mipmap_levels, 1);
+  GLsizeiptr num_bytes = 0;
+  GLsizeiptr width = desc.width;
+  GLsizeiptr height = desc.height;
+  for (GLsizei level = 0; level < num_levels; level++) {
+    num_bytes += width * height * num_pixel_bytes * num_samples;
+    width = std::max<GLsizeiptr>(width / 2, 1);
+    height = std::max<GLsizeiptr>(height / 2, 1);
+  }
+  return num_bytes;
+}
+
+/*******************************************************************************
+ * Call Issuings (Private)
+ ******************************************************************************/
+
+/*
+ * Returns a fake handler if the generation is not issued by the recording
+ * backend, otherwise returns the generated handler
+ */
+GLuint as::FramebufferManager::GenStubHdlr(const GLuint hdlr) {
+  if (hdlr == 0 && trace_manager_ != nullptr) {
+    return trace_manager_->GenStubHdlr();
+  }
+  return hdlr;
+}
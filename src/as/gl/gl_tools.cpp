@@ -126,23 +126,46 @@ void as::ClearDepthBuffer() { glClear(GL_DEPTH_BUFFER_BIT); }
 
 as::GLManagers::GLManagers() {
   // Create managers
+  trace_manager_ = TraceManager();
   buffer_manager_ = BufferManager();
   framebuffer_manager_ = FramebufferManager();
+  profiler_manager_ = ProfilerManager();
   program_manager_ = ProgramManager();
+  ring_buffer_manager_ = RingBufferManager();
   shader_manager_ = ShaderManager();
+  state_manager_ = StateManager();
   texture_manager_ = TextureManager();
   ui_manager_ = UiManager();
   uniform_manager_ = UniformManager();
   vertex_spec_manager_ = VertexSpecManager();
-  // Initialize managers
-  texture_manager_.Init();
-  uniform_manager_.Init();
   // Register managers
   framebuffer_manager_.RegisterTextureManager(texture_manager_);
   program_manager_.RegisterShaderManager(shader_manager_);
+  ring_buffer_manager_.RegisterBufferManager(buffer_manager_);
   uniform_manager_.RegisterProgramManager(program_manager_);
   uniform_manager_.RegisterBufferManager(buffer_manager_);
   vertex_spec_manager_.RegisterBufferManager(buffer_manager_);
+  // Register the state manager
+  buffer_manager_.RegisterStateManager(state_manager_);
+  framebuffer_manager_.RegisterStateManager(state_manager_);
+  program_manager_.RegisterStateManager(state_manager_);
+  texture_manager_.RegisterStateManager(state_manager_);
+  uniform_manager_.RegisterStateManager(state_manager_);
+  vertex_spec_manager_.RegisterStateManager(state_manager_);
+  // Register the trace manager
+  buffer_manager_.RegisterTraceManager(trace_manager_);
+  framebuffer_manager_.RegisterTraceManager(trace_manager_);
+  profiler_manager_.RegisterTraceManager(trace_manager_);
+  program_manager_.RegisterTraceManager(trace_manager_);
+  ring_buffer_manager_.RegisterTraceManager(trace_manager_);
+  shader_manager_.RegisterTraceManager(trace_manager_);
+  state_manager_.RegisterTraceManager(trace_manager_);
+  texture_manager_.RegisterTraceManager(trace_manager_);
+  uniform_manager_.RegisterTraceManager(trace_manager_);
+  vertex_spec_manager_.RegisterTraceManager(trace_manager_);
+  // Initialize managers, the limits are queried through the trace manager
+  texture_manager_.Init();
+  uniform_manager_.Init();
 }
 
 as::BufferManager& as::GLManagers::GetBufferManager() {
@@ -153,18 +176,34 @@ as::FramebufferManager& as::GLManagers::GetFramebufferManager() {
   return framebuffer_manager_;
 }
 
+as::ProfilerManager& as::GLManagers::GetProfilerManager() {
+  return profiler_manager_;
+}
+
 as::ProgramManager& as::GLManagers::GetProgramManager() {
   return program_manager_;
 }
 
+as::RingBufferManager& as::GLManagers::GetRingBufferManager() {
+  return ring_buffer_manager_;
+}
+
 as::ShaderManager& as::GLManagers::GetShaderManager() {
   return shader_manager_;
 }
 
+as::StateManager& as::GLManagers::GetStateManager() {
+  return state_manager_;
+}
+
 as::TextureManager& as::GLManagers::GetTextureManager() {
   return texture_manager_;
 }
 
+as::TraceManager& as::GLManagers::GetTraceManager() {
+  return trace_manager_;
+}
+
 as::UiManager& as::GLManagers::GetUiManager() { return ui_manager_; }
 
 as::UniformManager& as::GLManagers::GetUniformManager() {
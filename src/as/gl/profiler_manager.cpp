@@ -0,0 +1,246 @@
+#include "as/gl/profiler_manager.hpp"
+
+/*******************************************************************************
+ * Constants
+ ******************************************************************************/
+
+// Number of recent frames kept in the histories
+static const int kNumHistoryFrames = 120;
+
+/*******************************************************************************
+ * Scoped Timers
+ ******************************************************************************/
+
+as::ProfilerManager::ScopedPass::ScopedPass(ProfilerManager &profiler_manager,
+                                            const std::string &pass_name)
+    : profiler_manager_(profiler_manager), pass_name_(pass_name) {
+  profiler_manager_.StartPass(pass_name_);
+}
+
+as::ProfilerManager::ScopedPass::~ScopedPass() {
+  profiler_manager_.FinishPass(pass_name_);
+}
+
+as::ProfilerManager::ProfilerManager()
+    : trace_manager_(nullptr), frame_idx_(0), history_ofs_(0) {}
+
+as::ProfilerManager::~ProfilerManager() {
+  // Delete all queries
+  for (const auto &pair : passes_) {
+    for (const std::vector<GLuint> &query_hdlrs : pair.second.query_hdlrs) {
+      const GLsizei num_queries = static_cast<GLsizei>(query_hdlrs.size());
+      IssueCall("glDeleteQueries", {num_queries}, [&] {
+        glDeleteQueries(num_queries, query_hdlrs.data());
+      });
+    }
+  }
+}
+
+/*******************************************************************************
+ * Manager Registrations
+ ******************************************************************************/
+
+void as::ProfilerManager::RegisterTraceManager(TraceManager &trace_manager) {
+  trace_manager_ = &trace_manager;
+}
+
+/*******************************************************************************
+ * Frame Controls
+ ******************************************************************************/
+
+/*
+ * Reads the queries issued two frames ago, which are about to be reused in
+ * this frame, and pushes the times of the last frame into the histories
+ */
+void as::ProfilerManager::StartFrame() {
+  frame_idx_++;
+  const int query_idx = frame_idx_ % 2;
+  for (auto &pair : passes_) {
+    Pass &pass = pair.second;
+    // Update the times
+    pass.times.cpu_seconds = pass.cur_cpu_seconds;
+    pass.cur_cpu_seconds = 0.0;
+    ReadQuery(pass, query_idx);
+    // Update the histories
+    pass.cpu_history.at(history_ofs_) =
+        static_cast<float>(1e3 * pass.times.cpu_seconds);
+    pass.gpu_history.at(history_ofs_) =
+        static_cast<float>(1e3 * pass.times.gpu_seconds);
+  }
+  history_ofs_ = (history_ofs_ + 1) % kNumHistoryFrames;
+}
+
+/*******************************************************************************
+ * Pass Controls
+ ******************************************************************************/
+
+void as::ProfilerManager::StartPass(const std::string &pass_name) {
+  // Create the pass when it's first seen
+  if (passes_.count(pass_name) == 0) {
+    Pass pass;
+    pass.num_queries[0] = 0;
+    pass.num_queries[1] = 0;
+    pass.cur_cpu_seconds = 0.0;
+    pass.times = PassTimes{0.0, 0.0};
+    pass.cpu_history = std::vector<float>(kNumHistoryFrames, 0.0f);
+    pass.gpu_history = std::vector<float>(kNumHistoryFrames, 0.0f);
+    passes_[pass_name] = pass;
+    pass_names_.push_back(pass_name);
+  }
+  Pass &pass = GetPass(pass_name);
+  // Generate another query when the pass is started more times than before
+  const int query_idx = frame_idx_ % 2;
+  std::vector<GLuint> &query_hdlrs = pass.query_hdlrs[query_idx];
+  const size_t num_queries = pass.num_queries[query_idx];
+  if (num_queries == query_hdlrs.size()) {
+    GLuint query_hdlr = 0;
+    IssueCall("glGenQueries", {1}, [&] { glGenQueries(1, &query_hdlr); });
+    // Use a fake handler if the call is not issued by the recording backend
+    if (query_hdlr == 0 && trace_manager_ != nullptr) {
+      query_hdlr = trace_manager_->GenStubHdlr();
+    }
+    query_hdlrs.push_back(query_hdlr);
+  }
+  // Start the timers
+  const GLuint query_hdlr = query_hdlrs.at(num_queries);
+  IssueCall("glBeginQuery", {GL_TIME_ELAPSED, query_hdlr},
+            [&] { glBeginQuery(GL_TIME_ELAPSED, query_hdlr); });
+  pass.cpu_start_time = std::chrono::high_resolution_clock::now();
+}
+
+void as::ProfilerManager::FinishPass(const std::string &pass_name) {
+  Pass &pass = GetPass(pass_name);
+  // Stop the timers
+  const auto cpu_end_time = std::chrono::high_resolution_clock::now();
+  IssueCall("glEndQuery", {GL_TIME_ELAPSED},
+            [&] { glEndQuery(GL_TIME_ELAPSED); });
+  const std::chrono::duration<double> cpu_time =
+      cpu_end_time - pass.cpu_start_time;
+  pass.cur_cpu_seconds += cpu_time.count();
+  // Mark the query as issued
+  const int query_idx = frame_idx_ % 2;
+  pass.num_queries[query_idx]++;
+}
+
+/*******************************************************************************
+ * Exports
+ ******************************************************************************/
+
+/*
+ * Saves the histories as CSV from the oldest frame, the times are in
+ * milliseconds
+ */
+void as::ProfilerManager::SaveCsv(const std::string &path) const {
+  FILE *stream;
+  const errno_t err = fopen_s(&stream, path.c_str(), "w");
+  if (err || stream == nullptr) {
+    throw std::runtime_error("Could not open the file '" + path + "'");
+  }
+  // Write the header
+  fprintf(stream, "frame");
+  for (const std::string &pass_name : pass_names_) {
+    fprintf(stream, ",%s CPU (ms),%s GPU (ms)", pass_name.c_str(),
+            pass_name.c_str());
+  }
+  fprintf(stream, "\n");
+  // Write the times
+  for (int frame = 0; frame < kNumHistoryFrames; frame++) {
+    const int history_idx = (history_ofs_ + frame) % kNumHistoryFrames;
+    fprintf(stream, "%d", frame);
+    for (const std::string &pass_name : pass_names_) {
+      const Pass &pass = GetPass(pass_name);
+      fprintf(stream, ",%.4f,%.4f", pass.cpu_history.at(history_idx),
+              pass.gpu_history.at(history_idx));
+    }
+    fprintf(stream, "\n");
+  }
+  fclose(stream);
+}
+
+/*******************************************************************************
+ * Time Getters
+ ******************************************************************************/
+
+const std::vector<std::string> &as::ProfilerManager::GetPassNames() const {
+  return pass_names_;
+}
+
+as::ProfilerManager::PassTimes as::ProfilerManager::GetPassTimes(
+    const std::string &pass_name) const {
+  return GetPass(pass_name).times;
+}
+
+/*
+ * Returns the sums of the times of all passes, the skipped passes have zero
+ * times
+ */
+as::ProfilerManager::PassTimes as::ProfilerManager::GetFrameTimes() const {
+  PassTimes frame_times = {0.0, 0.0};
+  for (const auto &pair : passes_) {
+    frame_times.cpu_seconds += pair.second.times.cpu_seconds;
+    frame_times.gpu_seconds += pair.second.times.gpu_seconds;
+  }
+  return frame_times;
+}
+
+const std::vector<float> &as::ProfilerManager::GetCpuHistory(
+    const std::string &pass_name) const {
+  return GetPass(pass_name).cpu_history;
+}
+
+const std::vector<float> &as::ProfilerManager::GetGpuHistory(
+    const std::string &pass_name) const {
+  return GetPass(pass_name).gpu_history;
+}
+
+/*
+ * Returns the index of the oldest frame in the histories, which could be used
+ * as the offset of ImGui::PlotLines
+ */
+int as::ProfilerManager::GetHistoryOfs() const { return history_ofs_; }
+
+/*******************************************************************************
+ * Pass Getters (Private)
+ ******************************************************************************/
+
+as::ProfilerManager::Pass &as::ProfilerManager::GetPass(
+    const std::string &pass_name) {
+  if (passes_.count(pass_name) == 0) {
+    throw std::runtime_error("Could not find the pass name '" + pass_name +
+                             "'");
+  }
+  return passes_.at(pass_name);
+}
+
+const as::ProfilerManager::Pass &as::ProfilerManager::GetPass(
+    const std::string &pass_name) const {
+  if (passes_.count(pass_name) == 0) {
+    throw std::runtime_error("Could not find the pass name '" + pass_name +
+                             "'");
+  }
+  return passes_.at(pass_name);
+}
+
+/*******************************************************************************
+ * Query Readings (Private)
+ ******************************************************************************/
+
+/*
+ * Sums the times of all queries issued for the pass in that frame, which is
+ * zero if the pass was skipped
+ */
+void as::ProfilerManager::ReadQuery(Pass &pass, const int query_idx) {
+  GLuint64 total_elapsed_ns = 0;
+  for (size_t query_num = 0; query_num < pass.num_queries[query_idx];
+       query_num++) {
+    // The result should be available after two frames, so it rarely waits
+    const GLuint query_hdlr = pass.query_hdlrs[query_idx].at(query_num);
+    GLuint64 elapsed_ns = 0;
+    IssueCall("glGetQueryObjectui64v", {query_hdlr, GL_QUERY_RESULT}, [&] {
+      glGetQueryObjectui64v(query_hdlr, GL_QUERY_RESULT, &elapsed_ns);
+    });
+    total_elapsed_ns += elapsed_ns;
+  }
+  pass.times.gpu_seconds = 1e-9 * static_cast<double>(total_elapsed_ns);
+  pass.num_queries[query_idx] = 0;
+}
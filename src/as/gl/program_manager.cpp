@@ -1,49 +1,208 @@
 #include "as/gl/program_manager.hpp"
 
-as::ProgramManager::ProgramManager() : shader_manager_(nullptr) {}
+namespace fs = std::experimental::filesystem;
+
+/*******************************************************************************
+ * Constants
+ ******************************************************************************/
+
+// Magic number at the start of program binary cache files
+static const GLuint kBinaryCacheMagic = 0x42505341;  // "ASPB"
+
+// Tokens of KHR_parallel_shader_compile, which may be missing in GLEW
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+as::ProgramManager::ProgramManager()
+    : shader_manager_(nullptr),
+      state_manager_(nullptr),
+      trace_manager_(nullptr),
+      use_parallel_compile_(false),
+      has_parallel_compile_ext_(false),
+      link_stats_(LinkStats{0, 0, 0.0}) {}
 
 as::ProgramManager::~ProgramManager() {
   // Delete all program objects
   for (const auto &pair : hdlrs_) {
-    glDeleteProgram(pair.second);
+    IssueCall("glDeleteProgram", {pair.second},
+              [&] { glDeleteProgram(pair.second); });
   }
 }
 
-void as::ProgramManager::RegisterShaderManager(
-    const ShaderManager &shader_manager) {
+void as::ProgramManager::RegisterShaderManager(ShaderManager &shader_manager) {
   shader_manager_ = &shader_manager;
 }
 
+void as::ProgramManager::RegisterStateManager(StateManager &state_manager) {
+  state_manager_ = &state_manager;
+}
+
+void as::ProgramManager::RegisterTraceManager(TraceManager &trace_manager) {
+  trace_manager_ = &trace_manager;
+}
+
+/*
+ * Linked programs are saved as binaries in the directory and restored on the
+ * next launch, which skips compiling and linking the shaders. The binary is
+ * only used when the shader sources and the driver are unchanged.
+ */
+void as::ProgramManager::EnableBinaryCache(const std::string &cache_dir) {
+  // Check whether the driver supports any binary format
+  GLint num_formats = 0;
+  IssueCall("glGetIntegerv", {GL_NUM_PROGRAM_BINARY_FORMATS}, [&] {
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+  });
+  if (num_formats <= 0) {
+    std::cerr << "Program binary cache is disabled because the driver "
+                 "supports no binary formats"
+              << std::endl;
+    return;
+  }
+  fs::create_directories(cache_dir);
+  cache_dir_ = cache_dir;
+}
+
+/*
+ * Defers checking the compilation and linking status until the program is
+ * needed, so that all programs could be compiled by the driver in parallel.
+ * The completion could be polled without blocking when
+ * KHR_parallel_shader_compile is supported.
+ *
+ * Reference:
+ * https://www.khronos.org/registry/OpenGL/extensions/KHR/KHR_parallel_shader_compile.txt
+ */
+void as::ProgramManager::EnableParallelCompile() {
+  use_parallel_compile_ = true;
+  has_parallel_compile_ext_ =
+      glewIsSupported("GL_KHR_parallel_shader_compile") == GL_TRUE;
+#ifdef GLEW_KHR_parallel_shader_compile
+  if (has_parallel_compile_ext_) {
+    // Let the driver choose the number of threads
+    IssueCall("glMaxShaderCompilerThreadsKHR", {0xFFFFFFFF},
+              [&] { glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); });
+  }
+#endif
+}
+
 void as::ProgramManager::CreateProgram(const std::string &program_name) {
   // Create a program object
-  const GLuint program_hdlr = glCreateProgram();
+  GLuint program_hdlr = 0;
+  IssueCall("glCreateProgram", {}, [&] { program_hdlr = glCreateProgram(); });
+  // Use a fake handler if the call is not issued by the recording backend
+  if (program_hdlr == 0 && trace_manager_ != nullptr) {
+    program_hdlr = trace_manager_->GenStubHdlr();
+  }
   // Save the program handler
   hdlrs_[program_name] = program_hdlr;
+  // Assign the next sort index, a recreated program keeps its index
+  if (sort_idxs_.count(program_name) == 0) {
+    const GLuint sort_idx = static_cast<GLuint>(sort_idxs_.size());
+    sort_idxs_[program_name] = sort_idx;
+  }
 }
 
 void as::ProgramManager::AttachShader(const std::string &program_name,
-                                      const std::string &shader_name) const {
+                                      const std::string &shader_name) {
   const GLuint program_hdlr = GetProgramHdlr(program_name);
   const GLuint shader_hdlr = shader_manager_->GetShaderHdlr(shader_name);
-  glAttachShader(program_hdlr, shader_hdlr);
+  IssueCall("glAttachShader", {program_hdlr, shader_hdlr},
+            [&] { glAttachShader(program_hdlr, shader_hdlr); });
+  // Save the shader name for compiling and hashing
+  attached_shader_names_[program_name].push_back(shader_name);
 }
 
-void as::ProgramManager::LinkProgram(const std::string &program_name) const {
+void as::ProgramManager::LinkProgram(const std::string &program_name) {
+  const auto start_time = std::chrono::high_resolution_clock::now();
   const GLuint program_hdlr = GetProgramHdlr(program_name);
-  glLinkProgram(program_hdlr);
-  CheckProgramLinkingStatus(program_hdlr);
+  const std::string cache_path = GetBinaryCachePath(program_name);
+  // Try to restore the cached binary
+  if (!cache_path.empty() && LoadProgramBinary(program_hdlr, cache_path)) {
+    link_stats_.num_cache_hits++;
+  } else {
+    // Submit compiling and linking the shaders
+    CompileAttachedShaders(program_name);
+    if (!cache_path.empty()) {
+      IssueCall("glProgramParameteri",
+                {program_hdlr, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE},
+                [&] {
+                  glProgramParameteri(program_hdlr,
+                                      GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                      GL_TRUE);
+                });
+    }
+    IssueCall("glLinkProgram", {program_hdlr},
+              [&] { glLinkProgram(program_hdlr); });
+    pending_program_names_.insert(program_name);
+  }
+  const auto end_time = std::chrono::high_resolution_clock::now();
+  const std::chrono::duration<double> link_time = end_time - start_time;
+  link_stats_.link_seconds += link_time.count();
+  // Check the status right away unless compiling in parallel
+  if (!use_parallel_compile_) {
+    FinishLinkingProgram(program_name);
+  }
+}
+
+/*
+ * Returns whether the program could be used without blocking. Without
+ * KHR_parallel_shader_compile, this blocks until the program is linked.
+ */
+bool as::ProgramManager::IsProgramReady(
+    const std::string &program_name) const {
+  if (pending_program_names_.count(program_name) == 0) {
+    return true;
+  }
+  if (has_parallel_compile_ext_) {
+    const GLuint program_hdlr = hdlrs_.at(program_name);
+    // The stub value is kept when the call is not issued by the recording
+    // backend
+    GLint is_completed = GL_TRUE;
+    IssueCall("glGetProgramiv", {program_hdlr, GL_COMPLETION_STATUS_KHR}, [&] {
+      glGetProgramiv(program_hdlr, GL_COMPLETION_STATUS_KHR, &is_completed);
+    });
+    if (is_completed == GL_FALSE) {
+      return false;
+    }
+  }
+  FinishLinkingProgram(program_name);
+  return true;
+}
+
+void as::ProgramManager::FinishLinkingPrograms() const {
+  const std::set<std::string> program_names = pending_program_names_;
+  for (const std::string &program_name : program_names) {
+    FinishLinkingProgram(program_name);
+  }
 }
 
 void as::ProgramManager::UseProgram(const std::string &program_name) const {
   const GLuint program_hdlr = GetProgramHdlr(program_name);
-  glUseProgram(program_hdlr);
+  // Skip the redundant program switch if the state manager is registered
+  if (state_manager_ != nullptr) {
+    state_manager_->UseProgram(program_hdlr);
+  } else {
+    IssueCall("glUseProgram", {program_hdlr},
+              [&] { glUseProgram(program_hdlr); });
+  }
 }
 
-void as::ProgramManager::UseInvalidProgram() const { glUseProgram(0); }
+void as::ProgramManager::UseInvalidProgram() const {
+  if (state_manager_ != nullptr) {
+    state_manager_->UseProgram(0);
+  } else {
+    IssueCall("glUseProgram", {0}, [&] { glUseProgram(0); });
+  }
+}
 
 void as::ProgramManager::DeleteProgram(const std::string &program_name) const {
   const GLuint program_hdlr = GetProgramHdlr(program_name);
-  glDeleteProgram(program_hdlr);
+  IssueCall("glDeleteProgram", {program_hdlr},
+            [&] { glDeleteProgram(program_hdlr); });
+  // Forget the program state
+  if (state_manager_ != nullptr) {
+    state_manager_->InvalidateProgram(program_hdlr);
+  }
 }
 
 GLuint as::ProgramManager::GetProgramHdlr(
@@ -52,22 +211,209 @@ GLuint as::ProgramManager::GetProgramHdlr(
     throw std::runtime_error("Could not find the program name '" +
                              program_name + "'");
   }
+  // Make sure the program is linked before it's used
+  if (pending_program_names_.count(program_name) > 0) {
+    FinishLinkingProgram(program_name);
+  }
   return hdlrs_.at(program_name);
 }
 
+/*
+ * Returns the index which identifies the program in the sort keys of the draw
+ * lists
+ */
+GLuint as::ProgramManager::GetProgramSortIdx(
+    const std::string &program_name) const {
+  if (sort_idxs_.count(program_name) == 0) {
+    throw std::runtime_error("Could not find the program name '" +
+                             program_name + "'");
+  }
+  return sort_idxs_.at(program_name);
+}
+
+as::ProgramManager::LinkStats as::ProgramManager::GetLinkStats() const {
+  return link_stats_;
+}
+
+void as::ProgramManager::CompileAttachedShaders(
+    const std::string &program_name) {
+  if (attached_shader_names_.count(program_name) == 0) {
+    return;
+  }
+  for (const std::string &shader_name :
+       attached_shader_names_.at(program_name)) {
+    shader_manager_->CompileShader(shader_name);
+  }
+}
+
+/*
+ * Waits for the submitted linking and checks the status, the binary is saved
+ * if the binary cache is enabled
+ */
+void as::ProgramManager::FinishLinkingProgram(
+    const std::string &program_name) const {
+  const auto start_time = std::chrono::high_resolution_clock::now();
+  const GLuint program_hdlr = hdlrs_.at(program_name);
+  pending_program_names_.erase(program_name);
+  // Report the compilation errors before the linking errors
+  if (attached_shader_names_.count(program_name) > 0) {
+    for (const std::string &shader_name :
+         attached_shader_names_.at(program_name)) {
+      shader_manager_->CheckShaderCompilation(shader_name);
+    }
+  }
+  CheckProgramLinkingStatus(program_hdlr);
+  // Save the binary for the next launch
+  const std::string cache_path = GetBinaryCachePath(program_name);
+  if (!cache_path.empty()) {
+    SaveProgramBinary(program_hdlr, cache_path);
+    link_stats_.num_cache_misses++;
+  }
+  const auto end_time = std::chrono::high_resolution_clock::now();
+  const std::chrono::duration<double> link_time = end_time - start_time;
+  link_stats_.link_seconds += link_time.count();
+}
+
+/*
+ * The path is named after the hash of the driver information and the shader
+ * sources, so any change of them leads to another path. Returns an empty
+ * string if the binary cache is disabled.
+ */
+std::string as::ProgramManager::GetBinaryCachePath(
+    const std::string &program_name) const {
+  if (cache_dir_.empty()) {
+    return "";
+  }
+  // Hash the driver information
+  const GLenum driver_names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+  GLuint64 hash = as::kHashOffsetBasis;
+  for (const GLenum driver_name : driver_names) {
+    const GLubyte *driver_str = nullptr;
+    IssueCall("glGetString", {driver_name},
+              [&] { driver_str = glGetString(driver_name); });
+    if (driver_str != nullptr) {
+      hash = as::HashString(reinterpret_cast<const char *>(driver_str), hash);
+    }
+  }
+  // Hash the shader types and sources, the defines are part of the sources
+  if (attached_shader_names_.count(program_name) > 0) {
+    for (const std::string &shader_name :
+         attached_shader_names_.at(program_name)) {
+      const GLenum type = shader_manager_->GetShaderType(shader_name);
+      hash = as::HashString(std::to_string(type), hash);
+      hash = as::HashString(shader_manager_->GetShaderSource(shader_name),
+                            hash);
+    }
+  }
+  // Convert the hash to the file name
+  char file_name[32];
+  snprintf(file_name, sizeof(file_name), "%016llx.bin",
+           static_cast<unsigned long long>(hash));
+  return (fs::path(cache_dir_) / file_name).string();
+}
+
+/*
+ * Returns false if the binary is missing or rejected by the driver, the
+ * rejected binary is removed so that it would be saved again
+ */
+bool as::ProgramManager::LoadProgramBinary(const GLuint program_hdlr,
+                                           const std::string &path) const {
+  FILE *stream;
+  const errno_t err = fopen_s(&stream, path.c_str(), "rb");
+  if (err || stream == nullptr) {
+    return false;
+  }
+  // Read the header
+  GLuint magic = 0;
+  GLenum format = 0;
+  GLsizei len = 0;
+  bool is_valid = fread(&magic, sizeof(magic), 1, stream) == 1 &&
+                  fread(&format, sizeof(format), 1, stream) == 1 &&
+                  fread(&len, sizeof(len), 1, stream) == 1 &&
+                  magic == kBinaryCacheMagic && len > 0;
+  // Read the binary
+  std::vector<GLubyte> binary;
+  if (is_valid) {
+    binary.resize(len);
+    is_valid = fread(binary.data(), sizeof(GLubyte), len, stream) ==
+               static_cast<size_t>(len);
+  }
+  fclose(stream);
+  // Restore the binary
+  if (is_valid) {
+    IssueCall("glProgramBinary", {program_hdlr, format, len}, [&] {
+      glProgramBinary(program_hdlr, format, binary.data(), len);
+    });
+    is_valid = IsProgramLinked(program_hdlr);
+  }
+  if (!is_valid) {
+    std::cerr << "Program binary cache '" << path
+              << "' is invalid, recompiling" << std::endl;
+    fs::remove(path);
+  }
+  return is_valid;
+}
+
+void as::ProgramManager::SaveProgramBinary(const GLuint program_hdlr,
+                                           const std::string &path) const {
+  // Get the binary
+  GLint len = 0;
+  IssueCall("glGetProgramiv", {program_hdlr, GL_PROGRAM_BINARY_LENGTH}, [&] {
+    glGetProgramiv(program_hdlr, GL_PROGRAM_BINARY_LENGTH, &len);
+  });
+  if (len <= 0) {
+    return;
+  }
+  std::vector<GLubyte> binary(len);
+  GLenum format = 0;
+  IssueCall("glGetProgramBinary", {program_hdlr, len}, [&] {
+    glGetProgramBinary(program_hdlr, len, &len, &format, binary.data());
+  });
+  // Write the file
+  FILE *stream;
+  const errno_t err = fopen_s(&stream, path.c_str(), "wb");
+  if (err || stream == nullptr) {
+    std::cerr << "Could not save the program binary cache '" << path << "'"
+              << std::endl;
+    return;
+  }
+  const GLuint magic = kBinaryCacheMagic;
+  fwrite(&magic, sizeof(magic), 1, stream);
+  fwrite(&format, sizeof(format), 1, stream);
+  fwrite(&len, sizeof(len), 1, stream);
+  fwrite(binary.data(), sizeof(GLubyte), len, stream);
+  fclose(stream);
+}
+
+bool as::ProgramManager::IsProgramLinked(const GLuint program_hdlr) const {
+  // The stub value is kept when the call is not issued by the recording
+  // backend
+  GLint status = GL_TRUE;
+  IssueCall("glGetProgramiv", {program_hdlr, GL_LINK_STATUS},
+            [&] { glGetProgramiv(program_hdlr, GL_LINK_STATUS, &status); });
+  return status == GL_TRUE;
+}
+
 void as::ProgramManager::CheckProgramLinkingStatus(
     const GLuint program_hdlr) const {
-  GLint status = -1;
+  // The stub value is kept when the call is not issued by the recording
+  // backend
+  GLint status = GL_TRUE;
   // Get linking status
-  glGetProgramiv(program_hdlr, GL_LINK_STATUS, &status);
+  IssueCall("glGetProgramiv", {program_hdlr, GL_LINK_STATUS},
+            [&] { glGetProgramiv(program_hdlr, GL_LINK_STATUS, &status); });
   // Report the log if the linking is unsuccessful
   if (status == GL_FALSE) {
     // Get the length of the log
-    GLint len;
-    glGetProgramiv(program_hdlr, GL_INFO_LOG_LENGTH, &len);
+    GLint len = 0;
+    IssueCall("glGetProgramiv", {program_hdlr, GL_INFO_LOG_LENGTH}, [&] {
+      glGetProgramiv(program_hdlr, GL_INFO_LOG_LENGTH, &len);
+    });
     // Get the log
     std::string log(len, '\0');
-    glGetProgramInfoLog(program_hdlr, len, &len, &log[0]);
+    IssueCall("glGetProgramInfoLog", {program_hdlr, len}, [&] {
+      glGetProgramInfoLog(program_hdlr, len, &len, &log[0]);
+    });
     // Throw an error
     throw std::runtime_error(log);
   }
@@ -0,0 +1,460 @@
+#include "as/gl/render_graph.hpp"
+
+as::RenderGraph::RenderGraph()
+    : framebuffer_manager_(nullptr),
+      texture_manager_(nullptr),
+      profiler_manager_(nullptr),
+      trace_manager_(nullptr),
+      compiled_(false) {}
+
+/*******************************************************************************
+ * Constants
+ ******************************************************************************/
+
+const std::string as::RenderGraph::kDefaultFramebufferName = "default";
+
+/*******************************************************************************
+ * Manager Registrations
+ ******************************************************************************/
+
+void as::RenderGraph::RegisterFramebufferManager(
+    FramebufferManager &framebuffer_manager) {
+  framebuffer_manager_ = &framebuffer_manager;
+}
+
+void as::RenderGraph::RegisterTextureManager(TextureManager &texture_manager) {
+  texture_manager_ = &texture_manager;
+}
+
+void as::RenderGraph::RegisterProfilerManager(
+    ProfilerManager &profiler_manager) {
+  profiler_manager_ = &profiler_manager;
+}
+
+void as::RenderGraph::RegisterTraceManager(TraceManager &trace_manager) {
+  trace_manager_ = &trace_manager;
+}
+
+/*******************************************************************************
+ * Graph Buildings
+ ******************************************************************************/
+
+/*
+ * Forgets the passes and resources of the last frame, the acquired transient
+ * resources are kept until the next compilation
+ */
+void as::RenderGraph::Reset() {
+  resources_.clear();
+  passes_.clear();
+  output_resource_names_.clear();
+  compiled_ = false;
+}
+
+/*
+ * Adds the resource which could be read and written by the passes. The attach
+ * function is called after the transient resource is (re-)acquired, so that
+ * it could be attached to the framebuffers.
+ */
+void as::RenderGraph::AddResource(const std::string &resource_name,
+                                  const ResourceDesc &desc,
+                                  const std::function<void()> &attach_func) {
+  if (resources_.count(resource_name) > 0) {
+    throw std::runtime_error("Resource name '" + resource_name +
+                             "' has already been added");
+  }
+  resources_[resource_name] = Resource{desc, attach_func, -1, -1};
+}
+
+/*
+ * Adds the pass which is executed in the order of addition. The graph binds
+ * the framebuffer before the pass if the framebuffer name is not empty, and
+ * kDefaultFramebufferName binds the default framebuffer.
+ */
+void as::RenderGraph::AddPass(
+    const std::string &pass_name, const std::string &framebuffer_name,
+    const std::vector<std::string> &read_resource_names,
+    const std::vector<std::string> &write_resource_names,
+    const std::function<void()> &execute_func) {
+  Pass pass;
+  pass.name = pass_name;
+  pass.framebuffer_name = framebuffer_name;
+  pass.read_resource_names = read_resource_names;
+  pass.write_resource_names = write_resource_names;
+  pass.execute_func = execute_func;
+  pass.culled = false;
+  pass.live_pass_idx = -1;
+  pass.clear_mask = 0;
+  pass.barrier_bits = 0;
+  passes_.push_back(pass);
+}
+
+/*
+ * Marks the resource which is used outside the graph (e.g., presented), the
+ * passes that don't contribute to any output are culled
+ */
+void as::RenderGraph::AddOutput(const std::string &resource_name) {
+  GetResource(resource_name);
+  output_resource_names_.insert(resource_name);
+}
+
+/*******************************************************************************
+ * Compilations
+ ******************************************************************************/
+
+void as::RenderGraph::Compile() {
+  // Check whether all resources of the passes have been added
+  for (const Pass &pass : passes_) {
+    for (const std::string &resource_name : pass.read_resource_names) {
+      GetResource(resource_name);
+    }
+    for (const std::string &resource_name : pass.write_resource_names) {
+      GetResource(resource_name);
+    }
+  }
+  CullPasses();
+  ComputeLifetimes();
+  ComputeClearsAndBarriers();
+  AcquireTransientResources();
+  compiled_ = true;
+}
+
+/*******************************************************************************
+ * Executions
+ ******************************************************************************/
+
+void as::RenderGraph::Execute() {
+  if (!compiled_) {
+    throw std::runtime_error("Render graph has not been compiled");
+  }
+  for (const Pass &pass : passes_) {
+    if (pass.culled) {
+      continue;
+    }
+    if (profiler_manager_ != nullptr) {
+      profiler_manager_->StartPass(pass.name);
+    }
+    // Wait for the writes of the earlier passes
+    if (pass.barrier_bits != 0) {
+      IssueCall("glMemoryBarrier", {pass.barrier_bits},
+                [&] { glMemoryBarrier(pass.barrier_bits); });
+    }
+    // Bind the framebuffer
+    if (pass.framebuffer_name == kDefaultFramebufferName) {
+      framebuffer_manager_->BindDefaultFramebuffer(GL_FRAMEBUFFER);
+    } else if (!pass.framebuffer_name.empty()) {
+      framebuffer_manager_->BindFramebuffer(pass.framebuffer_name,
+                                            GL_FRAMEBUFFER);
+    }
+    // Clear the resources written for the first time
+    if (pass.clear_mask != 0) {
+      IssueCall("glClear", {pass.clear_mask},
+                [&] { glClear(pass.clear_mask); });
+    }
+    pass.execute_func();
+    if (profiler_manager_ != nullptr) {
+      profiler_manager_->FinishPass(pass.name);
+    }
+  }
+}
+
+/*******************************************************************************
+ * Exports
+ ******************************************************************************/
+
+/*
+ * Saves the passes in the execution order with their resources, clears and
+ * barriers, followed by the lifetimes of the resources. The times of the
+ * passes come from the last frame measured by the profiler manager.
+ */
+void as::RenderGraph::SaveTimeline(const std::string &path) const {
+  if (!compiled_) {
+    throw std::runtime_error("Render graph has not been compiled");
+  }
+  FILE *stream;
+  const errno_t err = fopen_s(&stream, path.c_str(), "w");
+  if (err || stream == nullptr) {
+    throw std::runtime_error("Could not open the file '" + path + "'");
+  }
+  // Write the passes
+  fprintf(stream, "Passes:\n");
+  for (const Pass &pass : passes_) {
+    if (pass.culled) {
+      fprintf(stream, "  [-] %s (culled)\n", pass.name.c_str());
+      continue;
+    }
+    fprintf(stream, "  [%d] %s", pass.live_pass_idx, pass.name.c_str());
+    // Write the times if the pass has been measured
+    if (profiler_manager_ != nullptr) {
+      const std::vector<std::string> &pass_names =
+          profiler_manager_->GetPassNames();
+      if (std::find(pass_names.begin(), pass_names.end(), pass.name) !=
+          pass_names.end()) {
+        const ProfilerManager::PassTimes pass_times =
+            profiler_manager_->GetPassTimes(pass.name);
+        fprintf(stream, " (CPU %.3f ms, GPU %.3f ms)",
+                1e3 * pass_times.cpu_seconds, 1e3 * pass_times.gpu_seconds);
+      }
+    }
+    fprintf(stream, "\n");
+    if (!pass.framebuffer_name.empty()) {
+      fprintf(stream, "    framebuffer: %s\n", pass.framebuffer_name.c_str());
+    }
+    if (pass.barrier_bits != 0) {
+      fprintf(stream, "    barrier: 0x%x\n", pass.barrier_bits);
+    }
+    if (pass.clear_mask != 0) {
+      fprintf(stream, "    clear: 0x%x\n", pass.clear_mask);
+    }
+    for (const std::string &resource_name : pass.read_resource_names) {
+      fprintf(stream, "    read: %s\n", resource_name.c_str());
+    }
+    for (const std::string &resource_name : pass.write_resource_names) {
+      fprintf(stream, "    write: %s\n", resource_name.c_str());
+    }
+  }
+  // Write the resource lifetimes
+  fprintf(stream, "Resources:\n");
+  for (const auto &pair : resources_) {
+    const std::string &resource_name = pair.first;
+    const Resource &resource = pair.second;
+    fprintf(stream, "  %s (%s)", resource_name.c_str(),
+            ResourceKindToName(resource.desc.kind).c_str());
+    if (resource.first_pass_idx < 0) {
+      fprintf(stream, ": unused\n");
+      continue;
+    }
+    fprintf(stream, ": passes %d-%d", resource.first_pass_idx,
+            resource.last_pass_idx);
+    // Transient resources with the same handler are aliased
+    if (IsTransientResourceKind(resource.desc.kind)) {
+      fprintf(stream, ", handler %u",
+              GetTransientResourceHdlr(resource_name));
+    }
+    fprintf(stream, "\n");
+  }
+  fclose(stream);
+}
+
+/*******************************************************************************
+ * Statistics Getters
+ ******************************************************************************/
+
+unsigned int as::RenderGraph::GetNumPasses() const {
+  return static_cast<unsigned int>(passes_.size());
+}
+
+unsigned int as::RenderGraph::GetNumCulledPasses() const {
+  unsigned int num_culled_passes = 0;
+  for (const Pass &pass : passes_) {
+    if (pass.culled) {
+      num_culled_passes++;
+    }
+  }
+  return num_culled_passes;
+}
+
+/*******************************************************************************
+ * Resource Getters (Private)
+ ******************************************************************************/
+
+as::RenderGraph::Resource &as::RenderGraph::GetResource(
+    const std::string &resource_name) {
+  if (resources_.count(resource_name) == 0) {
+    throw std::runtime_error("Could not find the resource name '" +
+                             resource_name + "'");
+  }
+  return resources_.at(resource_name);
+}
+
+const as::RenderGraph::Resource &as::RenderGraph::GetResource(
+    const std::string &resource_name) const {
+  if (resources_.count(resource_name) == 0) {
+    throw std::runtime_error("Could not find the resource name '" +
+                             resource_name + "'");
+  }
+  return resources_.at(resource_name);
+}
+
+/*******************************************************************************
+ * Compilations (Private)
+ ******************************************************************************/
+
+/*
+ * Walks the passes backwards from the outputs. A pass is kept if it writes any
+ * needed resource, and then the resources it reads are needed too. The needed
+ * resources stay needed, so the earlier passes writing the same resource are
+ * kept as well.
+ */
+void as::RenderGraph::CullPasses() {
+  std::set<std::string> needed_resource_names = output_resource_names_;
+  for (auto it = passes_.rbegin(); it != passes_.rend(); ++it) {
+    Pass &pass = *it;
+    pass.culled = true;
+    for (const std::string &resource_name : pass.write_resource_names) {
+      if (needed_resource_names.count(resource_name) > 0) {
+        pass.culled = false;
+        break;
+      }
+    }
+    if (!pass.culled) {
+      needed_resource_names.insert(pass.read_resource_names.begin(),
+                                   pass.read_resource_names.end());
+    }
+  }
+}
+
+void as::RenderGraph::ComputeLifetimes() {
+  int live_pass_idx = 0;
+  for (Pass &pass : passes_) {
+    if (pass.culled) {
+      pass.live_pass_idx = -1;
+      continue;
+    }
+    pass.live_pass_idx = live_pass_idx;
+    // Extend the lifetimes of all accessed resources
+    std::vector<std::string> resource_names = pass.read_resource_names;
+    resource_names.insert(resource_names.end(),
+                          pass.write_resource_names.begin(),
+                          pass.write_resource_names.end());
+    for (const std::string &resource_name : resource_names) {
+      Resource &resource = GetResource(resource_name);
+      if (resource.first_pass_idx < 0) {
+        resource.first_pass_idx = live_pass_idx;
+      }
+      resource.last_pass_idx = live_pass_idx;
+    }
+    live_pass_idx++;
+  }
+}
+
+void as::RenderGraph::ComputeClearsAndBarriers() {
+  std::set<std::string> written_resource_names;
+  for (Pass &pass : passes_) {
+    if (pass.culled) {
+      continue;
+    }
+    // Insert barriers for the resources written by earlier passes
+    for (const std::string &resource_name : pass.read_resource_names) {
+      if (written_resource_names.count(resource_name) > 0) {
+        pass.barrier_bits |= GetResource(resource_name).desc.barrier_bits;
+      }
+    }
+    // Clear the resources in their first writing pass
+    for (const std::string &resource_name : pass.write_resource_names) {
+      if (written_resource_names.count(resource_name) > 0) {
+        continue;
+      }
+      const GLbitfield clear_mask = GetResource(resource_name).desc.clear_mask;
+      if (clear_mask != 0 && pass.framebuffer_name.empty()) {
+        throw std::runtime_error("Could not clear the resource name '" +
+                                 resource_name + "' in pass name '" +
+                                 pass.name + "' without a framebuffer");
+      }
+      pass.clear_mask |= clear_mask;
+      written_resource_names.insert(resource_name);
+    }
+  }
+}
+
+/*
+ * Releases the transient resources which are no longer used or have changed
+ * first, so that the changed resources could alias the released ones
+ */
+void as::RenderGraph::AcquireTransientResources() {
+  // Release the unused or changed resources
+  std::vector<std::string> released_resource_names;
+  for (const auto &pair : acquired_resources_) {
+    const std::string &resource_name = pair.first;
+    const AcquiredResource &acquired_resource = pair.second;
+    bool is_changed = true;
+    if (resources_.count(resource_name) > 0) {
+      const Resource &resource = resources_.at(resource_name);
+      is_changed =
+          resource.first_pass_idx < 0 ||
+          resource.desc.kind != acquired_resource.desc.kind ||
+          !FramebufferManager::IsSameRenderTargetDesc(
+              resource.desc.target_desc, acquired_resource.desc.target_desc) ||
+          resource.first_pass_idx != acquired_resource.first_pass_idx ||
+          resource.last_pass_idx != acquired_resource.last_pass_idx;
+    }
+    if (is_changed) {
+      released_resource_names.push_back(resource_name);
+    }
+  }
+  for (const std::string &resource_name : released_resource_names) {
+    ReleaseTransientResource(resource_name);
+  }
+  // Acquire the new or changed resources
+  for (const auto &pair : resources_) {
+    const std::string &resource_name = pair.first;
+    const Resource &resource = pair.second;
+    if (!IsTransientResourceKind(resource.desc.kind) ||
+        resource.first_pass_idx < 0 ||
+        acquired_resources_.count(resource_name) > 0) {
+      continue;
+    }
+    if (resource.desc.kind == ResourceKinds::kTransientRenderbuffer) {
+      framebuffer_manager_->AcquireRenderbuffer(
+          resource_name, resource.desc.target_desc, resource.first_pass_idx,
+          resource.last_pass_idx);
+    } else {
+      framebuffer_manager_->AcquireTexture2D(
+          resource_name, resource.desc.target_desc, resource.first_pass_idx,
+          resource.last_pass_idx);
+    }
+    acquired_resources_[resource_name] = AcquiredResource{
+        resource.desc, resource.first_pass_idx, resource.last_pass_idx};
+    // Let the users attach the new handler
+    if (resource.attach_func) {
+      resource.attach_func();
+    }
+  }
+}
+
+void as::RenderGraph::ReleaseTransientResource(
+    const std::string &resource_name) {
+  const AcquiredResource &acquired_resource =
+      acquired_resources_.at(resource_name);
+  if (acquired_resource.desc.kind == ResourceKinds::kTransientRenderbuffer) {
+    framebuffer_manager_->ReleaseRenderbuffer(resource_name);
+  } else {
+    framebuffer_manager_->ReleaseTexture2D(resource_name);
+  }
+  acquired_resources_.erase(resource_name);
+}
+
+/*******************************************************************************
+ * Handler Getters (Private)
+ ******************************************************************************/
+
+GLuint as::RenderGraph::GetTransientResourceHdlr(
+    const std::string &resource_name) const {
+  const Resource &resource = GetResource(resource_name);
+  if (resource.desc.kind == ResourceKinds::kTransientRenderbuffer) {
+    return framebuffer_manager_->GetRenderbufferHdlr(resource_name);
+  } else {
+    return texture_manager_->GetTextureHdlr(resource_name);
+  }
+}
+
+/*******************************************************************************
+ * Type Conversions (Private)
+ ******************************************************************************/
+
+bool as::RenderGraph::IsTransientResourceKind(const ResourceKinds kind) {
+  return kind == ResourceKinds::kTransientRenderbuffer ||
+         kind == ResourceKinds::kTransientTexture2D;
+}
+
+std::string as::RenderGraph::ResourceKindToName(const ResourceKinds kind) {
+  switch (kind) {
+    case ResourceKinds::kExternal:
+      return "external";
+    case ResourceKinds::kTransientRenderbuffer:
+      return "transient renderbuffer";
+    case ResourceKinds::kTransientTexture2D:
+      return "transient texture 2D";
+    default:
+      throw std::runtime_error("Unknown resource kind");
+  }
+}
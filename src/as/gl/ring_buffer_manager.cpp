@@ -0,0 +1,266 @@
+#include "as/gl/ring_buffer_manager.hpp"
+
+/*******************************************************************************
+ * Constants
+ ******************************************************************************/
+
+// Timeout of each fence waiting in nanoseconds
+static const GLuint64 kFenceWaitTimeout = 1000000;
+
+// Offset alignment used when the alignment is not queried from the driver,
+// which is the largest alignment allowed by the specification
+static const GLint kStubOfsAlignment = 256;
+
+as::RingBufferManager::RingBufferManager()
+    : buffer_manager_(nullptr), trace_manager_(nullptr) {}
+
+as::RingBufferManager::~RingBufferManager() {
+  // Delete all fences
+  for (const auto &pair : ring_buffers_) {
+    for (const GLsync fence : pair.second.fences) {
+      if (fence != nullptr) {
+        IssueCall("glDeleteSync", {}, 0, [&] { glDeleteSync(fence); });
+      }
+    }
+  }
+}
+
+/*******************************************************************************
+ * Manager Registrations
+ ******************************************************************************/
+
+void as::RingBufferManager::RegisterBufferManager(
+    BufferManager &buffer_manager) {
+  buffer_manager_ = &buffer_manager;
+}
+
+void as::RingBufferManager::RegisterTraceManager(TraceManager &trace_manager) {
+  trace_manager_ = &trace_manager;
+}
+
+/*******************************************************************************
+ * Memory Initializations
+ ******************************************************************************/
+
+void as::RingBufferManager::InitRingBuffer(const std::string &buffer_name,
+                                           const GLenum target,
+                                           const GLsizeiptr segment_size,
+                                           const int num_segments) {
+  const GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  // Align the segment size so that every segment starts at an aligned offset
+  const GLsizeiptr aligned_segment_size = GetAlignedSize(target, segment_size);
+  const GLsizeiptr size = aligned_segment_size * num_segments;
+  // Create the immutable buffer storage
+  buffer_manager_->GenBuffer(buffer_name);
+  buffer_manager_->InitBufferStorage(buffer_name, target, size, nullptr, flags);
+  // Map the whole buffer once
+  GLvoid *ptr =
+      buffer_manager_->MapBufferRange(buffer_name, target, 0, size, flags);
+  // Save the ring buffer
+  RingBuffer ring_buffer;
+  ring_buffer.target = target;
+  ring_buffer.segment_size = aligned_segment_size;
+  ring_buffer.ofs_alignment = GetOfsAlignment(target);
+  ring_buffer.num_segments = num_segments;
+  ring_buffer.segment_idx = 0;
+  ring_buffer.segment_ofs = 0;
+  ring_buffer.mapped_ptr = static_cast<GLubyte *>(ptr);
+  ring_buffer.fences = std::vector<GLsync>(num_segments, nullptr);
+  ring_buffer.cur_stats = RingBufferStats{0, 0, 0, 0.0};
+  ring_buffer.frame_stats = RingBufferStats{0, 0, 0, 0.0};
+  ring_buffers_[buffer_name] = ring_buffer;
+}
+
+/*******************************************************************************
+ * Frame Controls
+ ******************************************************************************/
+
+void as::RingBufferManager::StartRingBufferFrame(
+    const std::string &buffer_name) {
+  RingBuffer &ring_buffer = GetRingBuffer(buffer_name);
+  // Keep the statistics of the last frame
+  ring_buffer.frame_stats = ring_buffer.cur_stats;
+  ring_buffer.cur_stats = RingBufferStats{0, 0, 0, 0.0};
+  // Move to the next segment
+  ring_buffer.segment_idx =
+      (ring_buffer.segment_idx + 1) % ring_buffer.num_segments;
+  ring_buffer.segment_ofs = 0;
+  // Wait until the GPU has finished reading the segment
+  WaitFence(ring_buffer, ring_buffer.segment_idx);
+}
+
+void as::RingBufferManager::FinishRingBufferFrame(
+    const std::string &buffer_name) {
+  RingBuffer &ring_buffer = GetRingBuffer(buffer_name);
+  // Guard the segment with a fence after all commands reading it, no fence is
+  // created when the call is not issued by the recording backend
+  GLsync &fence = ring_buffer.fences.at(ring_buffer.segment_idx);
+  IssueCall("glFenceSync", {GL_SYNC_GPU_COMMANDS_COMPLETE, 0}, 0,
+            [&] { fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0); });
+}
+
+/*******************************************************************************
+ * Memory Allocations
+ ******************************************************************************/
+
+/*
+ * Copies the data into the current segment and returns the offset from the
+ * start of the buffer, which could be used by glBindBufferRange
+ */
+GLintptr as::RingBufferManager::AllocRingBuffer(const std::string &buffer_name,
+                                                const GLsizeiptr size,
+                                                const GLvoid *data) {
+  RingBuffer &ring_buffer = GetRingBuffer(buffer_name);
+  // Align the size so that the next allocation starts at an aligned offset
+  const GLsizeiptr aligned_size =
+      (size + ring_buffer.ofs_alignment - 1) / ring_buffer.ofs_alignment *
+      ring_buffer.ofs_alignment;
+  // Check whether the segment has enough space
+  if (ring_buffer.segment_ofs + aligned_size > ring_buffer.segment_size) {
+    throw std::runtime_error("Ring buffer segment overflows for buffer name '" +
+                             buffer_name + "'");
+  }
+  // Copy the data, which is traced as the upload through the mapping
+  const GLintptr ofs = ring_buffer.segment_idx * ring_buffer.segment_size +
+                       ring_buffer.segment_ofs;
+  IssueCall("memcpy", {ofs, size}, size,
+            [&] { std::memcpy(ring_buffer.mapped_ptr + ofs, data, size); });
+  ring_buffer.segment_ofs += aligned_size;
+  // Update statistics
+  ring_buffer.cur_stats.num_uploaded_bytes += size;
+  ring_buffer.cur_stats.num_allocs++;
+  return ofs;
+}
+
+/*******************************************************************************
+ * Deletions
+ ******************************************************************************/
+
+void as::RingBufferManager::DeleteRingBuffer(const std::string &buffer_name) {
+  RingBuffer &ring_buffer = GetRingBuffer(buffer_name);
+  // Delete fences
+  for (const GLsync fence : ring_buffer.fences) {
+    if (fence != nullptr) {
+      IssueCall("glDeleteSync", {}, 0, [&] { glDeleteSync(fence); });
+    }
+  }
+  // Delete the buffer, which also unmaps it
+  buffer_manager_->DeleteBuffer(buffer_name);
+  ring_buffers_.erase(buffer_name);
+}
+
+/*******************************************************************************
+ * Alignment Getters
+ ******************************************************************************/
+
+GLsizeiptr as::RingBufferManager::GetAlignedSize(const GLenum target,
+                                                 const GLsizeiptr size) {
+  const GLsizeiptr ofs_alignment = GetOfsAlignment(target);
+  return (size + ofs_alignment - 1) / ofs_alignment * ofs_alignment;
+}
+
+/*******************************************************************************
+ * Statistics Getters
+ ******************************************************************************/
+
+as::RingBufferManager::RingBufferStats as::RingBufferManager::GetFrameStats(
+    const std::string &buffer_name) const {
+  const RingBuffer &ring_buffer = GetRingBuffer(buffer_name);
+  return ring_buffer.frame_stats;
+}
+
+/*******************************************************************************
+ * Ring Buffer Getters (Private)
+ ******************************************************************************/
+
+as::RingBufferManager::RingBuffer &as::RingBufferManager::GetRingBuffer(
+    const std::string &buffer_name) {
+  if (ring_buffers_.count(buffer_name) == 0) {
+    throw std::runtime_error("Could not find the ring buffer name '" +
+                             buffer_name + "'");
+  }
+  return ring_buffers_.at(buffer_name);
+}
+
+const as::RingBufferManager::RingBuffer &as::RingBufferManager::GetRingBuffer(
+    const std::string &buffer_name) const {
+  if (ring_buffers_.count(buffer_name) == 0) {
+    throw std::runtime_error("Could not find the ring buffer name '" +
+                             buffer_name + "'");
+  }
+  return ring_buffers_.at(buffer_name);
+}
+
+/*******************************************************************************
+ * Alignment Getters (Private)
+ ******************************************************************************/
+
+GLsizeiptr as::RingBufferManager::GetOfsAlignment(const GLenum target) {
+  // Query the alignment lazily
+  if (ofs_alignments_.count(target) == 0) {
+    // The stub value is kept when the call is not issued by the recording
+    // backend
+    GLint value = kStubOfsAlignment;
+    switch (target) {
+      case GL_UNIFORM_BUFFER: {
+        IssueCall("glGetIntegerv", {GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT}, 0,
+                  [&] {
+                    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &value);
+                  });
+      } break;
+      case GL_SHADER_STORAGE_BUFFER: {
+        IssueCall("glGetIntegerv", {GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT},
+                  0, [&] {
+                    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT,
+                                  &value);
+                  });
+      } break;
+      default: {
+        // Vertex attributes only need to be aligned to 4 bytes
+        value = 4;
+      }
+    }
+    ofs_alignments_[target] = std::max(value, 1);
+  }
+  return ofs_alignments_.at(target);
+}
+
+/*******************************************************************************
+ * Synchronizations (Private)
+ ******************************************************************************/
+
+void as::RingBufferManager::WaitFence(RingBuffer &ring_buffer,
+                                      const int segment_idx) {
+  GLsync &fence = ring_buffer.fences.at(segment_idx);
+  // Check whether the segment has never been used
+  if (fence == nullptr) {
+    return;
+  }
+  // Check whether the GPU has finished without waiting
+  GLenum result = GL_ALREADY_SIGNALED;
+  IssueCall("glClientWaitSync", {0, 0}, 0,
+            [&] { result = glClientWaitSync(fence, 0, 0); });
+  if (result == GL_TIMEOUT_EXPIRED) {
+    // Stall until the GPU has finished
+    const auto start_time = std::chrono::high_resolution_clock::now();
+    do {
+      IssueCall("glClientWaitSync",
+                {GL_SYNC_FLUSH_COMMANDS_BIT, kFenceWaitTimeout}, 0, [&] {
+                  result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                            kFenceWaitTimeout);
+                });
+    } while (result == GL_TIMEOUT_EXPIRED);
+    const auto end_time = std::chrono::high_resolution_clock::now();
+    const std::chrono::duration<double> stall_time = end_time - start_time;
+    // Update statistics
+    ring_buffer.cur_stats.num_stalls++;
+    ring_buffer.cur_stats.stall_seconds += stall_time.count();
+  }
+  if (result == GL_WAIT_FAILED) {
+    throw std::runtime_error("Could not wait for the ring buffer fence");
+  }
+  // Delete the signaled fence
+  IssueCall("glDeleteSync", {}, 0, [&] { glDeleteSync(fence); });
+  fence = nullptr;
+}
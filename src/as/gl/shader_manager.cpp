@@ -1,33 +1,84 @@
 #include "as/gl/shader_manager.hpp"
 
+namespace fs = std::experimental::filesystem;
+
+/*******************************************************************************
+ * Constants
+ ******************************************************************************/
+
+// Maximum depth of nested includes, which also stops cyclic includes
+static const int kMaxIncludeDepth = 16;
+
+as::ShaderManager::ShaderManager() : trace_manager_(nullptr) {}
+
 as::ShaderManager::~ShaderManager() {
   // Delete all shader objects
   for (const auto& pair : hdlrs_) {
-    glDeleteShader(pair.second);
+    IssueCall("glDeleteShader", {pair.second},
+              [&] { glDeleteShader(pair.second); });
   }
 }
 
+void as::ShaderManager::RegisterTraceManager(TraceManager& trace_manager) {
+  trace_manager_ = &trace_manager;
+}
+
+/*
+ * The defines are inserted after the #version line, and the #include
+ * directives are resolved relative to the including file.
+ *
+ * Note that the compilation is deferred until the shader is linked, so that
+ * it could be skipped when the program binary is cached
+ */
 void as::ShaderManager::CreateShader(const std::string& shader_name,
-                                     const GLenum type,
-                                     const std::string& path) {
+                                     const GLenum type, const std::string& path,
+                                     const std::vector<std::string>& defines) {
   // Create a shader object
-  const GLuint shader_hdlr = glCreateShader(type);
-  // Load the shader source
-  const std::string src = LoadShaderSource(path);
+  GLuint shader_hdlr = 0;
+  IssueCall("glCreateShader", {type},
+            [&] { shader_hdlr = glCreateShader(type); });
+  // Use a fake handler if the call is not issued by the recording backend
+  if (shader_hdlr == 0 && trace_manager_ != nullptr) {
+    shader_hdlr = trace_manager_->GenStubHdlr();
+  }
+  // Load and preprocess the shader source
+  const std::string src = PreprocessShaderSource(path, defines);
   // Replace the source code in the shader object
   const char* str = src.c_str();
-  glShaderSource(shader_hdlr, 1, &str, NULL);
-  // Compile the shader object
-  glCompileShader(shader_hdlr);
-  // Check the compilation status
-  CheckShaderCompilation(shader_hdlr);
+  IssueCall("glShaderSource", {shader_hdlr, 1},
+            [&] { glShaderSource(shader_hdlr, 1, &str, NULL); });
   // Save the handler
   hdlrs_[shader_name] = shader_hdlr;
+  types_[shader_name] = type;
+  srcs_[shader_name] = src;
+  compiled_shader_names_.erase(shader_name);
+}
+
+/*
+ * Only submits the compilation, the status should be checked by
+ * CheckShaderCompilation so that the driver could compile in parallel
+ */
+void as::ShaderManager::CompileShader(const std::string& shader_name) {
+  // Skip the shader which has been compiled
+  if (compiled_shader_names_.count(shader_name) > 0) {
+    return;
+  }
+  const GLuint shader_hdlr = GetShaderHdlr(shader_name);
+  // Compile the shader object
+  IssueCall("glCompileShader", {shader_hdlr},
+            [&] { glCompileShader(shader_hdlr); });
+  compiled_shader_names_.insert(shader_name);
+}
+
+void as::ShaderManager::CheckShaderCompilation(
+    const std::string& shader_name) const {
+  CheckShaderCompilation(GetShaderHdlr(shader_name));
 }
 
 void as::ShaderManager::DeleteShader(const std::string& shader_name) const {
   const GLuint shader_hdlr = GetShaderHdlr(shader_name);
-  glDeleteShader(shader_hdlr);
+  IssueCall("glDeleteShader", {shader_hdlr},
+            [&] { glDeleteShader(shader_hdlr); });
 }
 
 GLuint as::ShaderManager::GetShaderHdlr(const std::string& shader_name) const {
@@ -38,6 +89,23 @@ GLuint as::ShaderManager::GetShaderHdlr(const std::string& shader_name) const {
   return hdlrs_.at(shader_name);
 }
 
+GLenum as::ShaderManager::GetShaderType(const std::string& shader_name) const {
+  if (types_.count(shader_name) == 0) {
+    throw std::runtime_error("Could not find the shader name '" + shader_name +
+                             "'");
+  }
+  return types_.at(shader_name);
+}
+
+const std::string& as::ShaderManager::GetShaderSource(
+    const std::string& shader_name) const {
+  if (srcs_.count(shader_name) == 0) {
+    throw std::runtime_error("Could not find the shader name '" + shader_name +
+                             "'");
+  }
+  return srcs_.at(shader_name);
+}
+
 std::string as::ShaderManager::LoadShaderSource(const std::string& file) const {
   FILE* stream;
   const errno_t err = fopen_s(&stream, file.c_str(), "rb");
@@ -47,25 +115,97 @@ std::string as::ShaderManager::LoadShaderSource(const std::string& file) const {
   fseek(stream, 0, SEEK_END);
   const long sz = ftell(stream);
   fseek(stream, 0, SEEK_SET);
-  std::string src(sz + 1, '\0');
+  std::string src(sz, '\0');
   fread(&src[0], sizeof(char), sz, stream);
   fclose(stream);
   return src;
 }
 
 void as::ShaderManager::CheckShaderCompilation(const GLuint shader_hdlr) const {
-  GLint status = -1;
+  // The stub value is kept when the call is not issued by the recording
+  // backend
+  GLint status = GL_TRUE;
   // Get compilation status
-  glGetShaderiv(shader_hdlr, GL_COMPILE_STATUS, &status);
+  IssueCall("glGetShaderiv", {shader_hdlr, GL_COMPILE_STATUS}, [&] {
+    glGetShaderiv(shader_hdlr, GL_COMPILE_STATUS, &status);
+  });
   // Report the log if compilation is unsuccessful
   if (status == GL_FALSE) {
     // Get the length of the log
     GLint len = 0;
-    glGetShaderiv(shader_hdlr, GL_INFO_LOG_LENGTH, &len);
+    IssueCall("glGetShaderiv", {shader_hdlr, GL_INFO_LOG_LENGTH}, [&] {
+      glGetShaderiv(shader_hdlr, GL_INFO_LOG_LENGTH, &len);
+    });
     // Get the log
     std::string log(len, '\0');
-    glGetShaderInfoLog(shader_hdlr, len, &len, &log[0]);
+    IssueCall("glGetShaderInfoLog", {shader_hdlr, len}, [&] {
+      glGetShaderInfoLog(shader_hdlr, len, &len, &log[0]);
+    });
     // Throw an error
     throw std::runtime_error(log);
   }
 }
+
+std::string as::ShaderManager::PreprocessShaderSource(
+    const std::string& path, const std::vector<std::string>& defines) const {
+  std::string src = ResolveShaderIncludes(path, 0);
+  if (defines.empty()) {
+    return src;
+  }
+  // Build the define lines
+  std::string define_lines;
+  for (const std::string& define : defines) {
+    define_lines += "#define " + define + "\n";
+  }
+  // Insert the defines after the #version line, which must come first
+  const size_t version_pos = src.find("#version");
+  if (version_pos == std::string::npos) {
+    return define_lines + src;
+  }
+  const size_t line_end_pos = src.find('\n', version_pos);
+  if (line_end_pos == std::string::npos) {
+    return src + "\n" + define_lines;
+  }
+  src.insert(line_end_pos + 1, define_lines);
+  return src;
+}
+
+std::string as::ShaderManager::ResolveShaderIncludes(const std::string& path,
+                                                     const int depth) const {
+  if (depth > kMaxIncludeDepth) {
+    throw std::runtime_error("Includes are nested too deeply in the file '" +
+                             path + "'");
+  }
+  const std::string src = LoadShaderSource(path);
+  const fs::path dir = fs::path(path).parent_path();
+  // Replace each line of '#include "file"' with the file content
+  std::string resolved_src;
+  size_t line_start_pos = 0;
+  while (line_start_pos < src.size()) {
+    size_t line_end_pos = src.find('\n', line_start_pos);
+    if (line_end_pos == std::string::npos) {
+      line_end_pos = src.size();
+    }
+    const std::string line =
+        src.substr(line_start_pos, line_end_pos - line_start_pos);
+    const size_t directive_pos = line.find_first_not_of(" \t");
+    if (directive_pos != std::string::npos &&
+        line.compare(directive_pos, 8, "#include") == 0) {
+      const size_t file_start_pos = line.find('"', directive_pos);
+      const size_t file_end_pos = line.find('"', file_start_pos + 1);
+      if (file_start_pos == std::string::npos ||
+          file_end_pos == std::string::npos) {
+        throw std::runtime_error("Could not parse the include '" + line +
+                                 "' in the file '" + path + "'");
+      }
+      const std::string file =
+          line.substr(file_start_pos + 1, file_end_pos - file_start_pos - 1);
+      resolved_src += ResolveShaderIncludes((dir / file).string(), depth + 1);
+      resolved_src += "\n";
+    } else {
+      resolved_src += line + "\n";
+    }
+    line_start_pos = line_end_pos + 1;
+  }
+  return resolved_src;
+}
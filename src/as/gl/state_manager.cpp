@@ -0,0 +1,333 @@
+#include "as/gl/state_manager.hpp"
+
+/*******************************************************************************
+ * Constants
+ ******************************************************************************/
+
+// Handler value which means the bound object is unknown
+static const GLuint kUnknownHdlr = std::numeric_limits<GLuint>::max();
+
+// Viewport value which means the viewport is unknown
+static const glm::ivec4 kUnknownViewport = glm::ivec4(-1);
+
+as::StateManager::StateManager() : trace_manager_(nullptr) { Invalidate(); }
+
+/*******************************************************************************
+ * Manager Registrations
+ ******************************************************************************/
+
+void as::StateManager::RegisterTraceManager(TraceManager &trace_manager) {
+  trace_manager_ = &trace_manager;
+}
+
+/*******************************************************************************
+ * Frame Controls
+ ******************************************************************************/
+
+void as::StateManager::StartFrame() {
+  // Keep the counts of the last frame
+  frame_call_counts_ = cur_call_counts_;
+  // Reset the counts of the current frame
+  cur_call_counts_.clear();
+}
+
+/*******************************************************************************
+ * State Changes
+ ******************************************************************************/
+
+void as::StateManager::UseProgram(const GLuint program_hdlr) {
+  const bool is_issued = (program_hdlr_ != program_hdlr);
+  if (is_issued) {
+    IssueCall("glUseProgram", {program_hdlr},
+              [&] { glUseProgram(program_hdlr); });
+    program_hdlr_ = program_hdlr;
+  }
+  CountCall(CallTypes::kUseProgram, is_issued);
+}
+
+void as::StateManager::BindVertexArray(const GLuint va_hdlr) {
+  const bool is_issued = (va_hdlr_ != va_hdlr);
+  if (is_issued) {
+    IssueCall("glBindVertexArray", {va_hdlr},
+              [&] { glBindVertexArray(va_hdlr); });
+    va_hdlr_ = va_hdlr;
+  }
+  CountCall(CallTypes::kBindVertexArray, is_issued);
+}
+
+/*
+ * Note that the element array buffer binding is a part of the vertex array
+ * state, so it is saved for each vertex array
+ */
+void as::StateManager::BindBuffer(const GLenum target,
+                                  const GLuint buffer_hdlr) {
+  bool is_issued;
+  if (target == GL_ELEMENT_ARRAY_BUFFER) {
+    is_issued = (va_hdlr_ == kUnknownHdlr ||
+                 va_idxs_buffer_hdlrs_.count(va_hdlr_) == 0 ||
+                 va_idxs_buffer_hdlrs_.at(va_hdlr_) != buffer_hdlr);
+  } else {
+    is_issued = (buffer_hdlrs_.count(target) == 0 ||
+                 buffer_hdlrs_.at(target) != buffer_hdlr);
+  }
+  if (is_issued) {
+    IssueCall("glBindBuffer", {target, buffer_hdlr},
+              [&] { glBindBuffer(target, buffer_hdlr); });
+    // Save the binding only when the vertex array is known
+    if (target == GL_ELEMENT_ARRAY_BUFFER) {
+      if (va_hdlr_ != kUnknownHdlr) {
+        va_idxs_buffer_hdlrs_[va_hdlr_] = buffer_hdlr;
+      }
+    } else {
+      buffer_hdlrs_[target] = buffer_hdlr;
+    }
+  }
+  CountCall(CallTypes::kBindBuffer, is_issued);
+}
+
+/*
+ * Note that glBindBufferBase also binds the buffer to the generic binding
+ * point of the target
+ */
+void as::StateManager::BindBufferBase(const GLenum target,
+                                      const GLuint binding_idx,
+                                      const GLuint buffer_hdlr) {
+  const IndexedBufferBinding binding = {buffer_hdlr, 0, -1};
+  const bool is_issued = !IsIndexedBufferBound(target, binding_idx, binding);
+  if (is_issued) {
+    IssueCall("glBindBufferBase", {target, binding_idx, buffer_hdlr},
+              [&] { glBindBufferBase(target, binding_idx, buffer_hdlr); });
+    indexed_buffer_bindings_[std::make_tuple(target, binding_idx)] = binding;
+    buffer_hdlrs_[target] = buffer_hdlr;
+  }
+  CountCall(CallTypes::kBindBufferBase, is_issued);
+}
+
+/*
+ * Note that glBindBufferRange also binds the buffer to the generic binding
+ * point of the target
+ */
+void as::StateManager::BindBufferRange(const GLenum target,
+                                       const GLuint binding_idx,
+                                       const GLuint buffer_hdlr,
+                                       const GLintptr ofs,
+                                       const GLsizeiptr size) {
+  const IndexedBufferBinding binding = {buffer_hdlr, ofs, size};
+  const bool is_issued = !IsIndexedBufferBound(target, binding_idx, binding);
+  if (is_issued) {
+    IssueCall(
+        "glBindBufferRange", {target, binding_idx, buffer_hdlr, ofs, size},
+        [&] { glBindBufferRange(target, binding_idx, buffer_hdlr, ofs, size); });
+    indexed_buffer_bindings_[std::make_tuple(target, binding_idx)] = binding;
+    buffer_hdlrs_[target] = buffer_hdlr;
+  }
+  CountCall(CallTypes::kBindBufferRange, is_issued);
+}
+
+void as::StateManager::ActiveTexture(const GLuint unit_idx) {
+  const bool is_issued = (active_unit_idx_ != unit_idx);
+  if (is_issued) {
+    IssueCall("glActiveTexture", {GL_TEXTURE0 + unit_idx},
+              [&] { glActiveTexture(GL_TEXTURE0 + unit_idx); });
+    active_unit_idx_ = unit_idx;
+  }
+  CountCall(CallTypes::kActiveTexture, is_issued);
+}
+
+/*
+ * Note that the texture unit is always selected even if the texture has been
+ * bound, because the following texture calls operate on the active unit
+ */
+void as::StateManager::BindTexture(const GLenum target, const GLuint unit_idx,
+                                   const GLuint tex_hdlr) {
+  // Select the texture unit
+  ActiveTexture(unit_idx);
+  // Bind the texture
+  const auto key = std::make_tuple(unit_idx, target);
+  const bool is_issued =
+      (tex_hdlrs_.count(key) == 0 || tex_hdlrs_.at(key) != tex_hdlr);
+  if (is_issued) {
+    IssueCall("glBindTexture", {target, tex_hdlr},
+              [&] { glBindTexture(target, tex_hdlr); });
+    tex_hdlrs_[key] = tex_hdlr;
+  }
+  CountCall(CallTypes::kBindTexture, is_issued);
+}
+
+void as::StateManager::BindFramebuffer(const GLenum target,
+                                       const GLuint framebuffer_hdlr) {
+  bool is_issued;
+  switch (target) {
+    case GL_DRAW_FRAMEBUFFER: {
+      is_issued = (draw_framebuffer_hdlr_ != framebuffer_hdlr);
+    } break;
+    case GL_READ_FRAMEBUFFER: {
+      is_issued = (read_framebuffer_hdlr_ != framebuffer_hdlr);
+    } break;
+    default: {
+      is_issued = (draw_framebuffer_hdlr_ != framebuffer_hdlr ||
+                   read_framebuffer_hdlr_ != framebuffer_hdlr);
+    }
+  }
+  if (is_issued) {
+    IssueCall("glBindFramebuffer", {target, framebuffer_hdlr},
+              [&] { glBindFramebuffer(target, framebuffer_hdlr); });
+    if (target != GL_READ_FRAMEBUFFER) {
+      draw_framebuffer_hdlr_ = framebuffer_hdlr;
+    }
+    if (target != GL_DRAW_FRAMEBUFFER) {
+      read_framebuffer_hdlr_ = framebuffer_hdlr;
+    }
+  }
+  CountCall(CallTypes::kBindFramebuffer, is_issued);
+}
+
+void as::StateManager::SetViewport(const GLint x, const GLint y,
+                                   const GLsizei width, const GLsizei height) {
+  const glm::ivec4 viewport(x, y, width, height);
+  const bool is_issued = (viewport_ != viewport);
+  if (is_issued) {
+    IssueCall("glViewport", {x, y, width, height},
+              [&] { glViewport(x, y, width, height); });
+    viewport_ = viewport;
+  }
+  CountCall(CallTypes::kSetViewport, is_issued);
+}
+
+/*******************************************************************************
+ * Invalidations
+ ******************************************************************************/
+
+/*
+ * Should be called after any code which changes the GL states without this
+ * manager (e.g., FBX SDK drawing)
+ */
+void as::StateManager::Invalidate() {
+  program_hdlr_ = kUnknownHdlr;
+  va_hdlr_ = kUnknownHdlr;
+  buffer_hdlrs_.clear();
+  va_idxs_buffer_hdlrs_.clear();
+  indexed_buffer_bindings_.clear();
+  active_unit_idx_ = kUnknownHdlr;
+  tex_hdlrs_.clear();
+  draw_framebuffer_hdlr_ = kUnknownHdlr;
+  read_framebuffer_hdlr_ = kUnknownHdlr;
+  viewport_ = kUnknownViewport;
+}
+
+/*
+ * Note that a deleted program stays in use until another program is used, so
+ * we only forget it
+ */
+void as::StateManager::InvalidateProgram(const GLuint program_hdlr) {
+  if (program_hdlr_ == program_hdlr) {
+    program_hdlr_ = kUnknownHdlr;
+  }
+}
+
+void as::StateManager::InvalidateVertexArray(const GLuint va_hdlr) {
+  // Deleting a bound vertex array reverts the binding to zero
+  if (va_hdlr_ == va_hdlr) {
+    va_hdlr_ = 0;
+  }
+  va_idxs_buffer_hdlrs_.erase(va_hdlr);
+}
+
+void as::StateManager::InvalidateBuffer(const GLuint buffer_hdlr) {
+  // Deleting a bound buffer reverts the bindings to zero
+  for (auto &pair : buffer_hdlrs_) {
+    if (pair.second == buffer_hdlr) {
+      pair.second = 0;
+    }
+  }
+  for (auto &pair : indexed_buffer_bindings_) {
+    if (pair.second.buffer_hdlr == buffer_hdlr) {
+      pair.second = IndexedBufferBinding{0, 0, -1};
+    }
+  }
+  // Other vertex arrays may still reference the buffer, forget them
+  for (auto it = va_idxs_buffer_hdlrs_.begin();
+       it != va_idxs_buffer_hdlrs_.end();) {
+    if (it->second == buffer_hdlr) {
+      it = va_idxs_buffer_hdlrs_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void as::StateManager::InvalidateTexture(const GLuint tex_hdlr) {
+  // Deleting a bound texture reverts the bindings to zero
+  for (auto &pair : tex_hdlrs_) {
+    if (pair.second == tex_hdlr) {
+      pair.second = 0;
+    }
+  }
+}
+
+void as::StateManager::InvalidateFramebuffer(const GLuint framebuffer_hdlr) {
+  // Deleting a bound framebuffer reverts the binding to zero
+  if (draw_framebuffer_hdlr_ == framebuffer_hdlr) {
+    draw_framebuffer_hdlr_ = 0;
+  }
+  if (read_framebuffer_hdlr_ == framebuffer_hdlr) {
+    read_framebuffer_hdlr_ = 0;
+  }
+}
+
+/*******************************************************************************
+ * Statistics Getters
+ ******************************************************************************/
+
+as::StateManager::CallCounts as::StateManager::GetFrameCallCounts(
+    const CallTypes call_type) const {
+  if (frame_call_counts_.count(call_type) == 0) {
+    return CallCounts{0, 0};
+  }
+  return frame_call_counts_.at(call_type);
+}
+
+as::StateManager::CallCounts as::StateManager::GetFrameCallCounts() const {
+  CallCounts total_counts = {0, 0};
+  for (const auto &pair : frame_call_counts_) {
+    total_counts.num_issued += pair.second.num_issued;
+    total_counts.num_skipped += pair.second.num_skipped;
+  }
+  return total_counts;
+}
+
+/*******************************************************************************
+ * State Checkings (Private)
+ ******************************************************************************/
+
+bool as::StateManager::IsIndexedBufferBound(
+    const GLenum target, const GLuint binding_idx,
+    const IndexedBufferBinding &binding) const {
+  // Check the generic binding point
+  if (buffer_hdlrs_.count(target) == 0 ||
+      buffer_hdlrs_.at(target) != binding.buffer_hdlr) {
+    return false;
+  }
+  // Check the indexed binding point
+  const auto key = std::make_tuple(target, binding_idx);
+  if (indexed_buffer_bindings_.count(key) == 0) {
+    return false;
+  }
+  const IndexedBufferBinding &cur_binding = indexed_buffer_bindings_.at(key);
+  return cur_binding.buffer_hdlr == binding.buffer_hdlr &&
+         cur_binding.ofs == binding.ofs && cur_binding.size == binding.size;
+}
+
+/*******************************************************************************
+ * Statistics Updaters (Private)
+ ******************************************************************************/
+
+void as::StateManager::CountCall(const CallTypes call_type,
+                                 const bool is_issued) {
+  CallCounts &call_counts = cur_call_counts_[call_type];
+  if (is_issued) {
+    call_counts.num_issued++;
+  } else {
+    call_counts.num_skipped++;
+  }
+}
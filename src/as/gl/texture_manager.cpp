@@ -1,11 +1,22 @@
 #include "as/gl/texture_manager.hpp"
 
-as::TextureManager::TextureManager() {}
+/*******************************************************************************
+ * Constants
+ ******************************************************************************/
+
+// Number of texture units used when the limit is not queried from the driver
+static const GLint kStubMaxNumUnits = 96;
+
+as::TextureManager::TextureManager()
+    : state_manager_(nullptr), trace_manager_(nullptr) {}
 
 as::TextureManager::~TextureManager() {
-  // Delete all textures
+  // Delete all textures except the registered ones which are owned elsewhere
   for (const auto &pair : hdlrs_) {
-    glDeleteTextures(1, &pair.second);
+    if (registered_tex_names_.count(pair.first) == 0) {
+      IssueCall("glDeleteTextures", {1, pair.second}, 0,
+                [&] { glDeleteTextures(1, &pair.second); });
+    }
   }
 }
 
@@ -15,14 +26,40 @@ as::TextureManager::~TextureManager() {
 
 void as::TextureManager::Init() { InitLimits(); }
 
+/*******************************************************************************
+ * Manager Registrations
+ ******************************************************************************/
+
+void as::TextureManager::RegisterStateManager(StateManager &state_manager) {
+  state_manager_ = &state_manager;
+}
+
+void as::TextureManager::RegisterTraceManager(TraceManager &trace_manager) {
+  trace_manager_ = &trace_manager;
+}
+
 /*******************************************************************************
  * Generations
  ******************************************************************************/
 
 void as::TextureManager::GenTexture(const std::string &tex_name) {
-  GLuint tex_hdlr;
-  glGenTextures(1, &tex_hdlr);
+  GLuint tex_hdlr = 0;
+  IssueCall("glGenTextures", {1}, 0, [&] { glGenTextures(1, &tex_hdlr); });
+  // Use a fake handler if the call is not issued by the recording backend
+  if (tex_hdlr == 0 && trace_manager_ != nullptr) {
+    tex_hdlr = trace_manager_->GenStubHdlr();
+  }
+  hdlrs_[tex_name] = tex_hdlr;
+}
+
+/*
+ * Registers the texture which is owned elsewhere (e.g., by the render target
+ * pool), so that it could be used by name but is never deleted here
+ */
+void as::TextureManager::RegisterTexture(const std::string &tex_name,
+                                         const GLuint tex_hdlr) {
   hdlrs_[tex_name] = tex_hdlr;
+  registered_tex_names_.insert(tex_name);
 }
 
 /*******************************************************************************
@@ -35,10 +72,17 @@ void as::TextureManager::BindTexture(const std::string &tex_name,
   const GLuint tex_hdlr = GetTextureHdlr(tex_name);
   // Check the unit index
   index_manager_.CheckMaxIdx(unit_idx);
-  // Select the texture unit
-  glActiveTexture(GL_TEXTURE0 + unit_idx);
-  // Bind the texture
-  glBindTexture(target, tex_hdlr);
+  // Skip the redundant binding if the state manager is registered
+  if (state_manager_ != nullptr) {
+    state_manager_->BindTexture(target, unit_idx, tex_hdlr);
+  } else {
+    // Select the texture unit
+    IssueCall("glActiveTexture", {GL_TEXTURE0 + unit_idx}, 0,
+              [&] { glActiveTexture(GL_TEXTURE0 + unit_idx); });
+    // Bind the texture
+    IssueCall("glBindTexture", {target, tex_hdlr}, 0,
+              [&] { glBindTexture(target, tex_hdlr); });
+  }
   // Save the parameters
   BindTexturePrevParams prev_params = {target, unit_idx};
   bind_texture_prev_params_[tex_name] = prev_params;
@@ -67,10 +111,16 @@ void as::TextureManager::BindTexture(const std::string &tex_name) {
 
 void as::TextureManager::BindDefaultTexture(const GLenum target,
                                             const GLuint unit_idx) {
-  // Select the texture unit
-  glActiveTexture(GL_TEXTURE0 + unit_idx);
-  // Bind the texture
-  glBindTexture(target, 0);
+  if (state_manager_ != nullptr) {
+    state_manager_->BindTexture(target, unit_idx, 0);
+  } else {
+    // Select the texture unit
+    IssueCall("glActiveTexture", {GL_TEXTURE0 + unit_idx}, 0,
+              [&] { glActiveTexture(GL_TEXTURE0 + unit_idx); });
+    // Bind the texture
+    IssueCall("glBindTexture", {target, 0}, 0,
+              [&] { glBindTexture(target, 0); });
+  }
 }
 
 /*******************************************************************************
@@ -84,7 +134,11 @@ void as::TextureManager::InitTexture2D(const std::string &tex_name,
                                        const GLsizei width,
                                        const GLsizei height) {
   BindTexture(tex_name, target);
-  glTexStorage2D(target, num_mipmap_level, internal_fmt, width, height);
+  IssueCall(
+      "glTexStorage2D", {target, num_mipmap_level, internal_fmt, width, height},
+      0, [&] {
+        glTexStorage2D(target, num_mipmap_level, internal_fmt, width, height);
+      });
 }
 
 /*******************************************************************************
@@ -97,8 +151,12 @@ void as::TextureManager::UpdateTexture2D(
     const GLsizei height, const GLenum fmt, const GLenum type,
     const GLvoid *data) {
   BindTexture(tex_name, target);
-  glTexSubImage2D(target, mipmap_level, x_ofs, y_ofs, width, height, fmt, type,
-                  data);
+  IssueCall("glTexSubImage2D",
+            {target, mipmap_level, x_ofs, y_ofs, width, height, fmt, type},
+            GLsizeiptr(width) * height * GetPixelNumBytes(fmt, type), [&] {
+              glTexSubImage2D(target, mipmap_level, x_ofs, y_ofs, width,
+                              height, fmt, type, data);
+            });
   // Save the parameters
   UpdateTexture2DPrevParams prev_params = {
       target, mipmap_level, x_ofs, y_ofs, width, height, fmt, type, data};
@@ -111,8 +169,12 @@ void as::TextureManager::UpdateCubeMapTexture2D(
     const GLsizei height, const GLenum fmt, const GLenum type,
     const GLvoid *data) {
   BindTexture(tex_name, GL_TEXTURE_CUBE_MAP);
-  glTexSubImage2D(target, mipmap_level, x_ofs, y_ofs, width, height, fmt, type,
-                  data);
+  IssueCall("glTexSubImage2D",
+            {target, mipmap_level, x_ofs, y_ofs, width, height, fmt, type},
+            GLsizeiptr(width) * height * GetPixelNumBytes(fmt, type), [&] {
+              glTexSubImage2D(target, mipmap_level, x_ofs, y_ofs, width,
+                              height, fmt, type, data);
+            });
   // Save the parameters
   UpdateTexture2DPrevParams prev_params = {
       target, mipmap_level, x_ofs, y_ofs, width, height, fmt, type, data};
@@ -146,7 +208,8 @@ void as::TextureManager::UpdateCubeMapTexture2D(const std::string &tex_name,
 void as::TextureManager::GenMipmap(const std::string &tex_name,
                                    const GLenum target) {
   BindTexture(tex_name);
-  glGenerateMipmap(target);
+  IssueCall("glGenerateMipmap", {target}, 0,
+            [&] { glGenerateMipmap(target); });
 }
 
 /*******************************************************************************
@@ -158,7 +221,8 @@ void as::TextureManager::SetTextureParamFloat(const std::string &tex_name,
                                               const GLenum pname,
                                               const GLfloat param) {
   BindTexture(tex_name, target);
-  glTexParameterf(target, pname, param);
+  IssueCall("glTexParameterf", {target, pname}, 0,
+            [&] { glTexParameterf(target, pname, param); });
 }
 
 void as::TextureManager::SetTextureParamInt(const std::string &tex_name,
@@ -166,7 +230,8 @@ void as::TextureManager::SetTextureParamInt(const std::string &tex_name,
                                             const GLenum pname,
                                             const GLint param) {
   BindTexture(tex_name, target);
-  glTexParameteri(target, pname, param);
+  IssueCall("glTexParameteri", {target, pname, param}, 0,
+            [&] { glTexParameteri(target, pname, param); });
 }
 
 void as::TextureManager::SetTextureParamFloatVector(const std::string &tex_name,
@@ -174,7 +239,8 @@ void as::TextureManager::SetTextureParamFloatVector(const std::string &tex_name,
                                                     const GLenum pname,
                                                     const GLfloat *params) {
   BindTexture(tex_name, target);
-  glTexParameterfv(target, pname, params);
+  IssueCall("glTexParameterfv", {target, pname}, 0,
+            [&] { glTexParameterfv(target, pname, params); });
 }
 
 void as::TextureManager::SetTextureParamIntVector(const std::string &tex_name,
@@ -182,7 +248,8 @@ void as::TextureManager::SetTextureParamIntVector(const std::string &tex_name,
                                                   const GLenum pname,
                                                   const GLint *params) {
   BindTexture(tex_name, target);
-  glTexParameteriv(target, pname, params);
+  IssueCall("glTexParameteriv", {target, pname}, 0,
+            [&] { glTexParameteriv(target, pname, params); });
 }
 
 /*******************************************************************************
@@ -208,12 +275,29 @@ void as::TextureManager::UnbindTexture(const std::string &tex_name) {
 
 void as::TextureManager::DeleteTexture(const std::string &tex_name) {
   const GLuint tex_hdlr = GetTextureHdlr(tex_name);
-  glDeleteTextures(1, &tex_hdlr);
+  IssueCall("glDeleteTextures", {1, tex_hdlr}, 0,
+            [&] { glDeleteTextures(1, &tex_hdlr); });
+  // Forget the texture state
+  if (state_manager_ != nullptr) {
+    state_manager_->InvalidateTexture(tex_hdlr);
+  }
   // Delete previous parameters
   bind_texture_prev_params_.erase(tex_name);
   update_texture_2d_prev_params_.erase(tex_name);
 }
 
+void as::TextureManager::UnregisterTexture(const std::string &tex_name) {
+  if (registered_tex_names_.count(tex_name) == 0) {
+    throw std::runtime_error("Could not find the registered texture name '" +
+                             tex_name + "'");
+  }
+  // Forget the name without deleting the texture
+  hdlrs_.erase(tex_name);
+  registered_tex_names_.erase(tex_name);
+  bind_texture_prev_params_.erase(tex_name);
+  update_texture_2d_prev_params_.erase(tex_name);
+}
+
 /*******************************************************************************
  * Handler Getters
  ******************************************************************************/
@@ -280,7 +364,54 @@ as::TextureManager::GetUpdateTexture2DPrevParams(
  ******************************************************************************/
 
 void as::TextureManager::InitLimits() {
-  GLint value;
-  glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &value);
+  // The stub value is kept when the call is not issued by the recording
+  // backend
+  GLint value = kStubMaxNumUnits;
+  IssueCall("glGetIntegerv", {GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS}, 0, [&] {
+    glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &value);
+  });
   index_manager_.SetMaxIdx(value);
 }
+
+/*******************************************************************************
+ * Type Conversions (Private)
+ ******************************************************************************/
+
+/*
+ * Returns the number of bytes of a pixel in the client memory, which is used
+ * to count the uploaded bytes
+ */
+GLsizeiptr as::TextureManager::GetPixelNumBytes(const GLenum fmt,
+                                                const GLenum type) {
+  GLsizeiptr num_comps;
+  switch (fmt) {
+    case GL_RED:
+    case GL_DEPTH_COMPONENT: {
+      num_comps = 1;
+    } break;
+    case GL_RG: {
+      num_comps = 2;
+    } break;
+    case GL_RGB:
+    case GL_BGR: {
+      num_comps = 3;
+    } break;
+    default: {
+      num_comps = 4;
+    }
+  }
+  switch (type) {
+    case GL_UNSIGNED_BYTE:
+    case GL_BYTE: {
+      return num_comps;
+    } break;
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+    case GL_HALF_FLOAT: {
+      return 2 * num_comps;
+    } break;
+    default: {
+      return 4 * num_comps;
+    }
+  }
+}
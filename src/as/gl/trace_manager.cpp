@@ -0,0 +1,240 @@
+#include "as/gl/trace_manager.hpp"
+
+/*******************************************************************************
+ * Constants
+ ******************************************************************************/
+
+// First handler generated by the recording backend, which is far from the
+// handlers generated by drivers
+static const GLuint kFirstStubHdlr = 1u << 24;
+
+// Maximum length of a line in trace files
+static const int kMaxTraceLineLen = 1024;
+
+as::TraceManager::TraceManager()
+    : backend_(Backends::kDriver),
+      is_recording_(false),
+      frame_idx_(0),
+      stub_hdlr_(kFirstStubHdlr),
+      cur_summary_(FrameSummary{0, 0, 0, 0.0}),
+      frame_summary_(FrameSummary{0, 0, 0, 0.0}) {}
+
+/*******************************************************************************
+ * Backend Controls
+ ******************************************************************************/
+
+void as::TraceManager::SetBackend(const Backends backend) {
+  backend_ = backend;
+}
+
+as::TraceManager::Backends as::TraceManager::GetBackend() const {
+  return backend_;
+}
+
+/*******************************************************************************
+ * Recording Controls
+ ******************************************************************************/
+
+void as::TraceManager::StartRecording() {
+  trace_calls_.clear();
+  is_recording_ = true;
+}
+
+void as::TraceManager::StopRecording() { is_recording_ = false; }
+
+bool as::TraceManager::IsRecording() const { return is_recording_; }
+
+/*******************************************************************************
+ * Frame Controls
+ ******************************************************************************/
+
+void as::TraceManager::StartFrame() {
+  // Keep the summary of the last frame
+  frame_summary_ = cur_summary_;
+  // Reset the summary of the current frame
+  frame_idx_++;
+  cur_summary_ = FrameSummary{frame_idx_, 0, 0, 0.0};
+}
+
+/*******************************************************************************
+ * Call Interpositions (Private)
+ ******************************************************************************/
+
+/*
+ * Issues the call like RecordCall, and times and records it into the trace
+ */
+void as::TraceManager::RecordTraceCall(
+    const char *func_name, const std::initializer_list<GLint64> args,
+    const GLsizeiptr num_bytes, const std::function<void()> &call) {
+  // Issue the call
+  double seconds = 0.0;
+  if (backend_ == Backends::kDriver) {
+    const auto start_time = std::chrono::high_resolution_clock::now();
+    call();
+    const auto end_time = std::chrono::high_resolution_clock::now();
+    const std::chrono::duration<double> call_time = end_time - start_time;
+    seconds = call_time.count();
+  }
+  // Update statistics
+  cur_summary_.num_calls++;
+  cur_summary_.num_uploaded_bytes += num_bytes;
+  cur_summary_.call_seconds += seconds;
+  // Record the call
+  trace_calls_.push_back(TraceCall{frame_idx_, func_name,
+                                   std::vector<GLint64>(args), num_bytes,
+                                   seconds});
+}
+
+/*******************************************************************************
+ * Stub Resources
+ ******************************************************************************/
+
+/*
+ * Generates a fake handler for the calls which are not issued by the
+ * recording backend
+ */
+GLuint as::TraceManager::GenStubHdlr() { return stub_hdlr_++; }
+
+/*
+ * Allocates host memory for the mappings which are not issued by the
+ * recording backend. The memory lives as long as the manager.
+ */
+GLvoid *as::TraceManager::AllocStubMemory(const GLsizeiptr size) {
+  stub_memories_.push_back(std::vector<GLubyte>(size, 0));
+  return stub_memories_.back().data();
+}
+
+/*******************************************************************************
+ * Trace Files
+ ******************************************************************************/
+
+/*
+ * Saves the trace as CSV. Each line is
+ * "frame_idx,func_name,num_bytes,seconds,args" where the args are separated
+ * by spaces.
+ */
+void as::TraceManager::SaveTrace(const std::string &path) const {
+  FILE *stream;
+  const errno_t err = fopen_s(&stream, path.c_str(), "w");
+  if (err || stream == nullptr) {
+    throw std::runtime_error("Could not open the file '" + path + "'");
+  }
+  fprintf(stream, "frame_idx,func_name,num_bytes,seconds,args\n");
+  for (const TraceCall &trace_call : trace_calls_) {
+    fprintf(stream, "%u,%s,%lld,%.9f,", trace_call.frame_idx,
+            trace_call.func_name.c_str(),
+            static_cast<long long>(trace_call.num_bytes), trace_call.seconds);
+    for (size_t arg_idx = 0; arg_idx < trace_call.args.size(); arg_idx++) {
+      fprintf(stream, arg_idx == 0 ? "%lld" : " %lld",
+              static_cast<long long>(trace_call.args[arg_idx]));
+    }
+    fprintf(stream, "\n");
+  }
+  fclose(stream);
+}
+
+/*
+ * Loads the trace saved by SaveTrace, which replaces the recorded calls so
+ * that it could be summarized
+ */
+void as::TraceManager::LoadTrace(const std::string &path) {
+  FILE *stream;
+  const errno_t err = fopen_s(&stream, path.c_str(), "r");
+  if (err || stream == nullptr) {
+    throw std::runtime_error("Could not open the file '" + path + "'");
+  }
+  trace_calls_.clear();
+  char line[kMaxTraceLineLen];
+  // Skip the header
+  fgets(line, kMaxTraceLineLen, stream);
+  while (fgets(line, kMaxTraceLineLen, stream) != nullptr) {
+    // Split the columns
+    std::vector<std::string> cols;
+    std::string col;
+    for (const char *c = line; *c != '\0' && *c != '\n'; c++) {
+      if (*c == ',') {
+        cols.push_back(col);
+        col.clear();
+      } else {
+        col.push_back(*c);
+      }
+    }
+    cols.push_back(col);
+    if (cols.size() != 5) {
+      fclose(stream);
+      throw std::runtime_error("Could not parse the trace line '" +
+                               std::string(line) + "'");
+    }
+    // Parse the columns
+    TraceCall trace_call;
+    trace_call.frame_idx = std::stoul(cols[0]);
+    trace_call.func_name = cols[1];
+    trace_call.num_bytes = std::stoll(cols[2]);
+    trace_call.seconds = std::stod(cols[3]);
+    size_t pos = 0;
+    while (pos < cols[4].size()) {
+      size_t len;
+      trace_call.args.push_back(std::stoll(cols[4].substr(pos), &len));
+      pos += len + 1;
+    }
+    trace_calls_.push_back(trace_call);
+  }
+  fclose(stream);
+}
+
+/*******************************************************************************
+ * Summaries
+ ******************************************************************************/
+
+std::vector<as::TraceManager::FrameSummary> as::TraceManager::SummarizeTrace()
+    const {
+  std::vector<FrameSummary> frame_summaries;
+  for (const TraceCall &trace_call : trace_calls_) {
+    // Start a new summary when the frame changes
+    if (frame_summaries.empty() ||
+        frame_summaries.back().frame_idx != trace_call.frame_idx) {
+      frame_summaries.push_back(FrameSummary{trace_call.frame_idx, 0, 0, 0.0});
+    }
+    FrameSummary &frame_summary = frame_summaries.back();
+    frame_summary.num_calls++;
+    frame_summary.num_uploaded_bytes += trace_call.num_bytes;
+    frame_summary.call_seconds += trace_call.seconds;
+  }
+  return frame_summaries;
+}
+
+as::TraceManager::FrameSummary as::TraceManager::GetFrameSummary() const {
+  return frame_summary_;
+}
+
+/*
+ * Throws if any frame in the trace exceeds the budget, which could be used to
+ * catch regressions of the frame cost
+ */
+void as::TraceManager::CheckFrameBudget(
+    const unsigned int max_num_calls,
+    const GLsizeiptr max_num_uploaded_bytes) const {
+  for (const FrameSummary &frame_summary : SummarizeTrace()) {
+    if (frame_summary.num_calls > max_num_calls) {
+      throw std::runtime_error(
+          "Frame " + std::to_string(frame_summary.frame_idx) + " issues " +
+          std::to_string(frame_summary.num_calls) + " GL calls, exceeding " +
+          std::to_string(max_num_calls));
+    }
+    if (frame_summary.num_uploaded_bytes > max_num_uploaded_bytes) {
+      throw std::runtime_error(
+          "Frame " + std::to_string(frame_summary.frame_idx) + " uploads " +
+          std::to_string(frame_summary.num_uploaded_bytes) +
+          " bytes, exceeding " + std::to_string(max_num_uploaded_bytes));
+    }
+  }
+}
+
+/*******************************************************************************
+ * Trace Getters
+ ******************************************************************************/
+
+const std::vector<as::TraceManager::TraceCall> &
+as::TraceManager::GetTraceCalls() const {
+  return trace_calls_;
+}
@@ -1,7 +1,20 @@
 #include "as/gl/uniform_manager.hpp"
 
+/*******************************************************************************
+ * Constants
+ ******************************************************************************/
+
+// Number of uniform buffer binding points used when the limit is not queried
+// from the driver
+static const GLint kStubMaxNumBindings = 72;
+
 as::UniformManager::UniformManager()
-    : program_manager_(nullptr), buffer_manager_(nullptr) {}
+    : program_manager_(nullptr),
+      buffer_manager_(nullptr),
+      state_manager_(nullptr),
+      trace_manager_(nullptr),
+      cur_stats_(UniformStats{0, 0}),
+      frame_stats_(UniformStats{0, 0}) {}
 
 /*******************************************************************************
  * Initialization
@@ -23,24 +36,83 @@ void as::UniformManager::RegisterBufferManager(
   buffer_manager_ = &buffer_manager;
 }
 
+void as::UniformManager::RegisterStateManager(StateManager &state_manager) {
+  state_manager_ = &state_manager;
+}
+
+void as::UniformManager::RegisterTraceManager(TraceManager &trace_manager) {
+  trace_manager_ = &trace_manager;
+}
+
+/*******************************************************************************
+ * Frame Controls
+ ******************************************************************************/
+
+void as::UniformManager::StartFrame() {
+  // Keep the statistics of the last frame
+  frame_stats_ = cur_stats_;
+  cur_stats_ = UniformStats{0, 0};
+}
+
 /*******************************************************************************
  * Uniform Value Setters
  ******************************************************************************/
 
+/*
+ * Note that the program is only switched when the value is uploaded, so the
+ * caller should use the program before drawing
+ */
 void as::UniformManager::SetUniform1Float(const std::string &program_name,
                                           const std::string &var_name,
                                           const GLfloat v0) {
   const GLint var_hdlr = GetUniformVarHdlr(program_name, var_name);
+  if (!UpdateUniformValue(program_name, var_hdlr,
+                          UniformValue{GL_FLOAT, 0, v0})) {
+    return;
+  }
   program_manager_->UseProgram(program_name);
-  glUniform1f(var_hdlr, v0);
+  IssueCall("glUniform1f", {var_hdlr}, [&] { glUniform1f(var_hdlr, v0); });
 }
 
 void as::UniformManager::SetUniform1Int(const std::string &program_name,
                                         const std::string &var_name,
                                         const GLint v0) {
   const GLint var_hdlr = GetUniformVarHdlr(program_name, var_name);
+  if (!UpdateUniformValue(program_name, var_hdlr,
+                          UniformValue{GL_INT, v0, 0.0f})) {
+    return;
+  }
   program_manager_->UseProgram(program_name);
-  glUniform1i(var_hdlr, v0);
+  IssueCall("glUniform1i", {var_hdlr, v0}, [&] { glUniform1i(var_hdlr, v0); });
+}
+
+/*
+ * The program uniform setters upload the value without using the program
+ */
+void as::UniformManager::SetProgramUniform1Float(
+    const std::string &program_name, const std::string &var_name,
+    const GLfloat v0) {
+  const GLint var_hdlr = GetUniformVarHdlr(program_name, var_name);
+  if (!UpdateUniformValue(program_name, var_hdlr,
+                          UniformValue{GL_FLOAT, 0, v0})) {
+    return;
+  }
+  const GLuint program_hdlr = program_manager_->GetProgramHdlr(program_name);
+  IssueCall("glProgramUniform1f", {program_hdlr, var_hdlr},
+            [&] { glProgramUniform1f(program_hdlr, var_hdlr, v0); });
+}
+
+void as::UniformManager::SetProgramUniform1Int(const std::string &program_name,
+                                               const std::string &var_name,
+                                               const GLint v0) {
+  const GLint var_hdlr = GetUniformVarHdlr(program_name, var_name);
+  if (!UpdateUniformValue(program_name, var_hdlr,
+                          UniformValue{GL_INT, v0, 0.0f})) {
+    return;
+  }
+  const GLuint program_hdlr = program_manager_->GetProgramHdlr(program_name);
+  IssueCall("glProgramUniform1i", {program_hdlr, var_hdlr, v0},
+            [&] { glProgramUniform1i(program_hdlr, var_hdlr, v0); });
 }
 
 /*******************************************************************************
@@ -57,7 +129,10 @@ void as::UniformManager::AssignUniformBlockToBindingPoint(
   // Get uniform block handler
   const GLuint block_hdlr = GetUniformBlockHdlr(program_name, block_name);
   // Assign the binding point
-  glUniformBlockBinding(program_hdlr, block_hdlr, binding_idx);
+  IssueCall("glUniformBlockBinding", {program_hdlr, block_hdlr, binding_idx},
+            [&] {
+              glUniformBlockBinding(program_hdlr, block_hdlr, binding_idx);
+            });
 }
 
 void as::UniformManager::AssignUniformBlockToBindingPoint(
@@ -76,7 +151,14 @@ void as::UniformManager::BindBufferBaseToBindingPoint(
   // Get buffer handler
   const GLuint buffer_hdlr = buffer_manager_->GetBufferHdlr(buffer_name);
   // Bind the buffer to the binding point
-  glBindBufferBase(GL_UNIFORM_BUFFER, binding_idx, buffer_hdlr);
+  if (state_manager_ != nullptr) {
+    state_manager_->BindBufferBase(GL_UNIFORM_BUFFER, binding_idx, buffer_hdlr);
+  } else {
+    IssueCall("glBindBufferBase",
+              {GL_UNIFORM_BUFFER, binding_idx, buffer_hdlr}, [&] {
+                glBindBufferBase(GL_UNIFORM_BUFFER, binding_idx, buffer_hdlr);
+              });
+  }
 }
 
 void as::UniformManager::BindBufferBaseToBindingPoint(
@@ -87,6 +169,39 @@ void as::UniformManager::BindBufferBaseToBindingPoint(
   BindBufferBaseToBindingPoint(buffer_name, binding_idx);
 }
 
+void as::UniformManager::BindBufferRangeToBindingPoint(
+    const std::string &buffer_name, const GLuint binding_idx,
+    const GLintptr ofs, const GLsizeiptr size) {
+  // Check the binding index
+  index_manager_.CheckMaxIdx(binding_idx);
+  // Get buffer handler
+  const GLuint buffer_hdlr = buffer_manager_->GetBufferHdlr(buffer_name);
+  // Bind the buffer range to the binding point
+  if (state_manager_ != nullptr) {
+    state_manager_->BindBufferRange(GL_UNIFORM_BUFFER, binding_idx, buffer_hdlr,
+                                    ofs, size);
+  } else {
+    IssueCall("glBindBufferRange",
+              {GL_UNIFORM_BUFFER, binding_idx, buffer_hdlr, ofs, size}, [&] {
+                glBindBufferRange(GL_UNIFORM_BUFFER, binding_idx, buffer_hdlr,
+                                  ofs, size);
+              });
+  }
+}
+
+/*
+ * Note that the binding name should have been assigned by
+ * AssignUniformBlockToBindingPoint, and the buffer range replaces whatever is
+ * bound to the binding point
+ */
+void as::UniformManager::BindBufferRangeToBindingPoint(
+    const std::string &buffer_name, const std::string &binding_name,
+    const GLintptr ofs, const GLsizeiptr size) {
+  const GLuint binding_idx = index_manager_.GetNameIdx(binding_name);
+  // Bind with the binding index
+  BindBufferRangeToBindingPoint(buffer_name, binding_idx, ofs, size);
+}
+
 void as::UniformManager::UnassignUniformBlock(const std::string &program_name,
                                               const std::string &block_name) {
   const auto target = std::make_tuple(program_name, block_name);
@@ -115,8 +230,12 @@ GLint as::UniformManager::GetUniformVarHdlr(const std::string &program_name,
     var_hdlr = var_hdlrs_.at(program_name).at(block_name);
   } else {
     const GLuint program_hdlr = program_manager_->GetProgramHdlr(program_name);
-    // Retrieve the index of a named uniform variable
-    var_hdlr = glGetUniformLocation(program_hdlr, block_name.c_str());
+    // Retrieve the index of a named uniform variable, the variable is
+    // inactive when the call is not issued by the recording backend
+    var_hdlr = -1;
+    IssueCall("glGetUniformLocation", {program_hdlr}, [&] {
+      var_hdlr = glGetUniformLocation(program_hdlr, block_name.c_str());
+    });
     // Save the variable handler
     var_hdlrs_[program_name][block_name] = var_hdlr;
   }
@@ -132,8 +251,12 @@ GLuint as::UniformManager::GetUniformBlockHdlr(const std::string &program_name,
     block_hdlr = block_hdlrs_.at(program_name).at(block_name);
   } else {
     const GLuint program_hdlr = program_manager_->GetProgramHdlr(program_name);
-    // Retrieve the index of a named uniform block
-    block_hdlr = glGetUniformBlockIndex(program_hdlr, block_name.c_str());
+    // Retrieve the index of a named uniform block, the first block is used
+    // when the call is not issued by the recording backend
+    block_hdlr = 0;
+    IssueCall("glGetUniformBlockIndex", {program_hdlr}, [&] {
+      block_hdlr = glGetUniformBlockIndex(program_hdlr, block_name.c_str());
+    });
     // Save the block handler
     block_hdlrs_[program_name][block_name] = block_hdlr;
   }
@@ -150,22 +273,71 @@ GLint as::UniformManager::GetUniformBlockMemoryOfs(
   // Get program handler
   const GLuint program_hdlr = program_manager_->GetProgramHdlr(program_name);
   // Get uniform member index
-  GLuint uniform_idx;
+  GLuint uniform_idx = 0;
   const char *name = block_member_name.c_str();
-  glGetUniformIndices(program_hdlr, 1, &name, &uniform_idx);
+  IssueCall("glGetUniformIndices", {program_hdlr, 1}, [&] {
+    glGetUniformIndices(program_hdlr, 1, &name, &uniform_idx);
+  });
   // Get uniform member offset
-  GLint uniform_ofs;
-  glGetActiveUniformsiv(program_hdlr, 1, &uniform_idx, GL_UNIFORM_OFFSET,
-                        &uniform_ofs);
+  GLint uniform_ofs = 0;
+  IssueCall("glGetActiveUniformsiv", {program_hdlr, 1, uniform_idx}, [&] {
+    glGetActiveUniformsiv(program_hdlr, 1, &uniform_idx, GL_UNIFORM_OFFSET,
+                          &uniform_ofs);
+  });
   return uniform_ofs;
 }
 
+/*******************************************************************************
+ * Statistics Getters
+ ******************************************************************************/
+
+as::UniformManager::UniformStats as::UniformManager::GetFrameStats() const {
+  return frame_stats_;
+}
+
 /*******************************************************************************
  * Initialization (Private)
  ******************************************************************************/
 
 void as::UniformManager::InitLimits() {
-  GLint value;
-  glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &value);
+  // The stub value is kept when the call is not issued by the recording
+  // backend
+  GLint value = kStubMaxNumBindings;
+  IssueCall("glGetIntegerv", {GL_MAX_UNIFORM_BUFFER_BINDINGS}, [&] {
+    glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &value);
+  });
   index_manager_.SetMaxIdx(value);
 }
+
+/*******************************************************************************
+ * Uniform Value Caches (Private)
+ ******************************************************************************/
+
+/*
+ * Returns whether the value should be uploaded, and saves it as the current
+ * value of the location. The inactive location (-1) is always skipped.
+ */
+bool as::UniformManager::UpdateUniformValue(const std::string &program_name,
+                                            const GLint var_hdlr,
+                                            const UniformValue &value) {
+  // Check whether the uniform variable is inactive
+  if (var_hdlr < 0) {
+    cur_stats_.num_skipped++;
+    return false;
+  }
+  // Check whether the value is unchanged
+  std::map<GLint, UniformValue> &values = uniform_values_[program_name];
+  if (values.count(var_hdlr) > 0) {
+    const UniformValue &cur_value = values.at(var_hdlr);
+    if (cur_value.type == value.type &&
+        cur_value.int_value == value.int_value &&
+        cur_value.float_value == value.float_value) {
+      cur_stats_.num_skipped++;
+      return false;
+    }
+  }
+  // Save the value
+  values[var_hdlr] = value;
+  cur_stats_.num_uploads++;
+  return true;
+}
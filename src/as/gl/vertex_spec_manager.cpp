@@ -1,11 +1,15 @@
 #include "as/gl/vertex_spec_manager.hpp"
 
-as::VertexSpecManager::VertexSpecManager() : buffer_manager_(nullptr) {}
+as::VertexSpecManager::VertexSpecManager()
+    : buffer_manager_(nullptr),
+      state_manager_(nullptr),
+      trace_manager_(nullptr) {}
 
 as::VertexSpecManager::~VertexSpecManager() {
   // Delete all vertex array objects
   for (const auto& pair : hdlrs_) {
-    glDeleteVertexArrays(1, &pair.second);
+    IssueCall("glDeleteVertexArrays", {1, pair.second},
+              [&] { glDeleteVertexArrays(1, &pair.second); });
   }
 }
 
@@ -18,14 +22,26 @@ void as::VertexSpecManager::RegisterBufferManager(
   buffer_manager_ = &buffer_manager;
 }
 
+void as::VertexSpecManager::RegisterStateManager(StateManager& state_manager) {
+  state_manager_ = &state_manager;
+}
+
+void as::VertexSpecManager::RegisterTraceManager(TraceManager& trace_manager) {
+  trace_manager_ = &trace_manager;
+}
+
 /*******************************************************************************
  * Generations
  ******************************************************************************/
 
 void as::VertexSpecManager::GenVertexArray(const std::string& va_name) {
   // Generate a vertex array object
-  GLuint va_hdlr;
-  glGenVertexArrays(1, &va_hdlr);
+  GLuint va_hdlr = 0;
+  IssueCall("glGenVertexArrays", {1}, [&] { glGenVertexArrays(1, &va_hdlr); });
+  // Use a fake handler if the call is not issued by the recording backend
+  if (va_hdlr == 0 && trace_manager_ != nullptr) {
+    va_hdlr = trace_manager_->GenStubHdlr();
+  }
   // Save the vertex array object handler
   hdlrs_[va_name] = va_hdlr;
 }
@@ -36,7 +52,13 @@ void as::VertexSpecManager::GenVertexArray(const std::string& va_name) {
 
 void as::VertexSpecManager::BindVertexArray(const std::string& va_name) const {
   const GLuint va_hdlr = GetVertexArrayHdlr(va_name);
-  glBindVertexArray(va_hdlr);
+  // Skip the redundant binding if the state manager is registered
+  if (state_manager_ != nullptr) {
+    state_manager_->BindVertexArray(va_hdlr);
+  } else {
+    IssueCall("glBindVertexArray", {va_hdlr},
+              [&] { glBindVertexArray(va_hdlr); });
+  }
 }
 
 /*******************************************************************************
@@ -44,7 +66,11 @@ void as::VertexSpecManager::BindVertexArray(const std::string& va_name) const {
  ******************************************************************************/
 
 void as::VertexSpecManager::DeselectVertexArray() const {
-  glBindVertexArray(0);
+  if (state_manager_ != nullptr) {
+    state_manager_->BindVertexArray(0);
+  } else {
+    IssueCall("glBindVertexArray", {0}, [&] { glBindVertexArray(0); });
+  }
 }
 
 /*******************************************************************************
@@ -58,9 +84,14 @@ void as::VertexSpecManager::SpecifyVertexArrayOrg(
   // Bind the vertex array
   BindVertexArray(va_name);
   // Enable the generic vertex attribute array
-  glEnableVertexAttribArray(attrib_idx);
+  IssueCall("glEnableVertexAttribArray", {attrib_idx},
+            [&] { glEnableVertexAttribArray(attrib_idx); });
   // Specify the organization of the vertex array
-  glVertexAttribFormat(attrib_idx, size, type, normalized, relative_ofs);
+  IssueCall("glVertexAttribFormat",
+            {attrib_idx, size, type, normalized, relative_ofs}, [&] {
+              glVertexAttribFormat(attrib_idx, size, type, normalized,
+                                   relative_ofs);
+            });
 }
 
 /*******************************************************************************
@@ -73,7 +104,8 @@ void as::VertexSpecManager::AssocVertexAttribToBindingPoint(
   // Bind the vertex array
   BindVertexArray(va_name);
   // Associate the vertex attribute to the binding point
-  glVertexAttribBinding(attrib_idx, binding_idx);
+  IssueCall("glVertexAttribBinding", {attrib_idx, binding_idx},
+            [&] { glVertexAttribBinding(attrib_idx, binding_idx); });
   // Save the binding point
   binding_points_[va_name][attrib_idx] = binding_idx;
 }
@@ -91,7 +123,8 @@ void as::VertexSpecManager::BindBufferToBindingPoint(
   // Get the buffer handler
   const GLuint buffer_hdlr = buffer_manager_->GetBufferHdlr(buffer_name);
   // Bind the buffer to the binding point
-  glBindVertexBuffer(binding_idx, buffer_hdlr, ofs, stride);
+  IssueCall("glBindVertexBuffer", {binding_idx, buffer_hdlr, ofs, stride},
+            [&] { glBindVertexBuffer(binding_idx, buffer_hdlr, ofs, stride); });
   // Save the parameters
   BindBufferToBindingPointPrevParams prev_params = {ofs, stride};
   bind_buffer_to_binding_point_prev_params_[va_name][binding_idx] = prev_params;
@@ -112,7 +145,12 @@ void as::VertexSpecManager::BindBufferToBindingPoint(
 
 void as::VertexSpecManager::DeleteVertexArray(const std::string& va_name) {
   const GLuint va_hdlr = GetVertexArrayHdlr(va_name);
-  glDeleteVertexArrays(1, &va_hdlr);
+  IssueCall("glDeleteVertexArrays", {1, va_hdlr},
+            [&] { glDeleteVertexArrays(1, &va_hdlr); });
+  // Forget the vertex array state
+  if (state_manager_ != nullptr) {
+    state_manager_->InvalidateVertexArray(va_hdlr);
+  }
   // Delete previous parameters
   bind_buffer_to_binding_point_prev_params_.erase(va_name);
 }
@@ -0,0 +1,501 @@
+#include "as/trans/bvh.hpp"
+
+as::Bvh::Bvh() : built_cost_(0.0f) {}
+
+/*******************************************************************************
+ * Buildings
+ ******************************************************************************/
+
+void as::Bvh::Build(const std::vector<glm::vec3> &min_poses,
+                    const std::vector<glm::vec3> &max_poses) {
+  if (min_poses.size() != max_poses.size()) {
+    throw std::runtime_error(
+        "The numbers of minimum and maximum positions should be the same");
+  }
+  const size_t num_items = min_poses.size();
+  // Save the items
+  item_min_poses_ = min_poses;
+  item_max_poses_ = max_poses;
+  item_idxs_.resize(num_items);
+  for (size_t item_idx = 0; item_idx < num_items; item_idx++) {
+    item_idxs_[item_idx] = item_idx;
+  }
+  item_leaf_idxs_.assign(num_items, 0);
+  dirty_leaf_idxs_.clear();
+  // Build the nodes from the root
+  nodes_.clear();
+  if (num_items == 0) {
+    built_cost_ = 0.0f;
+    return;
+  }
+  nodes_.reserve(2 * num_items);
+  nodes_.push_back(Node{glm::vec3(0.0f), glm::vec3(0.0f), 0, 0, num_items, 0});
+  BuildNode(0);
+  built_cost_ = GetCost();
+}
+
+void as::Bvh::UpdateItem(const size_t item_idx, const glm::vec3 &min_pos,
+                         const glm::vec3 &max_pos) {
+  item_min_poses_.at(item_idx) = min_pos;
+  item_max_poses_.at(item_idx) = max_pos;
+  dirty_leaf_idxs_.push_back(item_leaf_idxs_.at(item_idx));
+}
+
+/*
+ * Refits the ancestors of the dirty leaves, each walk stops at the first node
+ * whose bounds don't change. All nodes are refitted when many leaves are
+ * dirty.
+ */
+void as::Bvh::Refit() {
+  if (dirty_leaf_idxs_.empty()) {
+    return;
+  }
+  if (dirty_leaf_idxs_.size() * kFullRefitRatio > nodes_.size()) {
+    // The children always follow their parents
+    for (size_t node_idx = nodes_.size(); node_idx-- > 0;) {
+      UpdateNodeBounds(node_idx);
+    }
+  } else {
+    for (const size_t leaf_idx : dirty_leaf_idxs_) {
+      size_t node_idx = leaf_idx;
+      while (true) {
+        const glm::vec3 prev_min_pos = nodes_[node_idx].min_pos;
+        const glm::vec3 prev_max_pos = nodes_[node_idx].max_pos;
+        UpdateNodeBounds(node_idx);
+        // Check whether the ancestors would change
+        const Node &node = nodes_[node_idx];
+        if (node_idx == 0 ||
+            (node.min_pos == prev_min_pos && node.max_pos == prev_max_pos)) {
+          break;
+        }
+        node_idx = node.parent_idx;
+      }
+    }
+  }
+  dirty_leaf_idxs_.clear();
+}
+
+/*******************************************************************************
+ * Traversals
+ ******************************************************************************/
+
+as::Bvh::TraversalStats as::Bvh::QueryFrustum(
+    const Frustum &frustum, std::vector<size_t> &item_idxs) const {
+  TraversalStats stats = TraversalStats{0, 0};
+  item_idxs.clear();
+  if (nodes_.empty()) {
+    return stats;
+  }
+  std::vector<size_t> node_stack = {0};
+  while (!node_stack.empty()) {
+    const Node &node = nodes_[node_stack.back()];
+    node_stack.pop_back();
+    stats.num_visited_nodes++;
+    // Classify the node
+    const glm::vec3 center = 0.5f * (node.min_pos + node.max_pos);
+    const glm::vec3 extent = 0.5f * (node.max_pos - node.min_pos);
+    const Frustum::Containments containment =
+        frustum.ClassifyAabb(center, extent);
+    if (containment == Frustum::Containments::kOutside) {
+      continue;
+    } else if (containment == Frustum::Containments::kInside) {
+      AddSubtreeItems(node, item_idxs);
+      continue;
+    }
+    // Test the items of the leaf or visit the children
+    if (node.left_idx == 0) {
+      for (size_t idx = node.first_item_idx;
+           idx < node.first_item_idx + node.num_items; idx++) {
+        const size_t item_idx = item_idxs_[idx];
+        const glm::vec3 &min_pos = item_min_poses_[item_idx];
+        const glm::vec3 &max_pos = item_max_poses_[item_idx];
+        stats.num_tested_items++;
+        if (frustum.TestAabb(0.5f * (min_pos + max_pos),
+                             0.5f * (max_pos - min_pos))) {
+          item_idxs.push_back(item_idx);
+        }
+      }
+    } else {
+      node_stack.push_back(node.left_idx);
+      node_stack.push_back(node.left_idx + 1);
+    }
+  }
+  return stats;
+}
+
+as::Bvh::TraversalStats as::Bvh::QuerySphere(
+    const glm::vec3 &center, const float radius,
+    std::vector<size_t> &item_idxs) const {
+  TraversalStats stats = TraversalStats{0, 0};
+  item_idxs.clear();
+  if (nodes_.empty()) {
+    return stats;
+  }
+  const float sq_radius = radius * radius;
+  std::vector<size_t> node_stack = {0};
+  while (!node_stack.empty()) {
+    const Node &node = nodes_[node_stack.back()];
+    node_stack.pop_back();
+    stats.num_visited_nodes++;
+    // Check whether the nearest point is outside the sphere
+    const glm::vec3 nearest_diff =
+        glm::max(glm::max(node.min_pos - center, center - node.max_pos),
+                 glm::vec3(0.0f));
+    if (glm::dot(nearest_diff, nearest_diff) > sq_radius) {
+      continue;
+    }
+    // Check whether the farthest point is inside the sphere
+    const glm::vec3 farthest_diff = glm::max(glm::abs(node.min_pos - center),
+                                             glm::abs(node.max_pos - center));
+    if (glm::dot(farthest_diff, farthest_diff) <= sq_radius) {
+      AddSubtreeItems(node, item_idxs);
+      continue;
+    }
+    // Test the items of the leaf or visit the children
+    if (node.left_idx == 0) {
+      for (size_t idx = node.first_item_idx;
+           idx < node.first_item_idx + node.num_items; idx++) {
+        const size_t item_idx = item_idxs_[idx];
+        const glm::vec3 item_diff =
+            glm::max(glm::max(item_min_poses_[item_idx] - center,
+                              center - item_max_poses_[item_idx]),
+                     glm::vec3(0.0f));
+        stats.num_tested_items++;
+        if (glm::dot(item_diff, item_diff) <= sq_radius) {
+          item_idxs.push_back(item_idx);
+        }
+      }
+    } else {
+      node_stack.push_back(node.left_idx);
+      node_stack.push_back(node.left_idx + 1);
+    }
+  }
+  return stats;
+}
+
+/*
+ * Finds the nearest item hit by the ray, the distance is in the units of the
+ * direction. The nearer child is visited first, and the nodes farther than the
+ * nearest hit so far are skipped.
+ */
+as::Bvh::TraversalStats as::Bvh::QueryRay(
+    const glm::vec3 &origin, const glm::vec3 &dir, const float max_dist,
+    RayHit &ray_hit, const std::function<bool(size_t)> &filter_func) const {
+  TraversalStats stats = TraversalStats{0, 0};
+  ray_hit = RayHit{false, 0, max_dist};
+  if (nodes_.empty()) {
+    return stats;
+  }
+  const glm::vec3 inv_dir = 1.0f / dir;
+  std::vector<size_t> node_stack = {0};
+  while (!node_stack.empty()) {
+    const Node &node = nodes_[node_stack.back()];
+    node_stack.pop_back();
+    stats.num_visited_nodes++;
+    float node_dist;
+    if (!IntersectRay(origin, inv_dir, node.min_pos, node.max_pos,
+                      ray_hit.dist, node_dist)) {
+      continue;
+    }
+    // Test the items of the leaf or visit the children
+    if (node.left_idx == 0) {
+      for (size_t idx = node.first_item_idx;
+           idx < node.first_item_idx + node.num_items; idx++) {
+        const size_t item_idx = item_idxs_[idx];
+        if (filter_func && !filter_func(item_idx)) {
+          continue;
+        }
+        stats.num_tested_items++;
+        float item_dist;
+        if (IntersectRay(origin, inv_dir, item_min_poses_[item_idx],
+                         item_max_poses_[item_idx], ray_hit.dist, item_dist)) {
+          ray_hit = RayHit{true, item_idx, item_dist};
+        }
+      }
+    } else {
+      // Push the farther child first so that the nearer one is visited first
+      const Node &left = nodes_[node.left_idx];
+      const Node &right = nodes_[node.left_idx + 1];
+      const float left_dist =
+          glm::dot(0.5f * (left.min_pos + left.max_pos) - origin, dir);
+      const float right_dist =
+          glm::dot(0.5f * (right.min_pos + right.max_pos) - origin, dir);
+      if (left_dist < right_dist) {
+        node_stack.push_back(node.left_idx + 1);
+        node_stack.push_back(node.left_idx);
+      } else {
+        node_stack.push_back(node.left_idx);
+        node_stack.push_back(node.left_idx + 1);
+      }
+    }
+  }
+  return stats;
+}
+
+/*******************************************************************************
+ * Statistics Getters
+ ******************************************************************************/
+
+size_t as::Bvh::GetNumItems() const { return item_min_poses_.size(); }
+
+size_t as::Bvh::GetNumNodes() const { return nodes_.size(); }
+
+/*
+ * Calculates the SAH cost of the tree, each node costs its traversal or item
+ * intersections weighted by the probability of hitting it, i.e., the ratio of
+ * its surface area to the root's
+ */
+float as::Bvh::GetCost() const {
+  if (nodes_.empty()) {
+    return 0.0f;
+  }
+  const float root_area =
+      std::max(GetSurfaceArea(nodes_[0].min_pos, nodes_[0].max_pos),
+               std::numeric_limits<float>::min());
+  float cost = 0.0f;
+  for (const Node &node : nodes_) {
+    const float area_ratio =
+        GetSurfaceArea(node.min_pos, node.max_pos) / root_area;
+    if (node.left_idx == 0) {
+      cost += area_ratio * kIntersectionCost * node.num_items;
+    } else {
+      cost += area_ratio * kTraversalCost;
+    }
+  }
+  return cost;
+}
+
+float as::Bvh::GetBuiltCost() const { return built_cost_; }
+
+/*******************************************************************************
+ * Constants (Private)
+ ******************************************************************************/
+
+const size_t as::Bvh::kMaxLeafItems = 4;
+
+const int as::Bvh::kNumBins = 16;
+
+const float as::Bvh::kTraversalCost = 1.0f;
+
+const float as::Bvh::kIntersectionCost = 1.0f;
+
+const size_t as::Bvh::kFullRefitRatio = 8;
+
+/*******************************************************************************
+ * Buildings (Private)
+ ******************************************************************************/
+
+/*
+ * Splits the nodes until the leaves are cheaper than the splits. The nodes are
+ * split with a stack instead of recursions because the tree could be deep for
+ * clustered items.
+ */
+void as::Bvh::BuildNode(const size_t node_idx) {
+  std::vector<size_t> node_stack = {node_idx};
+  while (!node_stack.empty()) {
+    const size_t cur_node_idx = node_stack.back();
+    node_stack.pop_back();
+    UpdateNodeBounds(cur_node_idx);
+    const Node node = nodes_[cur_node_idx];
+
+    // Find the split
+    int split_axis = 0;
+    float split_pos = 0.0f;
+    size_t num_left_items = 0;
+    if (FindSplit(node, split_axis, split_pos)) {
+      // Partition the items by the centroids
+      const auto begin = item_idxs_.begin() + node.first_item_idx;
+      const auto end = begin + node.num_items;
+      const auto mid = std::partition(begin, end, [&](const size_t item_idx) {
+        const float centroid = 0.5f * (item_min_poses_[item_idx][split_axis] +
+                                       item_max_poses_[item_idx][split_axis]);
+        return centroid < split_pos;
+      });
+      num_left_items = static_cast<size_t>(mid - begin);
+    }
+
+    // Make a leaf when the split leaves a side empty
+    if (num_left_items == 0 || num_left_items == node.num_items) {
+      for (size_t idx = node.first_item_idx;
+           idx < node.first_item_idx + node.num_items; idx++) {
+        item_leaf_idxs_[item_idxs_[idx]] = cur_node_idx;
+      }
+      continue;
+    }
+
+    // Add the children
+    const size_t left_idx = nodes_.size();
+    nodes_.push_back(Node{glm::vec3(0.0f), glm::vec3(0.0f), 0,
+                          node.first_item_idx, num_left_items, cur_node_idx});
+    nodes_.push_back(Node{glm::vec3(0.0f), glm::vec3(0.0f), 0,
+                          node.first_item_idx + num_left_items,
+                          node.num_items - num_left_items, cur_node_idx});
+    nodes_[cur_node_idx].left_idx = left_idx;
+    node_stack.push_back(left_idx);
+    node_stack.push_back(left_idx + 1);
+  }
+}
+
+/*
+ * Bins the item centroids along each axis and evaluates the SAH cost of the
+ * splits between the bins. Returns whether the best split is cheaper than the
+ * leaf, the large nodes are always split.
+ */
+bool as::Bvh::FindSplit(const Node &node, int &split_axis,
+                        float &split_pos) const {
+  if (node.num_items <= 1) {
+    return false;
+  }
+  const size_t first_idx = node.first_item_idx;
+  const size_t last_idx = node.first_item_idx + node.num_items;
+
+  // Calculate the bounds of the centroids
+  glm::vec3 centroid_min_pos(std::numeric_limits<float>::max());
+  glm::vec3 centroid_max_pos(std::numeric_limits<float>::lowest());
+  for (size_t idx = first_idx; idx < last_idx; idx++) {
+    const size_t item_idx = item_idxs_[idx];
+    const glm::vec3 centroid =
+        0.5f * (item_min_poses_[item_idx] + item_max_poses_[item_idx]);
+    centroid_min_pos = glm::min(centroid_min_pos, centroid);
+    centroid_max_pos = glm::max(centroid_max_pos, centroid);
+  }
+
+  const float node_area =
+      std::max(GetSurfaceArea(node.min_pos, node.max_pos),
+               std::numeric_limits<float>::min());
+  float best_cost = std::numeric_limits<float>::max();
+  for (int axis = 0; axis < 3; axis++) {
+    const float axis_min = centroid_min_pos[axis];
+    const float axis_extent = centroid_max_pos[axis] - axis_min;
+    if (axis_extent <= 0.0f) {
+      continue;
+    }
+    const float bin_scale = kNumBins / axis_extent;
+
+    // Bin the items
+    std::vector<size_t> bin_counts(kNumBins, 0);
+    std::vector<glm::vec3> bin_min_poses(
+        kNumBins, glm::vec3(std::numeric_limits<float>::max()));
+    std::vector<glm::vec3> bin_max_poses(
+        kNumBins, glm::vec3(std::numeric_limits<float>::lowest()));
+    for (size_t idx = first_idx; idx < last_idx; idx++) {
+      const size_t item_idx = item_idxs_[idx];
+      const glm::vec3 &min_pos = item_min_poses_[item_idx];
+      const glm::vec3 &max_pos = item_max_poses_[item_idx];
+      const float centroid = 0.5f * (min_pos[axis] + max_pos[axis]);
+      const int bin_idx = std::min(
+          static_cast<int>((centroid - axis_min) * bin_scale), kNumBins - 1);
+      bin_counts[bin_idx]++;
+      bin_min_poses[bin_idx] = glm::min(bin_min_poses[bin_idx], min_pos);
+      bin_max_poses[bin_idx] = glm::max(bin_max_poses[bin_idx], max_pos);
+    }
+
+    // Sweep from the right to accumulate the right sides of the splits
+    std::vector<size_t> right_counts(kNumBins, 0);
+    std::vector<float> right_areas(kNumBins, 0.0f);
+    glm::vec3 right_min_pos(std::numeric_limits<float>::max());
+    glm::vec3 right_max_pos(std::numeric_limits<float>::lowest());
+    size_t right_count = 0;
+    for (int bin_idx = kNumBins - 1; bin_idx > 0; bin_idx--) {
+      right_count += bin_counts[bin_idx];
+      right_min_pos = glm::min(right_min_pos, bin_min_poses[bin_idx]);
+      right_max_pos = glm::max(right_max_pos, bin_max_poses[bin_idx]);
+      right_counts[bin_idx] = right_count;
+      if (right_count > 0) {
+        right_areas[bin_idx] = GetSurfaceArea(right_min_pos, right_max_pos);
+      }
+    }
+
+    // Sweep from the left and evaluate the split before each bin
+    glm::vec3 left_min_pos(std::numeric_limits<float>::max());
+    glm::vec3 left_max_pos(std::numeric_limits<float>::lowest());
+    size_t left_count = 0;
+    for (int bin_idx = 1; bin_idx < kNumBins; bin_idx++) {
+      left_count += bin_counts[bin_idx - 1];
+      left_min_pos = glm::min(left_min_pos, bin_min_poses[bin_idx - 1]);
+      left_max_pos = glm::max(left_max_pos, bin_max_poses[bin_idx - 1]);
+      if (left_count == 0 || right_counts[bin_idx] == 0) {
+        continue;
+      }
+      const float left_area = GetSurfaceArea(left_min_pos, left_max_pos);
+      const float cost =
+          kTraversalCost +
+          kIntersectionCost *
+              (left_area * left_count +
+               right_areas[bin_idx] * right_counts[bin_idx]) /
+              node_area;
+      if (cost < best_cost) {
+        best_cost = cost;
+        split_axis = axis;
+        split_pos = axis_min + bin_idx / bin_scale;
+      }
+    }
+  }
+
+  // Check whether any split is found
+  if (best_cost == std::numeric_limits<float>::max()) {
+    return false;
+  }
+  const float leaf_cost = kIntersectionCost * node.num_items;
+  return best_cost < leaf_cost || node.num_items > kMaxLeafItems;
+}
+
+void as::Bvh::UpdateNodeBounds(const size_t node_idx) {
+  Node &node = nodes_[node_idx];
+  if (node.left_idx == 0) {
+    // Enclose the items
+    node.min_pos = glm::vec3(std::numeric_limits<float>::max());
+    node.max_pos = glm::vec3(std::numeric_limits<float>::lowest());
+    for (size_t idx = node.first_item_idx;
+         idx < node.first_item_idx + node.num_items; idx++) {
+      const size_t item_idx = item_idxs_[idx];
+      node.min_pos = glm::min(node.min_pos, item_min_poses_[item_idx]);
+      node.max_pos = glm::max(node.max_pos, item_max_poses_[item_idx]);
+    }
+  } else {
+    // Enclose the children
+    const Node &left = nodes_[node.left_idx];
+    const Node &right = nodes_[node.left_idx + 1];
+    node.min_pos = glm::min(left.min_pos, right.min_pos);
+    node.max_pos = glm::max(left.max_pos, right.max_pos);
+  }
+}
+
+/*******************************************************************************
+ * Traversals (Private)
+ ******************************************************************************/
+
+void as::Bvh::AddSubtreeItems(const Node &node,
+                              std::vector<size_t> &item_idxs) const {
+  const auto begin = item_idxs_.begin() + node.first_item_idx;
+  item_idxs.insert(item_idxs.end(), begin, begin + node.num_items);
+}
+
+/*
+ * Intersects the ray with the box by the slab method, the distance is where
+ * the ray enters the box, or 0 when the origin is inside it
+ */
+bool as::Bvh::IntersectRay(const glm::vec3 &origin, const glm::vec3 &inv_dir,
+                           const glm::vec3 &min_pos, const glm::vec3 &max_pos,
+                           const float max_dist, float &dist) {
+  const glm::vec3 t0 = (min_pos - origin) * inv_dir;
+  const glm::vec3 t1 = (max_pos - origin) * inv_dir;
+  const glm::vec3 t_near = glm::min(t0, t1);
+  const glm::vec3 t_far = glm::max(t0, t1);
+  const float t_enter =
+      std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.0f));
+  const float t_exit =
+      std::min(std::min(t_far.x, t_far.y), std::min(t_far.z, max_dist));
+  dist = t_enter;
+  return t_enter <= t_exit;
+}
+
+/*******************************************************************************
+ * Statistics Getters (Private)
+ ******************************************************************************/
+
+float as::Bvh::GetSurfaceArea(const glm::vec3 &min_pos,
+                              const glm::vec3 &max_pos) {
+  const glm::vec3 size = glm::max(max_pos - min_pos, glm::vec3(0.0f));
+  return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
@@ -0,0 +1,219 @@
+#include "as/trans/frustum.hpp"
+
+#include <xmmintrin.h>
+
+/*******************************************************************************
+ * Recordings
+ ******************************************************************************/
+
+void as::AabbBatch::Clear() {
+  for (int axis = 0; axis < 3; axis++) {
+    centers_[axis].clear();
+    extents_[axis].clear();
+  }
+}
+
+void as::AabbBatch::Resize(const size_t num_aabbs) {
+  for (int axis = 0; axis < 3; axis++) {
+    centers_[axis].resize(num_aabbs);
+    extents_[axis].resize(num_aabbs);
+  }
+}
+
+void as::AabbBatch::AddAabb(const glm::vec3 &center, const glm::vec3 &extent) {
+  for (int axis = 0; axis < 3; axis++) {
+    centers_[axis].push_back(center[axis]);
+    extents_[axis].push_back(extent[axis]);
+  }
+}
+
+void as::AabbBatch::SetAabb(const size_t aabb_idx, const glm::vec3 &center,
+                            const glm::vec3 &extent) {
+  for (int axis = 0; axis < 3; axis++) {
+    centers_[axis][aabb_idx] = center[axis];
+    extents_[axis][aabb_idx] = extent[axis];
+  }
+}
+
+/*******************************************************************************
+ * Getters
+ ******************************************************************************/
+
+size_t as::AabbBatch::GetNumAabbs() const { return centers_[0].size(); }
+
+glm::vec3 as::AabbBatch::GetCenter(const size_t aabb_idx) const {
+  return glm::vec3(centers_[0][aabb_idx], centers_[1][aabb_idx],
+                   centers_[2][aabb_idx]);
+}
+
+glm::vec3 as::AabbBatch::GetExtent(const size_t aabb_idx) const {
+  return glm::vec3(extents_[0][aabb_idx], extents_[1][aabb_idx],
+                   extents_[2][aabb_idx]);
+}
+
+const float *as::AabbBatch::GetCenters(const int axis) const {
+  return centers_[axis].data();
+}
+
+const float *as::AabbBatch::GetExtents(const int axis) const {
+  return extents_[axis].data();
+}
+
+/*******************************************************************************
+ * Constructors
+ ******************************************************************************/
+
+as::Frustum::Frustum() : Frustum(glm::mat4(1.0f)) {}
+
+as::Frustum::Frustum(const glm::mat4 &view_proj) { SetViewProj(view_proj); }
+
+/*******************************************************************************
+ * State Setters
+ ******************************************************************************/
+
+void as::Frustum::SetViewProj(const glm::mat4 &view_proj) {
+  // Get the rows of the column-major matrix
+  const glm::mat4 rows = glm::transpose(view_proj);
+  // Left, right, bottom, top, near and far planes
+  planes_[0] = rows[3] + rows[0];
+  planes_[1] = rows[3] - rows[0];
+  planes_[2] = rows[3] + rows[1];
+  planes_[3] = rows[3] - rows[1];
+  planes_[4] = rows[3] + rows[2];
+  planes_[5] = rows[3] - rows[2];
+  // Normalize the planes so that the distances are in world units
+  for (glm::vec4 &plane : planes_) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+}
+
+/*******************************************************************************
+ * Tests
+ ******************************************************************************/
+
+/*
+ * The box is outside when it lies entirely behind any plane, i.e., the signed
+ * distance of the center is less than the negative projected radius
+ */
+bool as::Frustum::TestAabb(const glm::vec3 &center,
+                           const glm::vec3 &extent) const {
+  for (const glm::vec4 &plane : planes_) {
+    const glm::vec3 normal = glm::vec3(plane);
+    const float dist = glm::dot(normal, center) + plane.w;
+    const float radius = glm::dot(glm::abs(normal), extent);
+    if (dist + radius < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * The box is inside when it lies entirely in front of all planes, so that the
+ * hierarchies could skip testing the boxes in it
+ */
+as::Frustum::Containments as::Frustum::ClassifyAabb(
+    const glm::vec3 &center, const glm::vec3 &extent) const {
+  Containments containment = Containments::kInside;
+  for (const glm::vec4 &plane : planes_) {
+    const glm::vec3 normal = glm::vec3(plane);
+    const float dist = glm::dot(normal, center) + plane.w;
+    const float radius = glm::dot(glm::abs(normal), extent);
+    if (dist + radius < 0.0f) {
+      return Containments::kOutside;
+    }
+    if (dist - radius < 0.0f) {
+      containment = Containments::kIntersecting;
+    }
+  }
+  return containment;
+}
+
+/*
+ * Tests four boxes against each plane at a time, the remaining boxes are
+ * tested one by one. Returns the number of visible boxes.
+ */
+size_t as::Frustum::TestAabbs(const AabbBatch &aabb_batch,
+                              std::vector<unsigned char> &visibles) const {
+  const size_t num_aabbs = aabb_batch.GetNumAabbs();
+  const float *center_xs = aabb_batch.GetCenters(0);
+  const float *center_ys = aabb_batch.GetCenters(1);
+  const float *center_zs = aabb_batch.GetCenters(2);
+  const float *extent_xs = aabb_batch.GetExtents(0);
+  const float *extent_ys = aabb_batch.GetExtents(1);
+  const float *extent_zs = aabb_batch.GetExtents(2);
+
+  visibles.resize(num_aabbs);
+  size_t num_visibles = 0;
+
+  // Test four boxes at a time
+  const __m128 zero = _mm_setzero_ps();
+  size_t aabb_idx = 0;
+  for (; aabb_idx + 4 <= num_aabbs; aabb_idx += 4) {
+    const __m128 center_x = _mm_loadu_ps(center_xs + aabb_idx);
+    const __m128 center_y = _mm_loadu_ps(center_ys + aabb_idx);
+    const __m128 center_z = _mm_loadu_ps(center_zs + aabb_idx);
+    const __m128 extent_x = _mm_loadu_ps(extent_xs + aabb_idx);
+    const __m128 extent_y = _mm_loadu_ps(extent_ys + aabb_idx);
+    const __m128 extent_z = _mm_loadu_ps(extent_zs + aabb_idx);
+    __m128 outside = _mm_setzero_ps();
+    for (const glm::vec4 &plane : planes_) {
+      const glm::vec3 abs_normal = glm::abs(glm::vec3(plane));
+      // Calculate the signed distances of the centers
+      __m128 dist = _mm_set1_ps(plane.w);
+      dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(plane.x), center_x));
+      dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(plane.y), center_y));
+      dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(plane.z), center_z));
+      // Calculate the projected radii of the boxes
+      __m128 radius = _mm_mul_ps(_mm_set1_ps(abs_normal.x), extent_x);
+      radius =
+          _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(abs_normal.y), extent_y));
+      radius =
+          _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(abs_normal.z), extent_z));
+      // Accumulate the boxes behind the plane
+      const __m128 behind = _mm_cmplt_ps(_mm_add_ps(dist, radius), zero);
+      outside = _mm_or_ps(outside, behind);
+    }
+    const int outside_mask = _mm_movemask_ps(outside);
+    for (size_t lane = 0; lane < 4; lane++) {
+      const unsigned char visible = ((outside_mask >> lane) & 1) == 0 ? 1 : 0;
+      visibles[aabb_idx + lane] = visible;
+      num_visibles += visible;
+    }
+  }
+
+  // Test the remaining boxes
+  for (; aabb_idx < num_aabbs; aabb_idx++) {
+    const unsigned char visible = TestAabb(aabb_batch.GetCenter(aabb_idx),
+                                           aabb_batch.GetExtent(aabb_idx))
+                                      ? 1
+                                      : 0;
+    visibles[aabb_idx] = visible;
+    num_visibles += visible;
+  }
+
+  return num_visibles;
+}
+
+/*******************************************************************************
+ * Bounds
+ ******************************************************************************/
+
+/*
+ * Transforms the local box into the world box which encloses it, the world
+ * extent is the local extent projected onto each world axis
+ *
+ * Reference: Transforming Axis-Aligned Bounding Boxes (Arvo), Graphics Gems
+ */
+void as::Frustum::TransformAabb(const glm::mat4 &trans,
+                                const glm::vec3 &min_pos,
+                                const glm::vec3 &max_pos, glm::vec3 &center,
+                                glm::vec3 &extent) {
+  const glm::vec3 local_center = 0.5f * (min_pos + max_pos);
+  const glm::vec3 local_extent = 0.5f * (max_pos - min_pos);
+  center = glm::vec3(trans * glm::vec4(local_center, 1.0f));
+  const glm::mat3 abs_rotation = glm::mat3(glm::abs(glm::vec3(trans[0])),
+                                           glm::abs(glm::vec3(trans[1])),
+                                           glm::abs(glm::vec3(trans[2])));
+  extent = abs_rotation * local_extent;
+}
@@ -0,0 +1,274 @@
+#include "as/trans/light_clusters.hpp"
+
+as::LightClusters::LightClusters(const int num_tiles_x, const int num_tiles_y,
+                                 const int num_slices)
+    : num_tiles_x_(num_tiles_x),
+      num_tiles_y_(num_tiles_y),
+      num_slices_(num_slices),
+      proj_(glm::mat4(0.0f)),
+      near_depth_(0.0f),
+      far_depth_(0.0f),
+      camera_near_(0.0f),
+      camera_far_(0.0f),
+      slice_scale_(0.0f),
+      slice_bias_(0.0f),
+      max_num_cluster_lights_(0) {
+  if (num_tiles_x <= 0 || num_tiles_y <= 0 || num_slices <= 0) {
+    throw std::runtime_error("Invalid light cluster size (" +
+                             std::to_string(num_tiles_x) + ", " +
+                             std::to_string(num_tiles_y) + ", " +
+                             std::to_string(num_slices) + ")");
+  }
+  const size_t num_clusters = static_cast<size_t>(num_tiles_x) *
+                              static_cast<size_t>(num_tiles_y) *
+                              static_cast<size_t>(num_slices);
+  cluster_ranges_.resize(num_clusters, {0, 0});
+}
+
+/*******************************************************************************
+ * Assignments
+ ******************************************************************************/
+
+/*
+ * The projection should be a perspective projection. The slices are spaced
+ * logarithmically between the near and far depths, the first slice is
+ * extended to the near plane of the camera and the last slice to the far
+ * plane. The cluster boxes are only rebuilt when the projection changes.
+ */
+void as::LightClusters::Assign(const glm::mat4 &proj, const glm::mat4 &view,
+                               const float near_depth, const float far_depth,
+                               const std::vector<PointLight> &point_lights) {
+  if (proj != proj_ || near_depth != near_depth_ || far_depth != far_depth_) {
+    BuildClusters(proj, near_depth, far_depth);
+  }
+
+  // Collect the clusters overlapped by each light
+  ref_cluster_idxs_.clear();
+  ref_light_idxs_.clear();
+  for (size_t light_idx = 0; light_idx < point_lights.size(); light_idx++) {
+    const PointLight &point_light = point_lights[light_idx];
+    const glm::vec3 center = glm::vec3(view * glm::vec4(point_light.pos, 1.0f));
+    const float radius = point_light.radius;
+    const float depth = -center.z;
+    if (depth + radius < camera_near_ || depth - radius > camera_far_) {
+      continue;
+    }
+    glm::ivec2 begin_tile;
+    glm::ivec2 end_tile;
+    if (!FindTileRange(center, radius, begin_tile, end_tile)) {
+      continue;
+    }
+    const int begin_slice = FindSlice(depth - radius);
+    const int end_slice = FindSlice(depth + radius);
+    for (int slice_idx = begin_slice; slice_idx <= end_slice; slice_idx++) {
+      for (int tile_y = begin_tile.y; tile_y <= end_tile.y; tile_y++) {
+        for (int tile_x = begin_tile.x; tile_x <= end_tile.x; tile_x++) {
+          const size_t cluster_idx =
+              (static_cast<size_t>(slice_idx) * num_tiles_y_ + tile_y) *
+                  num_tiles_x_ +
+              tile_x;
+          if (!TestSphereAabb(center, radius, cluster_min_poses_[cluster_idx],
+                              cluster_max_poses_[cluster_idx])) {
+            continue;
+          }
+          ref_cluster_idxs_.push_back(static_cast<GLuint>(cluster_idx));
+          ref_light_idxs_.push_back(static_cast<GLuint>(light_idx));
+        }
+      }
+    }
+  }
+
+  // Count the lights of each cluster
+  for (ClusterRange &cluster_range : cluster_ranges_) {
+    cluster_range.num_lights = 0;
+  }
+  for (const GLuint cluster_idx : ref_cluster_idxs_) {
+    cluster_ranges_[cluster_idx].num_lights++;
+  }
+  // Place the clusters one after another in the light indexes
+  GLuint offset = 0;
+  max_num_cluster_lights_ = 0;
+  for (ClusterRange &cluster_range : cluster_ranges_) {
+    cluster_range.offset = offset;
+    offset += cluster_range.num_lights;
+    max_num_cluster_lights_ =
+        std::max(max_num_cluster_lights_, cluster_range.num_lights);
+    // Count again while filling the light indexes
+    cluster_range.num_lights = 0;
+  }
+  // Fill the light indexes
+  light_idxs_.resize(ref_light_idxs_.size());
+  for (size_t ref_idx = 0; ref_idx < ref_light_idxs_.size(); ref_idx++) {
+    ClusterRange &cluster_range = cluster_ranges_[ref_cluster_idxs_[ref_idx]];
+    light_idxs_[cluster_range.offset + cluster_range.num_lights] =
+        ref_light_idxs_[ref_idx];
+    cluster_range.num_lights++;
+  }
+}
+
+/*******************************************************************************
+ * Getters
+ ******************************************************************************/
+
+int as::LightClusters::GetNumTilesX() const { return num_tiles_x_; }
+
+int as::LightClusters::GetNumTilesY() const { return num_tiles_y_; }
+
+int as::LightClusters::GetNumSlices() const { return num_slices_; }
+
+float as::LightClusters::GetSliceScale() const { return slice_scale_; }
+
+float as::LightClusters::GetSliceBias() const { return slice_bias_; }
+
+const std::vector<as::LightClusters::ClusterRange>
+    &as::LightClusters::GetClusterRanges() const {
+  return cluster_ranges_;
+}
+
+const std::vector<GLuint> &as::LightClusters::GetLightIdxs() const {
+  return light_idxs_;
+}
+
+GLuint as::LightClusters::GetMaxNumClusterLights() const {
+  return max_num_cluster_lights_;
+}
+
+/*******************************************************************************
+ * Clusters (Private)
+ ******************************************************************************/
+
+void as::LightClusters::BuildClusters(const glm::mat4 &proj,
+                                      const float near_depth,
+                                      const float far_depth) {
+  if (near_depth <= 0.0f || far_depth <= near_depth) {
+    throw std::runtime_error("Invalid light cluster depths (" +
+                             std::to_string(near_depth) + ", " +
+                             std::to_string(far_depth) + ")");
+  }
+  proj_ = proj;
+  near_depth_ = near_depth;
+  far_depth_ = far_depth;
+
+  // Get the near and far planes from the perspective projection
+  camera_near_ = proj[3][2] / (proj[2][2] - 1.0f);
+  camera_far_ = proj[3][2] / (proj[2][2] + 1.0f);
+  // Get the parameters to find the slices
+  const float log_depth_ratio = std::log(far_depth / near_depth);
+  slice_scale_ = static_cast<float>(num_slices_) / log_depth_ratio;
+  slice_bias_ = -std::log(near_depth) * slice_scale_;
+
+  // Get the boxes of the clusters, the depths change linearly along the rays
+  // through the tile corners
+  const glm::mat4 inv_proj = glm::inverse(proj);
+  cluster_min_poses_.resize(cluster_ranges_.size());
+  cluster_max_poses_.resize(cluster_ranges_.size());
+  for (int slice_idx = 0; slice_idx < num_slices_; slice_idx++) {
+    const float begin_depth = GetSliceDepth(slice_idx);
+    const float end_depth = GetSliceDepth(slice_idx + 1);
+    for (int tile_y = 0; tile_y < num_tiles_y_; tile_y++) {
+      for (int tile_x = 0; tile_x < num_tiles_x_; tile_x++) {
+        const size_t cluster_idx =
+            (static_cast<size_t>(slice_idx) * num_tiles_y_ + tile_y) *
+                num_tiles_x_ +
+            tile_x;
+        glm::vec3 min_pos(std::numeric_limits<float>::max());
+        glm::vec3 max_pos(std::numeric_limits<float>::lowest());
+        for (int corner_idx = 0; corner_idx < 4; corner_idx++) {
+          const int corner_x = tile_x + (corner_idx & 1);
+          const int corner_y = tile_y + ((corner_idx & 2) >> 1);
+          const float x = 2.0f * static_cast<float>(corner_x) /
+                              static_cast<float>(num_tiles_x_) -
+                          1.0f;
+          const float y = 2.0f * static_cast<float>(corner_y) /
+                              static_cast<float>(num_tiles_y_) -
+                          1.0f;
+          const glm::vec3 near_pos =
+              Unproject(inv_proj, glm::vec3(x, y, -1.0f));
+          const glm::vec3 begin_pos = near_pos * (begin_depth / -near_pos.z);
+          const glm::vec3 end_pos = near_pos * (end_depth / -near_pos.z);
+          min_pos = glm::min(min_pos, glm::min(begin_pos, end_pos));
+          max_pos = glm::max(max_pos, glm::max(begin_pos, end_pos));
+        }
+        cluster_min_poses_[cluster_idx] = min_pos;
+        cluster_max_poses_[cluster_idx] = max_pos;
+      }
+    }
+  }
+}
+
+float as::LightClusters::GetSliceDepth(const int slice_idx) const {
+  if (slice_idx <= 0) {
+    return camera_near_;
+  } else if (slice_idx >= num_slices_) {
+    return camera_far_;
+  }
+  const float slice_ratio =
+      static_cast<float>(slice_idx) / static_cast<float>(num_slices_);
+  return near_depth_ * std::pow(far_depth_ / near_depth_, slice_ratio);
+}
+
+int as::LightClusters::FindSlice(const float depth) const {
+  if (depth <= near_depth_) {
+    return 0;
+  }
+  const int slice_idx =
+      static_cast<int>(std::floor(std::log(depth) * slice_scale_ + slice_bias_));
+  return std::min(std::max(slice_idx, 0), num_slices_ - 1);
+}
+
+/*
+ * Projects the corners of the box around the sphere. The whole screen is used
+ * when the box crosses the near plane, since the projected corners would
+ * flip. Returns false when the sphere is outside the screen.
+ */
+bool as::LightClusters::FindTileRange(const glm::vec3 &center,
+                                      const float radius,
+                                      glm::ivec2 &begin_tile,
+                                      glm::ivec2 &end_tile) const {
+  const glm::ivec2 num_tiles(num_tiles_x_, num_tiles_y_);
+  if (center.z + radius > -camera_near_) {
+    begin_tile = glm::ivec2(0);
+    end_tile = num_tiles - 1;
+    return true;
+  }
+  glm::vec2 min_ndc_pos(std::numeric_limits<float>::max());
+  glm::vec2 max_ndc_pos(std::numeric_limits<float>::lowest());
+  for (int corner_idx = 0; corner_idx < 8; corner_idx++) {
+    const glm::vec3 corner =
+        center + radius * glm::vec3((corner_idx & 1) ? 1.0f : -1.0f,
+                                    (corner_idx & 2) ? 1.0f : -1.0f,
+                                    (corner_idx & 4) ? 1.0f : -1.0f);
+    const glm::vec4 clip_pos = proj_ * glm::vec4(corner, 1.0f);
+    const glm::vec2 ndc_pos = glm::vec2(clip_pos) / clip_pos.w;
+    min_ndc_pos = glm::min(min_ndc_pos, ndc_pos);
+    max_ndc_pos = glm::max(max_ndc_pos, ndc_pos);
+  }
+  if (glm::any(glm::lessThan(max_ndc_pos, glm::vec2(-1.0f))) ||
+      glm::any(glm::greaterThan(min_ndc_pos, glm::vec2(1.0f)))) {
+    return false;
+  }
+  // Convert the NDC positions to the tiles
+  const glm::vec2 tile_scale = 0.5f * glm::vec2(num_tiles);
+  begin_tile = glm::clamp(
+      glm::ivec2(glm::floor((min_ndc_pos + 1.0f) * tile_scale)),
+      glm::ivec2(0), num_tiles - 1);
+  end_tile = glm::clamp(
+      glm::ivec2(glm::floor((max_ndc_pos + 1.0f) * tile_scale)),
+      glm::ivec2(0), num_tiles - 1);
+  return true;
+}
+
+glm::vec3 as::LightClusters::Unproject(const glm::mat4 &inv_proj,
+                                       const glm::vec3 &ndc_pos) {
+  const glm::vec4 pos = inv_proj * glm::vec4(ndc_pos, 1.0f);
+  return glm::vec3(pos) / pos.w;
+}
+
+bool as::LightClusters::TestSphereAabb(const glm::vec3 &center,
+                                       const float radius,
+                                       const glm::vec3 &min_pos,
+                                       const glm::vec3 &max_pos) {
+  const glm::vec3 closest_pos = glm::clamp(center, min_pos, max_pos);
+  const glm::vec3 diff = closest_pos - center;
+  return glm::dot(diff, diff) <= radius * radius;
+}
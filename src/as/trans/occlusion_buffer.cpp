@@ -0,0 +1,407 @@
+#include "as/trans/occlusion_buffer.hpp"
+
+#include <future>
+#include <thread>
+
+#include <xmmintrin.h>
+
+as::OcclusionBuffer::OcclusionBuffer(const int width, const int height)
+    : width_(width), height_(height), view_proj_(glm::mat4(1.0f)) {
+  if (width_ <= 0 || width_ % kTileWidth != 0 || height_ <= 0 ||
+      height_ % kTileHeight != 0) {
+    throw std::runtime_error(
+        "The occlusion buffer size should be multiples of the tile size");
+  }
+  num_tiles_x_ = width_ / kTileWidth;
+  num_tiles_y_ = height_ / kTileHeight;
+  tile_triangle_idxs_.resize(num_tiles_x_ * num_tiles_y_);
+  // Nothing is occluded before the first rasterization
+  depths_.assign(width_ * height_, 1.0f);
+  tile_max_depths_.assign(num_tiles_x_ * num_tiles_y_, 1.0f);
+}
+
+/*******************************************************************************
+ * Recordings
+ ******************************************************************************/
+
+void as::OcclusionBuffer::Clear(const glm::mat4 &view_proj) {
+  view_proj_ = view_proj;
+  triangles_.clear();
+  for (std::vector<size_t> &triangle_idxs : tile_triangle_idxs_) {
+    triangle_idxs.clear();
+  }
+}
+
+void as::OcclusionBuffer::AddOccluder(const glm::mat4 &trans,
+                                      const std::vector<glm::vec3> &poses,
+                                      const std::vector<size_t> &idxs) {
+  // Transform the positions into the clip space
+  const glm::mat4 clip_trans = view_proj_ * trans;
+  std::vector<glm::vec4> clip_poses(poses.size());
+  for (size_t pos_idx = 0; pos_idx < poses.size(); pos_idx++) {
+    clip_poses[pos_idx] = clip_trans * glm::vec4(poses[pos_idx], 1.0f);
+  }
+  // Add the triangles
+  for (size_t idx = 0; idx + 2 < idxs.size(); idx += 3) {
+    AddClipTriangle(clip_poses[idxs[idx]], clip_poses[idxs[idx + 1]],
+                    clip_poses[idxs[idx + 2]]);
+  }
+}
+
+/*
+ * Rasterizes the binned triangles, the threads take the tiles one by one so
+ * that the tiles with many triangles don't hold up the others. The jobs run
+ * on the thread pool behind std::async instead of new threads every frame.
+ */
+void as::OcclusionBuffer::Rasterize() {
+  const unsigned int num_threads = std::min(
+      std::max(std::thread::hardware_concurrency(), 1u), kMaxNumThreads);
+  std::atomic<size_t> next_tile_idx(0);
+  // The current thread also rasterizes the tiles
+  std::vector<std::future<void>> jobs;
+  for (unsigned int thread_idx = 1; thread_idx < num_threads; thread_idx++) {
+    jobs.push_back(std::async(std::launch::async, [this, &next_tile_idx]() {
+      RasterizeTiles(next_tile_idx);
+    }));
+  }
+  RasterizeTiles(next_tile_idx);
+  for (std::future<void> &job : jobs) {
+    job.get();
+  }
+}
+
+/*******************************************************************************
+ * Tests
+ ******************************************************************************/
+
+/*
+ * The box is visible when any covered pixel is farther than the nearest corner
+ * of the box. The tiles whose farthest pixels are nearer than the box are
+ * skipped without testing the pixels.
+ */
+bool as::OcclusionBuffer::TestAabb(const glm::vec3 &min_pos,
+                                   const glm::vec3 &max_pos) const {
+  // Project the corners
+  glm::vec3 screen_min_pos(std::numeric_limits<float>::max());
+  glm::vec3 screen_max_pos(std::numeric_limits<float>::lowest());
+  for (int corner_idx = 0; corner_idx < 8; corner_idx++) {
+    const glm::vec3 corner((corner_idx & 1) ? max_pos.x : min_pos.x,
+                           (corner_idx & 2) ? max_pos.y : min_pos.y,
+                           (corner_idx & 4) ? max_pos.z : min_pos.z);
+    const glm::vec4 clip_pos = view_proj_ * glm::vec4(corner, 1.0f);
+    // The box crossing the near plane is treated as visible
+    if (clip_pos.z < -clip_pos.w) {
+      return true;
+    }
+    const glm::vec3 screen_pos = ToScreenPos(clip_pos);
+    screen_min_pos = glm::min(screen_min_pos, screen_pos);
+    screen_max_pos = glm::max(screen_max_pos, screen_pos);
+  }
+  const float min_depth = screen_min_pos.z;
+
+  // Find the pixels touched by the box
+  const int x_begin = static_cast<int>(
+      glm::clamp(screen_min_pos.x, 0.0f, static_cast<float>(width_)));
+  const int x_end = static_cast<int>(
+      glm::clamp(screen_max_pos.x + 1.0f, 0.0f, static_cast<float>(width_)));
+  const int y_begin = static_cast<int>(
+      glm::clamp(screen_min_pos.y, 0.0f, static_cast<float>(height_)));
+  const int y_end = static_cast<int>(
+      glm::clamp(screen_max_pos.y + 1.0f, 0.0f, static_cast<float>(height_)));
+  if (x_begin >= x_end || y_begin >= y_end) {
+    return false;
+  }
+
+  // Test the tiles
+  const __m128 box_depth = _mm_set1_ps(min_depth);
+  for (int tile_y = y_begin / kTileHeight; tile_y <= (y_end - 1) / kTileHeight;
+       tile_y++) {
+    for (int tile_x = x_begin / kTileWidth; tile_x <= (x_end - 1) / kTileWidth;
+         tile_x++) {
+      if (tile_max_depths_[tile_y * num_tiles_x_ + tile_x] < min_depth) {
+        continue;
+      }
+      // Test the pixels four at a time
+      const int tile_x_begin = std::max(x_begin, tile_x * kTileWidth);
+      const int tile_x_end = std::min(x_end, (tile_x + 1) * kTileWidth);
+      const int tile_y_begin = std::max(y_begin, tile_y * kTileHeight);
+      const int tile_y_end = std::min(y_end, (tile_y + 1) * kTileHeight);
+      for (int y = tile_y_begin; y < tile_y_end; y++) {
+        const float *row = depths_.data() + y * width_;
+        int x = tile_x_begin;
+        for (; x + 4 <= tile_x_end; x += 4) {
+          const __m128 depth = _mm_loadu_ps(row + x);
+          if (_mm_movemask_ps(_mm_cmpge_ps(depth, box_depth)) != 0) {
+            return true;
+          }
+        }
+        for (; x < tile_x_end; x++) {
+          if (row[x] >= min_depth) {
+            return true;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
+
+/*******************************************************************************
+ * Getters
+ ******************************************************************************/
+
+int as::OcclusionBuffer::GetWidth() const { return width_; }
+
+int as::OcclusionBuffer::GetHeight() const { return height_; }
+
+const std::vector<float> &as::OcclusionBuffer::GetDepths() const {
+  return depths_;
+}
+
+size_t as::OcclusionBuffer::GetNumTriangles() const {
+  return triangles_.size();
+}
+
+/*******************************************************************************
+ * Constants (Private)
+ ******************************************************************************/
+
+const int as::OcclusionBuffer::kTileWidth = 32;
+
+const int as::OcclusionBuffer::kTileHeight = 16;
+
+const unsigned int as::OcclusionBuffer::kMaxNumThreads = 8;
+
+const float as::OcclusionBuffer::kMinArea = 1e-6f;
+
+/*******************************************************************************
+ * Recordings (Private)
+ ******************************************************************************/
+
+/*
+ * Rejects the triangle outside any side of the frustum, and clips it against
+ * the near plane, which may split it into two triangles
+ */
+void as::OcclusionBuffer::AddClipTriangle(const glm::vec4 &clip_pos0,
+                                          const glm::vec4 &clip_pos1,
+                                          const glm::vec4 &clip_pos2) {
+  const glm::vec4 clip_poses[3] = {clip_pos0, clip_pos1, clip_pos2};
+  // Reject the triangle
+  for (int axis = 0; axis < 3; axis++) {
+    bool is_outside_pos = true;
+    bool is_outside_neg = true;
+    for (const glm::vec4 &clip_pos : clip_poses) {
+      is_outside_pos = is_outside_pos && clip_pos[axis] > clip_pos.w;
+      is_outside_neg = is_outside_neg && clip_pos[axis] < -clip_pos.w;
+    }
+    if (is_outside_pos || is_outside_neg) {
+      return;
+    }
+  }
+  // Clip the triangle against the near plane
+  glm::vec4 polygon[4];
+  int num_polygon_poses = 0;
+  for (int pos_idx = 0; pos_idx < 3; pos_idx++) {
+    const glm::vec4 &cur_pos = clip_poses[pos_idx];
+    const glm::vec4 &next_pos = clip_poses[(pos_idx + 1) % 3];
+    const float cur_dist = cur_pos.z + cur_pos.w;
+    const float next_dist = next_pos.z + next_pos.w;
+    if (cur_dist >= 0.0f) {
+      polygon[num_polygon_poses++] = cur_pos;
+    }
+    if ((cur_dist >= 0.0f) != (next_dist >= 0.0f)) {
+      const float t = cur_dist / (cur_dist - next_dist);
+      polygon[num_polygon_poses++] = cur_pos + t * (next_pos - cur_pos);
+    }
+  }
+  // Split the polygon into triangles
+  for (int pos_idx = 1; pos_idx + 1 < num_polygon_poses; pos_idx++) {
+    AddScreenTriangle(ToScreenPos(polygon[0]), ToScreenPos(polygon[pos_idx]),
+                      ToScreenPos(polygon[pos_idx + 1]));
+  }
+}
+
+/*
+ * Bins the triangle into the tiles it overlaps. The triangles are rasterized
+ * on both sides because the occluders may not be closed.
+ */
+void as::OcclusionBuffer::AddScreenTriangle(const glm::vec3 &pos0,
+                                            const glm::vec3 &pos1,
+                                            const glm::vec3 &pos2) {
+  Triangle triangle;
+  triangle.poses[0] = pos0;
+  triangle.poses[1] = pos1;
+  triangle.poses[2] = pos2;
+  // Make the triangle counter-clockwise
+  const float area = (pos1.x - pos0.x) * (pos2.y - pos0.y) -
+                     (pos1.y - pos0.y) * (pos2.x - pos0.x);
+  if (std::abs(area) < kMinArea) {
+    return;
+  }
+  if (area < 0.0f) {
+    std::swap(triangle.poses[1], triangle.poses[2]);
+  }
+  // Skip the triangle which covers no pixel centers
+  int x_begin;
+  int x_end;
+  int y_begin;
+  int y_end;
+  if (!GetPixelRange(std::min({pos0.x, pos1.x, pos2.x}),
+                     std::max({pos0.x, pos1.x, pos2.x}), width_, x_begin,
+                     x_end) ||
+      !GetPixelRange(std::min({pos0.y, pos1.y, pos2.y}),
+                     std::max({pos0.y, pos1.y, pos2.y}), height_, y_begin,
+                     y_end)) {
+    return;
+  }
+  // Bin the triangle
+  const size_t triangle_idx = triangles_.size();
+  triangles_.push_back(triangle);
+  for (int tile_y = y_begin / kTileHeight; tile_y <= (y_end - 1) / kTileHeight;
+       tile_y++) {
+    for (int tile_x = x_begin / kTileWidth; tile_x <= (x_end - 1) / kTileWidth;
+         tile_x++) {
+      tile_triangle_idxs_[tile_y * num_tiles_x_ + tile_x].push_back(
+          triangle_idx);
+    }
+  }
+}
+
+glm::vec3 as::OcclusionBuffer::ToScreenPos(const glm::vec4 &clip_pos) const {
+  const glm::vec3 ndc_pos = glm::vec3(clip_pos) / clip_pos.w;
+  return glm::vec3((0.5f * ndc_pos.x + 0.5f) * width_,
+                   (0.5f * ndc_pos.y + 0.5f) * height_,
+                   0.5f * ndc_pos.z + 0.5f);
+}
+
+/*
+ * Finds the pixels whose centers are in the range. Returns false when there
+ * are no such pixels.
+ */
+bool as::OcclusionBuffer::GetPixelRange(const float min_coord,
+                                        const float max_coord, const int size,
+                                        int &begin, int &end) {
+  const float max_pixel = static_cast<float>(size - 1);
+  begin = static_cast<int>(
+      std::ceil(glm::clamp(min_coord - 0.5f, 0.0f, max_pixel + 1.0f)));
+  end = static_cast<int>(
+            std::floor(glm::clamp(max_coord - 0.5f, -1.0f, max_pixel))) +
+        1;
+  return begin < end;
+}
+
+/*******************************************************************************
+ * Rasterization (Private)
+ ******************************************************************************/
+
+void as::OcclusionBuffer::RasterizeTiles(std::atomic<size_t> &next_tile_idx) {
+  while (true) {
+    const size_t tile_idx = next_tile_idx++;
+    if (tile_idx >= tile_triangle_idxs_.size()) {
+      break;
+    }
+    RasterizeTile(tile_idx);
+  }
+}
+
+void as::OcclusionBuffer::RasterizeTile(const size_t tile_idx) {
+  const int tile_x = static_cast<int>(tile_idx % num_tiles_x_) * kTileWidth;
+  const int tile_y = static_cast<int>(tile_idx / num_tiles_x_) * kTileHeight;
+  // Clear the tile
+  for (int y = tile_y; y < tile_y + kTileHeight; y++) {
+    float *row = depths_.data() + y * width_;
+    std::fill(row + tile_x, row + tile_x + kTileWidth, 1.0f);
+  }
+  // Rasterize the triangles
+  for (const size_t triangle_idx : tile_triangle_idxs_[tile_idx]) {
+    RasterizeTriangle(triangles_[triangle_idx], tile_x, tile_y);
+  }
+  // Find the farthest depth
+  float max_depth = 0.0f;
+  for (int y = tile_y; y < tile_y + kTileHeight; y++) {
+    const float *row = depths_.data() + y * width_;
+    max_depth = std::max(
+        max_depth, *std::max_element(row + tile_x, row + tile_x + kTileWidth));
+  }
+  tile_max_depths_[tile_idx] = max_depth;
+}
+
+/*
+ * Evaluates the edge functions at the centers of four pixels at a time, the
+ * pixels inside all edges take the nearer of the stored and interpolated
+ * depths
+ */
+void as::OcclusionBuffer::RasterizeTriangle(const Triangle &triangle,
+                                            const int tile_x,
+                                            const int tile_y) {
+  const glm::vec3 &pos0 = triangle.poses[0];
+  const glm::vec3 &pos1 = triangle.poses[1];
+  const glm::vec3 &pos2 = triangle.poses[2];
+
+  // Find the pixels in the tile
+  int x_begin;
+  int x_end;
+  int y_begin;
+  int y_end;
+  GetPixelRange(std::min({pos0.x, pos1.x, pos2.x}),
+                std::max({pos0.x, pos1.x, pos2.x}), width_, x_begin, x_end);
+  GetPixelRange(std::min({pos0.y, pos1.y, pos2.y}),
+                std::max({pos0.y, pos1.y, pos2.y}), height_, y_begin, y_end);
+  x_begin = std::max(x_begin, tile_x);
+  x_end = std::min(x_end, tile_x + kTileWidth);
+  y_begin = std::max(y_begin, tile_y);
+  y_end = std::min(y_end, tile_y + kTileHeight);
+  // Align the pixels to the groups of four
+  x_begin = tile_x + ((x_begin - tile_x) & ~3);
+
+  // Set up the edge functions, each of which is positive on the inner side of
+  // the edge opposite to a vertex
+  const glm::vec3 edge_as(pos1.y - pos2.y, pos2.y - pos0.y, pos0.y - pos1.y);
+  const glm::vec3 edge_bs(pos2.x - pos1.x, pos0.x - pos2.x, pos1.x - pos0.x);
+  const glm::vec3 edge_cs(-edge_as[0] * pos1.x - edge_bs[0] * pos1.y,
+                          -edge_as[1] * pos2.x - edge_bs[1] * pos2.y,
+                          -edge_as[2] * pos0.x - edge_bs[2] * pos0.y);
+  // Set up the depth plane from the barycentric coordinates
+  const float inv_area = 1.0f / (edge_as[2] * pos2.x + edge_bs[2] * pos2.y +
+                                 edge_cs[2]);
+  const glm::vec3 depths(pos0.z, pos1.z, pos2.z);
+  const float depth_a = glm::dot(edge_as, depths) * inv_area;
+  const float depth_b = glm::dot(edge_bs, depths) * inv_area;
+  const float depth_c = glm::dot(edge_cs, depths) * inv_area;
+
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 lane_ofses = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 edge_a0 = _mm_set1_ps(edge_as[0]);
+  const __m128 edge_a1 = _mm_set1_ps(edge_as[1]);
+  const __m128 edge_a2 = _mm_set1_ps(edge_as[2]);
+  const __m128 depth_slope = _mm_set1_ps(depth_a);
+  for (int y = y_begin; y < y_end; y++) {
+    const float center_y = y + 0.5f;
+    const __m128 row_edge0 = _mm_set1_ps(edge_bs[0] * center_y + edge_cs[0]);
+    const __m128 row_edge1 = _mm_set1_ps(edge_bs[1] * center_y + edge_cs[1]);
+    const __m128 row_edge2 = _mm_set1_ps(edge_bs[2] * center_y + edge_cs[2]);
+    const __m128 row_depth = _mm_set1_ps(depth_b * center_y + depth_c);
+    float *row = depths_.data() + y * width_;
+    for (int x = x_begin; x < x_end; x += 4) {
+      const __m128 center_x =
+          _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane_ofses);
+      // Find the pixels inside the triangle
+      const __m128 edge0 = _mm_add_ps(_mm_mul_ps(edge_a0, center_x), row_edge0);
+      const __m128 edge1 = _mm_add_ps(_mm_mul_ps(edge_a1, center_x), row_edge1);
+      const __m128 edge2 = _mm_add_ps(_mm_mul_ps(edge_a2, center_x), row_edge2);
+      const __m128 inside = _mm_and_ps(
+          _mm_cmpge_ps(edge0, zero),
+          _mm_and_ps(_mm_cmpge_ps(edge1, zero), _mm_cmpge_ps(edge2, zero)));
+      if (_mm_movemask_ps(inside) == 0) {
+        continue;
+      }
+      // Keep the nearer depths
+      const __m128 depth =
+          _mm_add_ps(_mm_mul_ps(depth_slope, center_x), row_depth);
+      const __m128 stored_depth = _mm_loadu_ps(row + x);
+      const __m128 nearer_depth = _mm_min_ps(stored_depth, depth);
+      _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer_depth),
+                                       _mm_andnot_ps(inside, stored_depth)));
+    }
+  }
+}
@@ -0,0 +1,143 @@
+#include "as/trans/shadow_cascades.hpp"
+
+as::ShadowCascades::ShadowCascades()
+    : num_cascades_(0),
+      bounding_min_(glm::vec3(-1.0f)),
+      bounding_max_(glm::vec3(1.0f)) {}
+
+/*******************************************************************************
+ * Fittings
+ ******************************************************************************/
+
+/*
+ * The camera projection should be a perspective projection. The near planes
+ * of the cascades are moved toward the light by the caster distance, so that
+ * the casters in front of the slices are also drawn into the shadow map.
+ */
+void as::ShadowCascades::Fit(const glm::mat4 &camera_proj,
+                             const glm::mat4 &camera_view,
+                             const glm::mat4 &light_view,
+                             const int num_cascades, const float max_dist,
+                             const float caster_dist, const int map_size) {
+  if (num_cascades < 1 || num_cascades > kMaxNumCascades) {
+    throw std::runtime_error("Invalid number of shadow cascades '" +
+                             std::to_string(num_cascades) + "'");
+  }
+  num_cascades_ = num_cascades;
+
+  // Get the near and far planes from the perspective projection
+  const float camera_near = camera_proj[3][2] / (camera_proj[2][2] - 1.0f);
+  const float camera_far = camera_proj[3][2] / (camera_proj[2][2] + 1.0f);
+  const float max_depth = std::min(camera_far, max_dist);
+  // Get the corners of the near and far planes in the camera space
+  const glm::mat4 inv_proj = glm::inverse(camera_proj);
+  glm::vec3 near_corners[4];
+  glm::vec3 far_corners[4];
+  for (int corner_idx = 0; corner_idx < 4; corner_idx++) {
+    const float x = (corner_idx & 1) ? 1.0f : -1.0f;
+    const float y = (corner_idx & 2) ? 1.0f : -1.0f;
+    near_corners[corner_idx] = Unproject(inv_proj, glm::vec3(x, y, -1.0f));
+    far_corners[corner_idx] = Unproject(inv_proj, glm::vec3(x, y, 1.0f));
+  }
+  // Get the transformation from the camera space to the light space
+  const glm::mat4 camera_to_light = light_view * glm::inverse(camera_view);
+
+  bounding_min_ = glm::vec3(std::numeric_limits<float>::max());
+  bounding_max_ = glm::vec3(std::numeric_limits<float>::lowest());
+  float begin_depth = camera_near;
+  for (int cascade_idx = 0; cascade_idx < num_cascades; cascade_idx++) {
+    // Blend the logarithmic and uniform splits
+    const float split_ratio =
+        static_cast<float>(cascade_idx + 1) / static_cast<float>(num_cascades);
+    const float log_depth =
+        camera_near * std::pow(max_depth / camera_near, split_ratio);
+    const float uniform_depth =
+        camera_near + (max_depth - camera_near) * split_ratio;
+    const float end_depth =
+        kSplitLambda * log_depth + (1.0f - kSplitLambda) * uniform_depth;
+
+    // Get the corners of the slice in the light space, the depths change
+    // linearly along the edges of the frustum
+    const float begin_ratio =
+        (begin_depth - camera_near) / (camera_far - camera_near);
+    const float end_ratio =
+        (end_depth - camera_near) / (camera_far - camera_near);
+    glm::vec3 corners[8];
+    for (int corner_idx = 0; corner_idx < 4; corner_idx++) {
+      const glm::vec3 &near_corner = near_corners[corner_idx];
+      const glm::vec3 edge = far_corners[corner_idx] - near_corner;
+      corners[2 * corner_idx] = glm::vec3(
+          camera_to_light * glm::vec4(near_corner + begin_ratio * edge, 1.0f));
+      corners[2 * corner_idx + 1] = glm::vec3(
+          camera_to_light * glm::vec4(near_corner + end_ratio * edge, 1.0f));
+    }
+
+    // Enclose the slice with a sphere
+    glm::vec3 center(0.0f);
+    for (const glm::vec3 &corner : corners) {
+      center += corner;
+    }
+    center /= 8.0f;
+    float radius = 0.0f;
+    for (const glm::vec3 &corner : corners) {
+      radius = std::max(radius, glm::distance(corner, center));
+    }
+    // Round up the radius to hide the floating-point errors
+    radius = std::ceil(radius / kRadiusStep) * kRadiusStep;
+    // Move the center in whole texels
+    const float texel_size = 2.0f * radius / static_cast<float>(map_size);
+    center.x = std::floor(center.x / texel_size) * texel_size;
+    center.y = std::floor(center.y / texel_size) * texel_size;
+
+    // The light looks at the negative z direction
+    const glm::vec3 min_pos(center.x - radius, center.y - radius,
+                            -center.z - radius - caster_dist);
+    const glm::vec3 max_pos(center.x + radius, center.y + radius,
+                            -center.z + radius);
+    projs_[cascade_idx] = glm::ortho(min_pos.x, max_pos.x, min_pos.y,
+                                     max_pos.y, min_pos.z, max_pos.z);
+    split_depths_[cascade_idx] = end_depth;
+    // Extend the bounding box
+    bounding_min_ = glm::min(bounding_min_, min_pos);
+    bounding_max_ = glm::max(bounding_max_, max_pos);
+
+    begin_depth = end_depth;
+  }
+}
+
+/*******************************************************************************
+ * Getters
+ ******************************************************************************/
+
+int as::ShadowCascades::GetNumCascades() const { return num_cascades_; }
+
+const glm::mat4 &as::ShadowCascades::GetProj(const int cascade_idx) const {
+  return projs_[cascade_idx];
+}
+
+float as::ShadowCascades::GetSplitDepth(const int cascade_idx) const {
+  return split_depths_[cascade_idx];
+}
+
+glm::mat4 as::ShadowCascades::GetBoundingProj() const {
+  return glm::ortho(bounding_min_.x, bounding_max_.x, bounding_min_.y,
+                    bounding_max_.y, bounding_min_.z, bounding_max_.z);
+}
+
+/*******************************************************************************
+ * Constants (Private)
+ ******************************************************************************/
+
+const float as::ShadowCascades::kSplitLambda = 0.75f;
+
+const float as::ShadowCascades::kRadiusStep = 1.0f / 16.0f;
+
+/*******************************************************************************
+ * Fittings (Private)
+ ******************************************************************************/
+
+glm::vec3 as::ShadowCascades::Unproject(const glm::mat4 &inv_proj,
+                                        const glm::vec3 &ndc_pos) {
+  const glm::vec4 pos = inv_proj * glm::vec4(ndc_pos, 1.0f);
+  return glm::vec3(pos) / pos.w;
+}